@@ -30,6 +30,10 @@ cmake_dependent_option(ENABLE_HDF5
   "Enable analysis methods that use HDF5" OFF
   "ENABLE_SENSEI" OFF)
 
+cmake_dependent_option(ENABLE_SHARED_MEM
+  "Enable the shared memory in transit transport" ON
+  "ENABLE_SENSEI;UNIX" OFF)
+
 cmake_dependent_option(ENABLE_CONDUIT
   "Enable analysis methods that use Conduit" OFF
   "ENABLE_SENSEI" OFF)
@@ -100,6 +104,7 @@ message(STATUS "ENABLE_CATALYST_PYTHON=${ENABLE_CATALYST}")
 message(STATUS "ENABLE_ADIOS1=${ENABLE_ADIOS1}")
 message(STATUS "ENABLE_ADIOS2=${ENABLE_ADIOS2}")
 message(STATUS "ENABLE_HDF5=${ENABLE_HDF5}")
+message(STATUS "ENABLE_SHARED_MEM=${ENABLE_SHARED_MEM}")
 message(STATUS "ENABLE_CONDUIT=${ENABLE_CONDUIT}")
 message(STATUS "ENABLE_ASCENT=${ENABLE_ASCENT}")
 message(STATUS "ENABLE_LIBSIM=${ENABLE_LIBSIM}")
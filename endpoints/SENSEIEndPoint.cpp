@@ -35,6 +35,10 @@ int main(int argc, char **argv)
     >> opts::Option('c', "connection-info", connectionInfo,
        "transport specific connection information");
 
+  bool mpmd = ops >> opts::Present('m', "mpmd",
+    "share MPI_COMM_WORLD with the simulation, as needed by the mpi_in_transit"
+    " transport. The simulation must split MPI_COMM_WORLD with color 0");
+
   if (ops >> opts::Present('h', "help", "show help"))
     {
     if (rank == 0)
@@ -50,6 +54,15 @@ int main(int argc, char **argv)
     MPI_Abort(MPI_COMM_WORLD, 1);
     }
 
+  // when launched together with the simulation the end point runs on its
+  // own ranks. the simulation makes the matching split with color 0.
+  MPI_Comm comm = MPI_COMM_NULL;
+  if (mpmd)
+    {
+    MPI_Comm_split(MPI_COMM_WORLD, 1, rank, &comm);
+    sensei::MPIManager::SetDefaultCommunicator(comm);
+    }
+
   // create the reead side of the transport
   SENSEI_STATUS("Creating transport data adaptor. transport-xml=\""
     << transportXml << "\"")
@@ -119,5 +132,11 @@ int main(int argc, char **argv)
   dataAdaptor = nullptr;
   analysisAdaptor = nullptr;
 
+  if (comm != MPI_COMM_NULL)
+    {
+    sensei::MPIManager::SetDefaultCommunicator(MPI_COMM_WORLD);
+    MPI_Comm_free(&comm);
+    }
+
   return 0;
 }
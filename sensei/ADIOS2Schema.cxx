@@ -1084,7 +1084,7 @@ int ArraySchema::Write(MPI_Comm comm, AdiosHandle handles, unsigned int i,
 
       // do the write
       if (adios2_put(handles.engine, putVar,
-        da->GetVoidPointer(0), adios2_mode_sync))
+        da->GetVoidPointer(0), adios2_mode_deferred))
         {
         SENSEI_ERROR("adios2_put block " << j << " array "
           << i << " failed")
@@ -1409,7 +1409,7 @@ int PointSchema::Write(MPI_Comm comm, AdiosHandle handles,
 
         svtkDataArray *da = ds->GetPoints()->GetData();
         if (adios2_put(handles.engine, putVar,
-          da->GetVoidPointer(0), adios2_mode_sync))
+          da->GetVoidPointer(0), adios2_mode_deferred))
           {
           SENSEI_ERROR("adios2_put \"" << md->MeshName
             << "\" block " << j << " points failed")
@@ -1735,7 +1735,7 @@ int UnstructuredCellSchema::Write(MPI_Comm comm, AdiosHandle handles,
 
         svtkDataArray *cta = ds->GetCellTypesArray();
         if (adios2_put(handles.engine, cellTypeVar,
-          cta->GetVoidPointer(0), adios2_mode_sync))
+          cta->GetVoidPointer(0), adios2_mode_deferred))
           {
           SENSEI_ERROR("adios2_put cell types for mesh \""
             << md->MeshName << "\" block " << j << " failed")
@@ -1758,7 +1758,7 @@ int UnstructuredCellSchema::Write(MPI_Comm comm, AdiosHandle handles,
         svtkDataArray *co = ds->GetCells()->GetOffsetsArray();
 
         if (adios2_put(handles.engine, cellOffsVar,
-          co->GetVoidPointer(0), adios2_mode_sync))
+          co->GetVoidPointer(0), adios2_mode_deferred))
           {
           SENSEI_ERROR("adios2_put cell offsets for mesh \""
             << md->MeshName << "\" block " << j << " failed")
@@ -1779,7 +1779,7 @@ int UnstructuredCellSchema::Write(MPI_Comm comm, AdiosHandle handles,
         svtkDataArray *cc = ds->GetCells()->GetConnectivityArray();
 
         if (adios2_put(handles.engine, cellConnVar,
-          cc->GetVoidPointer(0), adios2_mode_sync))
+          cc->GetVoidPointer(0), adios2_mode_deferred))
           {
           SENSEI_ERROR("adios2_put cell offsets for mesh \""
             << md->MeshName << "\" block " << j << " failed")
@@ -2026,6 +2026,10 @@ struct PolydataCellSchema
   std::map<std::string, adios2_variable*> CellConnVars;
   std::map<std::string, std::vector<size_t>> CellConnStarts;
   std::map<std::string, std::vector<size_t>> CellConnCounts;
+
+  // the cell arrays generated during Write. The puts are deferred, these
+  // are held until the next step is written.
+  std::vector<svtkSmartPointer<svtkDataArray>> Buffers;
 };
 
 // --------------------------------------------------------------------------
@@ -2211,8 +2215,15 @@ int PolydataCellSchema::Write(MPI_Comm comm, AdiosHandle handles,
         size_t ctStart = 4*j;
         size_t ctCount = 4;
 
-        int64_t ct[4] = {ds->GetNumberOfVerts(), ds->GetNumberOfLines(),
-            ds->GetNumberOfPolys(),  ds->GetNumberOfStrips()};
+        svtkAOSDataArrayTemplate<int64_t> *ct = svtkAOSDataArrayTemplate<int64_t>::New();
+        ct->SetNumberOfTuples(4);
+        ct->SetValue(0, ds->GetNumberOfVerts());
+        ct->SetValue(1, ds->GetNumberOfLines());
+        ct->SetValue(2, ds->GetNumberOfPolys());
+        ct->SetValue(3, ds->GetNumberOfStrips());
+
+        this->Buffers.push_back(ct);
+        ct->Delete();
 
         // write the cell types
         if (adios2_set_selection(cellTypeVar, 1, &ctStart, &ctCount))
@@ -2222,7 +2233,8 @@ int PolydataCellSchema::Write(MPI_Comm comm, AdiosHandle handles,
           return -1;
           }
 
-        if (adios2_put(handles.engine, cellTypeVar, ct, adios2_mode_sync))
+        if (adios2_put(handles.engine, cellTypeVar,
+          ct->GetVoidPointer(0), adios2_mode_deferred))
           {
           SENSEI_ERROR("adios2_put cell types for mesh \""
             << md->MeshName << "\" block " << j << " failed")
@@ -2277,6 +2289,12 @@ int PolydataCellSchema::Write(MPI_Comm comm, AdiosHandle handles,
 
             co = tco;
             cc = tcc;
+
+            this->Buffers.push_back(co);
+            this->Buffers.push_back(cc);
+
+            tco->Delete();
+            tcc->Delete();
             )
           default:
             {
@@ -2294,7 +2312,7 @@ int PolydataCellSchema::Write(MPI_Comm comm, AdiosHandle handles,
           }
 
         if (adios2_put(handles.engine, cellOffsVar,
-          co->GetVoidPointer(0), adios2_mode_sync))
+          co->GetVoidPointer(0), adios2_mode_deferred))
           {
           SENSEI_ERROR("adios2_put cell offsets for mesh \""
             << md->MeshName << "\" block " << j << " failed")
@@ -2310,16 +2328,13 @@ int PolydataCellSchema::Write(MPI_Comm comm, AdiosHandle handles,
           }
 
         if (adios2_put(handles.engine, cellConnVar,
-          cc->GetVoidPointer(0), adios2_mode_sync))
+          cc->GetVoidPointer(0), adios2_mode_deferred))
           {
           SENSEI_ERROR("adios2_put cell offsets for mesh \""
             << md->MeshName << "\" block " << j << " failed")
           return -1;
           }
 
-        co->Delete();
-        cc->Delete();
-
         // track number of bytes for profiling
         numBytes += 4 *sizeof(uint64_t) + (coCount + ccCount) * elemSize;
         }
@@ -2647,18 +2662,18 @@ int LogicallyCartesianSchema::Write(MPI_Comm comm, AdiosHandle handles,
           case SVTK_RECTILINEAR_GRID:
             ierr = adios2_put(handles.engine, writeVar,
               dynamic_cast<svtkRectilinearGrid*>(dobj)->GetExtent(),
-              adios2_mode_sync);
+              adios2_mode_deferred);
             break;
 
           case SVTK_IMAGE_DATA:
           case SVTK_UNIFORM_GRID:
             ierr = adios2_put(handles.engine, writeVar,
-              dynamic_cast<svtkImageData*>(dobj)->GetExtent(), adios2_mode_sync);
+              dynamic_cast<svtkImageData*>(dobj)->GetExtent(), adios2_mode_deferred);
             break;
 
           case SVTK_STRUCTURED_GRID:
             ierr = adios2_put(handles.engine, writeVar,
-              dynamic_cast<svtkStructuredGrid*>(dobj)->GetExtent(), adios2_mode_sync);
+              dynamic_cast<svtkStructuredGrid*>(dobj)->GetExtent(), adios2_mode_deferred);
             break;
           }
 
@@ -2884,7 +2899,7 @@ int UniformCartesianSchema::Write(MPI_Comm comm, AdiosHandle handles,
           }
 
         if (adios2_put(handles.engine, originWriteVar,
-          ds->GetOrigin(), adios2_mode_sync))
+          ds->GetOrigin(), adios2_mode_deferred))
           {
           SENSEI_ERROR("adios2_put origin block " << j << " failed")
           return -1;
@@ -2898,7 +2913,7 @@ int UniformCartesianSchema::Write(MPI_Comm comm, AdiosHandle handles,
           }
 
         if (adios2_put(handles.engine, spacingWriteVar,
-          ds->GetSpacing(), adios2_mode_sync))
+          ds->GetSpacing(), adios2_mode_deferred))
           {
           SENSEI_ERROR("adios2_put spacing block " << j << " failed")
           return -1;
@@ -3232,7 +3247,7 @@ int StretchedCartesianSchema::Write(MPI_Comm comm, AdiosHandle handles,
 
         svtkDataArray *xda = ds->GetXCoordinates();
         if (adios2_put(handles.engine, xcVar,
-          xda->GetVoidPointer(0), adios2_mode_sync))
+          xda->GetVoidPointer(0), adios2_mode_deferred))
           {
           SENSEI_ERROR("adios2_put x-coordinates block " << j << " failed")
           return -1;
@@ -3250,7 +3265,7 @@ int StretchedCartesianSchema::Write(MPI_Comm comm, AdiosHandle handles,
 
         svtkDataArray *yda = ds->GetYCoordinates();
         if (adios2_put(handles.engine, ycVar,
-          yda->GetVoidPointer(0), adios2_mode_sync))
+          yda->GetVoidPointer(0), adios2_mode_deferred))
           {
           SENSEI_ERROR("adios2_put y-coordinates block " << j << " failed")
           return -1;
@@ -3267,7 +3282,7 @@ int StretchedCartesianSchema::Write(MPI_Comm comm, AdiosHandle handles,
           }
 
         if (adios2_put(handles.engine, zcVar,
-          zda->GetVoidPointer(0), adios2_mode_sync))
+          zda->GetVoidPointer(0), adios2_mode_deferred))
           {
           SENSEI_ERROR("adios2_put y-coordinates block " << j << " failed")
           return -1;
@@ -3478,6 +3493,9 @@ struct DataObjectSchema
   int InitializeDataObject(MPI_Comm comm,
     const sensei::MeshMetadataPtr &md, svtkCompositeDataSet *&dobj);
 
+  // release data generated for the previous step's deferred puts
+  void ReleaseBuffers();
+
   ArraySchema DataArrays;
   PointSchema Points;
   UnstructuredCellSchema UnstructuredCells;
@@ -3514,6 +3532,12 @@ int DataObjectSchema::DefineVariables(MPI_Comm comm, AdiosHandle handles,
   return 0;
 }
 
+// --------------------------------------------------------------------------
+void DataObjectSchema::ReleaseBuffers()
+{
+  this->PolydataCells.Buffers.clear();
+}
+
 // --------------------------------------------------------------------------
 int DataObjectSchema::Write(MPI_Comm comm, AdiosHandle handles, unsigned int doid,
   const sensei::MeshMetadataPtr &md, svtkCompositeDataSet *dobj)
@@ -3852,6 +3876,9 @@ int DataObjectCollectionSchema::Write(MPI_Comm comm, AdiosHandle handles,
     return -1;
     }
 
+  // the previous step's puts have been performed
+  this->Internals->DataObject.ReleaseBuffers();
+
   // write the schema version
   if (this->Internals->Version.Write(handles))
     {
@@ -3859,6 +3886,9 @@ int DataObjectCollectionSchema::Write(MPI_Comm comm, AdiosHandle handles,
     return -1;
     }
 
+  // the scalars and the metadata are small and do not outlive this call,
+  // these are put synchronously. the arrays are deferred.
+
   // /time_step
   if (adios2_put_by_name(handles.engine, "time_step", &time_step, adios2_mode_sync))
     {
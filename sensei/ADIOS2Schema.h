@@ -65,7 +65,9 @@ public:
   // get the number of meshes available. Available after ReadMeshMetadata
   int GetNumberOfObjects(unsigned int &num);
 
-  // write the object collection
+  // write the object collection. The arrays are put in deferred mode, the
+  // caller must keep the objects alive until adios2_perform_puts or
+  // adios2_end_step has been called for the step.
   int Write(MPI_Comm comm, AdiosHandle handles, unsigned long time_step, double time,
     const std::vector<sensei::MeshMetadataPtr> &metadata,
     const std::vector<svtkCompositeDataSetPtr> &objects);
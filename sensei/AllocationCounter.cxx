@@ -0,0 +1,99 @@
+// AllocationCounter - counts the bytes allocated by each thread
+//
+// This is a small library that is loaded with LD_PRELOAD. It interposes
+// the C allocation functions, and through them C++ new, passing the calls
+// on to glibc's allocator after adding the requested size to a per-thread
+// count. The Profiler looks up sensei_allocated_bytes at initialization and,
+// when memory use is recorded with events, reports the bytes allocated by
+// the thread in each event. For example:
+//
+//     export LD_PRELOAD=libsenseiAllocationCounter.so PROFILER_ENABLE=0x15
+//     mpiexec -np 4 oscillator -f config.xml sample.osc
+//
+// Only glibc based systems are supported.
+
+#include <cstddef>
+#include <cerrno>
+
+extern "C"
+{
+void *__libc_malloc(size_t n);
+void *__libc_calloc(size_t n, size_t size);
+void *__libc_realloc(void *ptr, size_t n);
+void *__libc_memalign(size_t alignment, size_t n);
+void __libc_free(void *ptr);
+
+// the bytes allocated by the thread. initial-exec TLS does not allocate
+static __thread unsigned long long allocatedBytes
+  __attribute__((tls_model("initial-exec"))) = 0;
+
+// --------------------------------------------------------------------------
+__attribute__((visibility("default")))
+unsigned long long sensei_allocated_bytes()
+{
+  return allocatedBytes;
+}
+
+// --------------------------------------------------------------------------
+__attribute__((visibility("default")))
+void *malloc(size_t n)
+{
+  allocatedBytes += n;
+  return __libc_malloc(n);
+}
+
+// --------------------------------------------------------------------------
+__attribute__((visibility("default")))
+void *calloc(size_t n, size_t size)
+{
+  allocatedBytes += n*size;
+  return __libc_calloc(n, size);
+}
+
+// --------------------------------------------------------------------------
+__attribute__((visibility("default")))
+void *realloc(void *ptr, size_t n)
+{
+  allocatedBytes += n;
+  return __libc_realloc(ptr, n);
+}
+
+// --------------------------------------------------------------------------
+__attribute__((visibility("default")))
+void free(void *ptr)
+{
+  __libc_free(ptr);
+}
+
+// --------------------------------------------------------------------------
+__attribute__((visibility("default")))
+void *memalign(size_t alignment, size_t n)
+{
+  allocatedBytes += n;
+  return __libc_memalign(alignment, n);
+}
+
+// --------------------------------------------------------------------------
+__attribute__((visibility("default")))
+void *aligned_alloc(size_t alignment, size_t n)
+{
+  allocatedBytes += n;
+  return __libc_memalign(alignment, n);
+}
+
+// --------------------------------------------------------------------------
+__attribute__((visibility("default")))
+int posix_memalign(void **ptr, size_t alignment, size_t n)
+{
+  if ((alignment % sizeof(void*)) || (alignment & (alignment - 1)))
+    return EINVAL;
+
+  void *tmp = __libc_memalign(alignment, n);
+  if (!tmp && n)
+    return ENOMEM;
+
+  allocatedBytes += n;
+  *ptr = tmp;
+  return 0;
+}
+}
@@ -1,4 +1,5 @@
 #include "AnalysisAdaptor.h"
+#include "MPIManager.h"
 
 namespace sensei
 {
@@ -6,7 +7,7 @@ namespace sensei
 //----------------------------------------------------------------------------
 AnalysisAdaptor::AnalysisAdaptor() : Verbose(0)
 {
-  MPI_Comm_dup(MPI_COMM_WORLD, &this->Comm);
+  MPI_Comm_dup(MPIManager::GetDefaultCommunicator(), &this->Comm);
 }
 
 //----------------------------------------------------------------------------
@@ -0,0 +1,337 @@
+#include "AsyncAnalysisAdaptor.h"
+#include "SVTKDataAdaptor.h"
+#include "DataRequirements.h"
+#include "Profiler.h"
+#include "Error.h"
+
+#include <svtkObjectFactory.h>
+#include <svtkSmartPointer.h>
+#include <svtkDataObject.h>
+
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+using SVTKDataAdaptorPtr = svtkSmartPointer<sensei::SVTKDataAdaptor>;
+
+namespace sensei
+{
+
+struct AsyncAnalysisAdaptor::InternalsType
+{
+  InternalsType() : MaxInFlight(2), OverflowMode(OVERFLOW_BLOCK),
+    Threaded(false), Shutdown(false), Error(false), Dropped(0) {}
+
+  // the worker thread's main loop
+  void Work();
+
+  svtkSmartPointer<AnalysisAdaptor> Analysis;
+  DataRequirements Requirements;
+  unsigned int MaxInFlight;
+  int OverflowMode;
+  bool Threaded;
+
+  // snapshot slots, each one has its own communicator which is
+  // used by the wrapped analysis when it queries metadata
+  std::vector<SVTKDataAdaptorPtr> Snapshots;
+  std::deque<SVTKDataAdaptor*> Free;
+  std::deque<SVTKDataAdaptor*> Pending;
+
+  std::thread Worker;
+  std::mutex Mutex;
+  std::condition_variable Cond;
+  bool Shutdown;
+  bool Error;
+  unsigned long Dropped;
+};
+
+// --------------------------------------------------------------------------
+void AsyncAnalysisAdaptor::InternalsType::Work()
+{
+  while (true)
+    {
+    SVTKDataAdaptor *snap = nullptr;
+      {
+      std::unique_lock<std::mutex> lock(this->Mutex);
+      this->Cond.wait(lock, [this]() {
+        return this->Shutdown || !this->Pending.empty(); });
+
+      if (this->Pending.empty())
+        break;
+
+      snap = this->Pending.front();
+      this->Pending.pop_front();
+      }
+
+    bool ok = true;
+      {
+      TimeEvent<128> mark("AsyncAnalysisAdaptor::Work");
+      ok = this->Analysis->Execute(snap, nullptr);
+      snap->ReleaseData();
+      }
+
+      {
+      std::lock_guard<std::mutex> lock(this->Mutex);
+      if (!ok)
+        {
+        SENSEI_ERROR("Failed to execute " << this->Analysis->GetClassName())
+        this->Error = true;
+        }
+      this->Free.push_back(snap);
+      }
+    this->Cond.notify_all();
+    }
+}
+
+//----------------------------------------------------------------------------
+senseiNewMacro(AsyncAnalysisAdaptor);
+
+//----------------------------------------------------------------------------
+AsyncAnalysisAdaptor::AsyncAnalysisAdaptor() :
+  Internals(new AsyncAnalysisAdaptor::InternalsType)
+{
+}
+
+//----------------------------------------------------------------------------
+AsyncAnalysisAdaptor::~AsyncAnalysisAdaptor()
+{
+  // normally the worker is joined in Finalize
+  if (this->Internals->Worker.joinable())
+    {
+      {
+      std::lock_guard<std::mutex> lock(this->Internals->Mutex);
+      this->Internals->Shutdown = true;
+      }
+    this->Internals->Cond.notify_all();
+    this->Internals->Worker.join();
+    }
+
+  delete this->Internals;
+}
+
+//----------------------------------------------------------------------------
+int AsyncAnalysisAdaptor::SetAnalysis(AnalysisAdaptor *analysis)
+{
+  if (this->Internals->Worker.joinable())
+    {
+    SENSEI_ERROR("The analysis cannot be changed after Initialize")
+    return -1;
+    }
+
+  this->Internals->Analysis = analysis;
+  return 0;
+}
+
+//----------------------------------------------------------------------------
+AnalysisAdaptor *AsyncAnalysisAdaptor::GetAnalysis()
+{
+  return this->Internals->Analysis.GetPointer();
+}
+
+//----------------------------------------------------------------------------
+int AsyncAnalysisAdaptor::SetDataRequirements(const DataRequirements &reqs)
+{
+  this->Internals->Requirements = reqs;
+  return 0;
+}
+
+//----------------------------------------------------------------------------
+int AsyncAnalysisAdaptor::SetMaxInFlight(unsigned int n)
+{
+  if (n < 1)
+    {
+    SENSEI_ERROR("At least one step must be allowed in flight")
+    return -1;
+    }
+
+  this->Internals->MaxInFlight = n;
+  return 0;
+}
+
+//----------------------------------------------------------------------------
+int AsyncAnalysisAdaptor::SetOverflowMode(int mode)
+{
+  if ((mode != OVERFLOW_BLOCK) && (mode != OVERFLOW_DROP))
+    {
+    SENSEI_ERROR("Invalid overflow mode " << mode)
+    return -1;
+    }
+
+  this->Internals->OverflowMode = mode;
+  return 0;
+}
+
+//----------------------------------------------------------------------------
+int AsyncAnalysisAdaptor::SetOverflowMode(const std::string &mode)
+{
+  if (mode == "block")
+    return this->SetOverflowMode(OVERFLOW_BLOCK);
+  else if (mode == "drop")
+    return this->SetOverflowMode(OVERFLOW_DROP);
+
+  SENSEI_ERROR("Invalid overflow mode \"" << mode
+    << "\". Use one of \"block\" or \"drop\"")
+  return -1;
+}
+
+//----------------------------------------------------------------------------
+unsigned long AsyncAnalysisAdaptor::GetNumberOfDroppedSteps()
+{
+  std::lock_guard<std::mutex> lock(this->Internals->Mutex);
+  return this->Internals->Dropped;
+}
+
+//----------------------------------------------------------------------------
+int AsyncAnalysisAdaptor::Initialize()
+{
+  TimeEvent<128> mark("AsyncAnalysisAdaptor::Initialize");
+
+  if (!this->Internals->Analysis)
+    {
+    SENSEI_ERROR("No analysis was set")
+    return -1;
+    }
+
+  // the wrapped analysis will make MPI calls from the worker thread
+  // concurrently with the simulation
+  int threadLevel = MPI_THREAD_SINGLE;
+  MPI_Query_thread(&threadLevel);
+  if (threadLevel < MPI_THREAD_MULTIPLE)
+    {
+    SENSEI_WARNING("MPI was not initialized with MPI_THREAD_MULTIPLE. "
+      << this->Internals->Analysis->GetClassName() << " will run synchronously")
+    this->Internals->Threaded = false;
+    return 0;
+    }
+
+  this->Internals->Snapshots.resize(this->Internals->MaxInFlight);
+  for (unsigned int i = 0; i < this->Internals->MaxInFlight; ++i)
+    {
+    SVTKDataAdaptorPtr snap = SVTKDataAdaptorPtr::New();
+    snap->SetCommunicator(this->GetCommunicator());
+    this->Internals->Snapshots[i] = snap;
+    this->Internals->Free.push_back(snap.GetPointer());
+    }
+
+  this->Internals->Threaded = true;
+  this->Internals->Worker = std::thread(&InternalsType::Work, this->Internals);
+
+  return 0;
+}
+
+//----------------------------------------------------------------------------
+bool AsyncAnalysisAdaptor::Execute(DataAdaptor* data, DataAdaptor** dataOut)
+{
+  TimeEvent<128> mark("AsyncAnalysisAdaptor::Execute");
+
+  if (!this->Internals->Threaded)
+    return this->Internals->Analysis->Execute(data, dataOut);
+
+  // output is not available from an analysis running in the background
+  if (dataOut)
+    *dataOut = nullptr;
+
+  SVTKDataAdaptor *snap = nullptr;
+
+  std::unique_lock<std::mutex> lock(this->Internals->Mutex);
+  if (this->Internals->OverflowMode == OVERFLOW_DROP)
+    {
+    // all ranks must agree to drop the step else the analysis' collectives
+    // would not match up. slots are only released while we wait so a slot
+    // seen here remains available. a failure on any rank is agreed upon in
+    // the same reduction so that no rank is left waiting in it.
+    int state[2] = {this->Internals->Error ? 1 : 0,
+      this->Internals->Free.empty() ? 1 : 0};
+    lock.unlock();
+
+    int anyState[2] = {0, 0};
+    MPI_Allreduce(state, anyState, 2, MPI_INT, MPI_MAX, this->GetCommunicator());
+
+    if (anyState[0])
+      return false;
+
+    lock.lock();
+    if (anyState[1])
+      {
+      this->Internals->Dropped += 1;
+      if (this->GetVerbose())
+        {
+        SENSEI_STATUS("Dropped step " << data->GetDataTimeStep() << " for "
+          << this->Internals->Analysis->GetClassName())
+        }
+      return true;
+      }
+    }
+  else
+    {
+    TimeEvent<128> wait("AsyncAnalysisAdaptor::Wait");
+    this->Internals->Cond.wait(lock, [this]() {
+      return this->Internals->Error || !this->Internals->Free.empty(); });
+
+    if (this->Internals->Error)
+      return false;
+    }
+
+  snap = this->Internals->Free.front();
+  this->Internals->Free.pop_front();
+  lock.unlock();
+
+  // the simulation is free to modify its data once we return, hence the
+  // deep copy
+  if (snap->SetDataObjects(data, this->Internals->Requirements, true))
+    {
+    SENSEI_ERROR("Failed to snapshot the data for "
+      << this->Internals->Analysis->GetClassName())
+    lock.lock();
+    this->Internals->Free.push_back(snap);
+    return false;
+    }
+
+  lock.lock();
+  this->Internals->Pending.push_back(snap);
+  lock.unlock();
+
+  this->Internals->Cond.notify_all();
+
+  return true;
+}
+
+//----------------------------------------------------------------------------
+int AsyncAnalysisAdaptor::Finalize()
+{
+  TimeEvent<128> mark("AsyncAnalysisAdaptor::Finalize");
+
+  // process the steps that are still in flight
+  if (this->Internals->Worker.joinable())
+    {
+      {
+      std::lock_guard<std::mutex> lock(this->Internals->Mutex);
+      this->Internals->Shutdown = true;
+      }
+    this->Internals->Cond.notify_all();
+    this->Internals->Worker.join();
+    }
+
+  this->Internals->Snapshots.clear();
+  this->Internals->Free.clear();
+
+  if (this->Internals->Dropped)
+    {
+    SENSEI_STATUS(<< this->Internals->Analysis->GetClassName() << " dropped "
+      << this->Internals->Dropped << " steps")
+    }
+
+  int ierr = this->Internals->Analysis->Finalize();
+
+  return (ierr || this->Internals->Error) ? -1 : 0;
+}
+
+//----------------------------------------------------------------------------
+void AsyncAnalysisAdaptor::PrintSelf(ostream& os, svtkIndent indent)
+{
+  this->Superclass::PrintSelf(os, indent);
+}
+
+}
@@ -0,0 +1,89 @@
+#ifndef sensei_AsyncAnalysisAdaptor_h
+#define sensei_AsyncAnalysisAdaptor_h
+
+#include "AnalysisAdaptor.h"
+
+#include <string>
+#include <mpi.h>
+
+namespace sensei
+{
+class DataRequirements;
+
+/** An adaptor that runs another analysis asynchronously. When Execute is
+ * called a deep copy of the meshes and arrays named in the data requirements
+ * is taken and queued, and control is returned to the simulation right away. A
+ * background worker thread passes each snapshot to the wrapped analysis in
+ * the order they were taken. The number of snapshots that may be in flight is
+ * bounded. When the worker falls behind, Execute either blocks until a
+ * snapshot is released or, in drop mode, all ranks agree to skip the step.
+ *
+ * Because the wrapped analysis makes MPI calls from the worker thread, MPI
+ * must be initialized with MPI_THREAD_MULTIPLE. When it is not, a warning is
+ * issued and the wrapped analysis is run synchronously.
+ */
+class SENSEI_EXPORT AsyncAnalysisAdaptor : public AnalysisAdaptor
+{
+public:
+  /// creates a new instance
+  static AsyncAnalysisAdaptor *New();
+
+  senseiTypeMacro(AsyncAnalysisAdaptor, AnalysisAdaptor);
+
+  /// Prints the current adaptor state
+  void PrintSelf(ostream& os, svtkIndent indent) override;
+
+  /// how Execute behaves when all snapshot slots are in use
+  enum {OVERFLOW_BLOCK = 0, OVERFLOW_DROP = 1};
+
+  /** Set the analysis to run in the background. The analysis should be
+   * fully configured. It must be set before calling Initialize.
+   */
+  int SetAnalysis(AnalysisAdaptor *analysis);
+
+  /// Get the wrapped analysis
+  AnalysisAdaptor *GetAnalysis();
+
+  /** Set the meshes and arrays that are copied into each snapshot. When
+   * empty, all meshes and arrays the simulation provides are copied.
+   */
+  int SetDataRequirements(const DataRequirements &reqs);
+
+  /// Set the maximum number of steps in flight. The default is 2.
+  int SetMaxInFlight(unsigned int n);
+
+  /** Set the behavior when the worker falls behind. One of OVERFLOW_BLOCK or
+   * OVERFLOW_DROP, or by name "block" or "drop". The default is to block.
+   */
+  int SetOverflowMode(int mode);
+  int SetOverflowMode(const std::string &mode);
+
+  /// Get the number of steps that were skipped in drop mode
+  unsigned long GetNumberOfDroppedSteps();
+
+  /** Allocates the snapshot slots and starts the worker thread. Call after
+   * the communicator and analysis have been set.
+   */
+  int Initialize();
+
+  /// Snapshots the required data and queues it for processing
+  bool Execute(DataAdaptor* data, DataAdaptor** dataOut) override;
+
+  /// Waits for queued steps to complete then finalizes the wrapped analysis
+  int Finalize() override;
+
+protected:
+  AsyncAnalysisAdaptor();
+  ~AsyncAnalysisAdaptor();
+
+  AsyncAnalysisAdaptor(const AsyncAnalysisAdaptor&) = delete;
+  void operator=(const AsyncAnalysisAdaptor&) = delete;
+
+private:
+  struct InternalsType;
+  InternalsType *Internals;
+};
+
+}
+
+#endif
@@ -4,14 +4,17 @@
 #include "MeshMetadata.h"
 #include "MeshMetadataMap.h"
 #include "SVTKUtils.h"
+#include "MemoryUtils.h"
 #include "Profiler.h"
 #include "Error.h"
 
 // SVTK includes
+#include <svtkAOSDataArrayTemplate.h>
+#include <svtkSOADataArrayTemplate.h>
 #include <svtkCompositeDataIterator.h>
 #include <svtkCellData.h>
 #include <svtkFieldData.h>
-#include <svtkFloatArray.h>
+#include <svtkDataArray.h>
 #include <svtkImageData.h>
 #include <svtkMultiBlockDataSet.h>
 #include <svtkObjectFactory.h>
@@ -21,8 +24,17 @@
 
 #include <memory>
 #include <vector>
+#include <map>
+#include <set>
+#include <mutex>
+#include <future>
+#include <limits>
+#include <algorithm>
+#include <cmath>
+#include <unistd.h>
 
 #include <sdiy/master.hpp>
+#include <sdiy/storage.hpp>
 #include <sdiy/reduce.hpp>
 #include <sdiy/partners/merge.hpp>
 #include <sdiy/io/numpy.hpp>
@@ -65,6 +77,14 @@ using GridRef = sdiy::GridRef<float,3>;
 using Vertex  = GridRef::Vertex;
 using Vertex4D = Vertex::UPoint;
 
+/** The correlation of each point of a block with its values at earlier
+ * steps, and the values of the last window steps. Both grids are stored in
+ * Fortran order, so that the shift is the slowest varying index and each
+ * shift is a contiguous plane with the same layout as the simulation's data.
+ * This lets the updates run as vectorizable loops over the points. Blocks are
+ * only touched by the thread processing them. Whatever the type of the
+ * simulation's data the correlations are accumulated in single precision.
+ */
 struct AutocorrelationImpl
 {
   using Grid = sdiy::Grid<float,4>;
@@ -74,57 +94,96 @@ struct AutocorrelationImpl
     from(from_), to(to_),
     shape(to - from + Vertex::one()),
     // init grid with (to - from + 1) in 3D, and window in the 4-th dimension
-    values(shape.lift(3, window)),
-    corr(shape.lift(3, window))
-  { corr = 0; }
+    values(shape.lift(3, window), false),
+    corr(shape.lift(3, window), false)
+  { corr = 0; values = 0; }
 
   static void* create()            { return new AutocorrelationImpl; }
   static void destroy(void* b)    { delete static_cast<AutocorrelationImpl*>(b); }
-  void process(float* data, unsigned char *ghostArray)
+
+  // used by sdiy to move blocks that do not fit in memory to and from files
+  static void save(const void* b_, sdiy::BinaryBuffer& bb)
     {
-    GridRef g(data, shape);
+    const AutocorrelationImpl* b = static_cast<const AutocorrelationImpl*>(b_);
+    sdiy::save(bb, b->window);
+    sdiy::save(bb, b->gid);
+    sdiy::save(bb, b->from);
+    sdiy::save(bb, b->to);
+    sdiy::save(bb, b->offset);
+    sdiy::save(bb, b->count);
+    sdiy::save(bb, b->values.data(), b->values.size());
+    sdiy::save(bb, b->corr.data(), b->corr.size());
+    }
 
-    if (ghostArray)
-      {
-      sdiy::GridRef<unsigned char, 3> ghost(ghostArray, shape);
-      // record the values
-      sdiy::for_each(g.shape(), [&](const Vertex& v)
-        {
-        auto gv = (ghost(v) == 0) ? g(v) : 0;
+  static void load(void* b_, sdiy::BinaryBuffer& bb)
+    {
+    AutocorrelationImpl* b = static_cast<AutocorrelationImpl*>(b_);
+    sdiy::load(bb, b->window);
+    sdiy::load(bb, b->gid);
+    sdiy::load(bb, b->from);
+    sdiy::load(bb, b->to);
+    sdiy::load(bb, b->offset);
+    sdiy::load(bb, b->count);
+    b->shape = b->to - b->from + Vertex::one();
+    b->values = Grid(b->shape.lift(3, b->window), false);
+    b->corr = Grid(b->shape.lift(3, b->window), false);
+    sdiy::load(bb, b->values.data(), b->values.size());
+    sdiy::load(bb, b->corr.data(), b->corr.size());
+    }
 
-        for (size_t i = 1; i <= window; ++i)
-        {
-        if (i > count) continue;    // during the initial fill, we don't get contributions to some shifts
+  // the number of points in the block
+  size_t size() const { return this->corr.size() / this->window; }
 
-        auto uc = v.lift(3, i-1);
-        auto uv = v.lift(3, (offset + window - i) % window);
-        corr(uc) += values(uv)*gv;
-        }
+  /** update the correlations with the values of the current step. The
+   * values are read by reader_t, one of the readers below, directly from the
+   * simulation's memory.
+   */
+  template <typename reader_t>
+  void process(const reader_t &data, const unsigned char *ghostArray)
+    {
+    size_t nPts = this->size();
 
-        auto u = v.lift(3, offset);
-        values(u) = gv;
-        });
-      }
-    else
+    // during the initial fill, we don't get contributions to some shifts
+    size_t nShifts = std::min(this->count, this->window);
+
+    float *pValues = this->values.data();
+    float *pCorr = this->corr.data();
+
+    // work on tiles of points so that the data stays in cache while it is
+    // correlated with each of the earlier steps
+    const size_t tileSize = 2048;
+    float tile[tileSize];
+
+    for (size_t t0 = 0; t0 < nPts; t0 += tileSize)
       {
-      // record the values
-      sdiy::for_each(g.shape(), [&](const Vertex& v)
+      size_t nt = std::min(tileSize, nPts - t0);
+
+      // read and convert the values, ghost zones do not contribute
+      for (size_t j = 0; j < nt; ++j)
+        tile[j] = data(t0 + j);
+
+      if (ghostArray)
         {
-        auto gv = g(v);
+        const unsigned char *pg = ghostArray + t0;
+        for (size_t j = 0; j < nt; ++j)
+          tile[j] = pg[j] ? 0.0f : tile[j];
+        }
 
-        for (size_t i = 1; i <= window; ++i)
+      for (size_t i = 1; i <= nShifts; ++i)
         {
-        if (i > count) continue;    // during the initial fill, we don't get contributions to some shifts
+        const float *pv = pValues + ((offset + window - i) % window)*nPts + t0;
+        float *pc = pCorr + (i - 1)*nPts + t0;
 
-        auto uc = v.lift(3, i-1);
-        auto uv = v.lift(3, (offset + window - i) % window);
-        corr(uc) += values(uv)*gv;
+        for (size_t j = 0; j < nt; ++j)
+          pc[j] += pv[j] * tile[j];
         }
 
-        auto u = v.lift(3, offset);
-        values(u) = gv;
-        });
+      // record the values
+      float *pu = pValues + offset*nPts + t0;
+      for (size_t j = 0; j < nt; ++j)
+        pu[j] = tile[j];
       }
+
     offset += 1;
     offset %= window;
 
@@ -144,10 +203,289 @@ private:
   AutocorrelationImpl() {}        // here just for create; to let Master manage the blocks (+ if we choose to add OOC later)
 };
 
+/// reads one component of an array, components are separated by stride values
+template <typename data_t>
+struct ComponentReader
+{
+  float operator()(size_t i) const
+    { return this->Data[i*this->Stride]; }
+
+  const data_t *Data;
+  size_t Stride;
+};
+
+/// reads the magnitude of the components of an array
+template <typename data_t>
+struct MagnitudeReader
+{
+  float operator()(size_t i) const
+    {
+    double mag = 0.0;
+    for (size_t j = 0; j < this->Data.size(); ++j)
+      {
+      double val = this->Data[j][i*this->Stride];
+      mag += val*val;
+      }
+    return std::sqrt(mag);
+    }
+
+  std::vector<const data_t*> Data;
+  size_t Stride;
+};
+
+/** The simulation's values for a block. Components holds a pointer to each
+ * of the components read, consecutive values of a component are Stride
+ * values apart.
+ */
+struct BlockData
+{
+  int Type;
+  bool Magnitude;
+  std::vector<std::shared_ptr<void>> Components;
+  size_t Stride;
+  const unsigned char *Ghosts;
+};
+
+// **************************************************************************
+static int GetBlockData(svtkDataArray *da, int comp, BlockData &bd)
+{
+  size_t nVals = da->GetNumberOfTuples();
+  int nComps = da->GetNumberOfComponents();
+
+  if ((comp < Autocorrelation::MAGNITUDE) || (comp >= nComps))
+    {
+    SENSEI_ERROR("Invalid component " << comp << " of array \""
+      << da->GetName() << "\" with " << nComps << " components")
+    return -1;
+    }
+
+  bd.Type = da->GetDataType();
+  bd.Magnitude = comp == Autocorrelation::MAGNITUDE;
+  bd.Components.clear();
+
+  int c0 = bd.Magnitude ? 0 : comp;
+  int c1 = bd.Magnitude ? nComps : comp + 1;
+
+  switch (da->GetDataType())
+    {
+    svtkTemplateMacro(
+      using AOS_ARRAY_TT = svtkAOSDataArrayTemplate<SVTK_TT>;
+      using SOA_ARRAY_TT = svtkSOADataArrayTemplate<SVTK_TT>;
+
+      AOS_ARRAY_TT *aosDa = nullptr;
+      SOA_ARRAY_TT *soaDa = nullptr;
+
+      if ((aosDa = dynamic_cast<AOS_ARRAY_TT*>(da)))
+        {
+        // components are interleaved
+        std::shared_ptr<SVTK_TT> pDa = sensei::MemoryUtils::MakeCpuAccessible(
+          aosDa->GetPointer(0), nVals*nComps);
+
+        for (int i = c0; i < c1; ++i)
+          bd.Components.push_back(std::shared_ptr<void>(pDa, pDa.get() + i));
+
+        bd.Stride = nComps;
+        }
+      else if ((soaDa = dynamic_cast<SOA_ARRAY_TT*>(da)))
+        {
+        // each component is stored contiguously
+        for (int i = c0; i < c1; ++i)
+          bd.Components.push_back(sensei::MemoryUtils::MakeCpuAccessible(
+            soaDa->GetComponentArrayPointer(i), nVals));
+
+        bd.Stride = 1;
+        }
+      else
+        {
+        SENSEI_ERROR("Invalid svtkDataArray " << da->GetClassName())
+        return -1;
+        }
+
+      return 0;
+      );
+    }
+
+  SENSEI_ERROR("Unsupported array type " << da->GetDataTypeAsString())
+  return -1;
+}
+
+// **************************************************************************
+static void Process(AutocorrelationImpl *b, const BlockData &bd)
+{
+  switch (bd.Type)
+    {
+    svtkTemplateMacro(
+      if (bd.Magnitude)
+        {
+        MagnitudeReader<SVTK_TT> reader;
+        reader.Stride = bd.Stride;
+        for (const std::shared_ptr<void> &comp : bd.Components)
+          reader.Data.push_back(static_cast<const SVTK_TT*>(comp.get()));
+        b->process(reader, bd.Ghosts);
+        }
+      else
+        {
+        ComponentReader<SVTK_TT> reader;
+        reader.Stride = bd.Stride;
+        reader.Data = static_cast<const SVTK_TT*>(bd.Components[0].get());
+        b->process(reader, bd.Ghosts);
+        }
+      );
+    }
+}
+
+// **************************************************************************
+static float sum(const float *vals, size_t n)
+{
+  // accumulate in independent lanes so the loop vectorizes without
+  // reassociating floating point math
+  constexpr size_t nLanes = 16;
+  float lanes[nLanes] = {0.0f};
+
+  size_t nv = n - n % nLanes;
+  for (size_t i = 0; i < nv; i += nLanes)
+    {
+    for (size_t j = 0; j < nLanes; ++j)
+      lanes[j] += vals[i + j];
+    }
+
+  for (size_t i = nv; i < n; ++i)
+    lanes[i - nv] += vals[i];
+
+  float res = 0.0f;
+  for (size_t j = 0; j < nLanes; ++j)
+    res += lanes[j];
+
+  return res;
+}
+
+// **************************************************************************
+/** Storage for the blocks that do not fit in memory. The blocks are written
+ * to files by sdiy's FileStorage. sdiy reads the blocks back in the order
+ * they were written, so whenever one is read the next ones are read in the
+ * background, overlapping their I/O with the processing of the current block.
+ * The number of blocks read ahead is limited to depth.
+ */
+class PrefetchStorage : public sdiy::ExternalStorage
+{
+public:
+  PrefetchStorage(const std::string &fileTemplate, size_t depth) :
+    Files(fileTemplate), Depth(depth) {}
+
+  ~PrefetchStorage()
+    {
+    for (auto &it : this->Prefetched)
+      it.second.wait();
+    }
+
+  // message queues are passed straight through
+  int put(sdiy::MemoryBuffer &bb) override
+    {
+    return this->Files.put(bb);
+    }
+
+  void get(int i, sdiy::MemoryBuffer &bb, size_t extra) override
+    {
+    this->Files.get(i, bb, extra);
+    }
+
+  int put(const void *x, sdiy::detail::Save save) override
+    {
+    sdiy::MemoryBuffer bb;
+    save(x, bb);
+
+    int i = this->Files.put(bb);
+
+    std::lock_guard<std::mutex> lock(this->Mutex);
+    this->Pending.insert(i);
+
+    return i;
+    }
+
+  void get(int i, void *x, sdiy::detail::Load load) override
+    {
+    std::future<std::vector<char>> block;
+    {
+    std::lock_guard<std::mutex> lock(this->Mutex);
+    auto it = this->Prefetched.find(i);
+    if (it != this->Prefetched.end())
+      {
+      block = std::move(it->second);
+      this->Prefetched.erase(it);
+      }
+    else
+      {
+      this->Pending.erase(i);
+      }
+    this->Prefetch();
+    }
+
+    sdiy::MemoryBuffer bb;
+    if (block.valid())
+      bb.buffer = block.get();
+    else
+      this->Files.get(i, bb, 0);
+
+    bb.reset();
+    load(x, bb);
+    }
+
+  void destroy(int i) override
+    {
+    std::future<std::vector<char>> block;
+    {
+    std::lock_guard<std::mutex> lock(this->Mutex);
+    auto it = this->Prefetched.find(i);
+    if (it != this->Prefetched.end())
+      {
+      block = std::move(it->second);
+      this->Prefetched.erase(it);
+      }
+    else
+      {
+      this->Pending.erase(i);
+      }
+    }
+
+    // a block that was read ahead no longer has a file
+    if (block.valid())
+      block.wait();
+    else
+      this->Files.destroy(i);
+    }
+
+private:
+  // start reading the oldest blocks in the background. the caller must
+  // hold the mutex
+  void Prefetch()
+    {
+    while ((this->Prefetched.size() < this->Depth) && !this->Pending.empty())
+      {
+      int i = *this->Pending.begin();
+      this->Pending.erase(this->Pending.begin());
+
+      this->Prefetched[i] = std::async(std::launch::async, [this, i]()
+        {
+        sdiy::MemoryBuffer bb;
+        this->Files.get(i, bb, 0);
+        return std::move(bb.buffer);
+        });
+      }
+    }
+
+  sdiy::FileStorage Files;
+  size_t Depth;
+  std::mutex Mutex;
+  std::set<int> Pending;                                  // blocks in files
+  std::map<int, std::future<std::vector<char>>> Prefetched; // blocks being read
+};
+
 //-----------------------------------------------------------------------------
 class Autocorrelation::AInternals
 {
 public:
+  // the storage must out live the master
+  std::unique_ptr<PrefetchStorage> Storage;
   std::unique_ptr<sdiy::Master> Master;
   size_t KMax;
   std::string MeshName;
@@ -156,9 +494,10 @@ public:
   size_t Window;
   bool BlocksInitialized;
   size_t NumberOfBlocks;
+  int Component;
 
   AInternals() : KMax(3), Association(svtkDataObject::POINT),
-    Window(10), BlocksInitialized(false), NumberOfBlocks(0) {}
+    Window(10), BlocksInitialized(false), NumberOfBlocks(0), Component(0) {}
 
   void InitializeBlocks(svtkDataObject* dobj)
     {
@@ -236,21 +575,55 @@ Autocorrelation::~Autocorrelation()
 }
 
 //-----------------------------------------------------------------------------
-void Autocorrelation::Initialize(size_t window, const std::string &meshName,
-  int association, const std::string &arrayname, size_t kmax, int numThreads)
+int Autocorrelation::Initialize(size_t window, const std::string &meshName,
+  int association, const std::string &arrayname, size_t kmax, int numThreads,
+  int maxBlocksInMemory, const std::string &storageDir)
 {
   TimeEvent<128> mark("Autocorrelation::Initialize");
 
   AInternals& internals = (*this->Internals);
 
+  internals.Master.reset();
+  internals.Storage.reset();
+
+  // blocks that do not fit in memory are kept in files, one block per
+  // thread is read ahead
+  if (maxBlocksInMemory > 0)
+    {
+    if (access(storageDir.c_str(), W_OK))
+      {
+      SENSEI_ERROR("The storage directory \"" << storageDir
+        << "\" does not exist or is not writable")
+      return -1;
+      }
+
+    internals.Storage = make_unique<PrefetchStorage>(storageDir +
+      "/sensei_autocorrelation.XXXXXX", std::max(1, numThreads));
+    }
+  else if (maxBlocksInMemory != -1)
+    {
+    SENSEI_ERROR("Invalid number of blocks in memory " << maxBlocksInMemory)
+    return -1;
+    }
+
   internals.Master = make_unique<sdiy::Master>(this->GetCommunicator(),
-    numThreads, -1, &AutocorrelationImpl::create, &AutocorrelationImpl::destroy);
+    numThreads, maxBlocksInMemory, &AutocorrelationImpl::create,
+    &AutocorrelationImpl::destroy, internals.Storage.get(),
+    &AutocorrelationImpl::save, &AutocorrelationImpl::load);
 
   internals.MeshName = meshName;
   internals.Association = association;
   internals.ArrayName = arrayname;
   internals.Window = window;
   internals.KMax = kmax;
+
+  return 0;
+}
+
+//-----------------------------------------------------------------------------
+void Autocorrelation::SetComponent(int comp)
+{
+  this->Internals->Component = comp;
 }
 
 //-----------------------------------------------------------------------------
@@ -317,6 +690,32 @@ bool Autocorrelation::Execute(DataAdaptor* dataIn, DataAdaptor** dataOut)
   const int association = internals.Association;
   internals.InitializeBlocks(mesh);
 
+  // gather the data of each block, the blocks are then processed in
+  // parallel by sdiy's threads
+  std::map<int, BlockData> blockData;
+
+  auto addBlock = [&](int bid, svtkDataSet *ds) -> int
+    {
+    svtkFieldData *fd = ds->GetAttributesAsFieldData(association);
+
+    svtkDataArray* da = fd->GetArray(internals.ArrayName.c_str());
+
+    svtkUnsignedCharArray *gc = svtkUnsignedCharArray::SafeDownCast(
+      fd->GetArray("svtkGhostType"));
+
+    if (!da)
+      {
+      SENSEI_ERROR("Block " << bid << " has no array \""
+        << internals.ArrayName << "\"")
+      return -1;
+      }
+
+    BlockData &bd = blockData[bid];
+    bd.Ghosts = gc ? gc->GetPointer(0) : nullptr;
+
+    return GetBlockData(da, internals.Component, bd);
+    };
+
   if (svtkCompositeDataSet* cd = svtkCompositeDataSet::SafeDownCast(mesh))
     {
     svtkSmartPointer<svtkCompositeDataIterator> iter;
@@ -328,44 +727,29 @@ bool Autocorrelation::Execute(DataAdaptor* dataIn, DataAdaptor** dataOut)
       {
       if (svtkDataSet* dataObj = svtkDataSet::SafeDownCast(iter->GetCurrentDataObject()))
         {
-        int lid = internals.Master->lid(static_cast<int>(bid));
-        AutocorrelationImpl* corr = internals.Master->block<AutocorrelationImpl>(lid);
-        svtkFloatArray* fa = svtkFloatArray::SafeDownCast(
-          dataObj->GetAttributesAsFieldData(association)->GetArray(internals.ArrayName.c_str()));
-        svtkUnsignedCharArray *gc = svtkUnsignedCharArray::SafeDownCast(
-          dataObj->GetCellData()->GetArray("svtkGhostType"));
-        if (fa)
-          {
-          corr->process(fa->GetPointer(0), gc ? gc->GetPointer(0) : nullptr);
-          }
-        else
-          {
-          SENSEI_ERROR("Current implementation only supports float arrays")
+        if (addBlock(bid, dataObj))
           abort();
-          }
         }
       }
     }
   else if (svtkDataSet* ds = svtkDataSet::SafeDownCast(mesh))
     {
     int bid = internals.Master->communicator().rank();
-    int lid = internals.Master->lid(static_cast<int>(bid));
-    AutocorrelationImpl* corr = internals.Master->block<AutocorrelationImpl>(lid);
-    svtkFloatArray* fa = svtkFloatArray::SafeDownCast(
-      ds->GetAttributesAsFieldData(association)->GetArray(internals.ArrayName.c_str()));
-    svtkUnsignedCharArray *gc = svtkUnsignedCharArray::SafeDownCast(
-      ds->GetCellData()->GetArray("svtkGhostType"));
-    if (fa)
-      {
-      corr->process(fa->GetPointer(0), gc ? gc->GetPointer(0) : nullptr);
-      }
-    else
-      {
-      SENSEI_ERROR("Current implementation only supports float arrays")
+    if (addBlock(bid, ds))
       abort();
-      }
     }
 
+  // update the correlations
+  internals.Master->foreach([&blockData](AutocorrelationImpl* b,
+    const sdiy::Master::ProxyWithLink&)
+    {
+    auto it = blockData.find(b->gid);
+    if (it != blockData.end())
+      Process(b, it->second);
+    });
+
+  internals.Master->execute();
+
   mesh->Delete();
 
   return true;
@@ -382,12 +766,11 @@ void Autocorrelation::PrintResults(size_t k_max)
     // add up the autocorrellations
   internals.Master->foreach([](AutocorrelationImpl* b, const sdiy::Master::ProxyWithLink& cp)
                                      {
+                                        // each shift is a contiguous plane
+                                        size_t nPts = b->size();
                                         std::vector<float> sums(b->window, 0);
-                                        sdiy::for_each(b->corr.shape(), [&](const Vertex4D& v)
-                                        {
-                                            size_t w = v[3];
-                                            sums[w] += b->corr(v);
-                                        });
+                                        for (size_t w = 0; w < b->window; ++w)
+                                            sums[w] = sum(b->corr.data() + w*nPts, nPts);
 
                                         cp.all_reduce(sums, add_vectors<float>());
                                      });
@@ -425,22 +808,34 @@ void Autocorrelation::PrintResults(size_t k_max)
                   MaxHeapVector maxs(b->window);
                   if (rp.in_link().size() == 0)
                   {
-                      sdiy::for_each(b->corr.shape(), [&](const Vertex4D& v)
+                      // scan each shift's plane. the heap is only touched
+                      // when a value beats the smallest of the k kept
+                      size_t nPts = b->size();
+                      for (size_t offset = 0; offset < b->window; ++offset)
                       {
-                          size_t offset = v[3];
-                          float val = b->corr(v);
                           auto& max = maxs[offset];
-                          if (max.size() < k_max)
-                          {
-                              max.emplace_back(val, v.drop(3) + b->from);
-                              std::push_heap(max.begin(), max.end(), Compare());
-                          } else if (val > std::get<0>(max[0]))
+                          const float *pCorr = b->corr.data() + offset*nPts;
+                          float smallest = std::numeric_limits<float>::lowest();
+                          for (size_t i = 0; i < nPts; ++i)
                           {
-                              std::pop_heap(max.begin(), max.end(), Compare());
-                              maxs[offset].back() = std::make_tuple(val, v.drop(3) + b->from);
-                              std::push_heap(max.begin(), max.end(), Compare());
+                              float val = pCorr[i];
+                              if ((max.size() == k_max) && !(val > smallest))
+                                  continue;
+
+                              Vertex4D v = b->corr.vertex(offset*nPts + i);
+                              if (max.size() < k_max)
+                              {
+                                  max.emplace_back(val, v.drop(3) + b->from);
+                                  std::push_heap(max.begin(), max.end(), Compare());
+                              } else
+                              {
+                                  std::pop_heap(max.begin(), max.end(), Compare());
+                                  max.back() = std::make_tuple(val, v.drop(3) + b->from);
+                                  std::push_heap(max.begin(), max.end(), Compare());
+                              }
+                              smallest = std::get<0>(max[0]);
                           }
-                      });
+                      }
                   } else
                   {
                       for (long i = 0; i < rp.in_link().size(); ++i)
@@ -7,7 +7,11 @@
 
 namespace sensei
 {
-/// Performs a temporal autocorrelation on the simulation data
+/** Performs a temporal autocorrelation on the simulation data. Arrays of any
+ * of the standard numeric types, with the components either interleaved or
+ * stored contiguously, are read in place. The correlations are accumulated
+ * in single precision.
+ */
 class SENSEI_EXPORT Autocorrelation : public AnalysisAdaptor
 {
 public:
@@ -27,10 +31,26 @@ public:
    *         compute autocorrelation for.
    * @param kMax number of strongest autocorrelations to report
    * @param numThreads number of threads in sdiy's thread pool
+   * @param maxBlocksInMemory the number of blocks kept in memory on each
+   *         rank, the others are written to files in \c storageDir between
+   *         uses. -1, the default, keeps all blocks in memory.
+   * @param storageDir a directory for the blocks that do not fit in memory,
+   *         ideally on a local NVMe drive or tmpfs
+   * @returns zero if successful
    */
-  void Initialize(size_t window, const std::string &meshName,
+  int Initialize(size_t window, const std::string &meshName,
     int association, const std::string &arrayName, size_t kMax,
-    int numThreads = 1);
+    int numThreads = 1, int maxBlocksInMemory = -1,
+    const std::string &storageDir = "/tmp");
+
+  /// passed to SetComponent to correlate the magnitude of the components
+  enum {MAGNITUDE = -1};
+
+  /** Select the component of a multi-component array to correlate, or
+   * MAGNITUDE to correlate the magnitude of its components. The default is
+   * the first component.
+   */
+  void SetComponent(int comp);
 
   /// Incrementally computes autocorrelation on the current simulation state
   bool Execute(DataAdaptor* data, DataAdaptor**) override;
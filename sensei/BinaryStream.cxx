@@ -121,6 +121,12 @@ void BinaryStream::Swap(BinaryStream &other) noexcept
 
 //-----------------------------------------------------------------------------
 int BinaryStream::Broadcast(int rootRank)
+{
+  return this->Broadcast(MPI_COMM_WORLD, rootRank);
+}
+
+//-----------------------------------------------------------------------------
+int BinaryStream::Broadcast(MPI_Comm comm, int rootRank)
 {
   int init = 0;
   int rank = 0;
@@ -128,18 +134,18 @@ int BinaryStream::Broadcast(int rootRank)
   if (init)
     {
     unsigned long nbytes = 0;
-    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_rank(comm, &rank);
     if (rank == rootRank)
       {
       nbytes = this->Size();
-      MPI_Bcast(&nbytes, 1, MPI_UNSIGNED_LONG, rootRank, MPI_COMM_WORLD);
-      MPI_Bcast(this->GetData(), nbytes, MPI_BYTE, rootRank, MPI_COMM_WORLD);
+      MPI_Bcast(&nbytes, 1, MPI_UNSIGNED_LONG, rootRank, comm);
+      MPI_Bcast(this->GetData(), nbytes, MPI_BYTE, rootRank, comm);
       }
     else
       {
-      MPI_Bcast(&nbytes, 1, MPI_UNSIGNED_LONG, rootRank, MPI_COMM_WORLD);
+      MPI_Bcast(&nbytes, 1, MPI_UNSIGNED_LONG, rootRank, comm);
       this->Resize(nbytes);
-      MPI_Bcast(this->GetData(), nbytes, MPI_BYTE, rootRank, MPI_COMM_WORLD);
+      MPI_Bcast(this->GetData(), nbytes, MPI_BYTE, rootRank, comm);
       this->SetReadPos(0);
       this->SetWritePos(nbytes);
       }
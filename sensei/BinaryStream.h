@@ -4,6 +4,8 @@
 #include "senseiConfig.h"
 #include "Error.h"
 
+#include <mpi.h>
+
 #include <cstdlib>
 #include <cstring>
 #include <string>
@@ -109,6 +111,10 @@ public:
   // broadcast the stream from the root process to all other processes
   int Broadcast(int rootRank=0);
 
+  // broadcast the stream from the root process to all other processes of
+  // the communicator
+  int Broadcast(MPI_Comm comm, int rootRank);
+
 private:
   // re-allocation size
   static
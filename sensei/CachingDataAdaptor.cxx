@@ -0,0 +1,484 @@
+#include "CachingDataAdaptor.h"
+#include "SVTKUtils.h"
+#include "Profiler.h"
+#include "Error.h"
+
+#include <svtkObjectFactory.h>
+#include <svtkSmartPointer.h>
+#include <svtkDataObject.h>
+#include <svtkDataSet.h>
+#include <svtkCompositeDataSet.h>
+#include <svtkCompositeDataIterator.h>
+#include <svtkFieldData.h>
+#include <svtkPointData.h>
+#include <svtkCellData.h>
+#include <svtkDataArray.h>
+#include <svtkAbstractArray.h>
+
+#include <map>
+#include <set>
+#include <utility>
+
+using svtkDataObjectPtr = svtkSmartPointer<svtkDataObject>;
+
+namespace
+{
+// the meshes and arrays cached for a single mesh
+struct MeshCache
+{
+  MeshCache() : Fetched{false,false}, Static(false) {}
+
+  // pristine copies of the full and structure only meshes. these are never
+  // modified and are used as the source for the shallow copies handed out
+  svtkDataObjectPtr Mesh[2];
+  bool Fetched[2];
+
+  // when set the geometry is kept from one step to the next
+  bool Static;
+
+  // the mesh returned by the simulation to which arrays are added
+  svtkDataObjectPtr Arrays;
+  std::set<std::pair<int,std::string>> ArrayNames;
+};
+
+// make a copy of the mesh that shares its geometry and arrays
+svtkDataObject *NewShallowCopy(svtkDataObject *dobj)
+{
+  if (svtkCompositeDataSet *cd = dynamic_cast<svtkCompositeDataSet*>(dobj))
+    {
+    svtkCompositeDataSet *cdo = cd->NewInstance();
+    cdo->CopyStructure(cd);
+
+    svtkCompositeDataIterator *cdit = cd->NewIterator();
+    while (!cdit->IsDoneWithTraversal())
+      {
+      svtkDataObject *leaf = cd->GetDataSet(cdit);
+      svtkDataObject *leafo = leaf->NewInstance();
+      leafo->ShallowCopy(leaf);
+      cdo->SetDataSet(cdit, leafo);
+      leafo->Delete();
+
+      cdit->GoToNextItem();
+      }
+
+    cdit->Delete();
+
+    return cdo;
+    }
+
+  svtkDataObject *dobjo = dobj->NewInstance();
+  dobjo->ShallowCopy(dobj);
+  return dobjo;
+}
+
+// remove the arrays from a cached mesh, leaving geometry and connectivity
+int ClearArrays(svtkDataObject *dobj)
+{
+  sensei::SVTKUtils::DatasetFunction clearArrays = [](svtkDataSet *ds) -> int
+    {
+    ds->GetPointData()->Initialize();
+    ds->GetCellData()->Initialize();
+    ds->GetFieldData()->Initialize();
+    return 0;
+    };
+
+  return sensei::SVTKUtils::Apply(dobj, clearArrays);
+}
+
+// the metadata flags are not directly accessible, pack the ones that are
+// set into a key
+enum { RANGE_KEY = 0x10 };
+
+int GetFlagsKey(const sensei::MeshMetadataFlags &flags)
+{
+  return (flags.BlockDecompSet() ? 0x1 : 0) | (flags.BlockSizeSet() ? 0x2 : 0) |
+    (flags.BlockExtentsSet() ? 0x4 : 0) | (flags.BlockBoundsSet() ? 0x8 : 0) |
+    (flags.BlockArrayRangeSet() ? RANGE_KEY : 0);
+}
+}
+
+namespace sensei
+{
+
+struct CachingDataAdaptor::InternalsType
+{
+  InternalsType() : Data(nullptr), LastData(nullptr), TimeStep(0),
+    StaticGeometry(0), NumMeshes(0), HaveNumMeshes(false) {}
+
+  // clears the cache. when keepStatic is set metadata and optionally the
+  // geometry of static meshes is kept.
+  void Clear(bool keepStatic);
+
+  // true if the metadata reports the named mesh as static
+  bool IsStatic(const std::string &meshName);
+
+  svtkSmartPointer<DataAdaptor> Data;
+
+  // identifies the adaptor the static cache was populated from. no
+  // reference is held so that the simulation is free to delete it.
+  DataAdaptor *LastData;
+  long TimeStep;
+
+  int StaticGeometry;
+
+  unsigned int NumMeshes;
+  bool HaveNumMeshes;
+
+  std::map<std::pair<unsigned int,int>, MeshMetadataPtr> Metadata;
+  std::map<std::string, MeshCache> Meshes;
+};
+
+//----------------------------------------------------------------------------
+void CachingDataAdaptor::InternalsType::Clear(bool keepStatic)
+{
+  this->NumMeshes = 0;
+  this->HaveNumMeshes = false;
+
+  if (!keepStatic)
+    {
+    this->Metadata.clear();
+    this->Meshes.clear();
+    return;
+    }
+
+  // the metadata of a static mesh does not change, except for array ranges
+  auto mit = this->Metadata.begin();
+  while (mit != this->Metadata.end())
+    {
+    if (mit->second->StaticMesh && !(mit->first.second & RANGE_KEY))
+      ++mit;
+    else
+      mit = this->Metadata.erase(mit);
+    }
+
+  // the geometry of a static mesh does not change. arrays are fetched anew
+  // each step.
+  auto it = this->Meshes.begin();
+  while (it != this->Meshes.end())
+    {
+    MeshCache &mc = it->second;
+    if (mc.Static)
+      {
+      mc.Arrays = nullptr;
+      mc.ArrayNames.clear();
+      ++it;
+      }
+    else
+      {
+      it = this->Meshes.erase(it);
+      }
+    }
+}
+
+//----------------------------------------------------------------------------
+bool CachingDataAdaptor::InternalsType::IsStatic(const std::string &meshName)
+{
+  auto it = this->Metadata.begin();
+  auto end = this->Metadata.end();
+  for (; it != end; ++it)
+    {
+    if (it->second->MeshName == meshName)
+      return it->second->StaticMesh;
+    }
+  return false;
+}
+
+//----------------------------------------------------------------------------
+senseiNewMacro(CachingDataAdaptor);
+
+//----------------------------------------------------------------------------
+CachingDataAdaptor::CachingDataAdaptor() :
+  Internals(new CachingDataAdaptor::InternalsType)
+{
+}
+
+//----------------------------------------------------------------------------
+CachingDataAdaptor::~CachingDataAdaptor()
+{
+  delete this->Internals;
+}
+
+//----------------------------------------------------------------------------
+void CachingDataAdaptor::SetDataAdaptor(DataAdaptor *data)
+{
+  long step = data ? data->GetDataTimeStep() : 0;
+
+  if (data != this->Internals->LastData)
+    this->Internals->Clear(false);
+  else if (step != this->Internals->TimeStep)
+    this->Internals->Clear(true);
+
+  this->Internals->Data = data;
+  this->Internals->LastData = data;
+  this->Internals->TimeStep = step;
+}
+
+//----------------------------------------------------------------------------
+void CachingDataAdaptor::SetCacheStaticGeometry(int val)
+{
+  if (val != this->Internals->StaticGeometry)
+    {
+    this->Internals->Clear(false);
+    this->Internals->StaticGeometry = val;
+    }
+}
+
+//----------------------------------------------------------------------------
+int CachingDataAdaptor::GetCacheStaticGeometry()
+{
+  return this->Internals->StaticGeometry;
+}
+
+//----------------------------------------------------------------------------
+DataAdaptor *CachingDataAdaptor::GetDataAdaptor()
+{
+  return this->Internals->Data.GetPointer();
+}
+
+//----------------------------------------------------------------------------
+int CachingDataAdaptor::GetNumberOfMeshes(unsigned int &numMeshes)
+{
+  if (!this->Internals->Data)
+    {
+    SENSEI_ERROR("No data adaptor was set")
+    return -1;
+    }
+
+  if (!this->Internals->HaveNumMeshes)
+    {
+    if (this->Internals->Data->GetNumberOfMeshes(this->Internals->NumMeshes))
+      return -1;
+
+    this->Internals->HaveNumMeshes = true;
+    }
+
+  numMeshes = this->Internals->NumMeshes;
+  return 0;
+}
+
+//----------------------------------------------------------------------------
+int CachingDataAdaptor::GetMeshMetadata(unsigned int id,
+  MeshMetadataPtr &metadata)
+{
+  if (!this->Internals->Data)
+    {
+    SENSEI_ERROR("No data adaptor was set")
+    return -1;
+    }
+
+  // metadata generated with different flags is cached separately
+  std::pair<unsigned int,int> key(id, GetFlagsKey(metadata->Flags));
+
+  MeshMetadataPtr &cached = this->Internals->Metadata[key];
+  if (!cached)
+    {
+    MeshMetadataPtr md = MeshMetadata::New(metadata->Flags);
+    if (this->Internals->Data->GetMeshMetadata(id, md))
+      {
+      this->Internals->Metadata.erase(key);
+      return -1;
+      }
+    cached = md;
+    }
+
+  // the caller may modify the metadata, give it a copy
+  *metadata = *cached;
+
+  return 0;
+}
+
+//----------------------------------------------------------------------------
+int CachingDataAdaptor::GetMesh(const std::string &meshName,
+  bool structureOnly, svtkDataObject *&mesh)
+{
+  mesh = nullptr;
+
+  if (!this->Internals->Data)
+    {
+    SENSEI_ERROR("No data adaptor was set")
+    return -1;
+    }
+
+  MeshCache &mc = this->Internals->Meshes[meshName];
+
+  // a full mesh may stand in for a structure only one
+  int so = (structureOnly && !mc.Fetched[0]) ? 1 : 0;
+
+  if (!mc.Fetched[so])
+    {
+    TimeEvent<128> mark("CachingDataAdaptor::GetMesh");
+
+    svtkDataObject *dobj = nullptr;
+    if (this->Internals->Data->GetMesh(meshName, so, dobj))
+      return -1;
+
+    mc.Fetched[so] = true;
+
+    // not all ranks need to have data
+    if (!dobj)
+      return 0;
+
+    // keep a pristine copy, the first mesh fetched is also where arrays
+    // are added
+    mc.Mesh[so].TakeReference(NewShallowCopy(dobj));
+
+    if (!mc.Arrays)
+      mc.Arrays = dobj;
+
+    dobj->Delete();
+
+    // arrays added by the simulation along with the geometry would be
+    // stale on later steps
+    if (this->Internals->StaticGeometry && this->Internals->IsStatic(meshName))
+      {
+      ClearArrays(mc.Mesh[so]);
+      mc.Static = true;
+      }
+    }
+
+  if (mc.Mesh[so])
+    mesh = NewShallowCopy(mc.Mesh[so]);
+
+  return 0;
+}
+
+//----------------------------------------------------------------------------
+int CachingDataAdaptor::AddCachedArray(svtkDataObject* mesh,
+  const std::string &meshName, int association, const std::string &arrayName,
+  bool ghost)
+{
+  if (!this->Internals->Data)
+    {
+    SENSEI_ERROR("No data adaptor was set")
+    return -1;
+    }
+
+  std::map<std::string, MeshCache>::iterator it =
+    this->Internals->Meshes.find(meshName);
+
+  // the arrays of a static mesh are added to a copy of the cached
+  // geometry on the steps after the first
+  if ((it != this->Internals->Meshes.end()) && !it->second.Arrays)
+    {
+    MeshCache &mc = it->second;
+    svtkDataObject *geom = mc.Mesh[0] ? mc.Mesh[0] : mc.Mesh[1];
+    if (geom)
+      mc.Arrays.TakeReference(NewShallowCopy(geom));
+    }
+
+  // the mesh was not fetched through the cache, or there is no data on this
+  // rank. pass the request through.
+  if ((it == this->Internals->Meshes.end()) || !it->second.Arrays || !mesh)
+    {
+    if (!ghost)
+      return this->Internals->Data->AddArray(mesh, meshName, association, arrayName);
+    else if (association == svtkDataObject::CELL)
+      return this->Internals->Data->AddGhostCellsArray(mesh, meshName);
+    else
+      return this->Internals->Data->AddGhostNodesArray(mesh, meshName);
+    }
+
+  MeshCache &mc = it->second;
+
+  std::pair<int,std::string> key(association, arrayName);
+  if (!mc.ArrayNames.count(key))
+    {
+    TimeEvent<128> mark("CachingDataAdaptor::AddArray");
+
+    int ierr = 0;
+    if (!ghost)
+      ierr = this->Internals->Data->AddArray(mc.Arrays, meshName, association, arrayName);
+    else if (association == svtkDataObject::CELL)
+      ierr = this->Internals->Data->AddGhostCellsArray(mc.Arrays, meshName);
+    else
+      ierr = this->Internals->Data->AddGhostNodesArray(mc.Arrays, meshName);
+
+    if (ierr)
+      return -1;
+
+    mc.ArrayNames.insert(key);
+    }
+
+  // pass the cached array to the caller's mesh
+  SVTKUtils::BinaryDatasetFunction addArray =
+    [&](svtkDataSet *ds, svtkDataSet *dsOut) -> int
+    {
+    svtkFieldData *dsa = SVTKUtils::GetAttributes(ds, association);
+    svtkFieldData *dsaOut = SVTKUtils::GetAttributes(dsOut, association);
+
+    if (!dsa || !dsaOut)
+      return -1;
+
+    // a simulation need not provide ghost arrays on every block
+    if (svtkAbstractArray *aa = dsa->GetAbstractArray(arrayName.c_str()))
+      dsaOut->AddArray(aa);
+
+    return 0;
+    };
+
+  if (SVTKUtils::Apply(mc.Arrays, mesh, addArray))
+    {
+    SENSEI_ERROR("Failed to add " << SVTKUtils::GetAttributesName(association)
+      << " data array \"" << arrayName << "\" to mesh \"" << meshName << "\"")
+    return -1;
+    }
+
+  return 0;
+}
+
+//----------------------------------------------------------------------------
+int CachingDataAdaptor::AddArray(svtkDataObject* mesh,
+  const std::string &meshName, int association, const std::string &arrayName)
+{
+  return this->AddCachedArray(mesh, meshName, association, arrayName, false);
+}
+
+//----------------------------------------------------------------------------
+int CachingDataAdaptor::AddGhostCellsArray(svtkDataObject* mesh,
+  const std::string &meshName)
+{
+  return this->AddCachedArray(mesh, meshName, svtkDataObject::CELL,
+    "svtkGhostType", true);
+}
+
+//----------------------------------------------------------------------------
+int CachingDataAdaptor::AddGhostNodesArray(svtkDataObject* mesh,
+  const std::string &meshName)
+{
+  return this->AddCachedArray(mesh, meshName, svtkDataObject::POINT,
+    "svtkGhostType", true);
+}
+
+//----------------------------------------------------------------------------
+double CachingDataAdaptor::GetDataTime()
+{
+  if (this->Internals->Data)
+    return this->Internals->Data->GetDataTime();
+
+  return this->DataAdaptor::GetDataTime();
+}
+
+//----------------------------------------------------------------------------
+long CachingDataAdaptor::GetDataTimeStep()
+{
+  if (this->Internals->Data)
+    return this->Internals->Data->GetDataTimeStep();
+
+  return this->DataAdaptor::GetDataTimeStep();
+}
+
+//----------------------------------------------------------------------------
+int CachingDataAdaptor::ReleaseData()
+{
+  this->Internals->Clear(true);
+  this->Internals->Data = nullptr;
+  return 0;
+}
+
+//----------------------------------------------------------------------------
+void CachingDataAdaptor::PrintSelf(ostream& os, svtkIndent indent)
+{
+  this->Superclass::PrintSelf(os, indent);
+}
+
+}
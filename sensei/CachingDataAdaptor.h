@@ -0,0 +1,103 @@
+#ifndef sensei_CachingDataAdaptor_h
+#define sensei_CachingDataAdaptor_h
+
+#include "DataAdaptor.h"
+
+#include <string>
+#include <mpi.h>
+
+class svtkDataObject;
+
+namespace sensei
+{
+
+/** A data adaptor that sits in front of another data adaptor and memoizes
+ * the results of its calls during a single time step. When several analyses
+ * process the same step, mesh metadata, meshes, and arrays are fetched from
+ * the simulation once and each analysis is handed a shallow copy. Arrays
+ * are shared between copies, but adding arrays to a copy does not modify the
+ * cached data or the copies handed to other analyses.
+ *
+ * The cache is invalidated when ReleaseData is called, and when the adaptor
+ * being decorated or its time step changes. ReleaseData is not forwarded to
+ * the decorated adaptor, that remains the responsibility of the bridge.
+ *
+ * The metadata of meshes that report StaticMesh is kept from one step to the
+ * next, unless it includes array ranges. Optionally the geometry and
+ * connectivity of static meshes is kept as well, in which case only arrays
+ * are fetched on later steps. Those arrays are added to a copy of the first
+ * step's mesh, so the decorated adaptor's AddArray must accept any mesh with
+ * the same block structure as the one returned by its GetMesh.
+ *
+ * The cache is not thread safe. It should be accessed from one thread at a
+ * time.
+ */
+class SENSEI_EXPORT CachingDataAdaptor : public DataAdaptor
+{
+public:
+  static CachingDataAdaptor *New();
+  senseiTypeMacro(CachingDataAdaptor, DataAdaptor);
+
+  /// Prints the current adaptor state
+  void PrintSelf(ostream& os, svtkIndent indent) override;
+
+  /** Set the data adaptor to cache. If the adaptor or its time step differs
+   * from the one that is currently cached, the cache is cleared.
+   */
+  void SetDataAdaptor(DataAdaptor *data);
+
+  /// Get the data adaptor being cached
+  DataAdaptor *GetDataAdaptor();
+
+  /** When set the geometry and connectivity of meshes that report
+   * StaticMesh are kept from one step to the next. The default is 0.
+   */
+  void SetCacheStaticGeometry(int val);
+  int GetCacheStaticGeometry();
+
+  /// @name DataAdaptor API
+  /// Results are fetched from the decorated adaptor on first use only.
+  /// @{
+  int GetNumberOfMeshes(unsigned int &numMeshes) override;
+
+  int GetMeshMetadata(unsigned int id, MeshMetadataPtr &metadata) override;
+
+  int GetMesh(const std::string &meshName, bool structureOnly,
+    svtkDataObject *&mesh) override;
+
+  int AddGhostNodesArray(svtkDataObject* mesh,
+    const std::string &meshName) override;
+
+  int AddGhostCellsArray(svtkDataObject* mesh,
+    const std::string &meshName) override;
+
+  int AddArray(svtkDataObject* mesh, const std::string &meshName,
+    int association, const std::string &arrayName) override;
+
+  double GetDataTime() override;
+  long GetDataTimeStep() override;
+  /// @}
+
+  /// Clears the cache, except for what is kept for static meshes
+  int ReleaseData() override;
+
+protected:
+  CachingDataAdaptor();
+  ~CachingDataAdaptor();
+
+  CachingDataAdaptor(const CachingDataAdaptor&) = delete;
+  void operator=(const CachingDataAdaptor&) = delete;
+
+private:
+  // fetches and caches the array or ghost array then copies it into the
+  // passed mesh
+  int AddCachedArray(svtkDataObject* mesh, const std::string &meshName,
+    int association, const std::string &arrayName, bool ghost);
+
+  struct InternalsType;
+  InternalsType *Internals;
+};
+
+}
+
+#endif
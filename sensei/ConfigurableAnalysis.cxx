@@ -2,12 +2,19 @@
 #include <svtkSmartPointer.h>
 #include <svtkNew.h>
 #include <svtkDataObject.h>
+#include <svtkSMPTools.h>
 
 #include <vector>
+#include <deque>
+#include <map>
+#include <algorithm>
 #include <fstream>
 #include <sstream>
 #include <cstdio>
 #include <errno.h>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
 
 #include "ConfigurableAnalysis.h"
 #include "senseiConfig.h"
@@ -17,9 +24,14 @@
 #include "XMLUtils.h"
 #include "STLUtils.h"
 #include "DataRequirements.h"
+#include "SVTKDataAdaptor.h"
+#include "CachingDataAdaptor.h"
+#include "InTransitDataAdaptor.h"
 
+#include "AsyncAnalysisAdaptor.h"
 #include "Autocorrelation.h"
 #include "Histogram.h"
+#include "MultiHistogram.h"
 #ifdef ENABLE_VTK_IO
 #include "VTKPosthocIO.h"
 #ifdef ENABLE_VTK_MPI
@@ -42,6 +54,10 @@
 #ifdef ENABLE_HDF5
 #include "HDF5AnalysisAdaptor.h"
 #endif
+#ifdef ENABLE_SHARED_MEM
+#include "SharedMemAnalysisAdaptor.h"
+#endif
+#include "MPIInTransitAnalysisAdaptor.h"
 #ifdef ENABLE_CATALYST
 #include "CatalystAnalysisAdaptor.h"
 #include "CatalystParticle.h"
@@ -76,11 +92,38 @@ namespace sensei
 {
 using namespace STLUtils; // for operator<< overloads
 
+// per analysis state used to execute the analyses according to the
+// dependencies declared between them.
+struct AnalysisTask
+{
+  AnalysisTask() : NumPending(0), WantResult(false),
+    MainThread(true), Result(nullptr) {}
+
+  std::string Name;
+  std::vector<std::string> DependsOn;
+
+  // the tasks this one depends on, and the tasks that depend on it
+  std::vector<unsigned int> Inputs;
+  std::vector<unsigned int> Outputs;
+
+  // the data that is fetched for the analysis when it runs on
+  // the thread pool
+  DataRequirements Requirements;
+  svtkSmartPointer<SVTKDataAdaptor> Data;
+
+  // per step state
+  unsigned int NumPending;
+  bool WantResult;
+  bool MainThread;
+  DataAdaptor *Result;
+};
 
 struct ConfigurableAnalysis::InternalsType
 {
   InternalsType()
-    : Comm(MPI_COMM_NULL)
+    : Comm(MPI_COMM_NULL), Async(0), MaxInFlight(2), Overflow("block"),
+    Concurrent(0), NumThreads(0), NumDone(0), Shutdown(false),
+    OutputWarned(false), Cache(1), StaticGeometry(0)
   {
   }
 
@@ -97,12 +140,15 @@ struct ConfigurableAnalysis::InternalsType
   // a status message indicating success/failure is printed
   // by rank 0
   int AddHistogram(pugi::xml_node node);
+  int AddMultiHistogram(pugi::xml_node node);
   int AddVTKmContour(pugi::xml_node node);
   int AddVTKmVolumeReduction(pugi::xml_node node);
   int AddVTKmCDF(pugi::xml_node node);
   int AddAdios1(pugi::xml_node node);
   int AddAdios2(pugi::xml_node node);
   int AddHDF5(pugi::xml_node node);
+  int AddSharedMem(pugi::xml_node node);
+  int AddMPIInTransit(pugi::xml_node node);
   int AddAscent(pugi::xml_node node);
   int AddCatalyst(pugi::xml_node node);
   int AddLibsim(pugi::xml_node node);
@@ -114,6 +160,40 @@ struct ConfigurableAnalysis::InternalsType
   int AddSliceExtract(pugi::xml_node node);
   int AddCalculator(pugi::xml_node node);
 
+  // gets the meshes and arrays an analysis needs from either the standard
+  // data requirements or the mesh, array and association attributes used
+  // by the simpler analyses.
+  int GetDataRequirements(pugi::xml_node node, DataRequirements &req);
+
+  // replaces the most recently added analysis with one that runs it in the
+  // background, if asynchronous execution was requested in the XML.
+  int MakeAsync(pugi::xml_node node);
+
+  // records the name and dependencies of the most recently added analysis
+  int AddTask(pugi::xml_node node);
+
+  // resolves dependencies between the analyses, orders them, and if
+  // requested starts the thread pool used for concurrent execution.
+  int InitializeTasks(MPI_Comm comm);
+
+  // runs the analyses for the current step
+  void ExecuteTasks(DataAdaptor *data, DataAdaptor **dataOut);
+
+  // copies the data an analysis running on the pool needs from the simulation
+  void FetchTask(unsigned int i, DataAdaptor *data);
+
+  // runs one analysis on the current step
+  void RunTask(unsigned int i, DataAdaptor *data);
+
+  // updates the dependents of a finished analysis
+  void CompleteTask(unsigned int i);
+
+  // the thread pool's main loop
+  void Work();
+
+  // stops and joins the thread pool
+  void StopThreads();
+
 public:
   // list of all analyses. api calls are forwareded to each
   // analysis in the list
@@ -139,6 +219,35 @@ public:
   MPI_Comm Comm;
 
   std::vector<std::string> LogEventNames;
+
+  // global defaults for asynchronous execution. these may be
+  // overriden by attributes on each analysis element.
+  int Async;
+  unsigned int MaxInFlight;
+  std::string Overflow;
+
+  // execution state of each analysis, in the same order as Analyses,
+  // and an order in which they may be run that satisfies their
+  // dependencies
+  std::vector<AnalysisTask> Tasks;
+  std::vector<unsigned int> Order;
+
+  // thread pool for concurrent execution of independent analyses
+  int Concurrent;
+  unsigned int NumThreads;
+  std::vector<std::thread> Threads;
+  std::deque<unsigned int> Ready;
+  unsigned int NumDone;
+  bool Shutdown;
+  bool OutputWarned;
+  std::mutex Mutex;
+  std::condition_variable Cond;
+
+  // data fetched from the simulation is shared by the analyses
+  // during each step
+  int Cache;
+  int StaticGeometry;
+  svtkSmartPointer<CachingDataAdaptor> DataCache;
 };
 
 // --------------------------------------------------------------------------
@@ -198,6 +307,13 @@ int ConfigurableAnalysis::InternalsType::AddHistogram(pugi::xml_node node)
   if (this->Comm != MPI_COMM_NULL)
     histogram->SetCommunicator(this->Comm);
 
+  std::string range = node.attribute("range").as_string("auto");
+  if (histogram->SetRange(range))
+    {
+    SENSEI_ERROR("Failed to initialize Histogram");
+    return -1;
+    }
+
   this->TimeInitialization(histogram, [&]() {
       histogram->Initialize(bins, mesh, association, array, fileName);
       return 0;
@@ -206,7 +322,77 @@ int ConfigurableAnalysis::InternalsType::AddHistogram(pugi::xml_node node)
 
   SENSEI_STATUS("Configured histogram with " << bins
     << " bins on " << assocStr << " data array \"" << array
-    << "\" on mesh \"" << mesh << "\" writing output to "
+    << "\" on mesh \"" << mesh << "\" range " << range
+    << " writing output to " << (fileName.empty() ? "cout" : "file"))
+
+  return 0;
+}
+
+// --------------------------------------------------------------------------
+int ConfigurableAnalysis::InternalsType::AddMultiHistogram(pugi::xml_node node)
+{
+  if (XMLUtils::RequireAttribute(node, "mesh") || XMLUtils::RequireAttribute(node, "arrays"))
+    {
+    SENSEI_ERROR("Failed to initialize MultiHistogram");
+    return -1;
+    }
+
+  int association = 0;
+  std::string assocStr = node.attribute("association").as_string("point");
+  if (SVTKUtils::GetAssociation(assocStr, association))
+    {
+    SENSEI_ERROR("Failed to initialize MultiHistogram");
+    return -1;
+    }
+
+  std::string mesh = node.attribute("mesh").value();
+  std::string arraysStr = node.attribute("arrays").value();
+  std::string binsStr = node.attribute("bins").as_string("10");
+  std::string weights = node.attribute("weights").value();
+  std::string range = node.attribute("range").as_string("auto");
+  std::string storage = node.attribute("storage").as_string("auto");
+  int nThreads = node.attribute("n-threads").as_int(0);
+  std::string fileName = node.attribute("file").value();
+
+  std::vector<std::string> arrays;
+  XMLUtils::ParseList(arraysStr, arrays);
+
+  std::vector<std::string> binsList;
+  XMLUtils::ParseList(binsStr, binsList);
+
+  std::vector<int> bins;
+  for (const std::string &nBins : binsList)
+    bins.push_back(atoi(nBins.c_str()));
+
+  auto histogram = svtkSmartPointer<MultiHistogram>::New();
+
+  if (this->Comm != MPI_COMM_NULL)
+    histogram->SetCommunicator(this->Comm);
+
+  histogram->SetWeightArrayName(weights);
+  histogram->SetNumberOfThreads(nThreads);
+
+  if (histogram->SetRange(range) || histogram->SetStorage(storage))
+    {
+    SENSEI_ERROR("Failed to initialize MultiHistogram");
+    return -1;
+    }
+
+  if (this->TimeInitialization(histogram, [&]() {
+      return histogram->Initialize(mesh, association, arrays, bins, fileName);
+    }))
+    {
+    SENSEI_ERROR("Failed to initialize MultiHistogram");
+    return -1;
+    }
+
+  this->Analyses.push_back(histogram.GetPointer());
+
+  SENSEI_STATUS("Configured histogramnd with " << binsStr
+    << " bins on " << assocStr << " data arrays \"" << arraysStr
+    << "\" on mesh \"" << mesh << "\" range " << range
+    << (weights.empty() ? "" : " weighted by \"" + weights + "\"")
+    << " storage " << storage << " writing output to "
     << (fileName.empty() ? "cout" : "file"))
 
   return 0;
@@ -506,6 +692,52 @@ int ConfigurableAnalysis::InternalsType::AddHDF5(pugi::xml_node node)
 #endif
 }
 
+// --------------------------------------------------------------------------
+int ConfigurableAnalysis::InternalsType::AddSharedMem(pugi::xml_node node)
+{
+#ifndef ENABLE_SHARED_MEM
+  (void)node;
+  SENSEI_ERROR("The shared memory transport was requested but is disabled in this build")
+  return -1;
+#else
+  auto shmAdaptor = svtkSmartPointer<SharedMemAnalysisAdaptor>::New();
+
+  if (this->Comm != MPI_COMM_NULL)
+    shmAdaptor->SetCommunicator(this->Comm);
+
+  if (shmAdaptor->Initialize(node))
+    {
+    SENSEI_ERROR("Failed to configure the shared memory adaptor from XML")
+    return -1;
+    }
+
+  this->TimeInitialization(shmAdaptor);
+  this->Analyses.push_back(shmAdaptor.GetPointer());
+
+  return 0;
+#endif
+}
+
+// --------------------------------------------------------------------------
+int ConfigurableAnalysis::InternalsType::AddMPIInTransit(pugi::xml_node node)
+{
+  auto mpiAdaptor = svtkSmartPointer<MPIInTransitAnalysisAdaptor>::New();
+
+  if (this->Comm != MPI_COMM_NULL)
+    mpiAdaptor->SetCommunicator(this->Comm);
+
+  if (mpiAdaptor->Initialize(node))
+    {
+    SENSEI_ERROR("Failed to configure the MPI in transit adaptor from XML")
+    return -1;
+    }
+
+  this->TimeInitialization(mpiAdaptor);
+  this->Analyses.push_back(mpiAdaptor.GetPointer());
+
+  return 0;
+}
+
 
 // --------------------------------------------------------------------------
 int ConfigurableAnalysis::InternalsType::AddCatalyst(pugi::xml_node node)
@@ -889,23 +1121,37 @@ int ConfigurableAnalysis::InternalsType::AddAutoCorrelation(pugi::xml_node node)
   int window = node.attribute("window").as_int(10);
   int kMax = node.attribute("k-max").as_int(3);
   int numThreads = node.attribute("n-threads").as_int(1);
+  int maxBlocks = node.attribute("max-blocks-in-memory").as_int(-1);
+  std::string storageDir = node.attribute("storage-dir").as_string("/tmp");
+
+  std::string compStr = node.attribute("component").as_string("0");
+  int comp = compStr == "magnitude" ? Autocorrelation::MAGNITUDE :
+    atoi(compStr.c_str());
 
   auto adaptor = svtkSmartPointer<Autocorrelation>::New();
 
   if (this->Comm != MPI_COMM_NULL)
     adaptor->SetCommunicator(this->Comm);
 
-  this->TimeInitialization(adaptor, [&]() {
-    adaptor->Initialize(window, meshName, assoc, arrayName, kMax);
-    return 0;
-  });
+  adaptor->SetComponent(comp);
+
+  if (this->TimeInitialization(adaptor, [&]() {
+      return adaptor->Initialize(window, meshName, assoc, arrayName, kMax,
+        numThreads, maxBlocks, storageDir);
+    }))
+    {
+    SENSEI_ERROR("Failed to initialize Autocorrelation");
+    return -1;
+    }
 
   this->Analyses.push_back(adaptor.GetPointer());
 
   SENSEI_STATUS("Configured Autocorrelation " << assocStr
     << " data array \"" << arrayName << "\" on mesh \"" << meshName
-    << "\" window " << window << " k-max " << kMax
-    << " n-threads " << numThreads)
+    << "\" component " << compStr << " window " << window << " k-max " << kMax
+    << " n-threads " << numThreads << (maxBlocks > 0 ?
+    " max-blocks-in-memory " + std::to_string(maxBlocks) + " storage-dir " +
+    storageDir : std::string()))
 
   return 0;
 }
@@ -1228,6 +1474,459 @@ int ConfigurableAnalysis::InternalsType::AddCalculator(pugi::xml_node node)
 #endif
 }
 
+// --------------------------------------------------------------------------
+int ConfigurableAnalysis::InternalsType::GetDataRequirements(
+  pugi::xml_node node, DataRequirements &req)
+{
+  if (req.Initialize(node))
+    return -1;
+
+  if (req.Empty() && node.attribute("mesh"))
+    {
+    std::string mesh = node.attribute("mesh").value();
+    if (node.attribute("array"))
+      {
+      int association = 0;
+      std::string assocStr = node.attribute("association").as_string("point");
+      if (SVTKUtils::GetAssociation(assocStr, association))
+        return -1;
+
+      req.AddRequirement(mesh, association, node.attribute("array").value());
+      }
+    else
+      {
+      req.AddRequirement(mesh, false);
+      }
+    }
+
+  return 0;
+}
+
+// --------------------------------------------------------------------------
+int ConfigurableAnalysis::InternalsType::MakeAsync(pugi::xml_node node)
+{
+  if (!node.attribute("async").as_int(this->Async))
+    return 0;
+
+  AnalysisAdaptorPtr analysis = this->Analyses.back();
+
+  // the snapshot contains only the data the analysis needs
+  DataRequirements req;
+  if (this->GetDataRequirements(node, req))
+    {
+    SENSEI_ERROR("Failed to initialize data requirements for asynchronous "
+      << analysis->GetClassName())
+    return -1;
+    }
+
+  unsigned int maxInFlight = node.attribute("max-in-flight").as_uint(this->MaxInFlight);
+  std::string overflow = node.attribute("overflow").as_string(this->Overflow.c_str());
+
+  auto async = svtkSmartPointer<AsyncAnalysisAdaptor>::New();
+
+  if (this->Comm != MPI_COMM_NULL)
+    async->SetCommunicator(this->Comm);
+
+  if (async->SetAnalysis(analysis) || async->SetDataRequirements(req) ||
+    async->SetMaxInFlight(maxInFlight) || async->SetOverflowMode(overflow) ||
+    async->Initialize())
+    {
+    SENSEI_ERROR("Failed to configure asynchronous execution of "
+      << analysis->GetClassName())
+    return -1;
+    }
+
+  this->Analyses.back() = async.GetPointer();
+
+  SENSEI_STATUS("Configured " << analysis->GetClassName() << " to run asynchronously"
+    << " with max-in-flight=" << maxInFlight << " overflow=" << overflow)
+
+  return 0;
+}
+
+// --------------------------------------------------------------------------
+int ConfigurableAnalysis::InternalsType::AddTask(pugi::xml_node node)
+{
+  AnalysisTask task;
+  task.Name = node.attribute("name").as_string("");
+  XMLUtils::ParseList(node.attribute("depends").as_string(""), task.DependsOn);
+
+  if (this->GetDataRequirements(node, task.Requirements))
+    {
+    SENSEI_ERROR("Failed to initialize data requirements for "
+      << this->Analyses.back()->GetClassName())
+    return -1;
+    }
+
+  this->Tasks.push_back(task);
+
+  return 0;
+}
+
+// --------------------------------------------------------------------------
+int ConfigurableAnalysis::InternalsType::InitializeTasks(MPI_Comm comm)
+{
+  unsigned int nTasks = this->Tasks.size();
+
+  // resolve the dependencies
+  std::map<std::string, unsigned int> ids;
+  for (unsigned int i = 0; i < nTasks; ++i)
+    {
+    const std::string &name = this->Tasks[i].Name;
+    if (name.empty())
+      continue;
+
+    if (!ids.insert(std::make_pair(name, i)).second)
+      {
+      SENSEI_ERROR("Multiple analyses are named \"" << name << "\"")
+      return -1;
+      }
+    }
+
+  for (unsigned int i = 0; i < nTasks; ++i)
+    {
+    AnalysisTask &task = this->Tasks[i];
+    unsigned int nDeps = task.DependsOn.size();
+    for (unsigned int j = 0; j < nDeps; ++j)
+      {
+      auto it = ids.find(task.DependsOn[j]);
+      if (it == ids.end())
+        {
+        SENSEI_ERROR("Analysis " << i << " depends on \"" << task.DependsOn[j]
+          << "\" but no analysis has that name")
+        return -1;
+        }
+      task.Inputs.push_back(it->second);
+      this->Tasks[it->second].Outputs.push_back(i);
+      }
+    }
+
+  // order the analyses such that each one comes after those it depends on,
+  // and otherwise in the order they were configured
+  std::vector<unsigned int> nPending(nTasks);
+  for (unsigned int i = 0; i < nTasks; ++i)
+    nPending[i] = this->Tasks[i].Inputs.size();
+
+  this->Order.clear();
+  std::vector<bool> done(nTasks, false);
+  while (this->Order.size() < nTasks)
+    {
+    unsigned int i = 0;
+    while ((i < nTasks) && (done[i] || nPending[i]))
+      ++i;
+
+    if (i == nTasks)
+      {
+      SENSEI_ERROR("The dependencies between the analyses contain a cycle")
+      return -1;
+      }
+
+    done[i] = true;
+    this->Order.push_back(i);
+
+    unsigned int nOut = this->Tasks[i].Outputs.size();
+    for (unsigned int j = 0; j < nOut; ++j)
+      nPending[this->Tasks[i].Outputs[j]] -= 1;
+    }
+
+  if (this->Cache && ((nTasks > 1) || this->StaticGeometry))
+    {
+    this->DataCache = svtkSmartPointer<CachingDataAdaptor>::New();
+    this->DataCache->SetCommunicator(comm);
+    this->DataCache->SetCacheStaticGeometry(this->StaticGeometry);
+    }
+
+  if (!this->Concurrent || (nTasks < 2))
+    return 0;
+
+  // analyses will make MPI calls from the pool's threads
+  int threadLevel = MPI_THREAD_SINGLE;
+  MPI_Query_thread(&threadLevel);
+  if (threadLevel < MPI_THREAD_MULTIPLE)
+    {
+    SENSEI_WARNING("MPI was not initialized with MPI_THREAD_MULTIPLE."
+      " Analyses will run serially")
+    return 0;
+    }
+
+  // each analysis running on the pool gets its own copy of the
+  // simulation's data
+  for (unsigned int i = 0; i < nTasks; ++i)
+    {
+    this->Tasks[i].Data = svtkSmartPointer<SVTKDataAdaptor>::New();
+    this->Tasks[i].Data->SetCommunicator(comm);
+    }
+
+  unsigned int nThreads = this->NumThreads;
+  if (nThreads < 1)
+    nThreads = std::max(1u, std::min(nTasks, std::thread::hardware_concurrency()));
+
+  for (unsigned int i = 0; i < nThreads; ++i)
+    this->Threads.emplace_back(&InternalsType::Work, this);
+
+  SENSEI_STATUS("Analyses will run concurrently on " << nThreads << " threads")
+
+  return 0;
+}
+
+// --------------------------------------------------------------------------
+void ConfigurableAnalysis::InternalsType::FetchTask(unsigned int i,
+  DataAdaptor *data)
+{
+  if (this->Tasks[i].Data->SetDataObjects(data, this->Tasks[i].Requirements, false))
+    {
+    SENSEI_ERROR("Failed to fetch data for "
+      << this->Analyses[i]->GetClassName())
+    MPI_Abort(this->Analyses[i]->GetCommunicator(), -1);
+    }
+}
+
+// --------------------------------------------------------------------------
+void ConfigurableAnalysis::InternalsType::RunTask(unsigned int i,
+  DataAdaptor *data)
+{
+  AnalysisTask &task = this->Tasks[i];
+  AnalysisAdaptorPtr &analysis = this->Analyses[i];
+
+  // the output of a dependency takes the place of the simulation's data
+  DataAdaptor *input = task.MainThread ? data : task.Data.GetPointer();
+  unsigned int nInputs = task.Inputs.size();
+  for (unsigned int j = 0; j < nInputs; ++j)
+    {
+    DataAdaptor *result = this->Tasks[task.Inputs[j]].Result;
+    if (result)
+      input = result;
+    }
+
+  const char* analysisName = nullptr;
+  bool logEnabled = Profiler::Enabled();
+  if (logEnabled)
+    {
+    analysisName = this->LogEventNames[3 * i + 1].c_str();
+    Profiler::StartEvent(analysisName);
+    }
+
+  if (!analysis->Execute(input, task.WantResult ? &task.Result : nullptr))
+    {
+    SENSEI_ERROR("Failed to execute " << analysis->GetClassName())
+    MPI_Abort(analysis->GetCommunicator(), -1);
+    }
+
+  if (logEnabled)
+    Profiler::EndEvent(analysisName);
+}
+
+// --------------------------------------------------------------------------
+void ConfigurableAnalysis::InternalsType::CompleteTask(unsigned int i)
+{
+    {
+    std::lock_guard<std::mutex> lock(this->Mutex);
+    AnalysisTask &task = this->Tasks[i];
+    unsigned int nOut = task.Outputs.size();
+    for (unsigned int j = 0; j < nOut; ++j)
+      {
+      AnalysisTask &dep = this->Tasks[task.Outputs[j]];
+      dep.NumPending -= 1;
+      if (!dep.NumPending && !dep.MainThread)
+        this->Ready.push_back(task.Outputs[j]);
+      }
+    this->NumDone += 1;
+    }
+  this->Cond.notify_all();
+}
+
+// --------------------------------------------------------------------------
+void ConfigurableAnalysis::InternalsType::Work()
+{
+  while (true)
+    {
+    unsigned int i = 0;
+      {
+      std::unique_lock<std::mutex> lock(this->Mutex);
+      this->Cond.wait(lock, [this]() {
+        return this->Shutdown || !this->Ready.empty(); });
+
+      if (this->Ready.empty())
+        break;
+
+      i = this->Ready.front();
+      this->Ready.pop_front();
+      }
+
+    this->RunTask(i, nullptr);
+    this->CompleteTask(i);
+    }
+}
+
+// --------------------------------------------------------------------------
+void ConfigurableAnalysis::InternalsType::StopThreads()
+{
+    {
+    std::lock_guard<std::mutex> lock(this->Mutex);
+    this->Shutdown = true;
+    }
+  this->Cond.notify_all();
+
+  unsigned int nThreads = this->Threads.size();
+  for (unsigned int i = 0; i < nThreads; ++i)
+    this->Threads[i].join();
+
+  this->Threads.clear();
+}
+
+// --------------------------------------------------------------------------
+void ConfigurableAnalysis::InternalsType::ExecuteTasks(DataAdaptor *data,
+  DataAdaptor **dataOut)
+{
+  unsigned int nTasks = this->Tasks.size();
+  bool concurrent = !this->Threads.empty();
+
+  // fetch from the simulation once for all the analyses. in transit
+  // adaptors are passed as is since some analyses make use of their API
+  if (this->DataCache && !dynamic_cast<InTransitDataAdaptor*>(data))
+    {
+    this->DataCache->SetDataAdaptor(data);
+    data = this->DataCache.GetPointer();
+    }
+
+  // analyses that produce data for others, and when running concurrently
+  // the last analysis if the caller wants output, run on this thread. this
+  // keeps the communicator duplication that comes with allocating an output
+  // data adaptor in the same order on all ranks.
+  for (unsigned int i = 0; i < nTasks; ++i)
+    {
+    AnalysisTask &task = this->Tasks[i];
+    task.NumPending = task.Inputs.size();
+    task.Result = nullptr;
+    task.WantResult = !task.Outputs.empty() ||
+      (dataOut && (!concurrent || (i == nTasks - 1)));
+    task.MainThread = !concurrent || task.WantResult;
+    }
+
+  // in serial execution the output of the last analysis to produce any is
+  // returned. the output of the analyses running on the pool is not
+  // collected, so warn that it may differ
+  if (concurrent && dataOut && !this->OutputWarned)
+    {
+    std::string poolNames;
+    for (unsigned int i = 0; i < nTasks; ++i)
+      {
+      if (!this->Tasks[i].MainThread)
+        {
+        poolNames += poolNames.empty() ? "" : ", ";
+        poolNames += this->Analyses[i]->GetClassName();
+        }
+      }
+
+    int rank = 0;
+    if (!poolNames.empty())
+      MPI_Comm_rank(this->Analyses[0]->GetCommunicator(), &rank);
+
+    if (!poolNames.empty() && (rank == 0))
+      {
+      SENSEI_WARNING("In concurrent execution only the output of the last "
+        "analysis and of analyses others depend on is returned. Output of "
+        << poolNames << " is discarded")
+      }
+
+    this->OutputWarned = true;
+    }
+
+  if (concurrent)
+    {
+    // analyses that depend on others process their output, their data is
+    // fetched only if their dependencies produce none. see below.
+    TimeEvent<128> event("ConfigurableAnalysis::FetchData");
+    for (unsigned int i = 0; i < nTasks; ++i)
+      {
+      AnalysisTask &task = this->Tasks[i];
+      if (!task.MainThread && task.Inputs.empty())
+        this->FetchTask(i, data);
+      }
+    }
+
+  // start the analyses that are ready on the pool
+  std::unique_lock<std::mutex> lock(this->Mutex);
+  this->NumDone = 0;
+  for (unsigned int i = 0; i < nTasks; ++i)
+    {
+    AnalysisTask &task = this->Tasks[i];
+    if (!task.MainThread && !task.NumPending)
+      this->Ready.push_back(i);
+    }
+  lock.unlock();
+  this->Cond.notify_all();
+
+  // run the rest here
+  for (unsigned int j = 0; j < nTasks; ++j)
+    {
+    unsigned int i = this->Order[j];
+    AnalysisTask &task = this->Tasks[i];
+    if (!task.MainThread)
+      continue;
+
+    lock.lock();
+    this->Cond.wait(lock, [&task]() { return task.NumPending == 0; });
+    lock.unlock();
+
+    this->RunTask(i, data);
+
+    // the analyses that depend on others all run here. when this completes
+    // the last dependency of an analysis that runs on the pool and none of
+    // its dependencies produced data, it falls back to the simulation's data
+    unsigned int nOut = task.Outputs.size();
+    for (unsigned int k = 0; concurrent && (k < nOut); ++k)
+      {
+      unsigned int o = task.Outputs[k];
+      AnalysisTask &dep = this->Tasks[o];
+      if (dep.MainThread || (dep.NumPending != 1))
+        continue;
+
+      bool haveResult = false;
+      unsigned int nIn = dep.Inputs.size();
+      for (unsigned int q = 0; !haveResult && (q < nIn); ++q)
+        haveResult = this->Tasks[dep.Inputs[q]].Result != nullptr;
+
+      if (!haveResult)
+        {
+        TimeEvent<128> event("ConfigurableAnalysis::FetchData");
+        this->FetchTask(o, data);
+        }
+      }
+
+    this->CompleteTask(i);
+    }
+
+  lock.lock();
+  this->Cond.wait(lock, [this,nTasks]() { return this->NumDone == nTasks; });
+  lock.unlock();
+
+  // when more than one analysis produced output the last one wins
+  DataAdaptor *result = nullptr;
+  for (unsigned int i = 0; i < nTasks; ++i)
+    {
+    AnalysisTask &task = this->Tasks[i];
+    if (task.Result)
+      {
+      if (result)
+        result->Delete();
+      result = task.Result;
+      task.Result = nullptr;
+      }
+
+    if (task.Data)
+      task.Data->ReleaseData();
+    }
+
+  if (this->DataCache)
+    this->DataCache->ReleaseData();
+
+  if (dataOut)
+    *dataOut = result;
+  else if (result)
+    result->Delete();
+}
+
 //----------------------------------------------------------------------------
 senseiNewMacro(ConfigurableAnalysis);
 
@@ -1240,6 +1939,9 @@ ConfigurableAnalysis::ConfigurableAnalysis()
 //----------------------------------------------------------------------------
 ConfigurableAnalysis::~ConfigurableAnalysis()
 {
+  if (!this->Internals->Threads.empty())
+    this->Internals->StopThreads();
+
   delete this->Internals;
 }
 
@@ -1286,6 +1988,30 @@ int ConfigurableAnalysis::Initialize(const pugi::xml_node &root)
 {
   TimeEvent<128> event("ConfigurableAnalysis::Initialize");
 
+  // defaults for asynchronous execution
+  this->Internals->Async = root.attribute("async").as_int(0);
+  this->Internals->MaxInFlight = root.attribute("max-in-flight").as_uint(2);
+  this->Internals->Overflow = root.attribute("overflow").as_string("block");
+
+  // concurrent execution of independent analyses
+  std::string execution = root.attribute("execution").as_string("serial");
+  if ((execution != "serial") && (execution != "concurrent"))
+    {
+    SENSEI_ERROR("Invalid execution \"" << execution
+      << "\". Use one of \"serial\" or \"concurrent\"")
+    MPI_Abort(this->GetCommunicator(), -1);
+    }
+  this->Internals->Concurrent = (execution == "concurrent");
+  this->Internals->NumThreads = root.attribute("n-threads").as_uint(0);
+
+  // threads used by SVTK's parallel algorithms
+  if (int smpThreads = root.attribute("smp-threads").as_int(0))
+    svtkSMPTools::Initialize(smpThreads);
+
+  // sharing of the simulation's data between the analyses
+  this->Internals->Cache = root.attribute("cache").as_int(1);
+  this->Internals->StaticGeometry = root.attribute("static-geometry").as_int(0);
+
   // create and configure analysis adaptors
   for (pugi::xml_node node = root.child("analysis");
     node; node = node.next_sibling("analysis"))
@@ -1293,14 +2019,19 @@ int ConfigurableAnalysis::Initialize(const pugi::xml_node &root)
     if (!node.attribute("enabled").as_int(0))
       continue;
 
+    size_t nAnalyses = this->Internals->Analyses.size();
+
     std::string type = node.attribute("type").value();
     if (!(((type == "histogram") && !this->Internals->AddHistogram(node))
+      || ((type == "histogramnd") && !this->Internals->AddMultiHistogram(node))
       || ((type == "autocorrelation") && !this->Internals->AddAutoCorrelation(node))
       || ((type == "adios1") && !this->Internals->AddAdios1(node))
       || ((type == "adios2") && !this->Internals->AddAdios2(node))
       || ((type == "ascent") && !this->Internals->AddAscent(node))
       || ((type == "catalyst") && !this->Internals->AddCatalyst(node))
       || ((type == "hdf5") && !this->Internals->AddHDF5(node))
+      || ((type == "shared_mem") && !this->Internals->AddSharedMem(node))
+      || ((type == "mpi_in_transit") && !this->Internals->AddMPIInTransit(node))
       || ((type == "libsim") && !this->Internals->AddLibsim(node))
       || ((type == "vistle") && !this->Internals->AddVistle(node))
       || ((type == "PosthocIO") && !this->Internals->AddPosthocIO(node))
@@ -1315,6 +2046,14 @@ int ConfigurableAnalysis::Initialize(const pugi::xml_node &root)
       SENSEI_ERROR("Failed to add \"" << type << "\" analysis")
       MPI_Abort(this->GetCommunicator(), -1);
       }
+
+    // some analyses share a single instance, those can't be made asynchronous
+    if ((this->Internals->Analyses.size() > nAnalyses) &&
+      (this->Internals->MakeAsync(node) || this->Internals->AddTask(node)))
+      {
+      SENSEI_ERROR("Failed to configure the execution of \"" << type << "\" analysis")
+      MPI_Abort(this->GetCommunicator(), -1);
+      }
     }
 
   // create and configure transport analysis adaptors
@@ -1327,13 +2066,23 @@ int ConfigurableAnalysis::Initialize(const pugi::xml_node &root)
     std::string type = node.attribute("type").value();
     if (!(((type == "adios1") && !this->Internals->AddAdios1(node))
       || ((type == "adios2") && !this->Internals->AddAdios2(node))
-      || ((type == "hdf5") && !this->Internals->AddHDF5(node))))
+      || ((type == "hdf5") && !this->Internals->AddHDF5(node))
+      || ((type == "shared_mem") && !this->Internals->AddSharedMem(node))
+      || ((type == "mpi_in_transit") && !this->Internals->AddMPIInTransit(node)))
+      || this->Internals->AddTask(node))
       {
       SENSEI_ERROR("Failed to add \"" << type << "\" transport")
       MPI_Abort(this->GetCommunicator(), -1);
       }
     }
 
+  // order the analyses and set up concurrent execution
+  if (this->Internals->InitializeTasks(this->GetCommunicator()))
+    {
+    SENSEI_ERROR("Failed to initialize the execution of the analyses")
+    MPI_Abort(this->GetCommunicator(), -1);
+    }
+
   return 0;
 }
 
@@ -1342,34 +2091,16 @@ bool ConfigurableAnalysis::Execute(DataAdaptor* data, DataAdaptor** dataOut)
 {
   // Currently, we'll assume that only 1 analysis adaptor will generate
   // non-null result to report as the result; in case of multiple, the last one wins.
-  // In future, we can extend the XML
-  // specification to support identifying which analysis generates results of
-  // interest and potentially how results are propagated between analyses.
+  // Results of analyses that others depend on are passed to the dependent
+  // analyses in place of the simulation's data.
 
+  {
   TimeEvent<128> event("ConfigurableAnalysis::Execute");
+  this->Internals->ExecuteTasks(data, dataOut);
+  }
 
-  int ai = 0;
-  AnalysisAdaptorVector::iterator iter = this->Internals->Analyses.begin();
-  AnalysisAdaptorVector::iterator end = this->Internals->Analyses.end();
-  for (; iter != end; ++iter, ++ai)
-    {
-    const char* analysisName = nullptr;
-    bool logEnabled = Profiler::Enabled();
-    if (logEnabled)
-      {
-      analysisName = this->Internals->LogEventNames[3 * ai + 1].c_str();
-      Profiler::StartEvent(analysisName);
-      }
-
-    if (!(*iter)->Execute(data, dataOut))
-      {
-      SENSEI_ERROR("Failed to execute " << (*iter)->GetClassName())
-      MPI_Abort(this->GetCommunicator(), -1);
-      }
-
-    if (logEnabled)
-      Profiler::EndEvent(analysisName);
-    }
+  // reduce and write the profiler's statistics when an interval is set
+  Profiler::EndStep();
 
   return true;
 }
@@ -1379,6 +2110,9 @@ int ConfigurableAnalysis::Finalize()
 {
   TimeEvent<128> event("ConfigurableAnalysis::Finalize");
 
+  if (!this->Internals->Threads.empty())
+    this->Internals->StopThreads();
+
   int ai = 0;
   AnalysisAdaptorVector::iterator iter = this->Internals->Analyses.begin();
   AnalysisAdaptorVector::iterator end = this->Internals->Analyses.end();
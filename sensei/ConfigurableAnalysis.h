@@ -30,6 +30,14 @@ namespace sensei
  * | sensei::PythonAnalysis | Invokes user provided Pythons scripts that process simulation data |
  * | sensei::SliceExtract | Computes planar slices and iso-surfaces on simulation data |
  *
+ * Any of the above may be run in the background by setting the async
+ * attribute, see sensei::AsyncAnalysisAdaptor.
+ *
+ * When more than one analysis is configured, the data fetched from the
+ * simulation during a step is shared between them, see
+ * sensei::CachingDataAdaptor. Set cache="0" on the sensei element to disable
+ * this. Set static-geometry="1" to also keep the geometry of static meshes
+ * from one step to the next.
  */
 class SENSEI_EXPORT ConfigurableAnalysis : public AnalysisAdaptor
 {
@@ -1,5 +1,6 @@
 #include "ConfigurableInTransitDataAdaptor.h"
 #include "InTransitDataAdaptor.h"
+#include "MPIInTransitDataAdaptor.h"
 #include "XMLUtils.h"
 #include "Error.h"
 #ifdef ENABLE_ADIOS1
@@ -11,6 +12,9 @@
 #ifdef ENABLE_HDF5
 #include "HDF5DataAdaptor.h"
 #endif
+#ifdef ENABLE_SHARED_MEM
+#include "SharedMemDataAdaptor.h"
+#endif
 
 #include <pugixml.hpp>
 #include <string>
@@ -113,6 +117,19 @@ int ConfigurableInTransitDataAdaptor::Initialize(pugi::xml_node &root)
     adaptor = HDF5DataAdaptor::New();
 #endif
     }
+  else if (type == "shared_mem")
+    {
+#ifndef ENABLE_SHARED_MEM
+    SENSEI_ERROR("Shared memory transport requested but is disabled in this build")
+    return -1;
+#else
+    adaptor = SharedMemDataAdaptor::New();
+#endif
+    }
+  else if (type == "mpi_in_transit")
+    {
+    adaptor = MPIInTransitDataAdaptor::New();
+    }
   else if (type == "libis")
     {
 #ifndef ENABLE_LIBIS
@@ -138,6 +155,8 @@ int ConfigurableInTransitDataAdaptor::Initialize(pugi::xml_node &root)
 
   // intialize the adaptor. the partitioner is typically iniitialized
   // by the default initialize in the InTransitDataAdaptor
+  adaptor->SetCommunicator(this->GetCommunicator());
+
   if (adaptor->SetConnectionInfo(this->GetConnectionInfo()) ||
     adaptor->Initialize(node))
     {
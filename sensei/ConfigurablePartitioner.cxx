@@ -2,8 +2,11 @@
 #include "Partitioner.h"
 #include "BlockPartitioner.h"
 #include "MappedPartitioner.h"
+#include "NodeAwarePartitioner.h"
 #include "PlanarPartitioner.h"
 #include "PlanarSlicePartitioner.h"
+#include "SFCPartitioner.h"
+#include "WeightedPartitioner.h"
 #include "XMLUtils.h"
 #include "Profiler.h"
 
@@ -80,6 +83,18 @@ int ConfigurablePartitioner::Initialize(pugi::xml_node &partNode)
     {
     tmp = PlanarSlicePartitioner::New();
     }
+  else if (partType == "weighted")
+    {
+    tmp = WeightedPartitioner::New();
+    }
+  else if (partType == "sfc")
+    {
+    tmp = SFCPartitioner::New();
+    }
+  else if (partType == "node_aware")
+    {
+    tmp = NodeAwarePartitioner::New();
+    }
   else
     {
     SENSEI_ERROR("Failed to construct a partitioner. \""
@@ -31,8 +31,8 @@ public:
     sensei::MeshMetadataPtr &out) override;
 
   /** initialize the partitioner from the XML node.  recognizes the following
-   * Partitioner's: block, cyclic, planar, and mapped. The XML schema is as
-   * follows:
+   * Partitioner's: block, planar, mapped, planar_slice, weighted, sfc, and
+   * node_aware. The XML schema is as follows:
    *
    * ```xml
    * <partitioner type="..." ... >
@@ -40,8 +40,9 @@ public:
    * </partitioner>
    *```
    *
-   * where type is one of block, cyclic, planar, or mapped. See sensei::Parititioner
-   * sub-classes for documentation on the specific XML recognized by each.
+   * where type is one of block, planar, mapped, planar_slice, weighted, sfc,
+   * or node_aware. See sensei::Parititioner sub-classes for documentation on
+   * the specific XML recognized by each.
    */
   virtual int Initialize(pugi::xml_node &) override;
 
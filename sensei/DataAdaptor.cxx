@@ -1,5 +1,6 @@
 #include "DataAdaptor.h"
 #include "MeshMetadata.h"
+#include "MPIManager.h"
 #include "SVTKUtils.h"
 #include "Error.h"
 
@@ -29,7 +30,7 @@ struct DataAdaptor::InternalsType
 //----------------------------------------------------------------------------
 DataAdaptor::DataAdaptor()
 {
-  MPI_Comm_dup(MPI_COMM_WORLD, &this->Comm);
+  MPI_Comm_dup(MPIManager::GetDefaultCommunicator(), &this->Comm);
   this->Internals = new InternalsType;
 }
 
@@ -10,6 +10,9 @@
 #include "MappedPartitioner.h"
 #include "PlanarSlicePartitioner.h"
 #include "IsoSurfacePartitioner.h"
+#include "WeightedPartitioner.h"
+#include "SFCPartitioner.h"
+#include "NodeAwarePartitioner.h"
 #include "ConfigurablePartitioner.h"
 #include "SVTKUtils.h"
 #include "Error.h"
@@ -301,6 +304,9 @@ SENSEI_WRAP_DATA_ADAPTOR(DataAdaptor)
 %shared_ptr(sensei::MappedPartitioner)
 %shared_ptr(sensei::PlanarSlicePartitioner)
 %shared_ptr(sensei::IsoSurfacePartitioner)
+%shared_ptr(sensei::WeightedPartitioner)
+%shared_ptr(sensei::SFCPartitioner)
+%shared_ptr(sensei::NodeAwarePartitioner)
 %shared_ptr(sensei::ConfigurablePartitioner)
 
 %define PARTITIONER_API(cname)
@@ -326,6 +332,9 @@ PARTITIONER_API(PlanarPartitioner)
 PARTITIONER_API(MappedPartitioner)
 PARTITIONER_API(PlanarSlicePartitioner)
 PARTITIONER_API(IsoSurfacePartitioner)
+PARTITIONER_API(WeightedPartitioner)
+PARTITIONER_API(SFCPartitioner)
+PARTITIONER_API(NodeAwarePartitioner)
 PARTITIONER_API(ConfigurablePartitioner)
 
 %include "Partitioner.h"
@@ -334,6 +343,9 @@ PARTITIONER_API(ConfigurablePartitioner)
 %include "MappedPartitioner.h"
 %include "PlanarSlicePartitioner.h"
 %include "IsoSurfacePartitioner.h"
+%include "WeightedPartitioner.h"
+%include "SFCPartitioner.h"
+%include "NodeAwarePartitioner.h"
 %include "ConfigurablePartitioner.h"
 
 /****************************************************************************
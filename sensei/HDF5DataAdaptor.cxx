@@ -135,6 +135,8 @@ int HDF5DataAdaptor::CloseStream()
       this->m_HDF5Reader = nullptr;
     }
 
+  this->m_StaticReceiverMetadata.clear();
+
   return 0;
 }
 
@@ -232,6 +234,16 @@ int HDF5DataAdaptor::GetMeshMetadata(unsigned int id, MeshMetadataPtr& metadata)
           return -1;
         }
 
+      // the layout of a static mesh does not change
+      std::map<unsigned int, MeshMetadataPtr>::iterator it =
+        this->m_StaticReceiverMetadata.find(id);
+      if (senderMd->StaticMesh && (it != this->m_StaticReceiverMetadata.end()))
+        {
+          metadata = it->second;
+          this->m_HDF5Reader->m_AllMeshInfoReceiver.SetMeshMetadata(id, metadata);
+          return 0;
+        }
+
       // get the partitioner, default to the block based layout
       PartitionerPtr part = this->GetPartitioner();
       if (!part)
@@ -248,6 +260,10 @@ int HDF5DataAdaptor::GetMeshMetadata(unsigned int id, MeshMetadataPtr& metadata)
         }
 
       metadata = recverMd;
+
+      if (senderMd->StaticMesh && recverMd)
+        this->m_StaticReceiverMetadata[id] = recverMd;
+
       //
       // use this meshmetadata to read objects
       //
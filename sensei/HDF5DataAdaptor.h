@@ -79,6 +79,9 @@ private:
 
   std::string m_StreamName;
 
+  // receiver layouts of static meshes, computed by the partitioner once
+  std::map<unsigned int, MeshMetadataPtr> m_StaticReceiverMetadata;
+
   HDF5DataAdaptor(const HDF5DataAdaptor &) = delete;
   void operator=(const HDF5DataAdaptor &) = delete;
 };
@@ -17,13 +17,18 @@
 
 #include <algorithm>
 #include <vector>
+#include <thread>
+#include <limits>
+#include <cmath>
+#include <cstring>
+#include <cstdio>
 
 namespace
 {
 // **************************************************************************
 int Write(const std::string &fileName, int step, double time,
   const std::string &meshName, const std::string &arrayName,
-  sensei::Histogram::Data &result)
+  bool outOfRange, sensei::Histogram::Data &result)
 {
   // write the histogram to a file
   char fname[1024] = {'\0'};
@@ -51,6 +56,11 @@ int Write(const std::string &fileName, int step, double time,
   for (int i = 0; i < result.NumberOfBins; ++i)
     fprintf(file, "%d ", result.Histogram[i]);
   fprintf(file, "\n");
+  if (outOfRange)
+    {
+    fprintf(file, "underflow : %u\n", result.Underflow);
+    fprintf(file, "overflow : %u\n", result.Overflow);
+    }
   fclose(file);
 
   return 0;
@@ -58,7 +68,7 @@ int Write(const std::string &fileName, int step, double time,
 
 // **************************************************************************
 int Write(int step, double time, const std::string &meshName,
-  const std::string &arrayName, sensei::Histogram::Data &result)
+  const std::string &arrayName, bool outOfRange, sensei::Histogram::Data &result)
 {
   // write the histogram to std::cout
   int origPrec = cout.precision();
@@ -75,6 +85,12 @@ int Write(int step, double time, const std::string &meshName,
       << ": " << std::fixed << result.Histogram[i] << std::endl;
     }
 
+  if (outOfRange)
+    {
+    std::cout << "underflow : " << result.Underflow << std::endl
+      << "overflow : " << result.Overflow << std::endl;
+    }
+
   std::cout.precision(origPrec);
 
   return 0;
@@ -87,7 +103,8 @@ namespace sensei
 senseiNewMacro(Histogram);
 
 //-----------------------------------------------------------------------------
-Histogram::Histogram() : NumberOfBins(0),
+Histogram::Histogram() : NumberOfBins(0), NumberOfThreads(0),
+  RangeMode(RANGE_AUTO), RangeMin(0.0), RangeMax(1.0),
   Association(svtkDataObject::FIELD_ASSOCIATION_POINTS)
 {
 }
@@ -106,6 +123,104 @@ void Histogram::Initialize(int bins, const std::string &meshName,
   this->ArrayName = arrayName;
   this->Association = association;
   this->FileName = fileName;
+
+  // the number of bins may have changed
+  this->Internals = nullptr;
+}
+
+//-----------------------------------------------------------------------------
+int Histogram::SetRangeMode(int mode)
+{
+  if ((mode != RANGE_AUTO) && (mode != RANGE_METADATA) && (mode != RANGE_FIXED))
+    {
+    SENSEI_ERROR("Invalid range mode " << mode)
+    return -1;
+    }
+
+  this->RangeMode = mode;
+  return 0;
+}
+
+//-----------------------------------------------------------------------------
+int Histogram::SetRange(double min, double max)
+{
+  if (!(max > min) || !std::isfinite(max - min))
+    {
+    SENSEI_ERROR("Invalid range [" << min << ", " << max << "]")
+    return -1;
+    }
+
+  this->RangeMode = RANGE_FIXED;
+  this->RangeMin = min;
+  this->RangeMax = max;
+  return 0;
+}
+
+//-----------------------------------------------------------------------------
+int Histogram::SetRange(const std::string &range)
+{
+  if (range == "auto")
+    return this->SetRangeMode(RANGE_AUTO);
+  else if (range == "metadata")
+    return this->SetRangeMode(RANGE_METADATA);
+
+  double min = 0.0;
+  double max = 0.0;
+  char extra = '\0';
+  if (sscanf(range.c_str(), " %lf , %lf %c", &min, &max, &extra) != 2)
+    {
+    SENSEI_ERROR("Invalid range \"" << range
+      << "\". Use one of \"auto\", \"metadata\", or \"min,max\"")
+    return -1;
+    }
+
+  return this->SetRange(min, max);
+}
+
+//-----------------------------------------------------------------------------
+int Histogram::GetMetadataRange(MPI_Comm comm, const MeshMetadataPtr &mmd,
+  double &min, double &max)
+{
+  min = std::numeric_limits<double>::max();
+  max = std::numeric_limits<double>::lowest();
+
+  // find the array
+  int arrayId = -1;
+  for (int i = 0; i < mmd->NumArrays; ++i)
+    {
+    if ((mmd->ArrayName[i] == this->ArrayName) &&
+      (mmd->ArrayCentering[i] == this->Association))
+      {
+      arrayId = i;
+      break;
+      }
+    }
+
+  // reduce the block ranges. the simulation may not have provided them
+  if (arrayId >= 0)
+    {
+    unsigned int nBlocks = mmd->BlockArrayRange.size();
+    for (unsigned int i = 0; i < nBlocks; ++i)
+      {
+      if ((unsigned int)arrayId < mmd->BlockArrayRange[i].size())
+        {
+        min = std::min(min, mmd->BlockArrayRange[i][arrayId][0]);
+        max = std::max(max, mmd->BlockArrayRange[i][arrayId][1]);
+        }
+      }
+    }
+
+  // a local view holds only this rank's blocks
+  if (!mmd->GlobalView)
+    {
+    double rng[2] = {-min, max};
+    MPI_Allreduce(MPI_IN_PLACE, rng, 2, MPI_DOUBLE, MPI_MAX, comm);
+    min = -rng[0];
+    max = rng[1];
+    }
+
+  // the simulation may report an unbounded range when it doesn't know
+  return ((max > min) && std::isfinite(max - min)) ? 0 : -1;
 }
 
 //-----------------------------------------------------------------------------
@@ -126,8 +241,12 @@ bool Histogram::Execute(DataAdaptor* data, DataAdaptor** dataOut)
     }
 
   // see what the simulation is providing
+  MeshMetadataFlags flags;
+  if (this->RangeMode == RANGE_METADATA)
+    flags.SetBlockArrayRange();
+
   MeshMetadataMap mdMap;
-  if (mdMap.Initialize(data))
+  if (mdMap.Initialize(data, flags))
     {
     SENSEI_ERROR("Failed to get metadata")
     return false;
@@ -154,17 +273,42 @@ bool Histogram::Execute(DataAdaptor* data, DataAdaptor** dataOut)
   MPI_Comm_rank(comm, &rank);
 
   // TODO : this lets one laod balance across multiple GPU's and CPU's
-  // set -1 to execute on the CPU and 0 to N_CUDA_DEVICES -1 to specify
-  // the specific GPU to run on.
-#if defined(ENABLE_CUDA)
+  // set -1 to execute on the CPU, "cpu-threads" to execute on the CPU using
+  // a thread per core, and 0 to N_CUDA_DEVICES -1 to specify the specific GPU
+  // to run on.
   const char *aDevId = getenv("HISTOGRAM_DEVICE_ID");
+#if defined(ENABLE_CUDA)
   aDevId = aDevId ? aDevId : "0";
-  int deviceId = atoi(aDevId);
 #else
   // run on the CPU
-  int deviceId = -1;
-  const char *aDevId = "";
+  aDevId = aDevId ? aDevId : "-1";
 #endif
+  int deviceId = HistogramInternals::DEVICE_CPU;
+  if (strcmp(aDevId, "cpu-threads") == 0)
+    {
+    deviceId = HistogramInternals::DEVICE_CPU_THREADS;
+    }
+#if defined(ENABLE_CUDA)
+  else
+    {
+    deviceId = atoi(aDevId);
+    }
+#endif
+
+  // the cores of a node are shared by the ranks running on it
+  if ((deviceId == HistogramInternals::DEVICE_CPU_THREADS) &&
+    (this->NumberOfThreads < 1))
+    {
+    MPI_Comm nodeComm = MPI_COMM_NULL;
+    MPI_Comm_split_type(comm, MPI_COMM_TYPE_SHARED, 0, MPI_INFO_NULL, &nodeComm);
+
+    int nNodeRanks = 1;
+    MPI_Comm_size(nodeComm, &nNodeRanks);
+    MPI_Comm_free(&nodeComm);
+
+    this->NumberOfThreads = std::max(1u,
+      std::thread::hardware_concurrency() / nNodeRanks);
+    }
 
   // get the current time and step
   int step = data->GetDataTimeStep();
@@ -175,14 +319,51 @@ bool Histogram::Execute(DataAdaptor* data, DataAdaptor** dataOut)
     SENSEI_STATUS("Step = " << step << " Time = " << time
       << " Computing the histogram on mesh \""
       << this->MeshName << "\" array \"" << this->ArrayName
-      << "\" using " << (deviceId < 0 ? "the CPU" : "CUDA GPU ")
-      << aDevId)
+      << "\" using " << (deviceId == HistogramInternals::DEVICE_CPU ? "the CPU" :
+      (deviceId == HistogramInternals::DEVICE_CPU_THREADS ?
+      std::to_string(this->NumberOfThreads) + " CPU threads" :
+      "CUDA GPU " + std::to_string(deviceId))))
+    }
+
+
+  // this class does all the work. it is kept from one step to the next so
+  // that its buffers are reused
+  if (!this->Internals || (this->Internals->GetDeviceId() != deviceId))
+    {
+    this->Internals = std::make_shared<HistogramInternals>(comm,
+      deviceId, this->NumberOfBins);
     }
 
+  std::shared_ptr<HistogramInternals> internals = this->Internals;
 
-  // create a new histogram computation. this class does all the work.
-  std::shared_ptr<sensei::HistogramInternals>
-    internals(new sensei::HistogramInternals(comm, deviceId, this->NumberOfBins));
+  internals->SetNumberOfThreads(this->NumberOfThreads);
+
+  // when the range is known the data is binned in a single pass
+  if (this->RangeMode == RANGE_FIXED)
+    {
+    internals->SetRange(this->RangeMin, this->RangeMax);
+    }
+  else if (this->RangeMode == RANGE_METADATA)
+    {
+    internals->ClearRange();
+
+    double rangeMin = 0.0;
+    double rangeMax = 0.0;
+    if (this->GetMetadataRange(comm, mmd, rangeMin, rangeMax) == 0)
+      {
+      internals->SetRange(rangeMin, rangeMax);
+      }
+    else if (rank == 0)
+      {
+      SENSEI_WARNING("The range of array \"" << this->ArrayName
+        << "\" is not available in the metadata of mesh \""
+        << this->MeshName << "\". The range will be computed from the data.")
+      }
+    }
+  else
+    {
+    internals->ClearRange();
+    }
 
   if (!dobj)
     {
@@ -274,7 +455,20 @@ bool Histogram::Execute(DataAdaptor* data, DataAdaptor** dataOut)
   Histogram::Data result;
 
   internals->GetHistogram(result.NumberOfBins, result.BinMin,
-    result.BinMax, result.BinWidth, result.Histogram);
+    result.BinMax, result.BinWidth, result.Histogram, result.Underflow,
+    result.Overflow);
+
+  // report the memory allocated during this step. when the buffers are
+  // reused from the previous step these are zero
+  result.NumberOfAllocations = internals->GetNumberOfAllocations();
+  result.NumberOfBytesAllocated = internals->GetNumberOfBytesAllocated();
+
+  if (this->GetVerbose() && result.NumberOfAllocations)
+    {
+    SENSEI_STATUS("Histogram made " << result.NumberOfAllocations
+      << " allocations totaling " << result.NumberOfBytesAllocated
+      << " bytes")
+    }
 
   this->LastResult = result;
 
@@ -283,11 +477,13 @@ bool Histogram::Execute(DataAdaptor* data, DataAdaptor** dataOut)
     {
     if (this->FileName.empty())
       {
-      ::Write(step, time, this->MeshName, this->ArrayName, result);
+      ::Write(step, time, this->MeshName, this->ArrayName,
+        this->RangeMode != RANGE_AUTO, result);
       }
     else
       {
-      if (::Write(this->FileName, step, time, this->MeshName, this->ArrayName, result))
+      if (::Write(this->FileName, step, time, this->MeshName, this->ArrayName,
+        this->RangeMode != RANGE_AUTO, result))
         {
         SENSEI_ERROR("Failed to write histogram.")
         return false;
@@ -320,6 +516,7 @@ int Histogram::GetHistogram(Histogram::Data &result)
 //-----------------------------------------------------------------------------
 int Histogram::Finalize()
 {
+  this->Internals = nullptr;
   return 0;
 }
 
@@ -2,14 +2,17 @@
 #define Histogram_h
 
 #include "AnalysisAdaptor.h"
+#include "MeshMetadata.h"
 #include <mpi.h>
 #include <vector>
+#include <memory>
 
 class svtkDataObject;
 class svtkDataArray;
 
 namespace sensei
 {
+class HistogramInternals;
 
 /// Computes a histogram in parallel.
 class SENSEI_EXPORT Histogram : public AnalysisAdaptor
@@ -25,6 +28,26 @@ public:
     int association, const std::string& arrayName,
     const std::string &fileName);
 
+  /// the ways the range of the histogram may be determined
+  enum {RANGE_AUTO = 0, RANGE_METADATA = 1, RANGE_FIXED = 2};
+
+  /** Set how the range of the histogram is determined. With RANGE_AUTO,
+   * the default, the range is computed from the data. With RANGE_METADATA
+   * the array range reported in the mesh metadata is used, falling back to
+   * RANGE_AUTO if the simulation does not provide it. With RANGE_FIXED the
+   * range passed to SetRange is used. When the range is known the data is
+   * binned in a single pass and values outside of it are counted in the
+   * under and overflow bins.
+   */
+  int SetRangeMode(int mode);
+  int GetRangeMode() { return this->RangeMode; }
+
+  /// Set a fixed range, and set the range mode to RANGE_FIXED
+  int SetRange(double min, double max);
+
+  /// Set the range from a string, one of "auto", "metadata", or "min,max"
+  int SetRange(const std::string &range);
+
   /// compute the histogram for this time step
   bool Execute(DataAdaptor* data, DataAdaptor**) override;
 
@@ -34,13 +57,19 @@ public:
   /// the computed histogram may be accessed through the following data structure.
   struct Data
   {
-      Data() : NumberOfBins(1), BinMin(1.0), BinMax(0.0), BinWidth(1.0), Histogram() {}
+      Data() : NumberOfBins(1), BinMin(1.0), BinMax(0.0), BinWidth(1.0),
+        Histogram(), Underflow(0), Overflow(0), NumberOfAllocations(0),
+        NumberOfBytesAllocated(0) {}
 
       int NumberOfBins; ///< The number of bins in the histogram
       double BinMin;    ///< The left most bin edge
       double BinMax;    ///< The right most bin edge
       double BinWidth;  ///< The width of the equally spaced bins
       std::vector<unsigned int> Histogram; ///< The counts of each bin
+      unsigned int Underflow; ///< The number of values less than BinMin
+      unsigned int Overflow;  ///< The number of values greater than BinMax
+      unsigned long NumberOfAllocations; ///< Buffers allocated by this rank in the step
+      unsigned long long NumberOfBytesAllocated; ///< Bytes allocated by this rank in the step
   };
 
   /// return the histogram computed by the most recent call to Execute
@@ -56,12 +85,22 @@ protected:
   static const char *GetGhostArrayName();
   svtkDataArray* GetArray(svtkDataObject* dobj, const std::string& arrayname);
 
+  // get the range of the array from the mesh metadata. this is an MPI
+  // collective when the metadata is not a global view.
+  int GetMetadataRange(MPI_Comm comm, const MeshMetadataPtr &mmd,
+    double &min, double &max);
+
   int NumberOfBins;
+  int NumberOfThreads;
+  int RangeMode;
+  double RangeMin;
+  double RangeMax;
   std::string MeshName;
   std::string ArrayName;
   int Association;
   std::string FileName;
   Histogram::Data LastResult;
+  std::shared_ptr<HistogramInternals> Internals;
 };
 
 }
@@ -2,6 +2,7 @@
 #include "HistogramInternals.h"
 #include "SVTKUtils.h"
 #include "MemoryUtils.h"
+#include "Profiler.h"
 #include "Error.h"
 
 #if defined(ENABLE_CUDA)
@@ -16,6 +17,8 @@
 #include <cstring>
 #include <errno.h>
 #include <limits>
+#include <cmath>
+#include <thread>
 
 #include <svtkSmartPointer.h>
 #include <svtkDataArray.h>
@@ -139,20 +142,22 @@ int ComputeRange(std::shared_ptr<data_t> &pdata,
  * @param[in] ghosts    an array of 0 and non zero, 0 where data is valid
  * @param[in] nVals     the length of the array
  * @param[in] minVal    the minimum bin value
+ * @param[in] maxVal    the maximum bin value
  * @param[in] width     the width of histogram bins
  * @param[in] nBins     the number of bins + 1.
- * @param[in,out] hist  the histogram
+ * @param[in,out] hist  the histogram, of length nBins + 2. the last two bins
+ *                      count values below and above the range.
  */
 template <typename data_t>
 __global__
 void histogram(data_t *data, unsigned char *ghosts,
-  size_t nVals, data_t minVal, data_t width, unsigned int *hist,
-  size_t nBins)
+  size_t nVals, double minVal, double maxVal, double width,
+  unsigned int *hist, size_t nBins)
 {
   // per thread block local/temporary copy of the histogram.
-  // this shared array must be allocated to store nBins values.
+  // this shared array must be allocated to store nBins + 2 values.
   // nBins is 1 longer than the desired output to handle binning
-  // the maximum value.
+  // the maximum value. the last 2 values are the under and overflow.
   extern __shared__ unsigned int tmp[];
 
   unsigned long i = sensei::CUDAUtils::ThreadIdToArrayIndex();
@@ -161,13 +166,16 @@ void histogram(data_t *data, unsigned char *ghosts,
     return;
 
   // initialize the per thread block local histogram
-  if (threadIdx.x < nBins)
+  if (threadIdx.x < nBins + 2)
     tmp[threadIdx.x] = 0u;
 
   __syncthreads();
 
-  // find the bin for this value
-  unsigned long j = (data[i] - minVal) / width;
+  // find the bin for this value. values outside of the range are counted
+  // in the under and overflow bins
+  double value = data[i];
+  unsigned long j = value < minVal ? nBins : (value > maxVal ? nBins + 1 :
+    min((unsigned long)((value - minVal) / width), (unsigned long)(nBins - 1)));
 
   // update the bin count if the data point is not from a ghost zone
   unsigned int inc_valid = ghosts[i] ? 0 : 1;
@@ -181,15 +189,15 @@ void histogram(data_t *data, unsigned char *ghosts,
   __syncthreads();
 
   // finalize from per thread block local results into the global output array
-  if (threadIdx.x < nBins)
+  if (threadIdx.x < nBins + 2)
     atomicAdd(&(hist[threadIdx.x]), tmp[threadIdx.x]);
 }
 
 /** launch the histogram kernel */
 template <typename data_t>
 int block_local_histogram(data_t *data, unsigned char *ghosts,
-  size_t nVals, data_t minVal, data_t width, unsigned int *hist,
-  size_t nBins)
+  size_t nVals, double minVal, double maxVal, double width,
+  unsigned int *hist, size_t nBins)
 {
   // determine kernel launch parameters
   dim3 blockGrid;
@@ -203,12 +211,12 @@ int block_local_histogram(data_t *data, unsigned char *ghosts,
   }
 
   // this is the ammount of shared memory we need for the kernel
-  size_t histBytes = nBins*sizeof(unsigned int);
+  size_t histBytes = (nBins + 2)*sizeof(unsigned int);
 
   // compute the histgram for this block's worth of data on the GPU. It is
   // left on the GPU until data for all blocks has been processed.
   histogram<<<blockGrid, threadGrid, histBytes>>>(
-      data, ghosts, nVals, minVal, width, hist, nBins);
+      data, ghosts, nVals, minVal, maxVal, width, hist, nBins);
 
   cudaDeviceSynchronize();
 
@@ -219,34 +227,146 @@ int block_local_histogram(data_t *data, unsigned char *ghosts,
 
 namespace HistogramInternalsCPU
 {
+/** Stands in for the ghost array of a block that has no ghost zones. The
+ * kernels below are templated on the ghost array type, and with this type
+ * the ghost masking compiles away and no buffer is needed.
+ */
+struct NoGhosts
+{
+  unsigned char operator[](size_t) const { return 0; }
+  NoGhosts operator+(size_t) const { return *this; }
+};
+
 /** Computes a histogram on the CPU. The histgoram must be pre-initialized to
  * zero multiple invokations of the kernel accumulate results for new data.
  *
  * @param[in] data      the array to calculate the histogram for
- * @param[in] ghosts    an array of 0 and non zero, 0 where data is valid
+ * @param[in] ghosts    an array of 0 and non zero, 0 where data is valid,
+ *                      or NoGhosts
  * @param[in] nVals     the length of the array
  * @param[in] minVal    the minimum bin value
+ * @param[in] maxVal    the maximum bin value
  * @param[in] width     the width of histogram bins
  * @param[in] nBins     the number of bins + 1.
- * @param[in,out] hist  the histogram
+ * @param[in,out] hist  the histogram, of length nBins + 2. the last two bins
+ *                      count values below and above the range.
  */
-template <typename data_t>
-void block_local_histogram(data_t *data, unsigned char *ghosts,
-  size_t nVals, data_t minVal, data_t width, unsigned int *hist,
-  size_t nBins)
+template <typename data_t, typename ghost_t>
+void block_local_histogram(const data_t *data, ghost_t ghosts,
+  size_t nVals, double minVal, double maxVal, double width,
+  unsigned int *hist, size_t nBins)
 {
-  (void) nBins;
-
   for (size_t i = 0; i < nVals; ++i)
     {
-    // find the bin for this value
-    size_t j = (data[i] - minVal) / width;
+    // find the bin for this value. values outside of the range are counted
+    // in the under and overflow bins
+    double value = data[i];
+    size_t j = value < minVal ? nBins : (value > maxVal ? nBins + 1 :
+      std::min(size_t((value - minVal) / width), nBins - 1));
 
     // update the bin count if the data point is not from a ghost zone
     unsigned int inc_valid = ghosts[i] ? 0 : 1;
     hist[j] += inc_valid;
     }
 }
+
+/** Computes a histogram on the CPU into a thread private histogram. Values
+ * are binned into 4 interleaved sub-histograms so that runs of values in the
+ * same bin do not serialize on a single counter. Values outside of the range
+ * are counted in under and overflow bins, and ghosted values are counted in
+ * a discard bin rather than masked with a branch. The sub-histograms are
+ * summed into the first when the kernel completes. The histgoram must be
+ * pre-initialized to zero, multiple invokations of the kernel accumulate
+ * results for new data.
+ *
+ * @param[in] data      the array to calculate the histogram for
+ * @param[in] ghosts    an array of 0 and non zero, 0 where data is valid,
+ *                      or NoGhosts
+ * @param[in] nVals     the length of the array
+ * @param[in] minVal    the minimum bin value
+ * @param[in] maxVal    the maximum bin value
+ * @param[in] width     the width of histogram bins
+ * @param[in] nBins     the number of bins + 1.
+ * @param[in,out] hist  the histogram, of length 4*(nBins + 3). the last three
+ *                      bins of each sub-histogram count values below and
+ *                      above the range, and the ghosted values.
+ */
+template <typename data_t, typename ghost_t>
+void block_local_histogram_private(const data_t *data, ghost_t ghosts,
+  size_t nVals, double minVal, double maxVal, double width,
+  unsigned int *hist, size_t nBins)
+{
+  size_t stride = nBins + 3;
+  unsigned int *hist0 = hist;
+  unsigned int *hist1 = hist + stride;
+  unsigned int *hist2 = hist + 2*stride;
+  unsigned int *hist3 = hist + 3*stride;
+
+  // find the bin for a value. values outside of the range are replaced
+  // with the minimum before binning. the bin is computed in double precision
+  // so that integer data with bins narrower than 1 and fractional bounds are
+  // binned correctly.
+  auto bin = [&](size_t i) -> size_t
+    {
+    double value = data[i];
+    bool under = value < minVal;
+    bool over = value > maxVal;
+    value = (under || over) ? minVal : value;
+    size_t j = std::min(size_t((value - minVal) / width), nBins - 1);
+    j = under ? nBins : (over ? nBins + 1 : j);
+    return ghosts[i] ? nBins + 2 : j;
+    };
+
+  size_t nFull = nVals - nVals % 4;
+  for (size_t i = 0; i < nFull; i += 4)
+    {
+    size_t j0 = bin(i);
+    size_t j1 = bin(i + 1);
+    size_t j2 = bin(i + 2);
+    size_t j3 = bin(i + 3);
+
+    hist0[j0] += 1;
+    hist1[j1] += 1;
+    hist2[j2] += 1;
+    hist3[j3] += 1;
+    }
+
+  for (size_t i = nFull; i < nVals; ++i)
+    hist0[bin(i)] += 1;
+
+  for (size_t j = 0; j < stride; ++j)
+    {
+    hist0[j] += hist1[j] + hist2[j] + hist3[j];
+    hist1[j] = hist2[j] = hist3[j] = 0;
+    }
+}
+
+/// invokes op(i) for i in 0 to nThreads - 1, each on its own thread
+template <typename op_t>
+void parallel_for(int nThreads, const op_t &op)
+{
+  std::vector<std::thread> threads;
+  threads.reserve(nThreads - 1);
+
+  for (int i = 1; i < nThreads; ++i)
+    threads.emplace_back(op, i);
+
+  // the calling thread does its share of the work
+  op(0);
+
+  for (std::thread &thread : threads)
+    thread.join();
+}
+
+/// get the slice [start, end) of nVals values processed by thread i
+void partition(size_t nVals, int nThreads, int thread, size_t &start, size_t &end)
+{
+  size_t i = thread;
+  size_t blockSize = nVals / nThreads;
+  size_t nLarge = nVals % nThreads;
+  start = i*blockSize + (i < nLarge ? i : nLarge);
+  end = start + blockSize + (i < nLarge ? 1 : 0);
+}
 }
 
 // --------------------------------------------------------------------------
@@ -256,21 +376,56 @@ HistogramInternals::~HistogramInternals()
 // --------------------------------------------------------------------------
 int HistogramInternals::Clear()
 {
-  this->Min = std::numeric_limits<double>::max();
-  this->Max = std::numeric_limits<double>::lowest();
+  if (!this->FixedRange)
+    {
+    this->Min = std::numeric_limits<double>::max();
+    this->Max = std::numeric_limits<double>::lowest();
+    }
   this->Width = 1.0;
   this->DataCache.clear();
-  this->GhostCache.clear();
-  this->Histogram = nullptr;
+  this->Result.clear();
+  return 0;
+}
+
+// --------------------------------------------------------------------------
+int HistogramInternals::SetRange(double min, double max)
+{
+  if (!(max > min) || !std::isfinite(max - min))
+    {
+    SENSEI_ERROR("Invalid range [" << min << ", " << max << "]")
+    return -1;
+    }
+
+  this->FixedRange = true;
+  this->Min = min;
+  this->Max = max;
+
   return 0;
 }
 
+// --------------------------------------------------------------------------
+void HistogramInternals::ClearRange()
+{
+  this->FixedRange = false;
+  this->Min = std::numeric_limits<double>::max();
+  this->Max = std::numeric_limits<double>::lowest();
+}
+
 // --------------------------------------------------------------------------
 int HistogramInternals::Initialize()
 {
+  this->NumberOfAllocations = 0;
+  this->NumberOfBytesAllocated = 0;
   return this->Clear();
 }
 
+// --------------------------------------------------------------------------
+void HistogramInternals::CountAllocation(size_t nBytes)
+{
+  this->NumberOfAllocations += 1;
+  this->NumberOfBytesAllocated += nBytes;
+}
+
 // --------------------------------------------------------------------------
 int HistogramInternals::AddLocalData(svtkDataArray *da,
   svtkUnsignedCharArray *ghosts)
@@ -291,7 +446,9 @@ int HistogramInternals::AddLocalData(svtkDataArray *da,
     return -1;
     }
 
-  // if ghost zones were provided use them, otherwise generate
+  // if ghost zones were provided use them. on the CPU a block without ghost
+  // zones is processed by kernels that do no masking, on the GPU ghost zones
+  // are generated.
   size_t nVals = da->GetNumberOfTuples();
   std::shared_ptr<unsigned char> pGhosts;
   if (ghosts)
@@ -307,6 +464,9 @@ int HistogramInternals::AddLocalData(svtkDataArray *da,
       sensei::CUDAUtils::SetDevice(this->DeviceId);
 
       // get a pointer accessible on the GPU
+      if (!sensei::MemoryUtils::CudaAccessible(ghosts->GetPointer(0)))
+        this->CountAllocation(nVals);
+
       pGhosts = sensei::MemoryUtils::MakeCudaAccessible(ghosts->GetPointer(0), nVals);
       }
     else
@@ -321,63 +481,46 @@ int HistogramInternals::AddLocalData(svtkDataArray *da,
       }
 #endif
     }
-  else
+#if defined(ENABLE_CUDA)
+  else if (this->DeviceId >= 0)
     {
     // we don't have ghosts
-#if defined(ENABLE_CUDA)
-    if (this->DeviceId >= 0)
-      {
 #if defined(SENSEI_DEBUG)
-      std::cerr << "HistogramInternals::AddLocalData ghosts were not provided,"
-          " allocating on CUDA" << std::endl;
+    std::cerr << "HistogramInternals::AddLocalData ghosts were not provided,"
+        " allocating on CUDA" << std::endl;
 #endif
-      // make the requested GPU the active one
-      sensei::CUDAUtils::SetDevice(this->DeviceId);
+    // make the requested GPU the active one
+    sensei::CUDAUtils::SetDevice(this->DeviceId);
 
-      // generate ghosts on the GPU
-      unsigned char *devpGhosts = nullptr;
-      cudaError_t ierr = cudaSuccess;
-      if ((ierr = cudaMalloc(&devpGhosts, nVals)) != cudaSuccess)
-        {
-        SENSEI_ERROR("Failed to allocate ghost zones on the GPU. "
-          << cudaGetErrorString(ierr))
-        return -1;
-        }
-      if ((ierr = cudaMemset(devpGhosts, 0, nVals)) != cudaSuccess)
-        {
-        SENSEI_ERROR("Failed to zero ghost zones on the GPU. "
-          << cudaGetErrorString(ierr))
-        return -1;
-        }
-      pGhosts = std::shared_ptr<unsigned char>(devpGhosts,
-        sensei::MemoryUtils::FreeCudaPtr);
+    // generate ghosts on the GPU
+    unsigned char *devpGhosts = nullptr;
+    cudaError_t ierr = cudaSuccess;
+    if ((ierr = cudaMalloc(&devpGhosts, nVals)) != cudaSuccess)
+      {
+      SENSEI_ERROR("Failed to allocate ghost zones on the GPU. "
+        << cudaGetErrorString(ierr))
+      return -1;
       }
-    else
+    if ((ierr = cudaMemset(devpGhosts, 0, nVals)) != cudaSuccess)
       {
-#endif
-#if defined(SENSEI_DEBUG)
-      std::cerr << "HistogramInternals::AddLocalData ghosts were not provided,"
-        " allocating on the CPU" << std::endl;
-#endif
-      // generate ghosts on the CPU
-      pGhosts = std::shared_ptr<unsigned char>(
-        (unsigned char*)malloc(nVals), sensei::MemoryUtils::FreeCpuPtr);
-
-      memset(pGhosts.get(), 0, nVals);
-#if defined(ENABLE_CUDA)
+      SENSEI_ERROR("Failed to zero ghost zones on the GPU. "
+        << cudaGetErrorString(ierr))
+      return -1;
       }
-#endif
-    }
+    pGhosts = std::shared_ptr<unsigned char>(devpGhosts,
+      sensei::MemoryUtils::FreeCudaPtr);
 
-  // cache the GPU accessible pointer for use in the histogram calculation
-  this->GhostCache[da] = pGhosts;
+    this->CountAllocation(nVals);
+    }
+#endif
 
-  // compute the block min and max
+  // get the block's data
+  std::shared_ptr<void> pvDa;
   switch (da->GetDataType())
     {
     svtkTemplateMacro(
 
-      std::shared_ptr<SVTK_TT> pDa;
+      SVTK_TT *pDa = sensei::SVTKUtils::GetPointer<SVTK_TT>(da);
 #if defined(ENABLE_CUDA)
       if (this->DeviceId >= 0)
         {
@@ -386,8 +529,10 @@ int HistogramInternals::AddLocalData(svtkDataArray *da,
           << (da->GetName() ? da->GetName() : "\"\"") << " CUDA" << std::endl;
 #endif
         // get a pointer to the data that's usable on the GPU
-        pDa = sensei::MemoryUtils::MakeCudaAccessible(
-          sensei::SVTKUtils::GetPointer<SVTK_TT>(da), nVals);
+        if (!sensei::MemoryUtils::CudaAccessible(pDa))
+          this->CountAllocation(nVals*sizeof(SVTK_TT));
+
+        pvDa = sensei::MemoryUtils::MakeCudaAccessible(pDa, nVals);
         }
       else
         {
@@ -396,13 +541,10 @@ int HistogramInternals::AddLocalData(svtkDataArray *da,
         std::cerr << "HistogramInternals::AddLocalData "
           << (da->GetName() ? da->GetName() : "\"\"") << " CPU" << std::endl;
 #endif
-        pDa = sensei::MemoryUtils::MakeCpuAccessible(
-         sensei::SVTKUtils::GetPointer<SVTK_TT>(da), nVals);
+        pvDa = sensei::MemoryUtils::MakeCpuAccessible(pDa, nVals);
 #if defined(ENABLE_CUDA)
         }
 #endif
-      // cache the GPU accessible pointer for use in the histogram calculation
-      this->DataCache[da] = pDa;
     );
     default:
       {
@@ -411,6 +553,9 @@ int HistogramInternals::AddLocalData(svtkDataArray *da,
       }
     }
 
+  // cache the device accessible pointers for use in the histogram calculation
+  this->DataCache.push_back({da, ghosts, pvDa, pGhosts});
+
   return 0;
 }
 
@@ -420,75 +565,64 @@ int HistogramInternals::ComputeRange()
   this->Min = std::numeric_limits<double>::max();
   this->Max = std::numeric_limits<double>::lowest();
 
-  auto dit = this->DataCache.begin();
-  auto git = this->GhostCache.begin();
-
-  for (; dit != this->DataCache.end(); ++dit, ++git)
+  for (LocalData &block : this->DataCache)
     {
-    // get the data array. arrays in the cache have already been moved to the
-    // GPU if that was neccessary.
-    std::shared_ptr<unsigned char> pGhosts = git->second;
-
-    svtkDataArray *da = dit->first;
-    std::shared_ptr<void> pvDa = dit->second;
+    double blockRange[2] = {std::numeric_limits<double>::max(),
+      std::numeric_limits<double>::lowest()};
 
-    size_t nVals = da->GetNumberOfTuples();
-
-    // compute the block min and max
-    switch (da->GetDataType())
+#if defined(ENABLE_CUDA)
+    if (this->DeviceId >= 0)
       {
-      svtkTemplateMacro(
+      // get the data array. arrays in the cache have already been moved to
+      // the GPU in AddLocalData
+      svtkDataArray *da = block.Array;
+      size_t nVals = da->GetNumberOfTuples();
 
-        SVTK_TT blockMin = std::numeric_limits<SVTK_TT>::max();
-        SVTK_TT blockMax = std::numeric_limits<SVTK_TT>::lowest();
+      switch (da->GetDataType())
+        {
+        svtkTemplateMacro(
+          SVTK_TT blockMin = std::numeric_limits<SVTK_TT>::max();
+          SVTK_TT blockMax = std::numeric_limits<SVTK_TT>::lowest();
 
-        // cast to the correct type. The data will already be in the right place
-        // data movement is handled in AddLocalData
-        std::shared_ptr<SVTK_TT> pDa = std::static_pointer_cast<SVTK_TT>(pvDa);
+          std::shared_ptr<SVTK_TT> pDa = std::static_pointer_cast<SVTK_TT>(block.Data);
 
-#if defined(ENABLE_CUDA)
-        if (this->DeviceId >= 0)
-          {
           // make the requested GPU the active one
           sensei::CUDAUtils::SetDevice(this->DeviceId);
           // calculate range taking into account ghost zones on the GPU
-          HistogramInternalsCUDA::ComputeRange<SVTK_TT>(pDa, pGhosts, nVals, blockMin, blockMax);
-#if defined(SENSEI_DEBUG)
-          std::cerr << "HistogramInternals::ComputeRange CUDA ["
-             << blockMin << ", " << blockMax << "]" << std::endl;
-#endif
-          }
-        else
+          HistogramInternalsCUDA::ComputeRange<SVTK_TT>(pDa, block.Ghosts,
+            nVals, blockMin, blockMax);
+
+          blockRange[0] = blockMin;
+          blockRange[1] = blockMax;
+          );
+        default:
           {
-#endif
-          // calculate range taking into account ghost zones on the CPU
-          SVTK_TT *rpDa = pDa.get();
-          unsigned char *rpGhosts = pGhosts.get();
-          for (size_t i = 0; i < nVals; ++i)
-            {
-            if (rpGhosts[i] == 0)
-              {
-              SVTK_TT value = rpDa[i];
-              blockMin = std::min(blockMin, value);
-              blockMax = std::max(blockMax, value);
-              }
-            }
-#if defined(SENSEI_DEBUG)
-          std::cerr << "HistogramInternals::ComputeRange CPU ["
-             << blockMin << ", " << blockMax << "]" << std::endl;
-#endif
-#if defined(ENABLE_CUDA)
+          SENSEI_ERROR("Unsupported dispatch " << da->GetClassName());
+          return -1;
           }
+        }
+      }
+    else
+      {
 #endif
-        // accumulate the min/max
-        this->Min = std::min(this->Min, double(blockMin));
-        this->Max = std::max(this->Max, double(blockMax));
-        );
-      default:
-        {
-        SENSEI_ERROR("Unsupported dispatch " << da->GetClassName());
+      // on the CPU the range of the valid values is computed in parallel and
+      // cached on the array
+      if (SVTKUtils::GetArrayRange(block.Array, block.GhostArray, 0, blockRange))
         return -1;
-        }
+#if defined(ENABLE_CUDA)
+      }
+#endif
+
+#if defined(SENSEI_DEBUG)
+    std::cerr << "HistogramInternals::ComputeRange block ["
+       << blockRange[0] << ", " << blockRange[1] << "]" << std::endl;
+#endif
+
+    // accumulate the min/max
+    if (blockRange[0] <= blockRange[1])
+      {
+      this->Min = std::min(this->Min, blockRange[0]);
+      this->Max = std::max(this->Max, blockRange[1]);
       }
     }
 
@@ -521,12 +655,22 @@ int HistogramInternals::ComputeRange()
 // --------------------------------------------------------------------------
 int HistogramInternals::ComputeHistogram()
 {
-  if (this->ComputeRange()
+  // the range is only computed when it was not provided
+  int ierr = 0;
+  if ((!this->FixedRange && this->ComputeRange())
     || this->InitializeHistogram()
     || this->ComputeLocalHistogram()
     || this->FinalizeHistogram())
-    return -1;
-  return 0;
+    ierr = -1;
+
+  // report the memory allocated during this calculation
+  Profiler::RecordValue("HistogramInternals::NumberOfAllocations",
+    this->NumberOfAllocations);
+
+  Profiler::RecordValue("HistogramInternals::NumberOfBytesAllocated",
+    this->NumberOfBytesAllocated);
+
+  return ierr;
 }
 
 // --------------------------------------------------------------------------
@@ -535,12 +679,13 @@ int HistogramInternals::InitializeHistogram()
   // now with the min and amax in hand we can calculate the bin width.
   this->Width = (this->Max - this->Min) / this->NumberOfBins;
 
-  // allocate space for the histogram and initialize the first time
-  // through. NOTE: There is an extra bin allocated to deal with out-of-bounds
+  // allocate space for the histogram the first time through, and initialize
+  // it. NOTE: There is an extra bin allocated to deal with out-of-bounds
   // when binning the maximum value. This bin is merged in after the calculations
+  // Two more bins count the values below and above the range.
   size_t nBins = this->NumberOfBins + 1;
-  size_t histBytes = nBins*sizeof(unsigned int);
-  unsigned int *pHist = nullptr;
+  size_t histBytes = (nBins + 2)*sizeof(unsigned int);
+  unsigned int *pHist = this->Histogram.get();
 
 #if defined(ENABLE_CUDA)
   if (this->DeviceId >= 0)
@@ -553,23 +698,28 @@ int HistogramInternals::InitializeHistogram()
     sensei::CUDAUtils::SetDevice(this->DeviceId);
 
     cudaError_t ierr = cudaSuccess;
-    if ((ierr = cudaMalloc(&pHist, histBytes)) != cudaSuccess)
-    {
+    if (!pHist)
+      {
+      if ((ierr = cudaMalloc(&pHist, histBytes)) != cudaSuccess)
+        {
         SENSEI_ERROR("Failed to allocate space for the histogram on the GPU. "
             << cudaGetErrorString(ierr))
         return -1;
-    }
+        }
 
-    if ((ierr = cudaMemset(pHist, 0, histBytes)) != cudaSuccess)
-    {
-        SENSEI_ERROR("Failed to initialize the histogram on the GPU. "
-            << cudaGetErrorString(ierr))
-        return -1;
-    }
+      // save the pointer for calculations of subsequent blocks and steps
+      this->Histogram = std::shared_ptr<unsigned int>(pHist,
+        sensei::MemoryUtils::FreeCudaPtr);
 
-    // save the pointer for calculations of subsequent blocks
-    this->Histogram = std::shared_ptr<unsigned int>(pHist,
-      sensei::MemoryUtils::FreeCudaPtr);
+      this->CountAllocation(histBytes);
+      }
+
+    if ((ierr = cudaMemset(pHist, 0, histBytes)) != cudaSuccess)
+      {
+      SENSEI_ERROR("Failed to initialize the histogram on the GPU. "
+          << cudaGetErrorString(ierr))
+      return -1;
+      }
     }
   else
     {
@@ -578,12 +728,18 @@ int HistogramInternals::InitializeHistogram()
     std::cerr << "InitializeHistogram initializing "
       << this->NumberOfBins << " bins on the CPU" << std::endl;
 #endif
-    pHist = (unsigned int*)malloc(histBytes);
-    memset(pHist, 0, histBytes);
+    if (!pHist)
+      {
+      pHist = (unsigned int*)malloc(histBytes);
 
-    // save the pointer for calculations of subsequent blocks
-    this->Histogram = std::shared_ptr<unsigned int>(pHist,
-      sensei::MemoryUtils::FreeCpuPtr);
+      // save the pointer for calculations of subsequent blocks and steps
+      this->Histogram = std::shared_ptr<unsigned int>(pHist,
+        sensei::MemoryUtils::FreeCpuPtr);
+
+      this->CountAllocation(histBytes);
+      }
+
+    memset(pHist, 0, histBytes);
 #if defined(ENABLE_CUDA)
     }
 #endif
@@ -602,17 +758,15 @@ int HistogramInternals::ComputeLocalHistogram()
     return -1;
     }
 
-  auto dit = this->DataCache.begin();
-  auto git = this->GhostCache.begin();
+  // compute the histgram on the CPU threads
+  if (this->DeviceId == DEVICE_CPU_THREADS)
+    return this->ComputeLocalHistogramThreads();
 
-  for (; dit != this->DataCache.end(); ++dit, ++git)
+  for (LocalData &block : this->DataCache)
     {
     // get the data array. arrays in the cache have already been moved to the
     // GPU if that was neccessary.
-    std::shared_ptr<unsigned char> pGhosts = git->second;
-
-    svtkDataArray *da = dit->first;
-    std::shared_ptr<void> pDa = dit->second;
+    svtkDataArray *da = block.Array;
 
     // get the sizes of the datat array
     size_t nVals = da->GetNumberOfTuples();
@@ -625,6 +779,7 @@ int HistogramInternals::ComputeLocalHistogram()
     switch (da->GetDataType())
       {
       svtkTemplateMacro(
+        SVTK_TT *pDa = (SVTK_TT*)block.Data.get();
 #if defined(ENABLE_CUDA)
         if (this->DeviceId >= 0)
           {
@@ -637,8 +792,9 @@ int HistogramInternals::ComputeLocalHistogram()
           // compute the histgram for this block's worth of data on the GPU. It is
           // left on the GPU until data for all blocks has been processed.
           // data is already in the right place, it is moved in AddLocalData
-          if (HistogramInternalsCUDA::block_local_histogram<SVTK_TT>((SVTK_TT*)pDa.get(),
-            pGhosts.get(), nVals, this->Min, this->Width, this->Histogram.get(), nBins))
+          if (HistogramInternalsCUDA::block_local_histogram<SVTK_TT>(pDa,
+            block.Ghosts.get(), nVals, this->Min, this->Max, this->Width,
+            this->Histogram.get(), nBins))
             return -1;
           }
         else
@@ -649,8 +805,18 @@ int HistogramInternals::ComputeLocalHistogram()
 #endif
           // compute the histgram for this block's worth of data on the CPU
           // data is already in the right place, it is moved in AddLocalData
-          HistogramInternalsCPU::block_local_histogram<SVTK_TT>((SVTK_TT*)pDa.get(),
-            pGhosts.get(), nVals, this->Min, this->Width, this->Histogram.get(), nBins);
+          if (block.Ghosts)
+            {
+            HistogramInternalsCPU::block_local_histogram<SVTK_TT>(pDa,
+              block.Ghosts.get(), nVals, this->Min, this->Max, this->Width,
+              this->Histogram.get(), nBins);
+            }
+          else
+            {
+            HistogramInternalsCPU::block_local_histogram<SVTK_TT>(pDa,
+              HistogramInternalsCPU::NoGhosts(), nVals, this->Min, this->Max,
+              this->Width, this->Histogram.get(), nBins);
+            }
 #if defined(ENABLE_CUDA)
           }
 #endif
@@ -665,6 +831,84 @@ int HistogramInternals::ComputeLocalHistogram()
   return 0;
 }
 
+// --------------------------------------------------------------------------
+int HistogramInternals::GetNumberOfThreads()
+{
+  if (this->NumberOfThreads > 0)
+    return this->NumberOfThreads;
+
+  return std::max(1u, std::thread::hardware_concurrency());
+}
+
+// --------------------------------------------------------------------------
+int HistogramInternals::ComputeLocalHistogramThreads()
+{
+#if defined(SENSEI_DEBUG)
+  std::cerr << "HistogramInternals::ComputeLocalHistogramThreads" << std::endl;
+#endif
+  int nThreads = this->GetNumberOfThreads();
+
+  // an extra bin is used to handle binning of the maximum value, two more
+  // count values outside of the range, and another counts ghosted values.
+  // each thread has 4 sub-histograms, see block_local_histogram_private. the
+  // private histograms are padded to a multiple of the cache line size so
+  // that threads do not write to the same line.
+  size_t nBins = this->NumberOfBins + 1;
+  size_t stride = ((4*(nBins + 3) + 15) / 16) * 16;
+
+  if (this->ThreadHistograms.capacity() < nThreads*stride)
+    this->CountAllocation(nThreads*stride*sizeof(unsigned int));
+
+  this->ThreadHistograms.assign(nThreads*stride, 0u);
+  unsigned int *threadHist = this->ThreadHistograms.data();
+
+  // each thread bins its slice of every block into its private histogram
+  HistogramInternalsCPU::parallel_for(nThreads, [&](int i)
+    {
+    unsigned int *hist = threadHist + i*stride;
+
+    for (LocalData &block : this->DataCache)
+      {
+      svtkDataArray *da = block.Array;
+
+      size_t start = 0;
+      size_t end = 0;
+      HistogramInternalsCPU::partition(da->GetNumberOfTuples(),
+        nThreads, i, start, end);
+
+      switch (da->GetDataType())
+        {
+        svtkTemplateMacro(
+          SVTK_TT *pDa = (SVTK_TT*)block.Data.get() + start;
+          if (block.Ghosts)
+            {
+            HistogramInternalsCPU::block_local_histogram_private<SVTK_TT>(pDa,
+              block.Ghosts.get() + start, end - start, this->Min, this->Max,
+              this->Width, hist, nBins);
+            }
+          else
+            {
+            HistogramInternalsCPU::block_local_histogram_private<SVTK_TT>(pDa,
+              HistogramInternalsCPU::NoGhosts(), end - start, this->Min,
+              this->Max, this->Width, hist, nBins);
+            }
+          );
+        }
+      }
+    });
+
+  // merge the private histograms, dropping the ghost counts
+  unsigned int *pHist = this->Histogram.get();
+  for (int i = 0; i < nThreads; ++i)
+    {
+    const unsigned int *hist = threadHist + i*stride;
+    for (size_t j = 0; j < nBins + 2; ++j)
+      pHist[j] += hist[j];
+    }
+
+  return 0;
+}
+
 // --------------------------------------------------------------------------
 int HistogramInternals::FinalizeHistogram()
 {
@@ -675,13 +919,17 @@ int HistogramInternals::FinalizeHistogram()
   int rank = 0;
   MPI_Comm_rank(this->Comm, &rank);
 
-  size_t nBins = this->NumberOfBins + 1;
-  size_t histBytes = nBins*sizeof(unsigned int);
+  // the histogram, the extra bin for the maximum value, and the under and
+  // overflow bins
+  size_t nBins = this->NumberOfBins + 3;
 
 #if defined(ENABLE_CUDA)
   // make the requested GPU the active one
   if (this->DeviceId >= 0)
+    {
     sensei::CUDAUtils::SetDevice(this->DeviceId);
+    this->CountAllocation(nBins*sizeof(unsigned int));
+    }
 #endif
 
   // fetch result from the GPU for the MPI parallel part of the reduction
@@ -689,40 +937,41 @@ int HistogramInternals::FinalizeHistogram()
   std::shared_ptr<unsigned int> pHist =
     sensei::MemoryUtils::MakeCpuAccessible(this->Histogram.get(), nBins);
 
-  // allocate a buffer on teh CPU for the result of the MPI parallel reduction
-  // the result of the histogram is always coppied to the CPU
-  unsigned int *tmp = nullptr;
+  // the result of the histogram is always coppied to the CPU. the buffer is
+  // kept for subsequent steps
+  unsigned int *result = nullptr;
   if (rank == 0)
     {
-    tmp = (unsigned int *)malloc(histBytes);
-    memset(tmp, 0, histBytes);
+    if (this->Result.capacity() < nBins)
+      this->CountAllocation(nBins*sizeof(unsigned int));
+
+    this->Result.resize(nBins);
+    result = this->Result.data();
     }
 
   // finalize the histogram calculation by summing up contributions from each
   // MPI rank to MPI rank 0
-  MPI_Reduce(pHist.get(), tmp, nBins, MPI_UNSIGNED, MPI_SUM, 0, this->Comm);
+  MPI_Reduce(pHist.get(), result, nBins, MPI_UNSIGNED, MPI_SUM, 0, this->Comm);
 
   // merge in the extra bin (see earlier comments)
-  if (rank == 0)
-    tmp[this->NumberOfBins - 1] += tmp[this->NumberOfBins];
-
-  // Replace the internal copy of the histogram with the finalized result.
   // only MPI rank 0 has the result after this
-  this->Histogram = std::shared_ptr<unsigned int>(tmp, free);
+  if (rank == 0)
+    result[this->NumberOfBins - 1] += result[this->NumberOfBins];
 
   return 0;
 }
 
 // --------------------------------------------------------------------------
 int HistogramInternals::GetHistogram(int &nBins, double &binMin, double &binMax,
-  double &binWidth, std::vector<unsigned int> &histogram)
+  double &binWidth, std::vector<unsigned int> &histogram,
+  unsigned int &underflow, unsigned int &overflow)
 {
   int rank = 0;
   MPI_Comm_rank(this->Comm, &rank);
 
   if (rank == 0)
     {
-    if (!this->Histogram)
+    if (this->Result.empty())
       {
       SENSEI_ERROR("Failed calculation detected. MPI rank 0 has no histogram to return.")
       return -1;
@@ -733,8 +982,11 @@ int HistogramInternals::GetHistogram(int &nBins, double &binMin, double &binMax,
     binMax = this->Max;
     binWidth = this->Width;
 
-    unsigned int *pHist = this->Histogram.get();
+    const unsigned int *pHist = this->Result.data();
     histogram.assign(pHist, pHist + nBins);
+
+    underflow = pHist[nBins + 1];
+    overflow = pHist[nBins + 2];
     }
 
   return 0;
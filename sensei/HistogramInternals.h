@@ -6,10 +6,11 @@
 class svtkUnsignedCharArray;
 class svtkDataArray;
 
+#include "senseiConfig.h"
+
 #include <mpi.h>
 #include <string>
 #include <vector>
-#include <map>
 #include <memory>
 #include <limits>
 
@@ -21,7 +22,24 @@ namespace sensei
  * build, otherwise the CPU is used. The data arrays must have only one
  * component.
  *
- * Call the methods in the following order:
+ * The device id selects where the calculation runs. 0 to N_CUDA_DEVICES - 1
+ * selects a GPU, DEVICE_CPU selects a single CPU thread, and
+ * DEVICE_CPU_THREADS selects a team of CPU threads. Each thread bins a slice
+ * of every block into its own private histogram, and the private histograms
+ * are merged before the MPI reduction.
+ *
+ * When the range is known in advance it may be set with SetRange, in which
+ * case the data is binned in a single pass and no collective is needed to
+ * compute the range. Values outside of the range are counted separately in
+ * under and overflow bins.
+ *
+ * An instance may be reused from one step to the next, in which case the
+ * buffers used in the calculation are allocated once. The number of
+ * allocations and bytes allocated by each calculation are recorded with
+ * Profiler::RecordValue, and are returned by GetNumberOfAllocations and
+ * GetNumberOfBytesAllocated.
+ *
+ * Call the methods in the following order, once per step:
  *
  * Initialize
  * AddLocalData (once per local data block)
@@ -31,22 +49,44 @@ namespace sensei
  *
  * All methods return 0 if successful.
  */
-class HistogramInternals
+class SENSEI_EXPORT HistogramInternals
 {
 public:
+    /// device ids that select execution on the CPU
+    enum { DEVICE_CPU = -1, DEVICE_CPU_THREADS = -2 };
+
     HistogramInternals() = delete;
 
     HistogramInternals(MPI_Comm comm, int deviceId, int numberOfBins) :
       Comm(comm),
       DeviceId(deviceId),
       NumberOfBins(numberOfBins),
+      NumberOfThreads(0),
+      FixedRange(false),
       Min(std::numeric_limits<double>::max()),
       Max(std::numeric_limits<double>::lowest()),
-      Width(1.0)
+      Width(1.0),
+      NumberOfAllocations(0),
+      NumberOfBytesAllocated(0)
     {}
 
     ~HistogramInternals();
 
+    /** Set the number of threads used when the device is
+     * DEVICE_CPU_THREADS. The default, 0, uses one thread per core. */
+    void SetNumberOfThreads(int nThreads) { this->NumberOfThreads = nThreads; }
+
+    /** Set the range of the histogram. When set the range is not computed
+     * from the data. The range persists across calls to Clear. Returns -1 if
+     * the range is empty. */
+    int SetRange(double min, double max);
+
+    /** Compute the range from the data. This is the default. */
+    void ClearRange();
+
+    /// get the device the calculation runs on
+    int GetDeviceId() const { return this->DeviceId; }
+
     /** set up for the calculation */
     int Initialize();
 
@@ -57,13 +97,25 @@ public:
      * participate */
     int ComputeHistogram();
 
-    /// return the computed histogram, only valid on MPI rank 0
+    /** return the computed histogram, only valid on MPI rank 0. underflow
+     * and overflow are the number of values below and above the range, these
+     * are only non-zero when the range was set with SetRange. */
     int GetHistogram(int &nBins, double &binMin, double &binMax,
-      double &binWidth, std::vector<unsigned int> &histogram);
+      double &binWidth, std::vector<unsigned int> &histogram,
+      unsigned int &underflow, unsigned int &overflow);
 
-    /** free all cached memory and reset all internal parameters */
+    /** release references to the data and reset internal parameters.
+     * buffers are kept for use in the next step. */
     int Clear();
 
+    /** the number of allocations, and bytes allocated, by the most recent
+     * calculation. these are also recorded with the Profiler. */
+    unsigned long GetNumberOfAllocations() const
+    { return this->NumberOfAllocations; }
+
+    unsigned long long GetNumberOfBytesAllocated() const
+    { return this->NumberOfBytesAllocated; }
+
 private:
     /** compute the global min and max across all MPI ranks and blocks*/
     int ComputeRange();
@@ -74,6 +126,25 @@ private:
     /** compute the local histgrams */
     int ComputeLocalHistogram();
 
+    /** the threaded CPU implementation of the above */
+    int ComputeLocalHistogramThreads();
+
+    /** the number of threads to use with DEVICE_CPU_THREADS */
+    int GetNumberOfThreads();
+
+    /** record an allocation made during the calculation */
+    void CountAllocation(size_t nBytes);
+
+    /** a block of data, and its ghost zones, in the memory space of the
+     * device. Ghosts is null when a block on the CPU has no ghost zones. */
+    struct LocalData
+    {
+      svtkDataArray *Array;
+      svtkUnsignedCharArray *GhostArray;
+      std::shared_ptr<void> Data;
+      std::shared_ptr<unsigned char> Ghosts;
+    };
+
     /** Apply a reduction to locally computed histograms across all ranks.
      * Result is valid only on rank 0 */
     int FinalizeHistogram();
@@ -82,12 +153,17 @@ private:
   MPI_Comm Comm;
   int DeviceId;
   int NumberOfBins;
+  int NumberOfThreads;
+  bool FixedRange;
   double Min;
   double Max;
   double Width;
-  std::map<svtkDataArray*, std::shared_ptr<void>> DataCache;
-  std::map<svtkDataArray*, std::shared_ptr<unsigned char>> GhostCache;
+  std::vector<LocalData> DataCache;
   std::shared_ptr<unsigned int> Histogram;
+  std::vector<unsigned int> ThreadHistograms;
+  std::vector<unsigned int> Result;
+  unsigned long NumberOfAllocations;
+  unsigned long long NumberOfBytesAllocated;
 };
 
 }
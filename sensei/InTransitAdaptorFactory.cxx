@@ -8,6 +8,11 @@
 #include "HDF5DataAdaptor.h"
 #endif
 
+#ifdef ENABLE_SHARED_MEM
+#include "SharedMemDataAdaptor.h"
+#endif
+
+#include "MPIInTransitDataAdaptor.h"
 #include "XMLUtils.h"
 #include "Error.h"
 
@@ -76,6 +81,19 @@ int Initialize(MPI_Comm comm, const pugi::xml_node &root, InTransitDataAdaptor *
     dataAdaptor = HDF5DataAdaptor::New();
 #endif
     }
+  else if (type == "shared_mem")
+    {
+#ifndef ENABLE_SHARED_MEM
+    SENSEI_ERROR("Shared memory transport requested but is disabled in this build")
+    return -1;
+#else
+    dataAdaptor = SharedMemDataAdaptor::New();
+#endif
+    }
+  else if (type == "mpi_in_transit")
+    {
+    dataAdaptor = MPIInTransitDataAdaptor::New();
+    }
   else if (type == "libis")
     {
     // Create LibIS InTransitDataAdaptor
@@ -0,0 +1,88 @@
+#ifndef MPIInTransitAnalysisAdaptor_h
+#define MPIInTransitAnalysisAdaptor_h
+
+#include "AnalysisAdaptor.h"
+#include "DataRequirements.h"
+#include "MeshMetadata.h"
+#include "SVTKUtils.h"
+
+#include <vector>
+#include <string>
+#include <mpi.h>
+
+/// @cond
+namespace senseiMPIInTransit { class OutputStream; }
+namespace pugi { class xml_node; }
+/// @endcond
+
+namespace sensei
+{
+/** The write side of the MPI in transit transport. The simulation and the
+ * end point are launched together, in MPMD mode, and share MPI_COMM_WORLD.
+ * Each rank sends its blocks directly to the end point ranks they were
+ * assigned to by the end point's partitioner, using nonblocking point to
+ * point messages. Execute returns once the sends are posted, they are
+ * completed at the next step, so the transfer overlaps the simulation. The
+ * simulation must run on a communicator holding only its ranks, see
+ * sensei::MPIManager::SetDefaultCommunicator.
+ */
+class SENSEI_EXPORT MPIInTransitAnalysisAdaptor : public AnalysisAdaptor
+{
+public:
+  /// constructs a new MPIInTransitAnalysisAdaptor instance.
+  static MPIInTransitAnalysisAdaptor* New();
+
+  senseiTypeMacro(MPIInTransitAnalysisAdaptor, AnalysisAdaptor);
+
+  /// @name runtime configuration
+  /// @{
+
+  /// initialize from an XML representation. Data requirements are given in
+  /// mesh elements.
+  int Initialize(pugi::xml_node &parent);
+
+  /** Adds a set of sensei::DataRequirements. Data requirements tell the
+   * adaptor what to fetch from the simulation and send. If none are given
+   * then all available data is fetched and sent.
+   */
+  int SetDataRequirements(const DataRequirements &reqs);
+
+  /** Add an indivudal data requirement.
+
+   * @param[in] meshName    the name of the mesh to fetch and send
+   * @param[in] association the type of data array to fetch and send
+   *                        svtkDataObject::POINT or svtkDataObject::CELL
+   * @param[in] arrays      a list of arrays to fetch and send
+   * @returns zero if successful.
+   */
+  int AddDataRequirement(const std::string &meshName,
+    int association, const std::vector<std::string> &arrays);
+
+  /// @}
+
+  /// Sends the current step to the end point.
+  bool Execute(DataAdaptor* data, DataAdaptor** result) override;
+
+  /// Completes the sends in flight and marks the end of the stream.
+  int Finalize() override;
+
+protected:
+  MPIInTransitAnalysisAdaptor();
+  ~MPIInTransitAnalysisAdaptor();
+
+  // fetch meshes and metadata objects from the simulation
+  int FetchFromProducer(sensei::DataAdaptor *da,
+    std::vector<svtkCompositeDataSetPtr> &objects,
+    std::vector<MeshMetadataPtr> &metadata);
+
+  senseiMPIInTransit::OutputStream *Stream;
+  sensei::DataRequirements Requirements;
+
+private:
+  MPIInTransitAnalysisAdaptor(const MPIInTransitAnalysisAdaptor&) = delete;
+  void operator=(const MPIInTransitAnalysisAdaptor&) = delete;
+};
+
+}
+
+#endif
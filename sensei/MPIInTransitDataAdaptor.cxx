@@ -0,0 +1,378 @@
+#include "MPIInTransitDataAdaptor.h"
+#include "MPIInTransitSchema.h"
+#include "MeshMetadata.h"
+#include "Partitioner.h"
+#include "BlockPartitioner.h"
+#include "SVTKUtils.h"
+#include "Profiler.h"
+#include "Error.h"
+
+#include <svtkDataObject.h>
+#include <svtkMultiBlockDataSet.h>
+#include <svtkObjectFactory.h>
+
+#include <pugixml.hpp>
+
+#include <map>
+#include <vector>
+
+namespace sensei
+{
+struct MPIInTransitDataAdaptor::InternalsType
+{
+  InternalsType() : Good(-1), Released(true) {}
+
+  senseiMPIInTransit::InputStream Stream;
+
+  // 0 until the end of the stream, or an error, is reached
+  int Good;
+
+  // set once the current step has been released
+  bool Released;
+
+  // receiver layouts computed by the partitioner for the current step
+  std::map<unsigned int, MeshMetadataPtr> ReceiverMetadata;
+
+  // receiver layouts of static meshes, computed by the partitioner once
+  std::map<unsigned int, MeshMetadataPtr> StaticReceiverMetadata;
+};
+
+//----------------------------------------------------------------------------
+senseiNewMacro(MPIInTransitDataAdaptor);
+
+//----------------------------------------------------------------------------
+MPIInTransitDataAdaptor::MPIInTransitDataAdaptor() : Internals(new InternalsType)
+{
+}
+
+//----------------------------------------------------------------------------
+MPIInTransitDataAdaptor::~MPIInTransitDataAdaptor()
+{
+  delete this->Internals;
+}
+
+//----------------------------------------------------------------------------
+int MPIInTransitDataAdaptor::Initialize(pugi::xml_node &node)
+{
+  TimeEvent<128> mark("MPIInTransitDataAdaptor::Initialize");
+
+  // let the base class handle initialization of the partitioner etc
+  if (this->InTransitDataAdaptor::Initialize(node))
+    {
+    SENSEI_ERROR("Failed to intialize the MPIInTransitDataAdaptor")
+    return -1;
+    }
+
+  SENSEI_STATUS("Configured MPIInTransitDataAdaptor")
+
+  return 0;
+}
+
+//----------------------------------------------------------------------------
+int MPIInTransitDataAdaptor::Finalize()
+{
+  TimeEvent<128> mark("MPIInTransitDataAdaptor::Finalize");
+  return 0;
+}
+
+//----------------------------------------------------------------------------
+int MPIInTransitDataAdaptor::OpenStream()
+{
+  TimeEvent<128> mark("MPIInTransitDataAdaptor::OpenStream");
+
+  if (this->Internals->Stream.Open(this->GetCommunicator()))
+    {
+    SENSEI_ERROR("Failed to connect to the simulation")
+    return -1;
+    }
+
+  // wait for the first step
+  if (this->UpdateTimeStep())
+    return -1;
+
+  return 0;
+}
+
+//----------------------------------------------------------------------------
+int MPIInTransitDataAdaptor::StreamGood()
+{
+  return this->Internals->Good;
+}
+
+//----------------------------------------------------------------------------
+int MPIInTransitDataAdaptor::CloseStream()
+{
+  TimeEvent<128> mark("MPIInTransitDataAdaptor::CloseStream");
+
+  this->Internals->Stream.Close();
+  this->Internals->Good = -1;
+  this->Internals->ReceiverMetadata.clear();
+  this->Internals->StaticReceiverMetadata.clear();
+
+  return 0;
+}
+
+//----------------------------------------------------------------------------
+int MPIInTransitDataAdaptor::AdvanceStream()
+{
+  TimeEvent<128> mark("MPIInTransitDataAdaptor::AdvanceStream");
+
+  // the current step is done with, release it if that has not been done
+  if (this->ReleaseData())
+    return -1;
+
+  return this->UpdateTimeStep();
+}
+
+//----------------------------------------------------------------------------
+int MPIInTransitDataAdaptor::UpdateTimeStep()
+{
+  TimeEvent<128> mark("MPIInTransitDataAdaptor::UpdateTimeStep");
+
+  this->Internals->ReceiverMetadata.clear();
+
+  int ierr = this->Internals->Stream.BeginStep();
+  this->Internals->Good = ierr ? -1 : 0;
+
+  if (ierr < 0)
+    {
+    SENSEI_ERROR("Failed to update time step")
+    return -1;
+    }
+
+  if (ierr > 0)
+    {
+    SENSEI_STATUS("End of stream detected")
+    return 1;
+    }
+
+  this->Internals->Released = false;
+
+  this->SetDataTimeStep(this->Internals->Stream.GetTimeStep());
+  this->SetDataTime(this->Internals->Stream.GetTime());
+
+  return 0;
+}
+
+//----------------------------------------------------------------------------
+int MPIInTransitDataAdaptor::GetSenderMeshMetadata(unsigned int id,
+  MeshMetadataPtr &metadata)
+{
+  TimeEvent<128> mark("MPIInTransitDataAdaptor::GetSenderMeshMetadata");
+  if (this->Internals->Stream.GetSenderMeshMetadata(id, metadata))
+    {
+    SENSEI_ERROR("Failed to get metadata for object " << id)
+    return -1;
+    }
+
+  return 0;
+}
+
+//----------------------------------------------------------------------------
+int MPIInTransitDataAdaptor::GetNumberOfMeshes(unsigned int &numMeshes)
+{
+  TimeEvent<128> mark("MPIInTransitDataAdaptor::GetNumberOfMeshes");
+  numMeshes = this->Internals->Stream.GetNumberOfMeshes();
+  return 0;
+}
+
+//----------------------------------------------------------------------------
+int MPIInTransitDataAdaptor::GetMeshMetadata(unsigned int id, MeshMetadataPtr &metadata)
+{
+  TimeEvent<128> mark("MPIInTransitDataAdaptor::GetMeshMetadata");
+
+  // check if an analysis told us how the data should land by
+  // passing in reciever metadata
+  if (!this->GetReceiverMeshMetadata(id, metadata))
+    return 0;
+
+  // we did this already this step, return cached layout
+  std::map<unsigned int, MeshMetadataPtr>::iterator it =
+    this->Internals->ReceiverMetadata.find(id);
+  if (it != this->Internals->ReceiverMetadata.end())
+    {
+    metadata = it->second;
+    return 0;
+    }
+
+  MeshMetadataPtr senderMd;
+  if (this->GetSenderMeshMetadata(id, senderMd))
+    {
+    SENSEI_ERROR("Failed to get sender metadata")
+    return -1;
+    }
+
+  // the layout of a static mesh does not change
+  it = this->Internals->StaticReceiverMetadata.find(id);
+  if (senderMd->StaticMesh && (it != this->Internals->StaticReceiverMetadata.end()))
+    {
+    metadata = it->second;
+    this->Internals->ReceiverMetadata[id] = metadata;
+    return 0;
+    }
+
+  // get the partitioner, default to the block partitioner
+  PartitionerPtr part = this->GetPartitioner();
+  if (!part)
+    part = BlockPartitioner::New();
+
+  MeshMetadataPtr receiverMd;
+  if (part->GetPartition(this->GetCommunicator(), senderMd, receiverMd))
+    {
+    SENSEI_ERROR("Failed to determine a suitable layout to receive the data")
+    return -1;
+    }
+
+  this->Internals->ReceiverMetadata[id] = receiverMd;
+
+  if (senderMd->StaticMesh)
+    this->Internals->StaticReceiverMetadata[id] = receiverMd;
+
+  metadata = receiverMd;
+
+  return 0;
+}
+
+//----------------------------------------------------------------------------
+int MPIInTransitDataAdaptor::ReceiveBlocks()
+{
+  senseiMPIInTransit::InputStream &stream = this->Internals->Stream;
+  if (stream.Received())
+    return 0;
+
+  TimeEvent<128> mark("MPIInTransitDataAdaptor::ReceiveBlocks");
+
+  // the senders need the layout of every mesh, including those that are
+  // not used by the analysis, before any blocks are sent
+  unsigned int nMeshes = stream.GetNumberOfMeshes();
+  std::vector<MeshMetadataPtr> receiverMd(nMeshes);
+  for (unsigned int id = 0; id < nMeshes; ++id)
+    {
+    if (this->GetMeshMetadata(id, receiverMd[id]))
+      return -1;
+    }
+
+  if (stream.Receive(receiverMd))
+    {
+    SENSEI_ERROR("Failed to receive step " << stream.GetTimeStep())
+    return -1;
+    }
+
+  return 0;
+}
+
+//----------------------------------------------------------------------------
+int MPIInTransitDataAdaptor::GetMeshLayout(const std::string &meshName,
+  unsigned int &id, MeshMetadataPtr &senderMd, MeshMetadataPtr &receiverMd)
+{
+  if (this->ReceiveBlocks())
+    return -1;
+
+  unsigned int nMeshes = this->Internals->Stream.GetNumberOfMeshes();
+  for (id = 0; id < nMeshes; ++id)
+    {
+    if (this->GetSenderMeshMetadata(id, senderMd))
+      return -1;
+
+    if (senderMd->MeshName == meshName)
+      return this->GetMeshMetadata(id, receiverMd);
+    }
+
+  SENSEI_ERROR("No mesh named \"" << meshName << "\"")
+  return -1;
+}
+
+//----------------------------------------------------------------------------
+int MPIInTransitDataAdaptor::GetMesh(const std::string &meshName,
+   bool structureOnly, svtkDataObject *&mesh)
+{
+  TimeEvent<128> mark("MPIInTransitDataAdaptor::GetMesh");
+
+  mesh = nullptr;
+
+  unsigned int id = 0;
+  MeshMetadataPtr senderMd;
+  MeshMetadataPtr receiverMd;
+  svtkMultiBlockDataSet *mbds = nullptr;
+
+  if (this->GetMeshLayout(meshName, id, senderMd, receiverMd) ||
+    this->Internals->Stream.ReadMesh(id, receiverMd, structureOnly, mbds))
+    {
+    SENSEI_ERROR("Failed to read mesh \"" << meshName << "\"")
+    return -1;
+    }
+
+  mesh = mbds;
+
+  return 0;
+}
+
+//----------------------------------------------------------------------------
+int MPIInTransitDataAdaptor::AddGhostNodesArray(svtkDataObject *mesh,
+  const std::string &meshName)
+{
+  TimeEvent<128> mark("MPIInTransitDataAdaptor::AddGhostNodesArray");
+  return AddArray(mesh, meshName, svtkDataObject::POINT, "svtkGhostType");
+}
+
+//----------------------------------------------------------------------------
+int MPIInTransitDataAdaptor::AddGhostCellsArray(svtkDataObject *mesh,
+  const std::string &meshName)
+{
+  TimeEvent<128> mark("MPIInTransitDataAdaptor::AddGhostCellsArray");
+  return AddArray(mesh, meshName, svtkDataObject::CELL, "svtkGhostType");
+}
+
+//----------------------------------------------------------------------------
+int MPIInTransitDataAdaptor::AddArray(svtkDataObject* mesh,
+  const std::string &meshName, int association, const std::string& arrayName)
+{
+  TimeEvent<128> mark("MPIInTransitDataAdaptor::AddArray");
+
+  // the mesh should never be null. there must have been an error
+  // upstream.
+  svtkMultiBlockDataSet *mbds = dynamic_cast<svtkMultiBlockDataSet*>(mesh);
+  if (!mbds)
+    {
+    SENSEI_ERROR("Invalid mesh object")
+    return -1;
+    }
+
+  unsigned int id = 0;
+  MeshMetadataPtr senderMd;
+  MeshMetadataPtr receiverMd;
+
+  if (this->GetMeshLayout(meshName, id, senderMd, receiverMd) ||
+    this->Internals->Stream.ReadArray(id, receiverMd, association,
+      arrayName, mbds))
+    {
+    SENSEI_ERROR("Failed to read " << SVTKUtils::GetAttributesName(association)
+      << " data array \"" << arrayName << "\" from mesh \"" << meshName << "\"")
+    return -1;
+    }
+
+  return 0;
+}
+
+//----------------------------------------------------------------------------
+int MPIInTransitDataAdaptor::ReleaseData()
+{
+  TimeEvent<128> mark("MPIInTransitDataAdaptor::ReleaseData");
+
+  if (this->Internals->Good || this->Internals->Released)
+    return 0;
+
+  this->Internals->Released = true;
+
+  // the senders wait on the step's blocks, receive them even when the
+  // analysis did not ask for them. meshes and arrays handed out keep
+  // their blocks until they are deleted.
+  int ierr = this->ReceiveBlocks();
+
+  if (this->Internals->Stream.EndStep())
+    ierr = -1;
+
+  return ierr;
+}
+
+}
@@ -0,0 +1,81 @@
+#ifndef sensei_MPIInTransitDataAdaptor_h
+#define sensei_MPIInTransitDataAdaptor_h
+
+#include "InTransitDataAdaptor.h"
+
+#include <string>
+#include <mpi.h>
+
+namespace sensei
+{
+
+/** The read side of the MPI in transit transport. The end point is launched
+ * with the simulation, in MPMD mode, and receives the blocks sent by
+ * sensei::MPIInTransitAnalysisAdaptor over an intercommunicator. The blocks
+ * are laid out by the partitioner, they are received the first time a mesh
+ * or array of the step is requested, and are shared by the meshes handed
+ * out. The end point must run on a communicator holding only its ranks, see
+ * sensei::MPIManager::SetDefaultCommunicator.
+ */
+class SENSEI_EXPORT MPIInTransitDataAdaptor : public sensei::InTransitDataAdaptor
+{
+public:
+  static MPIInTransitDataAdaptor *New();
+  senseiTypeMacro(MPIInTransitDataAdaptor, sensei::InTransitDataAdaptor);
+
+  /// SENSEI InTransitDataAdaptor control API
+  int Initialize(pugi::xml_node &parent) override;
+  int Finalize() override;
+
+  int OpenStream() override;
+  int CloseStream() override;
+  int AdvanceStream() override;
+  int StreamGood() override;
+
+  /// SENSEI InTransitDataAdaptor explicit paritioning API
+  int GetSenderMeshMetadata(unsigned int id, MeshMetadataPtr &metadata) override;
+
+  /// SENSEI DataAdaptor API
+  int GetNumberOfMeshes(unsigned int &numMeshes) override;
+
+  int GetMeshMetadata(unsigned int id, MeshMetadataPtr &metadata) override;
+
+  int GetMesh(const std::string &meshName, bool structureOnly,
+    svtkDataObject *&mesh) override;
+
+  int AddGhostNodesArray(svtkDataObject* mesh, const std::string &meshName) override;
+  int AddGhostCellsArray(svtkDataObject* mesh, const std::string &meshName) override;
+
+  int AddArray(svtkDataObject* mesh, const std::string &meshName,
+    int association, const std::string &arrayName) override;
+
+  int ReleaseData() override;
+
+protected:
+  MPIInTransitDataAdaptor();
+  ~MPIInTransitDataAdaptor();
+
+  // waits for the next step, and updates the time step and time values
+  // stored in the base class information object. returns 1 at the end of
+  // the stream.
+  int UpdateTimeStep();
+
+  // compute the layouts of all the meshes and receive this rank's blocks,
+  // if that has not already been done this step
+  int ReceiveBlocks();
+
+  // get the sender and receiver layouts of a mesh
+  int GetMeshLayout(const std::string &meshName, unsigned int &id,
+    MeshMetadataPtr &senderMd, MeshMetadataPtr &receiverMd);
+
+private:
+  struct InternalsType;
+  InternalsType *Internals;
+
+  MPIInTransitDataAdaptor(const MPIInTransitDataAdaptor&) = delete;
+  void operator=(const MPIInTransitDataAdaptor&) = delete;
+};
+
+}
+
+#endif
@@ -0,0 +1,1158 @@
+#include "MPIInTransitSchema.h"
+#include "BinaryStream.h"
+#include "MeshMetadata.h"
+#include "SVTKUtils.h"
+#include "Profiler.h"
+#include "Error.h"
+
+#include <svtkCellArray.h>
+#include <svtkCompositeDataIterator.h>
+#include <svtkDataArray.h>
+#include <svtkDataObject.h>
+#include <svtkDataSet.h>
+#include <svtkFieldData.h>
+#include <svtkImageData.h>
+#include <svtkMultiBlockDataSet.h>
+#include <svtkPoints.h>
+#include <svtkPolyData.h>
+#include <svtkRectilinearGrid.h>
+#include <svtkSmartPointer.h>
+#include <svtkStructuredGrid.h>
+#include <svtkUnsignedCharArray.h>
+#include <svtkUnstructuredGrid.h>
+
+#include <algorithm>
+#include <array>
+#include <climits>
+#include <map>
+#include <set>
+
+namespace
+{
+// the messages of a step
+enum
+{
+  TAG_STEP = 5101,    // sender 0 to receiver 0, the step's metadata
+  TAG_LAYOUT = 5102,  // receiver 0 to sender 0, the receivers' layout
+  TAG_BLOCKS = 5103   // sender to receiver, the receiver's blocks
+};
+
+using svtkDataSetPtr = svtkSmartPointer<svtkDataSet>;
+
+// --------------------------------------------------------------------------
+int PackArray(sensei::BinaryStream &str, svtkDataArray *da)
+{
+  int haveArray = da ? 1 : 0;
+  str.Pack(haveArray);
+
+  if (!da)
+    return 0;
+
+  if (da->GetDataType() == SVTK_BIT)
+    {
+    SENSEI_ERROR("The bit array \"" << (da->GetName() ? da->GetName() : "")
+      << "\" can not be sent")
+    return -1;
+    }
+
+  // arrays with other layouts are copied into the standard layout
+  svtkSmartPointer<svtkDataArray> aos = da;
+  if (!da->HasStandardMemoryLayout())
+    {
+    aos.TakeReference(svtkDataArray::CreateDataArray(da->GetDataType()));
+    aos->DeepCopy(da);
+    }
+
+  str.Pack(std::string(da->GetName() ? da->GetName() : ""));
+  str.Pack(da->GetDataType());
+  str.Pack(da->GetNumberOfComponents());
+  str.Pack(long(da->GetNumberOfTuples()));
+
+  unsigned long nBytes = aos->GetNumberOfValues()*aos->GetDataTypeSize();
+  if (nBytes)
+    str.Pack(static_cast<unsigned char*>(aos->GetVoidPointer(0)), nBytes);
+
+  return 0;
+}
+
+// --------------------------------------------------------------------------
+int UnpackArray(sensei::BinaryStream &str, svtkDataArray *&da)
+{
+  da = nullptr;
+
+  int haveArray = 0;
+  str.Unpack(haveArray);
+
+  if (!haveArray)
+    return 0;
+
+  std::string name;
+  int type = 0;
+  int nComps = 0;
+  long nTuples = 0;
+
+  str.Unpack(name);
+  str.Unpack(type);
+  str.Unpack(nComps);
+  str.Unpack(nTuples);
+
+  da = svtkDataArray::CreateDataArray(type);
+  if (!da)
+    {
+    SENSEI_ERROR("Failed to create array \"" << name << "\" of type " << type)
+    return -1;
+    }
+
+  if (!name.empty())
+    da->SetName(name.c_str());
+
+  da->SetNumberOfComponents(nComps);
+  da->SetNumberOfTuples(nTuples);
+
+  unsigned long nBytes = da->GetNumberOfValues()*da->GetDataTypeSize();
+  if (nBytes)
+    str.Unpack(static_cast<unsigned char*>(da->GetVoidPointer(0)), nBytes);
+
+  return 0;
+}
+
+// --------------------------------------------------------------------------
+int PackCells(sensei::BinaryStream &str, svtkCellArray *cells)
+{
+  int haveCells = cells ? 1 : 0;
+  str.Pack(haveCells);
+
+  if (!cells)
+    return 0;
+
+  return (PackArray(str, cells->GetOffsetsArray()) ||
+    PackArray(str, cells->GetConnectivityArray())) ? -1 : 0;
+}
+
+// --------------------------------------------------------------------------
+int UnpackCells(sensei::BinaryStream &str, svtkCellArray *&cells)
+{
+  cells = nullptr;
+
+  int haveCells = 0;
+  str.Unpack(haveCells);
+
+  if (!haveCells)
+    return 0;
+
+  svtkDataArray *offs = nullptr;
+  svtkDataArray *conn = nullptr;
+
+  int ierr = 0;
+  if (UnpackArray(str, offs) || UnpackArray(str, conn) || !offs || !conn)
+    {
+    ierr = -1;
+    }
+  else
+    {
+    cells = svtkCellArray::New();
+    if (!cells->SetData(offs, conn))
+      {
+      SENSEI_ERROR("Invalid cells received")
+      cells->Delete();
+      cells = nullptr;
+      ierr = -1;
+      }
+    }
+
+  if (offs)
+    offs->Delete();
+
+  if (conn)
+    conn->Delete();
+
+  return ierr;
+}
+
+// --------------------------------------------------------------------------
+int PackPoints(sensei::BinaryStream &str, svtkPoints *points)
+{
+  return PackArray(str, points ? points->GetData() : nullptr);
+}
+
+// --------------------------------------------------------------------------
+int UnpackPoints(sensei::BinaryStream &str, svtkPoints *&points)
+{
+  points = nullptr;
+
+  svtkDataArray *da = nullptr;
+  if (UnpackArray(str, da))
+    return -1;
+
+  if (da)
+    {
+    points = svtkPoints::New();
+    points->SetData(da);
+    da->Delete();
+    }
+
+  return 0;
+}
+
+// --------------------------------------------------------------------------
+int PackBlock(sensei::BinaryStream &str, svtkDataSet *ds, int blockId)
+{
+  int blockType = ds->GetDataObjectType();
+  str.Pack(blockType);
+
+  // the structure
+  if (svtkImageData *im = dynamic_cast<svtkImageData*>(ds))
+    {
+    std::array<int,6> extent;
+    std::array<double,3> origin;
+    std::array<double,3> spacing;
+
+    im->GetExtent(extent.data());
+    im->GetOrigin(origin.data());
+    im->GetSpacing(spacing.data());
+
+    str.Pack(extent);
+    str.Pack(origin);
+    str.Pack(spacing);
+    }
+  else if (svtkRectilinearGrid *rg = dynamic_cast<svtkRectilinearGrid*>(ds))
+    {
+    std::array<int,6> extent;
+    rg->GetExtent(extent.data());
+    str.Pack(extent);
+
+    if (PackArray(str, rg->GetXCoordinates()) ||
+      PackArray(str, rg->GetYCoordinates()) ||
+      PackArray(str, rg->GetZCoordinates()))
+      return -1;
+    }
+  else if (svtkStructuredGrid *sg = dynamic_cast<svtkStructuredGrid*>(ds))
+    {
+    std::array<int,6> extent;
+    sg->GetExtent(extent.data());
+    str.Pack(extent);
+
+    if (PackPoints(str, sg->GetPoints()))
+      return -1;
+    }
+  else if (svtkPolyData *pd = dynamic_cast<svtkPolyData*>(ds))
+    {
+    if (PackPoints(str, pd->GetPoints()) || PackCells(str, pd->GetVerts()) ||
+      PackCells(str, pd->GetLines()) || PackCells(str, pd->GetPolys()) ||
+      PackCells(str, pd->GetStrips()))
+      return -1;
+    }
+  else if (svtkUnstructuredGrid *ug = dynamic_cast<svtkUnstructuredGrid*>(ds))
+    {
+    if (ug->GetFaces())
+      {
+      SENSEI_ERROR("Polyhedral cells in block " << blockId << " can not be sent")
+      return -1;
+      }
+
+    if (PackPoints(str, ug->GetPoints()) ||
+      PackArray(str, ug->GetCellTypesArray()) ||
+      PackCells(str, ug->GetCells()))
+      return -1;
+    }
+  else
+    {
+    SENSEI_ERROR("Block " << blockId << " is a " << ds->GetClassName()
+      << " which can not be sent")
+    return -1;
+    }
+
+  // the point and cell data arrays
+  for (int association : {svtkDataObject::POINT, svtkDataObject::CELL})
+    {
+    svtkFieldData *atts = sensei::SVTKUtils::GetAttributes(ds, association);
+
+    std::vector<svtkDataArray*> arrays;
+    int nArrays = atts->GetNumberOfArrays();
+    for (int i = 0; i < nArrays; ++i)
+      {
+      svtkDataArray *da = atts->GetArray(i);
+      if (da && da->GetName())
+        arrays.push_back(da);
+      }
+
+    nArrays = arrays.size();
+    str.Pack(nArrays);
+
+    for (int i = 0; i < nArrays; ++i)
+      {
+      if (PackArray(str, arrays[i]))
+        return -1;
+      }
+    }
+
+  return 0;
+}
+
+// --------------------------------------------------------------------------
+int UnpackBlock(sensei::BinaryStream &str, svtkDataSet *&ds)
+{
+  int blockType = 0;
+  str.Unpack(blockType);
+
+  ds = dynamic_cast<svtkDataSet*>(sensei::SVTKUtils::NewDataObject(blockType));
+  if (!ds)
+    {
+    SENSEI_ERROR("Failed to create a block of type " << blockType)
+    return -1;
+    }
+
+  int ierr = 0;
+
+  // the structure
+  if (svtkImageData *im = dynamic_cast<svtkImageData*>(ds))
+    {
+    std::array<int,6> extent;
+    std::array<double,3> origin;
+    std::array<double,3> spacing;
+
+    str.Unpack(extent);
+    str.Unpack(origin);
+    str.Unpack(spacing);
+
+    im->SetExtent(extent.data());
+    im->SetOrigin(origin.data());
+    im->SetSpacing(spacing.data());
+    }
+  else if (svtkRectilinearGrid *rg = dynamic_cast<svtkRectilinearGrid*>(ds))
+    {
+    std::array<int,6> extent;
+    str.Unpack(extent);
+    rg->SetExtent(extent.data());
+
+    svtkDataArray *coords[3] = {nullptr, nullptr, nullptr};
+    for (int i = 0; !ierr && (i < 3); ++i)
+      ierr = UnpackArray(str, coords[i]);
+
+    rg->SetXCoordinates(coords[0]);
+    rg->SetYCoordinates(coords[1]);
+    rg->SetZCoordinates(coords[2]);
+
+    for (int i = 0; i < 3; ++i)
+      {
+      if (coords[i])
+        coords[i]->Delete();
+      }
+    }
+  else if (svtkStructuredGrid *sg = dynamic_cast<svtkStructuredGrid*>(ds))
+    {
+    std::array<int,6> extent;
+    str.Unpack(extent);
+    sg->SetExtent(extent.data());
+
+    svtkPoints *points = nullptr;
+    if (!(ierr = UnpackPoints(str, points)) && points)
+      {
+      sg->SetPoints(points);
+      points->Delete();
+      }
+    }
+  else if (svtkPolyData *pd = dynamic_cast<svtkPolyData*>(ds))
+    {
+    svtkPoints *points = nullptr;
+    if (!(ierr = UnpackPoints(str, points)) && points)
+      {
+      pd->SetPoints(points);
+      points->Delete();
+      }
+
+    for (int i = 0; !ierr && (i < 4); ++i)
+      {
+      svtkCellArray *cells = nullptr;
+      if ((ierr = UnpackCells(str, cells)) || !cells)
+        continue;
+
+      if (i == 0)
+        pd->SetVerts(cells);
+      else if (i == 1)
+        pd->SetLines(cells);
+      else if (i == 2)
+        pd->SetPolys(cells);
+      else
+        pd->SetStrips(cells);
+
+      cells->Delete();
+      }
+    }
+  else if (svtkUnstructuredGrid *ug = dynamic_cast<svtkUnstructuredGrid*>(ds))
+    {
+    svtkPoints *points = nullptr;
+    if (!(ierr = UnpackPoints(str, points)) && points)
+      {
+      ug->SetPoints(points);
+      points->Delete();
+      }
+
+    svtkDataArray *types = nullptr;
+    svtkCellArray *cells = nullptr;
+    if (!ierr && !(ierr = UnpackArray(str, types)) &&
+      !(ierr = UnpackCells(str, cells)) && types && cells)
+      {
+      svtkUnsignedCharArray *uctypes = svtkUnsignedCharArray::SafeDownCast(types);
+      if (uctypes)
+        {
+        ug->SetCells(uctypes, cells);
+        }
+      else
+        {
+        SENSEI_ERROR("Invalid cell types received")
+        ierr = -1;
+        }
+      }
+
+    if (types)
+      types->Delete();
+
+    if (cells)
+      cells->Delete();
+    }
+  else
+    {
+    SENSEI_ERROR("Blocks of type " << ds->GetClassName() << " can not be received")
+    ierr = -1;
+    }
+
+  // the point and cell data arrays
+  for (int association : {svtkDataObject::POINT, svtkDataObject::CELL})
+    {
+    if (ierr)
+      break;
+
+    svtkFieldData *atts = sensei::SVTKUtils::GetAttributes(ds, association);
+
+    int nArrays = 0;
+    str.Unpack(nArrays);
+
+    for (int i = 0; i < nArrays; ++i)
+      {
+      svtkDataArray *da = nullptr;
+      if ((ierr = UnpackArray(str, da)))
+        break;
+
+      if (da)
+        {
+        atts->AddArray(da);
+        da->Delete();
+        }
+      }
+    }
+
+  if (ierr)
+    {
+    ds->Delete();
+    ds = nullptr;
+    return -1;
+    }
+
+  return 0;
+}
+
+// --------------------------------------------------------------------------
+// receive a message of unknown size
+int Recv(sensei::BinaryStream &str, int source, int tag, MPI_Comm comm)
+{
+  MPI_Status stat;
+  MPI_Probe(source, tag, comm, &stat);
+
+  int nBytes = 0;
+  MPI_Get_count(&stat, MPI_BYTE, &nBytes);
+
+  str.Resize(nBytes);
+  MPI_Recv(str.GetData(), nBytes, MPI_BYTE, source, tag, comm, MPI_STATUS_IGNORE);
+
+  str.SetReadPos(0);
+  str.SetWritePos(nBytes);
+
+  return 0;
+}
+
+// --------------------------------------------------------------------------
+// send a message, checking that it fits in an MPI count
+int Send(const sensei::BinaryStream &str, int dest, int tag, MPI_Comm comm)
+{
+  if (str.Size() > (unsigned long)INT_MAX)
+    {
+    SENSEI_ERROR("The message of " << str.Size() << " bytes to "
+      << dest << " is too large")
+    return -1;
+    }
+
+  MPI_Send(str.GetData(), str.Size(), MPI_BYTE, dest, tag, comm);
+
+  return 0;
+}
+
+// --------------------------------------------------------------------------
+// the block shares the received structure. Points and cells are skipped
+// when structureOnly is set.
+svtkDataSet *NewStructure(svtkDataSet *in, bool structureOnly)
+{
+  svtkDataSet *out = in->NewInstance();
+
+  if (!structureOnly || dynamic_cast<svtkImageData*>(in) ||
+    dynamic_cast<svtkRectilinearGrid*>(in))
+    {
+    out->CopyStructure(in);
+    }
+  else if (svtkStructuredGrid *sg = dynamic_cast<svtkStructuredGrid*>(in))
+    {
+    static_cast<svtkStructuredGrid*>(out)->SetExtent(sg->GetExtent());
+    }
+
+  return out;
+}
+}
+
+namespace senseiMPIInTransit
+{
+
+// --------------------------------------------------------------------------
+int Connect(MPI_Comm comm, MPI_Comm &interComm)
+{
+  sensei::TimeEvent<128> mark("senseiMPIInTransit::Connect");
+
+  interComm = MPI_COMM_NULL;
+
+  int worldSize = 1;
+  MPI_Comm_size(MPI_COMM_WORLD, &worldSize);
+
+  // find the ranks of this group in MPI_COMM_WORLD
+  MPI_Group group;
+  MPI_Group worldGroup;
+  MPI_Comm_group(comm, &group);
+  MPI_Comm_group(MPI_COMM_WORLD, &worldGroup);
+
+  int nRanks = 0;
+  MPI_Group_size(group, &nRanks);
+
+  std::vector<int> ranks(nRanks);
+  std::vector<int> worldRanks(nRanks);
+  for (int i = 0; i < nRanks; ++i)
+    ranks[i] = i;
+
+  MPI_Group_translate_ranks(group, nRanks, ranks.data(),
+    worldGroup, worldRanks.data());
+
+  MPI_Group_free(&group);
+  MPI_Group_free(&worldGroup);
+
+  // the other group's leader is the lowest rank not in this group
+  std::sort(worldRanks.begin(), worldRanks.end());
+
+  int remoteLeader = 0;
+  for (int i = 0; (i < nRanks) && (worldRanks[i] == remoteLeader); ++i)
+    remoteLeader += 1;
+
+  if (remoteLeader >= worldSize)
+    {
+    SENSEI_ERROR("No ranks outside of this group to connect to. Launch the"
+      " senders and the receivers in the same MPI_COMM_WORLD")
+    return -1;
+    }
+
+  MPI_Intercomm_create(comm, 0, MPI_COMM_WORLD, remoteLeader, TAG_STEP, &interComm);
+
+  return 0;
+}
+
+
+
+// --------------------------------------------------------------------------
+struct OutputStream::InternalsType
+{
+  InternalsType() : Comm(MPI_COMM_NULL), InterComm(MPI_COMM_NULL), Rank(0) {}
+
+  // complete the sends of the previous step
+  void WaitAll();
+
+  MPI_Comm Comm;
+  MPI_Comm InterComm;
+  int Rank;
+
+  // the sends in flight and their buffers
+  std::vector<MPI_Request> Requests;
+  std::vector<sensei::BinaryStream> Buffers;
+};
+
+// --------------------------------------------------------------------------
+void OutputStream::InternalsType::WaitAll()
+{
+  if (this->Requests.empty())
+    return;
+
+  sensei::TimeEvent<128> mark("senseiMPIInTransit::OutputStream::WaitAll");
+
+  MPI_Waitall(this->Requests.size(), this->Requests.data(), MPI_STATUSES_IGNORE);
+
+  this->Requests.clear();
+  this->Buffers.clear();
+}
+
+// --------------------------------------------------------------------------
+OutputStream::OutputStream() : Internals(new InternalsType)
+{
+}
+
+// --------------------------------------------------------------------------
+OutputStream::~OutputStream()
+{
+  delete this->Internals;
+}
+
+// --------------------------------------------------------------------------
+bool OutputStream::IsOpen()
+{
+  return this->Internals->InterComm != MPI_COMM_NULL;
+}
+
+// --------------------------------------------------------------------------
+int OutputStream::Open(MPI_Comm comm)
+{
+  sensei::TimeEvent<128> mark("senseiMPIInTransit::OutputStream::Open");
+
+  InternalsType *internals = this->Internals;
+
+  internals->Comm = comm;
+  MPI_Comm_rank(comm, &internals->Rank);
+
+  return Connect(comm, internals->InterComm);
+}
+
+// --------------------------------------------------------------------------
+int OutputStream::Write(unsigned long timeStep, double time,
+  const std::vector<sensei::MeshMetadataPtr> &metadata,
+  const std::vector<svtkCompositeDataSetPtr> &objects)
+{
+  sensei::TimeEvent<128> mark("senseiMPIInTransit::OutputStream::Write");
+
+  InternalsType *internals = this->Internals;
+  if (internals->InterComm == MPI_COMM_NULL)
+    {
+    SENSEI_ERROR("The stream is not open")
+    return -1;
+    }
+
+  // the previous step's buffers are reused
+  internals->WaitAll();
+
+  unsigned int nMeshes = metadata.size();
+
+  // send the metadata and receive the receivers' layout in return
+  sensei::BinaryStream layout;
+  if (internals->Rank == 0)
+    {
+    sensei::BinaryStream header;
+    header.Pack(int(1));
+    header.Pack(timeStep);
+    header.Pack(time);
+    header.Pack(nMeshes);
+
+    for (unsigned int j = 0; j < nMeshes; ++j)
+      metadata[j]->ToStream(header);
+
+    if (Send(header, 0, TAG_STEP, internals->InterComm))
+      return -1;
+
+    sensei::TimeEvent<128> waitMark("senseiMPIInTransit::OutputStream::WaitForLayout");
+    Recv(layout, 0, TAG_LAYOUT, internals->InterComm);
+    }
+
+  layout.Broadcast(internals->Comm, 0);
+
+  // group the local blocks by the receiver they were assigned to
+  struct BlockRef
+    {
+    unsigned int MeshId;
+    int BlockId;
+    svtkDataSet *Block;
+    };
+
+  std::map<int, std::vector<BlockRef>> blocksByDest;
+
+  for (unsigned int j = 0; j < nMeshes; ++j)
+    {
+    std::vector<int> owner;
+    layout.Unpack(owner);
+
+    const sensei::MeshMetadataPtr &md = metadata[j];
+    if (owner.size() != (unsigned long)md->NumBlocks)
+      {
+      SENSEI_ERROR("The layout of mesh \"" << md->MeshName << "\" has "
+        << owner.size() << " blocks, not " << md->NumBlocks)
+      return -1;
+      }
+
+    // where the local blocks are in the global view
+    std::map<int, int> blockIndex;
+    for (int i = 0; i < md->NumBlocks; ++i)
+      {
+      if (md->BlockOwner[i] == internals->Rank)
+        blockIndex[md->BlockIds[i]] = i;
+      }
+
+    svtkCompositeDataIterator *it = objects[j]->NewIterator();
+    it->SetSkipEmptyNodes(1);
+    for (it->InitTraversal(); !it->IsDoneWithTraversal(); it->GoToNextItem())
+      {
+      svtkDataSet *ds = dynamic_cast<svtkDataSet*>(it->GetCurrentDataObject());
+      if (!ds)
+        continue;
+
+      int bid = std::max(0, int(it->GetCurrentFlatIndex() - 1));
+
+      std::map<int, int>::iterator bit = blockIndex.find(bid);
+      if (bit == blockIndex.end())
+        {
+        SENSEI_ERROR("Block " << bid << " of mesh \"" << md->MeshName
+          << "\" is not in the metadata")
+        it->Delete();
+        return -1;
+        }
+
+      blocksByDest[owner[bit->second]].push_back(BlockRef{j, bid, ds});
+      }
+    it->Delete();
+    }
+
+  // copy the blocks and send them
+  internals->Buffers.resize(blocksByDest.size());
+  internals->Requests.resize(blocksByDest.size(), MPI_REQUEST_NULL);
+
+  unsigned int q = 0;
+  std::map<int, std::vector<BlockRef>>::iterator dit = blocksByDest.begin();
+  for (; dit != blocksByDest.end(); ++dit, ++q)
+    {
+    sensei::BinaryStream &str = internals->Buffers[q];
+
+    const std::vector<BlockRef> &blocks = dit->second;
+    unsigned int nBlocks = blocks.size();
+    str.Pack(nBlocks);
+
+    for (unsigned int i = 0; i < nBlocks; ++i)
+      {
+      unsigned int meshId = blocks[i].MeshId;
+      int bid = blocks[i].BlockId;
+
+      str.Pack(meshId);
+      str.Pack(bid);
+
+      if (PackBlock(str, blocks[i].Block, bid))
+        {
+        SENSEI_ERROR("Failed to send block " << bid << " of mesh \""
+          << metadata[meshId]->MeshName << "\"")
+        return -1;
+        }
+      }
+
+    if (str.Size() > (unsigned long)INT_MAX)
+      {
+      SENSEI_ERROR("The " << str.Size() << " bytes for receiver "
+        << dit->first << " exceed the size of an MPI message")
+      return -1;
+      }
+
+    MPI_Isend(str.GetData(), str.Size(), MPI_BYTE, dit->first, TAG_BLOCKS,
+      internals->InterComm, &internals->Requests[q]);
+    }
+
+  return 0;
+}
+
+// --------------------------------------------------------------------------
+int OutputStream::Close()
+{
+  InternalsType *internals = this->Internals;
+  if (internals->InterComm == MPI_COMM_NULL)
+    return 0;
+
+  sensei::TimeEvent<128> mark("senseiMPIInTransit::OutputStream::Close");
+
+  internals->WaitAll();
+
+  // mark the end of the stream
+  int ierr = 0;
+  if (internals->Rank == 0)
+    {
+    sensei::BinaryStream header;
+    header.Pack(int(0));
+    ierr = Send(header, 0, TAG_STEP, internals->InterComm);
+    }
+
+  MPI_Comm_free(&internals->InterComm);
+  internals->InterComm = MPI_COMM_NULL;
+
+  return ierr;
+}
+
+
+
+// --------------------------------------------------------------------------
+struct InputStream::InternalsType
+{
+  InternalsType() : Comm(MPI_COMM_NULL), InterComm(MPI_COMM_NULL), Rank(0),
+    HaveStep(false), HaveBlocks(false), TimeStep(0), Time(0.0) {}
+
+  MPI_Comm Comm;
+  MPI_Comm InterComm;
+  int Rank;
+  bool HaveStep;
+  bool HaveBlocks;
+  unsigned long TimeStep;
+  double Time;
+  std::vector<sensei::MeshMetadataPtr> Metadata;
+
+  // the received blocks of each mesh by block id
+  std::vector<std::map<int, svtkDataSetPtr>> Blocks;
+};
+
+// --------------------------------------------------------------------------
+InputStream::InputStream() : Internals(new InternalsType)
+{
+}
+
+// --------------------------------------------------------------------------
+InputStream::~InputStream()
+{
+  this->Close();
+  delete this->Internals;
+}
+
+// --------------------------------------------------------------------------
+int InputStream::Open(MPI_Comm comm)
+{
+  sensei::TimeEvent<128> mark("senseiMPIInTransit::InputStream::Open");
+
+  InternalsType *internals = this->Internals;
+
+  internals->Comm = comm;
+  MPI_Comm_rank(comm, &internals->Rank);
+
+  return Connect(comm, internals->InterComm);
+}
+
+// --------------------------------------------------------------------------
+int InputStream::BeginStep()
+{
+  sensei::TimeEvent<128> mark("senseiMPIInTransit::InputStream::BeginStep");
+
+  InternalsType *internals = this->Internals;
+  if (internals->InterComm == MPI_COMM_NULL)
+    {
+    SENSEI_ERROR("The stream is not open")
+    return -1;
+    }
+
+  if (internals->HaveStep)
+    return 0;
+
+  sensei::BinaryStream header;
+  if (internals->Rank == 0)
+    Recv(header, 0, TAG_STEP, internals->InterComm);
+
+  header.Broadcast(internals->Comm, 0);
+
+  int more = 0;
+  header.Unpack(more);
+  if (!more)
+    return 1;
+
+  header.Unpack(internals->TimeStep);
+  header.Unpack(internals->Time);
+
+  unsigned int nMeshes = 0;
+  header.Unpack(nMeshes);
+
+  internals->Metadata.resize(nMeshes);
+  for (unsigned int j = 0; j < nMeshes; ++j)
+    {
+    internals->Metadata[j] = sensei::MeshMetadata::New();
+    internals->Metadata[j]->FromStream(header);
+    }
+
+  internals->Blocks.clear();
+  internals->Blocks.resize(nMeshes);
+
+  internals->HaveStep = true;
+  internals->HaveBlocks = false;
+
+  return 0;
+}
+
+// --------------------------------------------------------------------------
+bool InputStream::Received()
+{
+  return this->Internals->HaveBlocks;
+}
+
+// --------------------------------------------------------------------------
+int InputStream::Receive(const std::vector<sensei::MeshMetadataPtr> &receiverMd)
+{
+  sensei::TimeEvent<128> mark("senseiMPIInTransit::InputStream::Receive");
+
+  InternalsType *internals = this->Internals;
+  if (!internals->HaveStep)
+    {
+    SENSEI_ERROR("No step is available")
+    return -1;
+    }
+
+  if (internals->HaveBlocks)
+    return 0;
+
+  unsigned int nMeshes = internals->Metadata.size();
+  if (receiverMd.size() != nMeshes)
+    {
+    SENSEI_ERROR("A layout is needed for each of the " << nMeshes << " meshes")
+    return -1;
+    }
+
+  // let the senders know where the blocks go
+  if (internals->Rank == 0)
+    {
+    sensei::BinaryStream layout;
+    for (unsigned int j = 0; j < nMeshes; ++j)
+      layout.Pack(receiverMd[j]->BlockOwner);
+
+    if (Send(layout, 0, TAG_LAYOUT, internals->InterComm))
+      return -1;
+    }
+
+  // the senders this rank gets blocks from
+  std::set<int> senders;
+  for (unsigned int j = 0; j < nMeshes; ++j)
+    {
+    const sensei::MeshMetadataPtr &senderMd = internals->Metadata[j];
+    for (int i = 0; i < receiverMd[j]->NumBlocks; ++i)
+      {
+      if (receiverMd[j]->BlockOwner[i] == internals->Rank)
+        senders.insert(senderMd->BlockOwner[i]);
+      }
+    }
+
+  // receive from all of them at once
+  unsigned int nSenders = senders.size();
+  std::vector<sensei::BinaryStream> buffers(nSenders);
+  std::vector<MPI_Request> requests(nSenders, MPI_REQUEST_NULL);
+
+  unsigned int q = 0;
+  std::set<int>::iterator sit = senders.begin();
+  for (; sit != senders.end(); ++sit, ++q)
+    {
+    MPI_Message msg;
+    MPI_Status stat;
+    MPI_Mprobe(*sit, TAG_BLOCKS, internals->InterComm, &msg, &stat);
+
+    int nBytes = 0;
+    MPI_Get_count(&stat, MPI_BYTE, &nBytes);
+
+    buffers[q].Resize(nBytes);
+    buffers[q].SetReadPos(0);
+    buffers[q].SetWritePos(nBytes);
+
+    MPI_Imrecv(buffers[q].GetData(), nBytes, MPI_BYTE, &msg, &requests[q]);
+    }
+
+  if (nSenders)
+    MPI_Waitall(nSenders, requests.data(), MPI_STATUSES_IGNORE);
+
+  // unpack the blocks
+  for (q = 0; q < nSenders; ++q)
+    {
+    sensei::BinaryStream &str = buffers[q];
+
+    unsigned int nBlocks = 0;
+    str.Unpack(nBlocks);
+
+    for (unsigned int i = 0; i < nBlocks; ++i)
+      {
+      unsigned int meshId = 0;
+      int bid = 0;
+      str.Unpack(meshId);
+      str.Unpack(bid);
+
+      svtkDataSet *ds = nullptr;
+      if ((meshId >= nMeshes) || UnpackBlock(str, ds))
+        {
+        SENSEI_ERROR("Failed to receive block " << bid << " of mesh " << meshId)
+        return -1;
+        }
+
+      internals->Blocks[meshId][bid].TakeReference(ds);
+      }
+    }
+
+  internals->HaveBlocks = true;
+
+  return 0;
+}
+
+// --------------------------------------------------------------------------
+int InputStream::EndStep()
+{
+  InternalsType *internals = this->Internals;
+
+  internals->Blocks.clear();
+  internals->HaveStep = false;
+  internals->HaveBlocks = false;
+
+  return 0;
+}
+
+// --------------------------------------------------------------------------
+int InputStream::Close()
+{
+  InternalsType *internals = this->Internals;
+  if (internals->InterComm == MPI_COMM_NULL)
+    return 0;
+
+  sensei::TimeEvent<128> mark("senseiMPIInTransit::InputStream::Close");
+
+  this->EndStep();
+  internals->Metadata.clear();
+
+  MPI_Comm_free(&internals->InterComm);
+  internals->InterComm = MPI_COMM_NULL;
+
+  return 0;
+}
+
+// --------------------------------------------------------------------------
+unsigned long InputStream::GetTimeStep()
+{
+  return this->Internals->TimeStep;
+}
+
+// --------------------------------------------------------------------------
+double InputStream::GetTime()
+{
+  return this->Internals->Time;
+}
+
+// --------------------------------------------------------------------------
+unsigned int InputStream::GetNumberOfMeshes()
+{
+  return this->Internals->HaveStep ? this->Internals->Metadata.size() : 0;
+}
+
+// --------------------------------------------------------------------------
+int InputStream::GetSenderMeshMetadata(unsigned int id,
+  sensei::MeshMetadataPtr &md)
+{
+  if (id >= this->GetNumberOfMeshes())
+    {
+    SENSEI_ERROR("Invalid mesh id " << id)
+    return -1;
+    }
+
+  md = this->Internals->Metadata[id];
+
+  return 0;
+}
+
+// --------------------------------------------------------------------------
+int InputStream::ReadMesh(unsigned int id,
+  const sensei::MeshMetadataPtr &receiverMd, bool structureOnly,
+  svtkMultiBlockDataSet *&mesh)
+{
+  sensei::TimeEvent<128> mark("senseiMPIInTransit::InputStream::ReadMesh");
+
+  InternalsType *internals = this->Internals;
+
+  mesh = nullptr;
+
+  if (!internals->HaveBlocks || (id >= internals->Blocks.size()))
+    {
+    SENSEI_ERROR("Mesh " << id << " has not been received")
+    return -1;
+    }
+
+  const sensei::MeshMetadataPtr &senderMd = internals->Metadata[id];
+  std::map<int, svtkDataSetPtr> &blocks = internals->Blocks[id];
+
+  svtkMultiBlockDataSet *mbds = svtkMultiBlockDataSet::New();
+  mbds->SetNumberOfBlocks(receiverMd->NumBlocks);
+
+  for (int i = 0; i < receiverMd->NumBlocks; ++i)
+    {
+    if (receiverMd->BlockOwner[i] != internals->Rank)
+      continue;
+
+    std::map<int, svtkDataSetPtr>::iterator it = blocks.find(senderMd->BlockIds[i]);
+    if (it == blocks.end())
+      {
+      SENSEI_ERROR("Block " << senderMd->BlockIds[i] << " of mesh \""
+        << senderMd->MeshName << "\" was not received")
+      mbds->Delete();
+      return -1;
+      }
+
+    svtkDataSet *ds = NewStructure(it->second, structureOnly);
+    mbds->SetBlock(receiverMd->BlockIds[i], ds);
+    ds->Delete();
+    }
+
+  mesh = mbds;
+
+  return 0;
+}
+
+// --------------------------------------------------------------------------
+int InputStream::ReadArray(unsigned int id,
+  const sensei::MeshMetadataPtr &receiverMd, int association,
+  const std::string &arrayName, svtkMultiBlockDataSet *mesh)
+{
+  sensei::TimeEvent<128> mark("senseiMPIInTransit::InputStream::ReadArray");
+
+  InternalsType *internals = this->Internals;
+
+  if (!internals->HaveBlocks || (id >= internals->Blocks.size()))
+    {
+    SENSEI_ERROR("Mesh " << id << " has not been received")
+    return -1;
+    }
+
+  const sensei::MeshMetadataPtr &senderMd = internals->Metadata[id];
+  std::map<int, svtkDataSetPtr> &blocks = internals->Blocks[id];
+
+  for (int i = 0; i < receiverMd->NumBlocks; ++i)
+    {
+    if (receiverMd->BlockOwner[i] != internals->Rank)
+      continue;
+
+    svtkDataSet *ds = dynamic_cast<svtkDataSet*>(
+      mesh->GetBlock(receiverMd->BlockIds[i]));
+
+    std::map<int, svtkDataSetPtr>::iterator it = blocks.find(senderMd->BlockIds[i]);
+
+    if (!ds || (it == blocks.end()))
+      {
+      SENSEI_ERROR("Block " << receiverMd->BlockIds[i] << " of mesh \""
+        << senderMd->MeshName << "\" is missing")
+      return -1;
+      }
+
+    svtkDataArray *da = sensei::SVTKUtils::GetAttributes(it->second,
+      association)->GetArray(arrayName.c_str());
+
+    if (!da)
+      {
+      SENSEI_ERROR("Block " << senderMd->BlockIds[i] << " of mesh \""
+        << senderMd->MeshName << "\" has no "
+        << sensei::SVTKUtils::GetAttributesName(association)
+        << " data array \"" << arrayName << "\"")
+      return -1;
+      }
+
+    // the received array is shared, not copied
+    sensei::SVTKUtils::GetAttributes(ds, association)->AddArray(da);
+    }
+
+  return 0;
+}
+
+}
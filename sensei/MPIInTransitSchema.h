@@ -0,0 +1,121 @@
+#ifndef MPIInTransitSchema_h
+#define MPIInTransitSchema_h
+
+#include "MeshMetadata.h"
+#include "SVTKUtils.h"
+
+#include <svtkCompositeDataSet.h>
+
+#include <mpi.h>
+#include <string>
+#include <vector>
+
+class svtkMultiBlockDataSet;
+
+/// @file MPIInTransitSchema.h
+/// The MPI in transit transport. The senders and the receivers are two
+/// disjoint groups of MPI_COMM_WORLD joined by an intercommunicator. For each
+/// step the first sender sends the metadata of the meshes to the first
+/// receiver, the receivers partition the blocks and the first receiver
+/// sends the resulting layout back. The senders then send the blocks each
+/// receiver was assigned in a single nonblocking message per receiver, and
+/// return to the simulation. The sends are completed by the next step, so
+/// that the transfer overlaps the simulation. A receiver only waits for its
+/// blocks when it first needs them.
+namespace senseiMPIInTransit
+{
+
+/// Join the group of this process with the other group of MPI_COMM_WORLD.
+/// comm holds this process's group. MPI_COMM_WORLD must hold exactly the two
+/// groups, and the first rank of each group must be the group's lowest rank
+/// in MPI_COMM_WORLD, as is the case when MPI_COMM_WORLD is split or when
+/// the programs are launched with mpiexec -np N sim : -np M end_point.
+int Connect(MPI_Comm comm, MPI_Comm &interComm);
+
+/// The sending side. Open, Write, and Close are called by all the sending
+/// ranks.
+class OutputStream
+{
+public:
+  OutputStream();
+  ~OutputStream();
+
+  /// connect to the receivers
+  int Open(MPI_Comm comm);
+
+  /// send a step. The blocks are copied and sent without waiting for them to
+  /// be received. Sends from the previous step are completed first.
+  int Write(unsigned long timeStep, double time,
+    const std::vector<sensei::MeshMetadataPtr> &metadata,
+    const std::vector<svtkCompositeDataSetPtr> &objects);
+
+  /// complete the sends in flight and mark the end of the stream
+  int Close();
+
+  /// true between Open and Close
+  bool IsOpen();
+
+private:
+  OutputStream(const OutputStream &) = delete;
+  void operator=(const OutputStream &) = delete;
+
+  struct InternalsType;
+  InternalsType *Internals;
+};
+
+/// The receiving side. Open, BeginStep, Receive, EndStep, and Close are called
+/// by all the receiving ranks.
+class InputStream
+{
+public:
+  InputStream();
+  ~InputStream();
+
+  /// connect to the senders
+  int Open(MPI_Comm comm);
+
+  /// wait for the metadata of the next step. Returns 0 when a step is
+  /// available, 1 at the end of the stream, and -1 on error.
+  int BeginStep();
+
+  /// send the receivers' layout of each mesh to the senders and receive this
+  /// rank's blocks. The layouts are given in the order of the meshes.
+  int Receive(const std::vector<sensei::MeshMetadataPtr> &receiverMd);
+
+  /// true once the current step's blocks have been received
+  bool Received();
+
+  /// release the current step's blocks
+  int EndStep();
+
+  /// disconnect from the senders
+  int Close();
+
+  /// the current step's time and time step
+  unsigned long GetTimeStep();
+  double GetTime();
+
+  /// the current step's meshes, as laid out by the senders
+  unsigned int GetNumberOfMeshes();
+  int GetSenderMeshMetadata(unsigned int id, sensei::MeshMetadataPtr &md);
+
+  /// create the receiver's blocks of a mesh. Points and cells are skipped
+  /// when structureOnly is set. The blocks share the received data.
+  int ReadMesh(unsigned int id, const sensei::MeshMetadataPtr &receiverMd,
+    bool structureOnly, svtkMultiBlockDataSet *&mesh);
+
+  /// add a received array to each of the receiver's blocks of a mesh
+  int ReadArray(unsigned int id, const sensei::MeshMetadataPtr &receiverMd,
+    int association, const std::string &arrayName, svtkMultiBlockDataSet *mesh);
+
+private:
+  InputStream(const InputStream &) = delete;
+  void operator=(const InputStream &) = delete;
+
+  struct InternalsType;
+  InternalsType *Internals;
+};
+
+}
+
+#endif
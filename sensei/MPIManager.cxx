@@ -7,6 +7,16 @@
 using seconds_t =
   std::chrono::duration<double, std::chrono::seconds::period>;
 
+namespace
+{
+// the communicator adaptors use when none is given
+MPI_Comm &DefaultCommunicator()
+{
+  static MPI_Comm comm = MPI_COMM_WORLD;
+  return comm;
+}
+}
+
 namespace sensei
 {
 
@@ -70,4 +80,16 @@ MPIManager::~MPIManager()
     Profiler::Flush();
 }
 
+// --------------------------------------------------------------------------
+void MPIManager::SetDefaultCommunicator(MPI_Comm comm)
+{
+  DefaultCommunicator() = comm;
+}
+
+// --------------------------------------------------------------------------
+MPI_Comm MPIManager::GetDefaultCommunicator()
+{
+  return DefaultCommunicator();
+}
+
 }
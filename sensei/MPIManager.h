@@ -4,6 +4,8 @@
 #include "senseiConfig.h"
 #define SENSEI_HAS_MPI
 
+#include <mpi.h>
+
 namespace sensei
 {
 
@@ -24,6 +26,18 @@ public:
   int GetCommRank(){ return mRank; }
   int GetCommSize(){ return mSize; }
 
+  /** Set the communicator that adaptors use when none is given, in place of
+   * MPI_COMM_WORLD. This is needed when MPI_COMM_WORLD is shared with another
+   * program, for instance a simulation and an end point launched together
+   * with mpiexec -np N sim : -np M end_point. It must be set before any
+   * adaptors are created, since their constructors are collective over the
+   * default communicator.
+   */
+  static void SetDefaultCommunicator(MPI_Comm comm);
+
+  /// Get the communicator that adaptors use when none is given.
+  static MPI_Comm GetDefaultCommunicator();
+
 private:
   int mRank;
   int mSize;
@@ -254,6 +254,55 @@ struct MemoryProfiler::InternalsType
   long long AvailablePhysicalMemory;
 };
 
+// --------------------------------------------------------------------------
+long long MemoryProfiler::GetResidentSetSize()
+{
+#if defined(__linux)
+  // the file is kept open, pread is safe to use from several threads
+  static int fd = open("/proc/self/statm", O_RDONLY|O_CLOEXEC);
+  static long long pageKiB = sysconf(_SC_PAGESIZE)/1024;
+
+  // the total size and resident size in pages
+  char buf[128];
+  ssize_t n = fd < 0 ? -1 : pread(fd, buf, sizeof(buf) - 1, 0);
+  if (n <= 0)
+    return -1;
+  buf[n] = '\0';
+
+  char *end = nullptr;
+  strtoll(buf, &end, 10);
+  long long rss = strtoll(end, nullptr, 10);
+
+  return rss*pageKiB;
+#elif defined(__APPLE__)
+  mach_task_basic_info_data_t info;
+  mach_msg_type_number_t count = MACH_TASK_BASIC_INFO_COUNT;
+  if (task_info(mach_task_self(), MACH_TASK_BASIC_INFO,
+    (task_info_t)&info, &count) != KERN_SUCCESS)
+    return -1;
+  return info.resident_size/1024;
+#else
+  return -1;
+#endif
+}
+
+// --------------------------------------------------------------------------
+long long MemoryProfiler::GetPeakResidentSetSize()
+{
+#if defined(__linux) || defined(__APPLE__)
+  struct rusage usage;
+  if (getrusage(RUSAGE_SELF, &usage))
+    return -1;
+#if defined(__APPLE__)
+  return usage.ru_maxrss/1024;
+#else
+  return usage.ru_maxrss;
+#endif
+#else
+  return -1;
+#endif
+}
+
 // --------------------------------------------------------------------------
 MemoryProfiler::MemoryProfiler()
 {
@@ -638,11 +687,7 @@ long long MemoryProfiler::InternalsType::GetProcMemoryUsed()
     }
   return pmc.working_set_size / 1024;
 #elif defined(__linux)
-  long long mem_used = 0;
-  int ierr = getFieldFromFile("/proc/self/status", "VmRSS:", mem_used);
-  if (ierr)
-    return -1;
-  return mem_used;
+  return MemoryProfiler::GetResidentSetSize();
 #elif defined(__APPLE__)
   long long mem_used = 0;
   pid_t pid = getpid();
@@ -43,6 +43,15 @@ public:
   void SetFilename(const std::string &filename);
   const char *GetFilename() const;
 
+  // Get the resident set size of the process in KiB. On Linux this is a
+  // single read of /proc/self/statm, cheap enough to call at the start and
+  // end of each profiler event. Returns -1 when not available.
+  static long long GetResidentSetSize();
+
+  // Get the peak resident set size of the process in KiB, from getrusage.
+  // Returns -1 when not available.
+  static long long GetPeakResidentSetSize();
+
   friend void *::profile(void *argp);
 
 private:
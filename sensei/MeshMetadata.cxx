@@ -386,35 +386,140 @@ int MeshMetadata::Validate(MPI_Comm comm, const MeshMetadataFlags &requiredFlags
 
 // --------------------------------------------------------------------------
 int MeshMetadata::GlobalizeView(MPI_Comm comm)
+{
+  return this->GlobalizeView(comm, -1);
+}
+
+// --------------------------------------------------------------------------
+int MeshMetadata::GlobalizeView(MPI_Comm comm, int rootRank)
 {
   TimeEvent<128> mark("MeshMetadata::GlobalizeView");
-  if (!this->GlobalView)
+
+  if (this->GlobalView)
+    return 0;
+
+  int rank = 0;
+  int nRanks = 1;
+
+  MPI_Comm_rank(comm, &rank);
+  MPI_Comm_size(comm, &nRanks);
+
+  // serialize the block level information. this lets us move all of it
+  // with one exchange of sizes and one exchange of data, rather than a pair
+  // of collectives per field.
+  BinaryStream lstr;
+  lstr.Pack(this->BlockOwner);
+  lstr.Pack(this->BlockIds);
+  lstr.Pack(this->NumBlocksLocal);
+  lstr.Pack(this->BlockNumPoints);
+  lstr.Pack(this->BlockNumCells);
+  lstr.Pack(this->BlockCellArraySize);
+  lstr.Pack(this->BlockExtents);
+  lstr.Pack(this->BlockBounds);
+  lstr.Pack(this->BlockArrayRange);
+  lstr.Pack(this->BlockLevel);
+  lstr.Pack(this->BlocksPerLevel);
+
+  int lsize = lstr.Size();
+
+  std::vector<int> gsizes(nRanks);
+  if (rootRank < 0)
+    MPI_Allgather(&lsize, 1, MPI_INT, gsizes.data(), 1, MPI_INT, comm);
+  else
+    MPI_Gather(&lsize, 1, MPI_INT, gsizes.data(), 1, MPI_INT, rootRank, comm);
+
+  std::vector<int> goffsets(nRanks);
+  int gsize = 0;
+  for (int i = 0; i < nRanks; ++i)
+    {
+    goffsets[i] = gsize;
+    gsize += gsizes[i];
+    }
+
+  BinaryStream gstr;
+  if ((rootRank < 0) || (rank == rootRank))
+    gstr.Resize(gsize);
+
+  if (rootRank < 0)
+    {
+    MPI_Allgatherv(lstr.GetData(), lsize, MPI_BYTE, gstr.GetData(),
+      gsizes.data(), goffsets.data(), MPI_BYTE, comm);
+    }
+  else
     {
-    MPIUtils::GlobalViewV(comm, this->BlockOwner);
-    MPIUtils::GlobalViewV(comm, this->BlockIds);
-    MPIUtils::GlobalViewV(comm, this->NumBlocksLocal);
-    MPIUtils::GlobalViewV(comm, this->BlockNumPoints);
-    MPIUtils::GlobalViewV(comm, this->BlockNumCells);
-    MPIUtils::GlobalViewV(comm, this->BlockCellArraySize);
-    MPIUtils::GlobalViewV(comm, this->BlockExtents);
-    MPIUtils::GlobalViewV(comm, this->BlockBounds);
-    MPIUtils::GlobalViewV(comm, this->BlockArrayRange);
-    MPIUtils::GlobalViewV(comm, this->BlockLevel);
-
-    MPIUtils::GlobalCounts(comm, this->BlocksPerLevel);
-
-    STLUtils::ReduceRange(this->BlockBounds, this->Bounds);
-    STLUtils::ReduceRange(this->BlockExtents, this->Extent);
-    STLUtils::ReduceRange(this->BlockArrayRange, this->ArrayRange);
-
-    this->NumBlocks = STLUtils::Sum(this->NumBlocksLocal);
-    this->NumPoints = STLUtils::Sum(this->BlockNumPoints);
-    this->NumCells = STLUtils::Sum(this->BlockNumCells);
-    this->CellArraySize = STLUtils::Sum(this->BlockCellArraySize);
-
-    this->GlobalView = true;
+    MPI_Gatherv(lstr.GetData(), lsize, MPI_BYTE, gstr.GetData(),
+      gsizes.data(), goffsets.data(), MPI_BYTE, rootRank, comm);
+
+    // the other ranks keep their local view
+    if (rank != rootRank)
+      return 0;
     }
 
+  // deserialize, appending each rank's blocks in rank order
+  std::vector<int> blocksPerLevel(std::move(this->BlocksPerLevel));
+  blocksPerLevel.clear();
+
+  this->BlockOwner.clear();
+  this->BlockIds.clear();
+  this->NumBlocksLocal.clear();
+  this->BlockNumPoints.clear();
+  this->BlockNumCells.clear();
+  this->BlockCellArraySize.clear();
+  this->BlockExtents.clear();
+  this->BlockBounds.clear();
+  this->BlockArrayRange.clear();
+  this->BlockLevel.clear();
+
+  MeshMetadataPtr rmd = MeshMetadata::New();
+  for (int i = 0; i < nRanks; ++i)
+    {
+    gstr.SetReadPos(goffsets[i]);
+
+    gstr.Unpack(rmd->BlockOwner);
+    gstr.Unpack(rmd->BlockIds);
+    gstr.Unpack(rmd->NumBlocksLocal);
+    gstr.Unpack(rmd->BlockNumPoints);
+    gstr.Unpack(rmd->BlockNumCells);
+    gstr.Unpack(rmd->BlockCellArraySize);
+    gstr.Unpack(rmd->BlockExtents);
+    gstr.Unpack(rmd->BlockBounds);
+    gstr.Unpack(rmd->BlockArrayRange);
+    gstr.Unpack(rmd->BlockLevel);
+    gstr.Unpack(rmd->BlocksPerLevel);
+
+    STLUtils::Append(this->BlockOwner, rmd->BlockOwner);
+    STLUtils::Append(this->BlockIds, rmd->BlockIds);
+    STLUtils::Append(this->NumBlocksLocal, rmd->NumBlocksLocal);
+    STLUtils::Append(this->BlockNumPoints, rmd->BlockNumPoints);
+    STLUtils::Append(this->BlockNumCells, rmd->BlockNumCells);
+    STLUtils::Append(this->BlockCellArraySize, rmd->BlockCellArraySize);
+    STLUtils::Append(this->BlockExtents, rmd->BlockExtents);
+    STLUtils::Append(this->BlockBounds, rmd->BlockBounds);
+    STLUtils::Append(this->BlockArrayRange, rmd->BlockArrayRange);
+    STLUtils::Append(this->BlockLevel, rmd->BlockLevel);
+
+    // the number of blocks in each level is summed
+    unsigned int nLevels = rmd->BlocksPerLevel.size();
+    if (blocksPerLevel.size() < nLevels)
+      blocksPerLevel.resize(nLevels, 0);
+
+    for (unsigned int j = 0; j < nLevels; ++j)
+      blocksPerLevel[j] += rmd->BlocksPerLevel[j];
+    }
+
+  this->BlocksPerLevel = std::move(blocksPerLevel);
+
+  STLUtils::ReduceRange(this->BlockBounds, this->Bounds);
+  STLUtils::ReduceRange(this->BlockExtents, this->Extent);
+  STLUtils::ReduceRange(this->BlockArrayRange, this->ArrayRange);
+
+  this->NumBlocks = STLUtils::Sum(this->NumBlocksLocal);
+  this->NumPoints = STLUtils::Sum(this->BlockNumPoints);
+  this->NumCells = STLUtils::Sum(this->BlockNumCells);
+  this->CellArraySize = STLUtils::Sum(this->BlockCellArraySize);
+
+  this->GlobalView = true;
+
   return 0;
 }
 
@@ -156,6 +156,12 @@ struct SENSEI_EXPORT MeshMetadata
    */
   int GlobalizeView(MPI_Comm);
 
+  /** construct a global view of the metadata on rootRank only. the other
+   * ranks keep their local view. when rootRank is negative all ranks get the
+   * global view. return 0 if successful. this call uses MPI collectives
+   */
+  int GlobalizeView(MPI_Comm, int rootRank);
+
   /** removes all block level information from the instance. initialize
    * the related dataset level information.
    */
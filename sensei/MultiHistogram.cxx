@@ -0,0 +1,1285 @@
+#include "MultiHistogram.h"
+#include "DataAdaptor.h"
+#include "MeshMetadata.h"
+#include "MeshMetadataMap.h"
+#include "MemoryUtils.h"
+#include "Profiler.h"
+#include "SVTKUtils.h"
+#include "Error.h"
+
+#include <svtkAOSDataArrayTemplate.h>
+#include <svtkSOADataArrayTemplate.h>
+#include <svtkCompositeDataIterator.h>
+#include <svtkCompositeDataSet.h>
+#include <svtkDataObject.h>
+#include <svtkDataSetAttributes.h>
+#include <svtkObjectFactory.h>
+#include <svtkSmartPointer.h>
+#include <svtkUnsignedCharArray.h>
+
+#include <algorithm>
+#include <unordered_map>
+#include <memory>
+#include <vector>
+#include <thread>
+#include <limits>
+#include <iomanip>
+#include <cmath>
+#include <cerrno>
+#include <cstring>
+#include <cstdio>
+
+namespace
+{
+using BinMap = std::unordered_map<unsigned long long, double>;
+
+// the number of values each thread bins at a time
+constexpr size_t ChunkSize = 2048;
+
+// the bytes the bins of a rank may use before sparse storage is used
+constexpr unsigned long long DenseLimit = 64ull*1024ull*1024ull;
+
+// the largest number of values sent in a single MPI call
+constexpr unsigned long long MaxMessageSize = 1ull << 26;
+
+// the state of a value during binning
+enum {VALUE_IN_RANGE = 0, VALUE_OUT_OF_RANGE = 1, VALUE_GHOST = 2};
+
+// message tags used in the sparse reduction
+enum {TAG_SIZE = 7100, TAG_INDEX = 7101, TAG_COUNT = 7102};
+
+/// a component of an array, in CPU accessible memory
+struct Column
+{
+  Column() : Array(nullptr), ArrayComponent(0), Type(0),
+    NumberOfComponents(1), Component(0) {}
+
+  svtkDataArray *Array;
+  int ArrayComponent;
+  std::shared_ptr<void> Data;
+  int Type;
+  int NumberOfComponents;
+  int Component;
+};
+
+/// the columns of a block of data that are binned
+struct Block
+{
+  Block() : NumberOfValues(0), GhostArray(nullptr) {}
+
+  size_t NumberOfValues;
+  std::vector<Column> Columns;
+  Column Weights;
+  svtkUnsignedCharArray *GhostArray;
+  std::shared_ptr<unsigned char> Ghosts;
+};
+
+// **************************************************************************
+int GetColumn(svtkDataArray *da, int comp, Column &col)
+{
+  size_t nVals = da->GetNumberOfTuples();
+  int nComps = da->GetNumberOfComponents();
+
+  switch (da->GetDataType())
+    {
+    svtkTemplateMacro(
+      using AOS_ARRAY_TT = svtkAOSDataArrayTemplate<SVTK_TT>;
+      using SOA_ARRAY_TT = svtkSOADataArrayTemplate<SVTK_TT>;
+
+      AOS_ARRAY_TT *aosDa = nullptr;
+      SOA_ARRAY_TT *soaDa = nullptr;
+
+      col.Array = da;
+      col.ArrayComponent = comp;
+      col.Type = da->GetDataType();
+
+      if ((aosDa = dynamic_cast<AOS_ARRAY_TT*>(da)))
+        {
+        // components are interleaved
+        col.Data = sensei::MemoryUtils::MakeCpuAccessible(
+          aosDa->GetPointer(0), nVals*nComps);
+        col.NumberOfComponents = nComps;
+        col.Component = comp;
+        }
+      else if ((soaDa = dynamic_cast<SOA_ARRAY_TT*>(da)))
+        {
+        // each component is stored contiguously
+        col.Data = sensei::MemoryUtils::MakeCpuAccessible(
+          soaDa->GetComponentArrayPointer(comp), nVals);
+        col.NumberOfComponents = 1;
+        col.Component = 0;
+        }
+      else
+        {
+        SENSEI_ERROR("Invalid svtkDataArray " << da->GetClassName())
+        return -1;
+        }
+
+      return 0;
+      );
+    }
+
+  SENSEI_ERROR("Unsupported array type " << da->GetDataTypeAsString())
+  return -1;
+}
+
+/** Bins the values of one dimension. The flat bin index of each value is
+ * accumulated in index, and the values that are out of range are flagged in
+ * state. NaN is out of range.
+ *
+ * @param[in] data      the values, nComps components per tuple
+ * @param[in] nComps    the number of components
+ * @param[in] comp      the component to bin
+ * @param[in] start     the first tuple to bin
+ * @param[in] nVals     the number of tuples to bin
+ * @param[in] minVal    the minimum bin value
+ * @param[in] maxVal    the maximum bin value
+ * @param[in] width     the bin width
+ * @param[in] nBins     the number of bins of this dimension
+ * @param[in] stride    the distance between the bins of this dimension in
+ *                      the flat index
+ * @param[in,out] index the flat bin index of each value
+ * @param[in,out] state VALUE_OUT_OF_RANGE is or'd in for values out of range
+ */
+template <typename data_t>
+void bin_dimension(const data_t *data, int nComps, int comp, size_t start,
+  size_t nVals, double minVal, double maxVal, double width,
+  unsigned long long nBins, unsigned long long stride,
+  unsigned long long *index, unsigned char *state)
+{
+  const data_t *pData = data + start*nComps + comp;
+  unsigned long long lastBin = nBins - 1;
+
+  for (size_t i = 0; i < nVals; ++i)
+    {
+    double val = pData[i*nComps];
+    bool inRange = (val >= minVal) && (val <= maxVal);
+
+    // the maximum value goes in the last bin
+    unsigned long long bin = inRange ?
+      std::min(lastBin, (unsigned long long)((val - minVal) / width)) : 0;
+
+    index[i] += bin*stride;
+    state[i] |= inRange ? VALUE_IN_RANGE : VALUE_OUT_OF_RANGE;
+    }
+}
+
+/// converts nVals values starting at start to double
+template <typename data_t>
+void get_weights(const data_t *data, size_t start, size_t nVals,
+  double *weights)
+{
+  const data_t *pData = data + start;
+  for (size_t i = 0; i < nVals; ++i)
+    weights[i] = pData[i];
+}
+
+/// merges two lists of occupied bins sorted by index
+void merge_sparse(const std::vector<unsigned long long> &indexA,
+  const std::vector<double> &countA, const std::vector<unsigned long long> &indexB,
+  const std::vector<double> &countB, std::vector<unsigned long long> &index,
+  std::vector<double> &count)
+{
+  size_t nA = indexA.size();
+  size_t nB = indexB.size();
+
+  index.clear();
+  count.clear();
+  index.reserve(nA + nB);
+  count.reserve(nA + nB);
+
+  size_t a = 0;
+  size_t b = 0;
+  while ((a < nA) || (b < nB))
+    {
+    if ((b == nB) || ((a < nA) && (indexA[a] < indexB[b])))
+      {
+      index.push_back(indexA[a]);
+      count.push_back(countA[a]);
+      ++a;
+      }
+    else if ((a == nA) || (indexB[b] < indexA[a]))
+      {
+      index.push_back(indexB[b]);
+      count.push_back(countB[b]);
+      ++b;
+      }
+    else
+      {
+      index.push_back(indexA[a]);
+      count.push_back(countA[a] + countB[b]);
+      ++a;
+      ++b;
+      }
+    }
+}
+
+/// invokes op(i) for i in [0, nThreads) on nThreads threads
+template <typename op_t>
+void parallel_for(int nThreads, const op_t &op)
+{
+  std::vector<std::thread> threads;
+  threads.reserve(nThreads - 1);
+
+  for (int i = 1; i < nThreads; ++i)
+    threads.emplace_back(op, i);
+
+  // the calling thread does its share of the work
+  op(0);
+
+  for (std::thread &thread : threads)
+    thread.join();
+}
+
+/// get the slice [start, end) of nVals values processed by thread i
+void partition(size_t nVals, int nThreads, int thread, size_t &start, size_t &end)
+{
+  size_t i = thread;
+  size_t blockSize = nVals / nThreads;
+  size_t nLarge = nVals % nThreads;
+  start = i*blockSize + (i < nLarge ? i : nLarge);
+  end = start + blockSize + (i < nLarge ? 1 : 0);
+}
+
+// **************************************************************************
+int Write(const std::string &fileName, int step, double time,
+  const std::string &meshName, const std::vector<std::string> &dimNames,
+  sensei::MultiHistogram::Data &result)
+{
+  // write the histogram to a file
+  char fname[1024] = {'\0'};
+
+  snprintf(fname, 1024, "%s_%s_%d.txt", fileName.c_str(),
+    meshName.c_str(), step);
+
+  FILE *file = fopen(fname, "w");
+  if (!file)
+    {
+    char *estr = strerror(errno);
+    SENSEI_ERROR("Failed to open \"" << fname << "\"" << std::endl << estr)
+    return -1;
+    }
+
+  size_t nDims = result.NumberOfBins.size();
+
+  fprintf(file, "step : %d\n", step);
+  fprintf(file, "time : %0.6g\n", time);
+  fprintf(file, "num dims : %zu\n", nDims);
+  for (size_t i = 0; i < nDims; ++i)
+    {
+    fprintf(file, "dim %zu : %s num bins %d range %0.6g %0.6g\n", i,
+      dimNames[i].c_str(), result.NumberOfBins[i], result.BinMin[i],
+      result.BinMax[i]);
+    }
+  fprintf(file, "out of range : %0.6g\n", result.OutOfRange);
+  fprintf(file, "occupied bins : %zu\n", result.Index.size());
+
+  // each occupied bin, its index in each dimension then its count
+  size_t nOccupied = result.Index.size();
+  for (size_t i = 0; i < nOccupied; ++i)
+    {
+    unsigned long long index = result.Index[i];
+    for (size_t j = 0; j < nDims; ++j)
+      {
+      fprintf(file, "%llu ", index % result.NumberOfBins[j]);
+      index /= result.NumberOfBins[j];
+      }
+    fprintf(file, ": %0.6g\n", result.Count[i]);
+    }
+
+  fclose(file);
+
+  return 0;
+}
+
+// **************************************************************************
+int Write(int step, double time, const std::string &meshName,
+  const std::vector<std::string> &dimNames, sensei::MultiHistogram::Data &result)
+{
+  // write the histogram to std::cout
+  int origPrec = std::cout.precision();
+  std::cout.precision(4);
+
+  size_t nDims = result.NumberOfBins.size();
+
+  std::cout << "Histogram mesh \"" << meshName << "\" data arrays";
+  for (size_t i = 0; i < nDims; ++i)
+    std::cout << " \"" << dimNames[i] << "\"";
+  std::cout << " step " << step << " time " << time << std::endl;
+
+  // each occupied bin, its extent in each dimension then its count
+  size_t nOccupied = result.Index.size();
+  for (size_t i = 0; i < nOccupied; ++i)
+    {
+    unsigned long long index = result.Index[i];
+    for (size_t j = 0; j < nDims; ++j)
+      {
+      unsigned long long bin = index % result.NumberOfBins[j];
+      index /= result.NumberOfBins[j];
+
+      const int wid = 11;
+      std::cout << (j ? " x " : "") << std::scientific << "[" << std::setw(wid)
+        << std::right << result.BinMin[j] + bin*result.BinWidth[j] << " - "
+        << std::setw(wid) << std::left << result.BinMin[j] + (bin+1)*result.BinWidth[j]
+        << "]";
+      }
+    std::cout << " : " << std::defaultfloat << result.Count[i] << std::endl;
+    }
+
+  std::cout << "out of range : " << result.OutOfRange << std::endl;
+
+  std::cout.precision(origPrec);
+
+  return 0;
+}
+}
+
+namespace sensei
+{
+struct MultiHistogram::InternalsType
+{
+  // the blocks of data gathered for this step
+  std::vector<Block> Blocks;
+
+  // per thread bins and scratch space. these are kept from one step to
+  // the next. only one of ThreadBins or ThreadMaps is used in a given step
+  std::vector<std::vector<double>> ThreadBins;
+  std::vector<BinMap> ThreadMaps;
+  std::vector<double> ThreadOutOfRange;
+};
+
+//-----------------------------------------------------------------------------
+senseiNewMacro(MultiHistogram);
+
+//-----------------------------------------------------------------------------
+MultiHistogram::MultiHistogram() :
+  Association(svtkDataObject::FIELD_ASSOCIATION_POINTS),
+  Storage(STORAGE_AUTO), NumberOfThreads(0),
+  Internals(new MultiHistogram::InternalsType)
+{
+}
+
+//-----------------------------------------------------------------------------
+MultiHistogram::~MultiHistogram()
+{
+  delete this->Internals;
+}
+
+//-----------------------------------------------------------------------------
+int MultiHistogram::Initialize(const std::string &meshName, int association,
+  const std::vector<std::string> &arrayNames, const std::vector<int> &bins,
+  const std::string &fileName)
+{
+  if (arrayNames.empty())
+    {
+    SENSEI_ERROR("No arrays were specified")
+    return -1;
+    }
+
+  if (bins.empty() || ((bins.size() > 1) && (arrayNames.size() > 1) &&
+    (bins.size() != arrayNames.size())))
+    {
+    SENSEI_ERROR(<< bins.size() << " bin counts were given for "
+      << arrayNames.size() << " arrays")
+    return -1;
+    }
+
+  for (int nBins : bins)
+    {
+    if (nBins < 1)
+      {
+      SENSEI_ERROR("Invalid number of bins " << nBins)
+      return -1;
+      }
+    }
+
+  this->MeshName = meshName;
+  this->Association = association;
+  this->ArrayNames = arrayNames;
+  this->NumberOfBins = bins;
+  this->FileName = fileName;
+
+  return 0;
+}
+
+//-----------------------------------------------------------------------------
+void MultiHistogram::SetWeightArrayName(const std::string &name)
+{
+  this->WeightArrayName = name;
+}
+
+//-----------------------------------------------------------------------------
+int MultiHistogram::SetRange(int dim, double min, double max)
+{
+  if (dim < 0)
+    {
+    SENSEI_ERROR("Invalid dimension " << dim)
+    return -1;
+    }
+
+  if (!(max > min) || !std::isfinite(max - min))
+    {
+    SENSEI_ERROR("Invalid range [" << min << ", " << max << "]")
+    return -1;
+    }
+
+  if (this->FixedRange.size() <= size_t(dim))
+    {
+    this->FixedRange.resize(dim + 1, 0);
+    this->RangeMin.resize(dim + 1, 0.0);
+    this->RangeMax.resize(dim + 1, 1.0);
+    }
+
+  this->FixedRange[dim] = 1;
+  this->RangeMin[dim] = min;
+  this->RangeMax[dim] = max;
+
+  return 0;
+}
+
+//-----------------------------------------------------------------------------
+int MultiHistogram::SetRange(const std::string &range)
+{
+  this->FixedRange.clear();
+  this->RangeMin.clear();
+  this->RangeMax.clear();
+
+  int dim = 0;
+  size_t pos = 0;
+  while (pos <= range.size())
+    {
+    size_t next = range.find(';', pos);
+    if (next == std::string::npos)
+      next = range.size();
+
+    std::string entry = range.substr(pos, next - pos);
+
+    double min = 0.0;
+    double max = 0.0;
+    char extra = '\0';
+    char word[8] = {'\0'};
+    if ((sscanf(entry.c_str(), " %7s %c", word, &extra) == 1) &&
+      (strcmp(word, "auto") == 0))
+      {
+      // the range of this dimension is computed from the data
+      this->FixedRange.resize(dim + 1, 0);
+      this->RangeMin.resize(dim + 1, 0.0);
+      this->RangeMax.resize(dim + 1, 1.0);
+      }
+    else if ((sscanf(entry.c_str(), " %lf , %lf %c", &min, &max, &extra) != 2) ||
+      this->SetRange(dim, min, max))
+      {
+      SENSEI_ERROR("Invalid range \"" << range << "\". Use a semicolon "
+        "separated list of \"auto\" or \"min,max\", one for each dimension")
+      return -1;
+      }
+
+    pos = next + 1;
+    ++dim;
+    }
+
+  return 0;
+}
+
+//-----------------------------------------------------------------------------
+int MultiHistogram::SetStorage(int mode)
+{
+  if ((mode != STORAGE_AUTO) && (mode != STORAGE_DENSE) && (mode != STORAGE_SPARSE))
+    {
+    SENSEI_ERROR("Invalid storage mode " << mode)
+    return -1;
+    }
+
+  this->Storage = mode;
+  return 0;
+}
+
+//-----------------------------------------------------------------------------
+int MultiHistogram::SetStorage(const std::string &mode)
+{
+  if (mode == "auto")
+    return this->SetStorage(STORAGE_AUTO);
+  else if (mode == "dense")
+    return this->SetStorage(STORAGE_DENSE);
+  else if (mode == "sparse")
+    return this->SetStorage(STORAGE_SPARSE);
+
+  SENSEI_ERROR("Invalid storage mode \"" << mode
+    << "\". Use one of \"auto\", \"dense\", or \"sparse\"")
+  return -1;
+}
+
+//-----------------------------------------------------------------------------
+void MultiHistogram::SetNumberOfThreads(int nThreads)
+{
+  this->NumberOfThreads = nThreads;
+}
+
+//-----------------------------------------------------------------------------
+const char *MultiHistogram::GetGhostArrayName()
+{
+    return "svtkGhostType";
+}
+
+//-----------------------------------------------------------------------------
+svtkDataArray* MultiHistogram::GetArray(svtkDataObject* dobj,
+  const std::string& arrayname)
+{
+  if (svtkFieldData* fd = dobj->GetAttributesAsFieldData(this->Association))
+    {
+    return fd->GetArray(arrayname.c_str());
+    }
+  return nullptr;
+}
+
+//-----------------------------------------------------------------------------
+bool MultiHistogram::Execute(DataAdaptor* data, DataAdaptor** dataOut)
+{
+  TimeEvent<128> mark("MultiHistogram::Execute");
+
+  // we do not return anything
+  if (dataOut)
+    {
+    *dataOut = nullptr;
+    }
+
+  // see what the simulation is providing
+  MeshMetadataMap mdMap;
+  if (mdMap.Initialize(data))
+    {
+    SENSEI_ERROR("Failed to get metadata")
+    return false;
+    }
+
+  // get the mesh metadata object
+  MeshMetadataPtr mmd;
+  if (mdMap.GetMeshMetadata(this->MeshName, mmd))
+    {
+    SENSEI_ERROR("Failed to get metadata for mesh \"" << this->MeshName << "\"")
+    return false;
+    }
+
+  // get the mesh object
+  svtkDataObject *dobj = nullptr;
+  if (data->GetMesh(this->MeshName, true, dobj))
+    {
+    SENSEI_ERROR("Failed to get mesh \"" << this->MeshName << "\"")
+    return false;
+    }
+
+  int rank = 0;
+  MPI_Comm comm = this->GetCommunicator();
+  MPI_Comm_rank(comm, &rank);
+
+  // the cores of a node are shared by the ranks running on it
+  if (this->NumberOfThreads < 1)
+    {
+    MPI_Comm nodeComm = MPI_COMM_NULL;
+    MPI_Comm_split_type(comm, MPI_COMM_TYPE_SHARED, 0, MPI_INFO_NULL, &nodeComm);
+
+    int nNodeRanks = 1;
+    MPI_Comm_size(nodeComm, &nNodeRanks);
+    MPI_Comm_free(&nodeComm);
+
+    this->NumberOfThreads = std::max(1u,
+      std::thread::hardware_concurrency() / nNodeRanks);
+    }
+
+  // get the current time and step
+  int step = data->GetDataTimeStep();
+  double time = data->GetDataTime();
+
+  // the arrays to fetch
+  std::vector<std::string> arrayNames = this->ArrayNames;
+  if (!this->WeightArrayName.empty())
+    arrayNames.push_back(this->WeightArrayName);
+
+  this->Internals->Blocks.clear();
+
+  int nDims = 0;
+  if (dobj)
+    {
+    // fetch the arrays that the histogram will be computed on
+    for (const std::string &arrayName : arrayNames)
+      {
+      if (data->AddArray(dobj, this->MeshName, this->Association, arrayName))
+        {
+        SENSEI_ERROR(<< data->GetClassName() << " failed to add "
+          << (this->Association == svtkDataObject::POINT ? "point" : "cell")
+          << " data array \""  << arrayName << "\"")
+
+        // abort to avoid deadlocks in collective calls
+        MPI_Abort(comm, -1);
+        return false;
+        }
+      }
+
+    // add the ghost zones
+    if ((mmd->NumGhostCells || SVTKUtils::AMR(mmd)) &&
+      data->AddGhostCellsArray(dobj, this->MeshName))
+      {
+      SENSEI_ERROR(<< data->GetClassName() << " failed to add ghost cells.")
+      // abort to avoid deadlocks in collective calls
+      MPI_Abort(comm, -1);
+      return false;
+      }
+
+    if (mmd->NumGhostNodes && data->AddGhostNodesArray(dobj, this->MeshName))
+      {
+      SENSEI_ERROR(<< data->GetClassName() << " failed to add ghost nodes.")
+      // abort to avoid deadlocks in collective calls
+      MPI_Abort(comm, -1);
+      return false;
+      }
+
+    // gather the columns of each block
+    svtkCompositeDataSetPtr mesh = SVTKUtils::AsCompositeData(comm, dobj, true);
+    svtkSmartPointer<svtkCompositeDataIterator> iter;
+    iter.TakeReference(mesh->NewIterator());
+    for (iter->InitTraversal(); !iter->IsDoneWithTraversal(); iter->GoToNextItem())
+      {
+      svtkDataObject *curObj = iter->GetCurrentDataObject();
+
+      // get the arrays to compute the histogram of
+      std::vector<svtkDataArray*> arrays;
+      for (const std::string &arrayName : arrayNames)
+        {
+        svtkDataArray *array = this->GetArray(curObj, arrayName);
+        if (!array)
+          {
+          SENSEI_WARNING("Data block " << iter->GetCurrentFlatIndex()
+            << " of mesh \"" << this->MeshName << " has no array named \""
+            << arrayName << "\"")
+          break;
+          }
+        arrays.push_back(array);
+        }
+
+      if (arrays.size() != arrayNames.size())
+        continue;
+
+      Block block;
+      block.NumberOfValues = arrays[0]->GetNumberOfTuples();
+
+      // a single vector array has a dimension per component, otherwise each
+      // array is a dimension
+      size_t nArrays = this->ArrayNames.size();
+      for (size_t i = 0; i < nArrays; ++i)
+        {
+        int nComps = arrays[i]->GetNumberOfComponents();
+        if ((nArrays > 1) && (nComps != 1))
+          {
+          SENSEI_ERROR("Array \"" << this->ArrayNames[i] << "\" has "
+            << nComps << " components. When more than one array is binned"
+            " each must have a single component")
+          MPI_Abort(comm, -1);
+          return false;
+          }
+
+        if (size_t(arrays[i]->GetNumberOfTuples()) != block.NumberOfValues)
+          {
+          SENSEI_ERROR("Array \"" << this->ArrayNames[i] << "\" has "
+            << arrays[i]->GetNumberOfTuples() << " values, expected "
+            << block.NumberOfValues)
+          MPI_Abort(comm, -1);
+          return false;
+          }
+
+        for (int j = 0; j < nComps; ++j)
+          {
+          Column col;
+          if (GetColumn(arrays[i], j, col))
+            {
+            SENSEI_ERROR("Failed to get array \"" << this->ArrayNames[i] << "\"")
+            MPI_Abort(comm, -1);
+            return false;
+            }
+          block.Columns.push_back(col);
+          }
+        }
+
+      // the weights
+      if (!this->WeightArrayName.empty())
+        {
+        svtkDataArray *weights = arrays.back();
+        if ((weights->GetNumberOfComponents() != 1) ||
+          (size_t(weights->GetNumberOfTuples()) != block.NumberOfValues) ||
+          GetColumn(weights, 0, block.Weights))
+          {
+          SENSEI_ERROR("Invalid weight array \"" << this->WeightArrayName << "\"")
+          MPI_Abort(comm, -1);
+          return false;
+          }
+        }
+
+      // and the ghost zones
+      svtkUnsignedCharArray *ghostArray = dynamic_cast<svtkUnsignedCharArray*>(
+        this->GetArray(curObj, this->GetGhostArrayName()));
+
+      block.GhostArray = ghostArray;
+      if (ghostArray)
+        {
+        block.Ghosts = MemoryUtils::MakeCpuAccessible(
+          ghostArray->GetPointer(0), block.NumberOfValues);
+        }
+
+      int blockDims = block.Columns.size();
+      if (nDims && (blockDims != nDims))
+        {
+        SENSEI_ERROR("Data block " << iter->GetCurrentFlatIndex() << " has "
+          << blockDims << " dimensions, expected " << nDims)
+        MPI_Abort(comm, -1);
+        return false;
+        }
+      nDims = blockDims;
+
+      this->Internals->Blocks.push_back(block);
+      }
+    }
+
+  // ranks without data do not know the number of dimensions
+  int maxDims = 0;
+  MPI_Allreduce(&nDims, &maxDims, 1, MPI_INT, MPI_MAX, comm);
+
+  if (nDims && (nDims != maxDims))
+    {
+    SENSEI_ERROR("The data has " << nDims << " dimensions on rank " << rank
+      << " and " << maxDims << " on another rank")
+    MPI_Abort(comm, -1);
+    return false;
+    }
+
+  if (maxDims == 0)
+    {
+    if (rank == 0)
+      {
+      SENSEI_WARNING("No data was found for the histogram of mesh \""
+        << this->MeshName << "\"")
+      }
+    this->Internals->Blocks.clear();
+    return true;
+    }
+
+  std::vector<std::string> dimNames;
+  if (this->ArrayNames.size() == 1)
+    {
+    for (int i = 0; i < maxDims; ++i)
+      dimNames.push_back(this->ArrayNames[0] + "[" + std::to_string(i) + "]");
+    }
+  else
+    {
+    dimNames = this->ArrayNames;
+    }
+
+  if (rank == 0)
+    {
+    std::string names;
+    for (int i = 0; i < maxDims; ++i)
+      names += (i ? " x \"" : "\"") + dimNames[i] + "\"";
+
+    SENSEI_STATUS("Step = " << step << " Time = " << time
+      << " Computing the " << maxDims << "-D histogram on mesh \""
+      << this->MeshName << "\" arrays " << names
+      << (this->WeightArrayName.empty() ? "" : " weighted by \"" +
+      this->WeightArrayName + "\"") << " using "
+      << this->NumberOfThreads << " CPU threads")
+    }
+
+  // compute the histogram. this is an MPI collective, all MPI ranks must
+  // participate. after this call returns MPI rank 0 holds the histogram
+  MultiHistogram::Data result;
+  if (this->ComputeHistogram(comm, maxDims, result))
+    {
+    SENSEI_ERROR("Failed to compute the histogram of mesh \""
+      << this->MeshName << "\"")
+    // abort to prevent deadlock in collective calls
+    MPI_Abort(comm, -1);
+    }
+
+  // release the references to the simulation's data
+  this->Internals->Blocks.clear();
+
+  this->LastResult = result;
+
+  // write the results if on MPI rank 0
+  if (rank == 0)
+    {
+    if (this->FileName.empty())
+      {
+      ::Write(step, time, this->MeshName, dimNames, result);
+      }
+    else
+      {
+      if (::Write(this->FileName, step, time, this->MeshName, dimNames, result))
+        {
+        SENSEI_ERROR("Failed to write histogram.")
+        return false;
+        }
+      }
+    }
+
+  return true;
+}
+
+//-----------------------------------------------------------------------------
+int MultiHistogram::ComputeHistogram(MPI_Comm comm, int nDims,
+  MultiHistogram::Data &result)
+{
+  TimeEvent<128> mark("MultiHistogram::ComputeHistogram");
+
+  int rank = 0;
+  MPI_Comm_rank(comm, &rank);
+
+  int nThreads = this->NumberOfThreads;
+  std::vector<Block> &blocks = this->Internals->Blocks;
+
+  // the number of bins of each dimension
+  if ((this->NumberOfBins.size() != 1) && (this->NumberOfBins.size() != size_t(nDims)))
+    {
+    SENSEI_ERROR(<< this->NumberOfBins.size() << " bin counts were given for "
+      << nDims << " dimensions")
+    return -1;
+    }
+
+  unsigned long long totalBins = 1;
+  std::vector<unsigned long long> strides(nDims);
+  result.NumberOfBins.resize(nDims);
+  for (int i = 0; i < nDims; ++i)
+    {
+    int nBins = this->NumberOfBins.size() == 1 ?
+      this->NumberOfBins[0] : this->NumberOfBins[i];
+
+    if (totalBins > std::numeric_limits<unsigned long long>::max() / nBins)
+      {
+      SENSEI_ERROR("Too many bins")
+      return -1;
+      }
+
+    result.NumberOfBins[i] = nBins;
+    strides[i] = totalBins;
+    totalBins *= nBins;
+    }
+
+  // the range of each dimension, a single range applies to all
+  size_t nRanges = this->FixedRange.size();
+  if ((nRanges > 1) && (nRanges != size_t(nDims)))
+    {
+    SENSEI_ERROR(<< nRanges << " ranges were given for " << nDims << " dimensions")
+    return -1;
+    }
+
+  std::vector<int> fixed(nDims, 0);
+  result.BinMin.assign(nDims, std::numeric_limits<double>::max());
+  result.BinMax.assign(nDims, std::numeric_limits<double>::lowest());
+  for (int i = 0; (i < nDims) && nRanges; ++i)
+    {
+    int j = nRanges == 1 ? 0 : i;
+    fixed[i] = this->FixedRange[j];
+    if (fixed[i])
+      {
+      result.BinMin[i] = this->RangeMin[j];
+      result.BinMax[i] = this->RangeMax[j];
+      }
+    }
+
+  // compute the range of the others from the data
+  if (std::find(fixed.begin(), fixed.end(), 0) != fixed.end())
+    {
+    TimeEvent<128> markRange("MultiHistogram::ComputeRange");
+
+    // the range of the valid values of each block is computed in parallel
+    // and cached on the array. negate the minimum so that a single reduction
+    // can be used
+    std::vector<double> range(2*nDims);
+    for (int i = 0; i < nDims; ++i)
+      {
+      range[2*i] = -std::numeric_limits<double>::max();
+      range[2*i + 1] = std::numeric_limits<double>::lowest();
+      }
+
+    for (Block &block : blocks)
+      {
+      for (int i = 0; i < nDims; ++i)
+        {
+        if (fixed[i])
+          continue;
+
+        Column &col = block.Columns[i];
+        double blockRange[2];
+        if (SVTKUtils::GetArrayRange(col.Array, block.GhostArray,
+          col.ArrayComponent, blockRange))
+          {
+          SENSEI_ERROR("Failed to compute the range of dimension " << i)
+          return -1;
+          }
+
+        range[2*i] = std::max(range[2*i], -blockRange[0]);
+        range[2*i + 1] = std::max(range[2*i + 1], blockRange[1]);
+        }
+      }
+
+    MPI_Allreduce(MPI_IN_PLACE, range.data(), 2*nDims, MPI_DOUBLE, MPI_MAX, comm);
+
+    for (int i = 0; i < nDims; ++i)
+      {
+      if (!fixed[i])
+        {
+        result.BinMin[i] = -range[2*i];
+        result.BinMax[i] = range[2*i + 1];
+        }
+      }
+    }
+
+  // the bin widths. a dimension with no valid values, or a single value, is
+  // given unit width
+  result.BinWidth.resize(nDims);
+  for (int i = 0; i < nDims; ++i)
+    {
+    if (result.BinMin[i] > result.BinMax[i])
+      {
+      result.BinMin[i] = 0.0;
+      result.BinMax[i] = result.NumberOfBins[i];
+      }
+    else if (result.BinMin[i] == result.BinMax[i])
+      {
+      result.BinMax[i] = result.BinMin[i] + result.NumberOfBins[i];
+      }
+
+    result.BinWidth[i] = (result.BinMax[i] - result.BinMin[i]) /
+      result.NumberOfBins[i];
+    }
+
+  // each thread bins its part of each block into private bins. these are
+  // stored densely unless they would use too much memory.
+  bool dense = (this->Storage == STORAGE_DENSE) ||
+    ((this->Storage == STORAGE_AUTO) &&
+    (totalBins <= DenseLimit / sizeof(double) / nThreads));
+
+  std::vector<std::vector<double>> &threadBins = this->Internals->ThreadBins;
+  std::vector<BinMap> &threadMaps = this->Internals->ThreadMaps;
+  std::vector<double> &threadOutOfRange = this->Internals->ThreadOutOfRange;
+
+  if (dense)
+    {
+    threadBins.resize(nThreads);
+    threadMaps.clear();
+    }
+  else
+    {
+    threadMaps.resize(nThreads);
+    threadBins.clear();
+    }
+
+  threadOutOfRange.assign(nThreads, 0.0);
+
+    {
+    TimeEvent<128> markBin("MultiHistogram::Bin");
+
+    parallel_for(nThreads, [&](int t)
+      {
+      unsigned long long index[ChunkSize];
+      unsigned char state[ChunkSize];
+      double weights[ChunkSize];
+
+      double *bins = nullptr;
+      BinMap *binMap = nullptr;
+      if (dense)
+        {
+        threadBins[t].assign(totalBins, 0.0);
+        bins = threadBins[t].data();
+        }
+      else
+        {
+        binMap = &threadMaps[t];
+        binMap->clear();
+        }
+
+      double outOfRange = 0.0;
+
+      for (Block &block : blocks)
+        {
+        size_t start = 0;
+        size_t end = 0;
+        partition(block.NumberOfValues, nThreads, t, start, end);
+
+        for (size_t chunk = start; chunk < end; chunk += ChunkSize)
+          {
+          size_t nVals = std::min(ChunkSize, end - chunk);
+
+          // ghost zones are skipped
+          memset(index, 0, nVals*sizeof(unsigned long long));
+
+          const unsigned char *ghosts = block.Ghosts.get();
+          if (ghosts)
+            {
+            for (size_t i = 0; i < nVals; ++i)
+              state[i] = ghosts[chunk + i] ? VALUE_GHOST : VALUE_IN_RANGE;
+            }
+          else
+            {
+            memset(state, VALUE_IN_RANGE, nVals);
+            }
+
+          // compute the flat bin index of each value one dimension at a time
+          for (int i = 0; i < nDims; ++i)
+            {
+            Column &col = block.Columns[i];
+            switch (col.Type)
+              {
+              svtkTemplateMacro(
+                bin_dimension(static_cast<const SVTK_TT*>(col.Data.get()),
+                  col.NumberOfComponents, col.Component, chunk, nVals,
+                  result.BinMin[i], result.BinMax[i], result.BinWidth[i],
+                  result.NumberOfBins[i], strides[i], index, state);
+                );
+              }
+            }
+
+          // get the weights
+          Column &col = block.Weights;
+          if (col.Data)
+            {
+            switch (col.Type)
+              {
+              svtkTemplateMacro(
+                get_weights(static_cast<const SVTK_TT*>(col.Data.get()),
+                  chunk, nVals, weights);
+                );
+              }
+            }
+          else
+            {
+            for (size_t i = 0; i < nVals; ++i)
+              weights[i] = 1.0;
+            }
+
+          // accumulate
+          for (size_t i = 0; i < nVals; ++i)
+            {
+            if (state[i] == VALUE_IN_RANGE)
+              {
+              if (dense)
+                bins[index[i]] += weights[i];
+              else
+                (*binMap)[index[i]] += weights[i];
+              }
+            else if (state[i] == VALUE_OUT_OF_RANGE)
+              {
+              outOfRange += weights[i];
+              }
+            }
+          }
+        }
+
+      threadOutOfRange[t] = outOfRange;
+      });
+    }
+
+  // merge the threads' bins, the result is left in the first thread's
+  // bins or in a list of the occupied bins sorted by index
+  std::vector<unsigned long long> index;
+  std::vector<double> count;
+  unsigned long long nOccupied = 0;
+
+  if (dense)
+    {
+    TimeEvent<128> markMerge("MultiHistogram::Merge");
+
+    std::vector<unsigned long long> threadOccupied(nThreads, 0);
+
+    parallel_for(nThreads, [&](int t)
+      {
+      size_t start = 0;
+      size_t end = 0;
+      partition(totalBins, nThreads, t, start, end);
+
+      double *bins = threadBins[0].data();
+      for (int j = 1; j < nThreads; ++j)
+        {
+        const double *tBins = threadBins[j].data();
+        for (size_t i = start; i < end; ++i)
+          bins[i] += tBins[i];
+        }
+
+      for (size_t i = start; i < end; ++i)
+        threadOccupied[t] += bins[i] != 0.0 ? 1 : 0;
+      });
+
+    for (int t = 0; t < nThreads; ++t)
+      nOccupied += threadOccupied[t];
+    }
+  else
+    {
+    TimeEvent<128> markMerge("MultiHistogram::Merge");
+
+    BinMap &binMap = threadMaps[0];
+    for (int j = 1; j < nThreads; ++j)
+      {
+      for (const auto &bin : threadMaps[j])
+        binMap[bin.first] += bin.second;
+      }
+
+    std::vector<std::pair<unsigned long long, double>> bins(binMap.begin(), binMap.end());
+    std::sort(bins.begin(), bins.end());
+
+    nOccupied = bins.size();
+    index.resize(nOccupied);
+    count.resize(nOccupied);
+    for (unsigned long long i = 0; i < nOccupied; ++i)
+      {
+      index[i] = bins[i].first;
+      count[i] = bins[i].second;
+      }
+    }
+
+  // when few bins are occupied only those are sent. every rank must make
+  // the same choice
+  unsigned long long occupancy[2] = {nOccupied, dense ? 0ull : 1ull};
+  MPI_Allreduce(MPI_IN_PLACE, occupancy, 2, MPI_UNSIGNED_LONG_LONG, MPI_MAX, comm);
+
+  bool sparseReduce = occupancy[1] ||
+    ((sizeof(unsigned long long) + sizeof(double))*occupancy[0] <
+    sizeof(double)*totalBins/2);
+
+  double outOfRange = 0.0;
+  for (int t = 0; t < nThreads; ++t)
+    outOfRange += threadOutOfRange[t];
+
+  TimeEvent<128> markReduce("MultiHistogram::Reduce");
+
+  MPI_Reduce(rank == 0 ? MPI_IN_PLACE : &outOfRange, &outOfRange, 1,
+    MPI_DOUBLE, MPI_SUM, 0, comm);
+
+  result.OutOfRange = outOfRange;
+
+  if (sparseReduce)
+    {
+    if (dense)
+      {
+      // list the occupied bins
+      const double *bins = threadBins[0].data();
+      index.reserve(nOccupied);
+      count.reserve(nOccupied);
+      for (unsigned long long i = 0; i < totalBins; ++i)
+        {
+        if (bins[i] != 0.0)
+          {
+          index.push_back(i);
+          count.push_back(bins[i]);
+          }
+        }
+      }
+
+    if (this->ReduceSparse(comm, index, count))
+      return -1;
+
+    if (rank == 0)
+      {
+      result.Index.swap(index);
+      result.Count.swap(count);
+      }
+    }
+  else
+    {
+    double *bins = threadBins[0].data();
+    for (unsigned long long i = 0; i < totalBins; i += MaxMessageSize)
+      {
+      int nVals = std::min(MaxMessageSize, totalBins - i);
+      MPI_Reduce(rank == 0 ? MPI_IN_PLACE : bins + i, bins + i, nVals,
+        MPI_DOUBLE, MPI_SUM, 0, comm);
+      }
+
+    if (rank == 0)
+      {
+      for (unsigned long long i = 0; i < totalBins; ++i)
+        {
+        if (bins[i] != 0.0)
+          {
+          result.Index.push_back(i);
+          result.Count.push_back(bins[i]);
+          }
+        }
+      }
+    }
+
+  return 0;
+}
+
+//-----------------------------------------------------------------------------
+int MultiHistogram::ReduceSparse(MPI_Comm comm,
+  std::vector<unsigned long long> &index, std::vector<double> &count)
+{
+  int rank = 0;
+  int nRanks = 1;
+  MPI_Comm_rank(comm, &rank);
+  MPI_Comm_size(comm, &nRanks);
+
+  std::vector<unsigned long long> inIndex;
+  std::vector<double> inCount;
+  std::vector<unsigned long long> outIndex;
+  std::vector<double> outCount;
+
+  // in each round ranks send to a partner and drop out, after the last
+  // round rank 0 holds the sum
+  for (int step = 1; step < nRanks; step *= 2)
+    {
+    if (rank % (2*step))
+      {
+      int dest = rank - step;
+      unsigned long long n = index.size();
+      MPI_Send(&n, 1, MPI_UNSIGNED_LONG_LONG, dest, TAG_SIZE, comm);
+
+      for (unsigned long long i = 0; i < n; i += MaxMessageSize)
+        {
+        int nVals = std::min(MaxMessageSize, n - i);
+        MPI_Send(index.data() + i, nVals, MPI_UNSIGNED_LONG_LONG, dest, TAG_INDEX, comm);
+        MPI_Send(count.data() + i, nVals, MPI_DOUBLE, dest, TAG_COUNT, comm);
+        }
+
+      index.clear();
+      count.clear();
+      break;
+      }
+    else if (rank + step < nRanks)
+      {
+      int src = rank + step;
+      unsigned long long n = 0;
+      MPI_Recv(&n, 1, MPI_UNSIGNED_LONG_LONG, src, TAG_SIZE, comm, MPI_STATUS_IGNORE);
+
+      inIndex.resize(n);
+      inCount.resize(n);
+      for (unsigned long long i = 0; i < n; i += MaxMessageSize)
+        {
+        int nVals = std::min(MaxMessageSize, n - i);
+        MPI_Recv(inIndex.data() + i, nVals, MPI_UNSIGNED_LONG_LONG, src,
+          TAG_INDEX, comm, MPI_STATUS_IGNORE);
+        MPI_Recv(inCount.data() + i, nVals, MPI_DOUBLE, src, TAG_COUNT,
+          comm, MPI_STATUS_IGNORE);
+        }
+
+      merge_sparse(index, count, inIndex, inCount, outIndex, outCount);
+      index.swap(outIndex);
+      count.swap(outCount);
+      }
+    }
+
+  return 0;
+}
+
+//-----------------------------------------------------------------------------
+int MultiHistogram::GetHistogram(MultiHistogram::Data &result)
+{
+  result = this->LastResult;
+  return 0;
+}
+
+//-----------------------------------------------------------------------------
+int MultiHistogram::Finalize()
+{
+  // release the buffers
+  delete this->Internals;
+  this->Internals = new MultiHistogram::InternalsType;
+  return 0;
+}
+
+}
@@ -0,0 +1,138 @@
+#ifndef MultiHistogram_h
+#define MultiHistogram_h
+
+#include "AnalysisAdaptor.h"
+
+#include <mpi.h>
+#include <vector>
+#include <string>
+
+class svtkDataObject;
+class svtkDataArray;
+
+namespace sensei
+{
+
+/** Computes a joint histogram of several arrays in parallel, for example the
+ * density against the temperature. Each array, or each component of a single
+ * vector array, is a dimension of the histogram. Optionally the values of a
+ * weight array are summed in the bins in place of counts.
+ *
+ * Each thread bins its part of the data into private bins, these are merged
+ * and then reduced across MPI ranks onto rank 0. The bins are stored densely
+ * unless there are too many of them, in which case only the occupied bins are
+ * stored. When few bins are occupied only those are sent in the reduction.
+ */
+class SENSEI_EXPORT MultiHistogram : public AnalysisAdaptor
+{
+public:
+  /// allocates a new instance
+  static MultiHistogram *New();
+
+  senseiTypeMacro(MultiHistogram, AnalysisAdaptor);
+
+  /** initialize for the run. When a single array is named and that array has
+   * more than one component, each component is a dimension. bins holds the
+   * number of bins of each dimension, or a single value used for all of them.
+   */
+  int Initialize(const std::string &meshName, int association,
+    const std::vector<std::string> &arrayNames, const std::vector<int> &bins,
+    const std::string &fileName);
+
+  /// Set the name of an array whose values are summed in place of counts
+  void SetWeightArrayName(const std::string &name);
+
+  /** Set the range of dimension dim. Values outside of the range are not
+   * binned, the total of these is reported separately. By default the range
+   * is computed from the data.
+   */
+  int SetRange(int dim, double min, double max);
+
+  /** Set the ranges from a string, a semicolon separated list with an entry
+   * of "auto" or "min,max" for each dimension. A single entry is used for all
+   * dimensions.
+   */
+  int SetRange(const std::string &range);
+
+  /// the ways the bins may be stored during the calculation
+  enum {STORAGE_AUTO = 0, STORAGE_DENSE = 1, STORAGE_SPARSE = 2};
+
+  /** Set how the bins are stored during the calculation. With STORAGE_AUTO,
+   * the default, the bins are stored densely unless the bins of all threads
+   * on a rank would need more than 64 MiB.
+   */
+  int SetStorage(int mode);
+
+  /// Set the storage from a string, one of "auto", "dense", or "sparse"
+  int SetStorage(const std::string &mode);
+
+  /** Set the number of threads used on each rank. By default the cores of a
+   * node are divided evenly between the MPI ranks running on it.
+   */
+  void SetNumberOfThreads(int nThreads);
+
+  /// compute the histogram for this time step
+  bool Execute(DataAdaptor* data, DataAdaptor**) override;
+
+  /// finalize the run
+  int Finalize() override;
+
+  /** the computed histogram may be accessed through the following data
+   * structure. Only the occupied bins are listed.
+   */
+  struct Data
+  {
+      Data() : OutOfRange(0.0) {}
+
+      std::vector<int> NumberOfBins; ///< The number of bins of each dimension
+      std::vector<double> BinMin;    ///< The left most bin edge of each dimension
+      std::vector<double> BinMax;    ///< The right most bin edge of each dimension
+      std::vector<double> BinWidth;  ///< The bin width of each dimension
+      std::vector<unsigned long long> Index; ///< The flat index of each occupied bin, the first dimension varies fastest
+      std::vector<double> Count;     ///< The count, or sum of weights, of each occupied bin
+      double OutOfRange;             ///< The count, or sum of weights, of values outside of the range
+  };
+
+  /** return the histogram computed by the most recent call to Execute, only
+   * valid on MPI rank 0
+   */
+  int GetHistogram(MultiHistogram::Data &data);
+
+protected:
+  MultiHistogram();
+  ~MultiHistogram();
+
+  MultiHistogram(const MultiHistogram&) = delete;
+  void operator=(const MultiHistogram&) = delete;
+
+  static const char *GetGhostArrayName();
+  svtkDataArray* GetArray(svtkDataObject* dobj, const std::string& arrayname);
+
+  // bin the data that was gathered for this step, this is an MPI collective
+  int ComputeHistogram(MPI_Comm comm, int nDims, MultiHistogram::Data &result);
+
+  // reduce the occupied bins onto rank 0 in a binomial tree
+  int ReduceSparse(MPI_Comm comm, std::vector<unsigned long long> &index,
+    std::vector<double> &count);
+
+  std::string MeshName;
+  int Association;
+  std::vector<std::string> ArrayNames;
+  std::vector<int> NumberOfBins;
+  std::string WeightArrayName;
+  std::vector<int> FixedRange;
+  std::vector<double> RangeMin;
+  std::vector<double> RangeMax;
+  int Storage;
+  int NumberOfThreads;
+  std::string FileName;
+  MultiHistogram::Data LastResult;
+
+private:
+  struct InternalsType;
+  InternalsType *Internals;
+};
+
+}
+
+#endif
@@ -0,0 +1,261 @@
+#include "NodeAwarePartitioner.h"
+#include "XMLUtils.h"
+#include "STLUtils.h"
+#include "Profiler.h"
+
+#include <pugixml.hpp>
+
+#include <algorithm>
+#include <map>
+#include <set>
+#include <sstream>
+#include <tuple>
+
+namespace sensei
+{
+using namespace STLUtils; // for operator<<
+
+namespace
+{
+// the load of a rank while blocks are assigned. the least loaded rank is
+// taken first, ties go to the rank with fewer blocks and then the lower rank
+// so that the result is the same on all ranks
+using RankLoad = std::tuple<double, int, int>;
+}
+
+// --------------------------------------------------------------------------
+int NodeAwarePartitioner::GetNodes(MPI_Comm comm, int nSenders,
+  std::vector<int> &receiverNodes, std::vector<int> &senderNodes)
+{
+  int rank = 0;
+  int nRanks = 1;
+  MPI_Comm_rank(comm, &rank);
+  MPI_Comm_size(comm, &nRanks);
+
+  // the receivers that share memory with this one. the node is identified
+  // by the lowest receiving rank on it
+  MPI_Comm nodeComm = MPI_COMM_NULL;
+  MPI_Comm_split_type(comm, MPI_COMM_TYPE_SHARED, rank, MPI_INFO_NULL, &nodeComm);
+
+  int node = rank;
+  MPI_Allreduce(&rank, &node, 1, MPI_INT, MPI_MIN, nodeComm);
+  MPI_Comm_free(&nodeComm);
+
+  receiverNodes.resize(nRanks);
+  MPI_Allgather(&node, 1, MPI_INT, receiverNodes.data(), 1, MPI_INT, comm);
+
+  senderNodes.assign(nSenders, -1);
+
+  if (!this->SenderHosts.empty())
+    {
+    if (this->SenderHosts.size() < unsigned(nSenders))
+      {
+      SENSEI_ERROR(<< nSenders << " ranks sent data but the host names of "
+        << this->SenderHosts.size() << " were provided")
+      return -1;
+      }
+
+    // the host name of each receiver
+    std::vector<char> host(MPI_MAX_PROCESSOR_NAME, '\0');
+    int len = 0;
+    MPI_Get_processor_name(host.data(), &len);
+
+    std::vector<char> hosts(nRanks*MPI_MAX_PROCESSOR_NAME);
+    MPI_Allgather(host.data(), MPI_MAX_PROCESSOR_NAME, MPI_CHAR,
+      hosts.data(), MPI_MAX_PROCESSOR_NAME, MPI_CHAR, comm);
+
+    std::map<std::string, int> hostNodes;
+    for (int j = 0; j < nRanks; ++j)
+      hostNodes.insert(std::make_pair(
+        std::string(hosts.data() + j*MPI_MAX_PROCESSOR_NAME), receiverNodes[j]));
+
+    for (int j = 0; j < nSenders; ++j)
+      {
+      std::map<std::string, int>::iterator it = hostNodes.find(this->SenderHosts[j]);
+      if (it != hostNodes.end())
+        senderNodes[j] = it->second;
+      }
+
+    return 0;
+    }
+
+  if (this->SenderRanksPerNode > 0)
+    {
+    // the senders are packed onto the receivers' nodes in rank order
+    std::set<int> nodeSet(receiverNodes.begin(), receiverNodes.end());
+    std::vector<int> nodes(nodeSet.begin(), nodeSet.end());
+
+    int nNodes = nodes.size();
+    for (int j = 0; j < nSenders; ++j)
+      {
+      int k = j / this->SenderRanksPerNode;
+      if (k < nNodes)
+        senderNodes[j] = nodes[k];
+      }
+
+    return 0;
+    }
+
+  SENSEI_ERROR("The NodeAwarePartitioner requires the host names of the"
+    " sending ranks or the number of sending ranks per node")
+  return -1;
+}
+
+// --------------------------------------------------------------------------
+int NodeAwarePartitioner::GetPartition(MPI_Comm comm, const MeshMetadataPtr &mdIn,
+  MeshMetadataPtr &mdOut)
+{
+  TimeEvent<128> mark("NodeAwarePartitioner::GetPartition");
+
+  mdOut = mdIn->NewCopy();
+
+  int nRanks = 1;
+  MPI_Comm_size(comm, &nRanks);
+
+  unsigned int nBlocks = mdOut->NumBlocks;
+
+  std::vector<double> costs;
+  if (this->GetBlockCosts(mdOut, costs))
+    return -1;
+
+  // the bytes moved, or the cost when the block sizes are not known
+  std::vector<double> bytes(costs);
+  if ((this->CostModel != COST_BYTES) &&
+    (mdOut->BlockNumCells.size() == nBlocks) &&
+    (mdOut->BlockNumPoints.size() == nBlocks) &&
+    this->GetBlockCosts(mdOut, COST_BYTES, bytes))
+    return -1;
+
+  // the layout of the senders and receivers
+  int nSenders = mdIn->NumBlocksLocal.size();
+  for (unsigned int i = 0; i < nBlocks; ++i)
+    nSenders = std::max(nSenders, mdIn->BlockOwner[i] + 1);
+
+  std::vector<int> receiverNodes;
+  std::vector<int> senderNodes;
+  if (this->GetNodes(comm, nSenders, receiverNodes, senderNodes))
+    return -1;
+
+  std::map<int, std::vector<int>> nodeRanks;
+  for (int j = 0; j < nRanks; ++j)
+    nodeRanks[receiverNodes[j]].push_back(j);
+
+  // the most a receiver may be given before blocks go off the node
+  double total = 0.0;
+  for (unsigned int i = 0; i < nBlocks; ++i)
+    total += costs[i];
+
+  double maxLoad = (1.0 + this->Tolerance)*total/nRanks;
+
+  // take the blocks in order of decreasing cost
+  std::vector<unsigned int> order(nBlocks);
+  for (unsigned int i = 0; i < nBlocks; ++i)
+    order[i] = i;
+
+  std::stable_sort(order.begin(), order.end(),
+    [&costs](unsigned int a, unsigned int b) { return costs[a] > costs[b]; });
+
+  std::vector<double> loads(nRanks, 0.0);
+  std::vector<int> counts(nRanks, 0);
+
+  std::set<RankLoad> ranks;
+  for (int j = 0; j < nRanks; ++j)
+    ranks.insert(RankLoad(0.0, 0, j));
+
+  mdOut->BlockOwner.resize(nBlocks);
+
+  double onNode = 0.0;
+  double moved = 0.0;
+
+  for (unsigned int k = 0; k < nBlocks; ++k)
+    {
+    unsigned int i = order[k];
+
+    int sender = mdIn->BlockOwner[i];
+    int node = (sender >= 0) && (sender < nSenders) ? senderNodes[sender] : -1;
+
+    // the least loaded receiver on the sender's node, if it has room
+    int rank = -1;
+    std::map<int, std::vector<int>>::iterator it = nodeRanks.find(node);
+    if (it != nodeRanks.end())
+      {
+      const std::vector<int> &local = it->second;
+
+      RankLoad best(loads[local[0]], counts[local[0]], local[0]);
+      unsigned int nLocal = local.size();
+      for (unsigned int q = 1; q < nLocal; ++q)
+        best = std::min(best, RankLoad(loads[local[q]], counts[local[q]], local[q]));
+
+      if (std::get<0>(best) + costs[i] <= maxLoad)
+        rank = std::get<2>(best);
+      }
+
+    // otherwise the least loaded receiver
+    if (rank < 0)
+      rank = std::get<2>(*ranks.begin());
+
+    ranks.erase(RankLoad(loads[rank], counts[rank], rank));
+    loads[rank] += costs[i];
+    counts[rank] += 1;
+    ranks.insert(RankLoad(loads[rank], counts[rank], rank));
+
+    mdOut->BlockOwner[i] = rank;
+
+    moved += bytes[i];
+    if (receiverNodes[rank] == node)
+      onNode += bytes[i];
+    }
+
+  this->OnNodeFraction = moved > 0.0 ? onNode/moved : 0.0;
+
+  Profiler::RecordValue("NodeAwarePartitioner::OnNode", this->OnNodeFraction);
+
+  this->UpdateImbalance(mdOut, costs, nRanks);
+
+  if (this->Verbose)
+    {
+    SENSEI_STATUS("NodeAwarePartitioner kept " << onNode << " of " << moved
+      << (this->CostModel == COST_BYTES ? " bytes" : "") << " on the node, "
+      << 100.0*this->OnNodeFraction << "%")
+    }
+
+  return 0;
+}
+
+// --------------------------------------------------------------------------
+int NodeAwarePartitioner::Initialize(pugi::xml_node &node)
+{
+  TimeEvent<128> mark("NodeAwarePartitioner::Initialize");
+
+  std::ostringstream oss;
+  if (this->InitializeCostModel(node, oss))
+    return -1;
+
+  this->Tolerance = node.attribute("tolerance").as_double(0.1);
+  this->SenderRanksPerNode = node.attribute("sender_ranks_per_node").as_int(0);
+
+  this->SenderHosts.clear();
+  pugi::xml_node hosts = node.child("sender_hosts");
+  if (hosts)
+    XMLUtils::ParseList(hosts.text().as_string(), this->SenderHosts);
+
+  if (this->SenderHosts.empty() && (this->SenderRanksPerNode < 1))
+    {
+    SENSEI_ERROR("The node_aware partitioner requires a sender_hosts element"
+      " or a sender_ranks_per_node attribute")
+    return -1;
+    }
+
+  oss << " tolerance=" << this->Tolerance;
+
+  if (this->SenderHosts.empty())
+    oss << " sender_ranks_per_node=" << this->SenderRanksPerNode;
+  else
+    oss << " sender_hosts=" << this->SenderHosts;
+
+  SENSEI_STATUS("Configured NodeAwarePartitioner " << oss.str())
+
+  return 0;
+}
+
+}
@@ -0,0 +1,105 @@
+#ifndef sensei_NodeAwarePartitioner_h
+#define sensei_NodeAwarePartitioner_h
+
+#include "WeightedPartitioner.h"
+
+#include <string>
+#include <vector>
+
+namespace sensei
+{
+
+class NodeAwarePartitioner;
+using NodeAwarePartitionerPtr = std::shared_ptr<sensei::NodeAwarePartitioner>;
+
+/// @class NodeAwarePartitioner
+/// The node aware partitioner prefers to give each block to a receiving
+/// rank on the node of the sending rank that owns it, so that when the
+/// simulation and end point share nodes the data moves through shared memory
+/// rather than across the network. Blocks are taken in order of decreasing
+/// cost. Each goes to the least loaded receiver on its sender's node, unless
+/// that would load the receiver beyond the mean load by more than the
+/// tolerance, in which case it goes to the least loaded receiver.
+///
+/// The receivers' nodes are found with MPI_Comm_split_type on the
+/// receivers' communicator, and their host names are exchanged. The senders
+/// are not part of that communicator, so their nodes are given either as
+/// the host name of each sending rank, or as the number of sending ranks per
+/// node, in which case the sending ranks are taken to be packed in rank
+/// order onto the receivers' nodes, ordered by their lowest receiving rank.
+/// Blocks of senders on nodes without receivers are balanced over all the
+/// receivers.
+///
+/// The fraction of the bytes kept on the node, or of the cost when the
+/// metadata lacks the block sizes, is recorded with Profiler::RecordValue as
+/// "NodeAwarePartitioner::OnNode", and the imbalance as
+/// "NodeAwarePartitioner::Imbalance". They are also returned by
+/// GetOnNodeFraction and GetImbalance.
+///
+/// XML attributes:
+///
+///   tolerance             -- the allowed load above the mean, as a fraction
+///                            of the mean. default: 0.1
+///   sender_ranks_per_node -- the number of sending ranks on each node
+///   cost                  -- cells, points, bytes, or weights. default: bytes
+///   arrays                -- comma separated names of the arrays counted by
+///                            the bytes cost. default: all arrays
+///   verbose               -- report the loads when non-zero. default: 0
+///
+/// The host names of the sending ranks may be given in a `sender_hosts`
+/// child element, and the weights in a `block_weights` child element.
+class SENSEI_EXPORT NodeAwarePartitioner : public sensei::WeightedPartitioner
+{
+public:
+  static sensei::NodeAwarePartitionerPtr New()
+  { return NodeAwarePartitionerPtr(new NodeAwarePartitioner); }
+
+  const char *GetClassName() override { return "NodeAwarePartitioner"; }
+
+  /// Set/get the allowed load above the mean, as a fraction of the mean
+  void SetTolerance(double tol) { this->Tolerance = tol; }
+  double GetTolerance() { return this->Tolerance; }
+
+  /// Set/get the host name of each sending rank
+  void SetSenderHosts(const std::vector<std::string> &hosts) { this->SenderHosts = hosts; }
+  void GetSenderHosts(std::vector<std::string> &hosts) { hosts = this->SenderHosts; }
+
+  /// Set/get the number of sending ranks on each node. This is used when
+  /// the sender host names are not set.
+  void SetSenderRanksPerNode(int n) { this->SenderRanksPerNode = n; }
+  int GetSenderRanksPerNode() { return this->SenderRanksPerNode; }
+
+  /// Get the fraction of the bytes kept on the node by the last partition
+  double GetOnNodeFraction() { return this->OnNodeFraction; }
+
+  /// Initialize from XML
+  int Initialize(pugi::xml_node &node) override;
+
+  /// given an existing partitioning of data passed in the first MeshMetadata
+  /// argument,return a new partittioning in the second MeshMetadata argument.
+  /// blocks are given to a receiver on the sender's node when the balance
+  /// allows. This is a collective call on the receivers' communicator.
+  int GetPartition(MPI_Comm comm, const sensei::MeshMetadataPtr &in,
+    sensei::MeshMetadataPtr &out) override;
+
+protected:
+  NodeAwarePartitioner() : Tolerance(0.1), SenderRanksPerNode(0),
+    OnNodeFraction(0.0) { this->CostModel = COST_BYTES; }
+
+  NodeAwarePartitioner(const NodeAwarePartitioner &) = default;
+
+  // get the node of each receiving and sending rank. nodes are numbered by
+  // their lowest receiving rank, senders on nodes without receivers are
+  // given -1
+  virtual int GetNodes(MPI_Comm comm, int nSenders,
+    std::vector<int> &receiverNodes, std::vector<int> &senderNodes);
+
+  double Tolerance;
+  std::vector<std::string> SenderHosts;
+  int SenderRanksPerNode;
+  double OnNodeFraction;
+};
+
+}
+
+#endif
@@ -3,6 +3,15 @@
 #include "Error.h"
 
 #include <sys/time.h>
+#include <time.h>
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+#if !defined(_WIN32)
+#include <dlfcn.h>
+#endif
 #include <fstream>
 #include <cstdlib>
 #include <cstring>
@@ -14,44 +23,237 @@
 #include <cstdio>
 
 #include <map>
-#include <list>
+#include <set>
+#include <cmath>
+#include <deque>
 #include <vector>
+#include <memory>
 #include <iomanip>
 #include <limits>
+#include <algorithm>
 #include <unordered_map>
 #include <mutex>
+#include <atomic>
 
 namespace impl
 {
 #if defined(ENABLE_PROFILER)
 
-// container for data captured in a timing Event
+// the most hardware performance counters recorded with an event
+static constexpr int MaxCounters = 4;
+
+// container for data captured in a timing Event. these are plain data so
+// that they can be kept in preallocated buffers
 struct Event
 {
-  Event();
-
   // serializes the Event in CSV format into the stream.
-  void ToStream(std::ostream &str) const;
+  void ToStream(std::ostream &str, int rank, const std::string &name,
+    double timeOffset) const;
 
   enum { START=0, END=1, DELTA=2 }; // record fields
 
-  // user provided identifier for the record
-  std::string Name;
+  // identifies the name of the Event, see InternName
+  int NameId;
 
-  // Event duration, initially start Time, end Time and duration
-  // are recorded. when summarizing this contains min,max and sum
-  // of the summariezed set of events
-  double Time[3];
+  // how deep is the Event stack
+  int Depth;
 
   // the number of bytes, if this is an I/O or datamovement operation
   // else -1
   long long NumBytes;
 
-  // how deep is the Event stack
-  int Depth;
+  // start Time, end Time, and duration. the times are from the monotonic
+  // clock, see getSystemTime
+  double Time[3];
 
   // the thread id that generated the Event
   std::thread::id Tid;
+
+  // the change in the performance counters over the event, see
+  // Profiler::SetCounters
+  long long Counters[MaxCounters];
+
+  enum { RSS=0, PEAK_RSS=1, PEAK=2, ALLOCATED=3 }; // memory fields
+
+  // the change in the resident set size and the peak resident set size in
+  // KiB, the peak resident set size at the end in KiB, and the bytes
+  // allocated by the thread or -1 when allocations are not counted
+  long long Memory[4];
+};
+
+/** Online statistics of the events with a given name. The durations are
+ * binned in a histogram with 4 bins per factor of 2 from 1 ns to about 1000
+ * seconds so that percentiles can be estimated in constant memory.
+ */
+struct EventStats
+{
+  static constexpr int NumBins = 160;
+
+  // add an event of duration dt seconds
+  void Add(double dt, long long nBytes, const long long *counters,
+    const long long *memory)
+  {
+    for (int i = 0; i < MaxCounters; ++i)
+      this->Counters[i] += counters[i];
+
+    this->Memory[Event::RSS] += memory[Event::RSS];
+    this->Memory[Event::PEAK_RSS] += memory[Event::PEAK_RSS];
+    this->Memory[Event::PEAK] = std::max(this->Memory[Event::PEAK],
+      double(memory[Event::PEAK]));
+    this->Memory[Event::ALLOCATED] += memory[Event::ALLOCATED];
+
+    this->Count += 1;
+    double delta = dt - this->Mean;
+    this->Mean += delta / this->Count;
+    this->M2 += delta * (dt - this->Mean);
+    this->Sum += dt;
+    this->Min = std::min(this->Min, dt);
+    this->Max = std::max(this->Max, dt);
+    if (nBytes > 0)
+      this->Bytes += nBytes;
+    this->Hist[GetBin(dt)] += 1;
+  }
+
+  // add the events of another set of statistics
+  void Merge(const EventStats &other);
+
+  // get the bin of a duration
+  static int GetBin(double dt);
+
+  // get the geometric center of a bin
+  static double GetBinCenter(int bin);
+
+  long Count = 0;
+  double Sum = 0.0;
+  double Mean = 0.0;
+  double M2 = 0.0;
+  double Min = std::numeric_limits<double>::max();
+  double Max = 0.0;
+  long long Bytes = 0;
+  uint64_t Hist[NumBins] = {0};
+  double Counters[MaxCounters] = {0.0};
+  double Memory[4] = {0.0};
+};
+
+/** Statistics of the values recorded with a given name, see
+ * Profiler::RecordValue. These are kept apart from the events so that they
+ * do not enter the timing, byte, and bandwidth statistics.
+ */
+struct ValueStats
+{
+  // add a value
+  void Add(double value)
+  {
+    this->Count += 1;
+    this->Sum += value;
+    this->Min = std::min(this->Min, value);
+    this->Max = std::max(this->Max, value);
+  }
+
+  // add the values of another set of statistics
+  void Merge(const ValueStats &other)
+  {
+    this->Count += other.Count;
+    this->Sum += other.Sum;
+    this->Min = std::min(this->Min, other.Min);
+    this->Max = std::max(this->Max, other.Max);
+  }
+
+  long Count = 0;
+  double Sum = 0.0;
+  double Min = std::numeric_limits<double>::max();
+  double Max = std::numeric_limits<double>::lowest();
+};
+
+/** The events of a thread. Only the owning thread touches the buffer while
+ * events are being logged so that no locks are needed. Completed events are
+ * stored in fixed size chunks that are allocated up front and reused after
+ * each flush. When a thread exits its buffer is handed to the next new
+ * thread, keeping the events already logged.
+ */
+struct ThreadBuffer
+{
+  ThreadBuffer();
+
+  // return the id of the named event
+  int GetNameId(const char *name);
+
+  // add a completed event
+  void Append(const Event &evt)
+  {
+    if (this->Size == this->Chunks.size()*ChunkSize)
+      this->Chunks.emplace_back(new Event[ChunkSize]);
+    this->Chunks[this->Size / ChunkSize][this->Size % ChunkSize] = evt;
+    ++this->Size;
+  }
+
+  // access a completed event
+  const Event &GetEvent(size_t i) const
+  { return this->Chunks[i / ChunkSize][i % ChunkSize]; }
+
+  // update the statistics of the named event
+  void AddStats(int nameId, double dt, long long nBytes,
+    const long long *counters, const long long *memory)
+  {
+    std::lock_guard<std::mutex> lock(this->StatsMutex);
+    if (size_t(nameId) >= this->Stats.size())
+      this->Stats.resize(nameId + 1);
+    this->Stats[nameId].Add(dt, nBytes, counters, memory);
+  }
+
+  // update the statistics of the named value
+  void AddValue(int nameId, double value)
+  {
+    std::lock_guard<std::mutex> lock(this->StatsMutex);
+    if (size_t(nameId) >= this->Values.size())
+      this->Values.resize(nameId + 1);
+    this->Values[nameId].Add(value);
+  }
+
+  // read the performance counters of the calling thread, opening them the
+  // first time. if they are not available zeros are returned
+  void ReadCounters(long long *counters);
+
+  // close the performance counters
+  void CloseCounters();
+
+  // discard the completed events, the first chunk is kept
+  void Clear()
+  {
+    this->Chunks.resize(1);
+    this->Size = 0;
+  }
+
+  static constexpr size_t ChunkSize = 1024;
+  static constexpr size_t CacheSize = 64;
+
+  std::thread::id Tid;
+  std::vector<Event> Active;                      // events not yet ended
+  std::vector<std::unique_ptr<Event[]>> Chunks;   // completed events
+  size_t Size;                                    // number of completed events
+  std::vector<EventStats> Stats;                  // statistics by name id
+  std::vector<ValueStats> Values;                 // value statistics by name id
+  std::mutex StatsMutex;                          // guards Stats and Values
+  std::vector<int> CounterFds;                    // the counter group
+  bool CountersOpened;                            // set once opening was tried
+
+  // a cache of recently used names, keyed by the address of the name
+  struct CacheEntry
+  {
+    const char *Address;
+    const char *Name;
+    int Id;
+  };
+
+  CacheEntry Cache[CacheSize];
+};
+
+// hands the thread's buffer on when the thread exits
+struct ThreadBufferHandle
+{
+  ~ThreadBufferHandle();
+
+  ThreadBuffer *Buffer = nullptr;
 };
 
 #if !defined(SENSEI_HAS_MPI)
@@ -60,55 +262,927 @@ using MPI_Comm = void*;
 #endif
 static MPI_Comm comm = MPI_COMM_NULL;
 
-static int loggingEnabled = 0x00;
+static std::atomic<int> loggingEnabled(0x00);
 
 static std::string timerLogFile = "timer.csv";
 
-using eventLogType = std::list<impl::Event>;
-using threadMapType = std::unordered_map<std::thread::id, eventLogType>;
+static std::string statsLogFile = "timer_stats.csv";
+
+// the number of statistics reports written, and the time of the first
+static int statsReport = 0;
+static double statsStartTime = -1.0;
+
+// the number of steps between statistics reports, and the steps counted
+static int statsInterval = 0;
+static long statsSteps = 0;
 
-static eventLogType eventLog;
-static threadMapType activeEvents;
-static std::mutex eventLogMutex;
+static int logFormat = sensei::Profiler::FORMAT_CSV;
+
+// the start of the chrome trace, times are written relative to this
+static double chromeTimeOrigin = -1.0;
+
+// a performance counter that may be recorded
+struct CounterType
+{
+  const char *Name;
+  unsigned int Type;
+  unsigned long long Config;
+};
+
+#if defined(__linux__)
+static const CounterType counterTypes[] = {
+  {"cycles", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+  {"instructions", PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+  {"cache-references", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_REFERENCES},
+  {"cache-misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+  {"branches", PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_INSTRUCTIONS},
+  {"branch-misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+  {"stalled-cycles-frontend", PERF_TYPE_HARDWARE, PERF_COUNT_HW_STALLED_CYCLES_FRONTEND},
+  {"stalled-cycles-backend", PERF_TYPE_HARDWARE, PERF_COUNT_HW_STALLED_CYCLES_BACKEND},
+  {"task-clock", PERF_TYPE_SOFTWARE, PERF_COUNT_SW_TASK_CLOCK},
+  {"page-faults", PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS},
+  {"context-switches", PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CONTEXT_SWITCHES},
+  {"cpu-migrations", PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CPU_MIGRATIONS}};
+#else
+static const CounterType counterTypes[] = {{"", 0, 0}};
+#endif
+
+// the counters recorded with each event
+static std::vector<const CounterType*> counters;
+
+// set when the counters could not be opened
+static std::atomic<int> countersUnavailable(0);
+
+// the index of the named counter in the recorded counters, or -1
+static int GetCounterIndex(const char *name)
+{
+  int nCounters = counters.size();
+  for (int i = 0; i < nCounters; ++i)
+    {
+    if (strcmp(counters[i]->Name, name) == 0)
+      return i;
+    }
+  return -1;
+}
+
+// the bytes allocated by the calling thread, when the allocation counter
+// library is preloaded. see AllocationCounter.cxx
+using AllocatedBytesFunc = unsigned long long (*)();
+static AllocatedBytesFunc allocatedBytes = nullptr;
+
+// get the memory use at the start of an event
+static void StartMemory(long long *memory)
+{
+  memory[Event::RSS] = sensei::MemoryProfiler::GetResidentSetSize();
+  memory[Event::PEAK_RSS] = sensei::MemoryProfiler::GetPeakResidentSetSize();
+  memory[Event::PEAK] = 0;
+  memory[Event::ALLOCATED] = allocatedBytes ? allocatedBytes() : 0;
+}
+
+// get the change in memory use at the end of an event
+static void EndMemory(long long *memory)
+{
+  long long peak = sensei::MemoryProfiler::GetPeakResidentSetSize();
+  memory[Event::ALLOCATED] = allocatedBytes ?
+    allocatedBytes() - memory[Event::ALLOCATED] : -1;
+  memory[Event::RSS] = sensei::MemoryProfiler::GetResidentSetSize() - memory[Event::RSS];
+  memory[Event::PEAK_RSS] = peak - memory[Event::PEAK_RSS];
+  memory[Event::PEAK] = peak;
+}
+
+// the buffers of all threads that have logged events, and the buffers of
+// threads that have exited
+static std::mutex buffersMutex;
+static std::vector<std::unique_ptr<ThreadBuffer>> buffers;
+static std::vector<ThreadBuffer*> freeBuffers;
+static thread_local ThreadBufferHandle threadBuffer;
+
+// the interned event names. strings in a deque are never moved so threads
+// may keep pointers to them
+static std::mutex namesMutex;
+static std::deque<std::string> names;
+static std::unordered_map<std::string, int> nameIds;
 
 // memory profiler
 static sensei::MemoryProfiler memProf;
 
-// return high res system Time relative to system epoch
+// return high res monotonic Time. this is cheaper than the system clock
+// and not subject to adjustment
 static double getSystemTime()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec/1.0e9;
+}
+
+// return the offset from the monotonic clock to the system epoch, applied when
+// events are written so that times may be compared across processes
+static double getTimeOffset()
 {
   struct timeval tv;
   gettimeofday(&tv, nullptr);
-  return tv.tv_sec + tv.tv_usec/1.0e6;
+  return tv.tv_sec + tv.tv_usec/1.0e6 - getSystemTime();
 }
 
+// get the id of the named event, adding the name if it is new. the
+// interned copy of the name is returned in internedName
+static int InternName(const char *name, const char **internedName)
+{
+  std::lock_guard<std::mutex> lock(namesMutex);
 
-// --------------------------------------------------------------------------
-Event::Event() : Time{0,0,0}, NumBytes(-1ll), Depth(0),
-  Tid(std::this_thread::get_id())
+  int id = 0;
+  auto it = nameIds.find(name);
+  if (it == nameIds.end())
+    {
+    id = names.size();
+    names.emplace_back(name);
+    nameIds[names.back()] = id;
+    }
+  else
+    {
+    id = it->second;
+    }
+
+  *internedName = names[id].c_str();
+
+  return id;
+}
+
+#if !defined(NDEBUG)
+// get the name of an event
+static std::string GetName(int id)
 {
+  std::lock_guard<std::mutex> lock(namesMutex);
+  return names[id];
 }
+#endif
 
-//-----------------------------------------------------------------------------
-void Event::ToStream(std::ostream &str) const
+// discard the completed events of all threads
+static void ClearEvents()
+{
+  std::lock_guard<std::mutex> lock(buffersMutex);
+  for (std::unique_ptr<ThreadBuffer> &tb : buffers)
+    tb->Clear();
+}
+
+// get the completed events of all threads in the order they ended, and the
+// event names. the threads that logged events are required to be finished
+static void GatherEvents(std::vector<const Event*> &events,
+  std::vector<std::string> &eventNames)
+{
+  {
+  std::lock_guard<std::mutex> lock(buffersMutex);
+  for (const std::unique_ptr<ThreadBuffer> &tb : buffers)
+    {
+    for (size_t i = 0; i < tb->Size; ++i)
+      events.push_back(&tb->GetEvent(i));
+    }
+  }
+
+  std::stable_sort(events.begin(), events.end(),
+    [](const Event *l, const Event *r)
+    { return l->Time[Event::END] < r->Time[Event::END]; });
+
+  std::lock_guard<std::mutex> lock(namesMutex);
+  eventNames.assign(names.begin(), names.end());
+}
+
+// the rank of this process in the profiler's communicator
+static int GetRank()
 {
-#if defined(ENABLE_PROFILER)
   int rank = 0;
 #if defined(SENSEI_HAS_MPI)
   int ini = 0, fin = 0;
   MPI_Initialized(&ini);
   MPI_Finalized(&fin);
   if (ini && !fin)
-    MPI_Comm_rank(impl::comm, &rank);
+    MPI_Comm_rank(comm, &rank);
 #endif
-  str << rank << ", " << this->Tid << ", \"" << this->Name << "\", "
-    << this->Time[START] << ", " << this->Time[END] << ", "
-    << this->Time[DELTA] << ", " << this->NumBytes  << ", "
-    << this->Depth << std::endl;
+  return rank;
+}
+
+// an event in the binary log, see Profiler::SetLogFormat
+struct BinaryEvent
+{
+  int32_t NameId;
+  int32_t Depth;
+  int64_t NumBytes;
+  double Start;
+  double End;
+  uint64_t Thread;
+};
+
+template <typename T>
+void Append(std::string &str, const T &val)
+{
+  str.append(reinterpret_cast<const char*>(&val), sizeof(T));
+}
+
+// serialize the events in the binary format, appending to str
+static void ToBinary(int rank, std::string &str)
+{
+  std::vector<const Event*> events;
+  std::vector<std::string> eventNames;
+  GatherEvents(events, eventNames);
+
+  str.append("SENSEIPF", 8);
+  Append(str, uint32_t(1));
+  Append(str, int32_t(rank));
+  Append(str, getTimeOffset());
+
+  Append(str, uint32_t(eventNames.size()));
+  for (const std::string &name : eventNames)
+    {
+    Append(str, uint32_t(name.size()));
+    str.append(name);
+    }
+
+  Append(str, uint64_t(events.size()));
+  for (const Event *evt : events)
+    {
+    BinaryEvent bevt{evt->NameId, evt->Depth, evt->NumBytes,
+      evt->Time[Event::START], evt->Time[Event::END],
+      uint64_t(std::hash<std::thread::id>()(evt->Tid))};
+    Append(str, bevt);
+    }
+}
+
+// write a string as a JSON string
+static void JsonString(std::ostream &os, const std::string &str)
+{
+  os << '"';
+  for (char c : str)
+    {
+    if ((c == '"') || (c == '\\'))
+      os << '\\' << c;
+    else if ((unsigned char)c < 0x20)
+      os << "\\u00" << std::hex << std::setw(2) << std::setfill('0')
+        << int(c) << std::dec << std::setfill(' ');
+    else
+      os << c;
+    }
+  os << '"';
+}
+
+// the earliest start time of the events on this rank, relative to the epoch
+static double GetStartTime(double timeOffset)
+{
+  double t0 = std::numeric_limits<double>::max();
+
+  std::lock_guard<std::mutex> lock(buffersMutex);
+  for (const std::unique_ptr<ThreadBuffer> &tb : buffers)
+    {
+    for (size_t i = 0; i < tb->Size; ++i)
+      t0 = std::min(t0, tb->GetEvent(i).Time[Event::START]);
+    }
+
+  return t0 + timeOffset;
+}
+
+/** Serialize the events in the Chrome trace event format. The rank is a
+ * process and each thread a thread of that process. Events are sorted by
+ * start time and depth, and clipped to their parent, so that the nesting
+ * recorded by the profiler is what is shown. The bandwidth of events that
+ * report a number of bytes is shown on a counter track for each thread.
+ * The events are separated by commas, the enclosing brackets are left to
+ * the caller. Times are in microseconds from timeOrigin, timeOffset converts
+ * the recorded times to times from the epoch.
+ */
+static void ToChrome(std::ostream &os, int rank, double timeOrigin,
+  double timeOffset)
+{
+  std::vector<const Event*> events;
+  std::vector<std::string> eventNames;
+  GatherEvents(events, eventNames);
+
+  // number the threads in the order they started logging
+  std::stable_sort(events.begin(), events.end(),
+    [](const Event *l, const Event *r)
+    {
+    return (l->Time[Event::START] < r->Time[Event::START]) ||
+      ((l->Time[Event::START] == r->Time[Event::START]) && (l->Depth < r->Depth));
+    });
+
+  // times are taken relative to the first event before the shift to the
+  // origin, so that the precision lost converting to and from the epoch does
+  // not move events before the origin
+  double t00 = events.empty() ? 0.0 : events[0]->Time[Event::START];
+  double shift = std::max(0.0, t00 + timeOffset - timeOrigin) - t00;
+
+  std::map<std::thread::id, int> threadIds;
+  std::vector<std::vector<const Event*>> threadEvents;
+  for (const Event *evt : events)
+    {
+    auto it = threadIds.insert(std::make_pair(evt->Tid, int(threadIds.size()))).first;
+    if (size_t(it->second) == threadEvents.size())
+      threadEvents.emplace_back();
+    threadEvents[it->second].push_back(evt);
+    }
+
+  os << std::fixed << std::setprecision(3);
+
+  size_t nCounters = counters.size();
+  int cycles = GetCounterIndex("cycles");
+  int instructions = GetCounterIndex("instructions");
+  bool memory = loggingEnabled & 0x10;
+
+  os << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":" << rank
+    << ",\"args\":{\"name\":\"rank " << rank << "\"}},\n"
+    << "{\"name\":\"process_sort_index\",\"ph\":\"M\",\"pid\":" << rank
+    << ",\"args\":{\"sort_index\":" << rank << "}}";
+
+  size_t nThreads = threadEvents.size();
+  for (size_t i = 0; i < nThreads; ++i)
+    {
+    os << ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":" << rank
+      << ",\"tid\":" << i << ",\"args\":{\"name\":\"thread " << i << "\"}}";
+
+    // the start and end of the enclosing events
+    std::vector<std::pair<double,double>> parents;
+
+    // the bandwidth over time
+    std::vector<std::pair<double,double>> bandwidth;
+
+    for (const Event *evt : threadEvents[i])
+      {
+      double t0 = evt->Time[Event::START];
+      double t1 = evt->Time[Event::END];
+
+      size_t depth = evt->Depth;
+      if (depth > parents.size())
+        depth = parents.size();
+
+      if (depth > 0)
+        {
+        t0 = std::max(t0, parents[depth-1].first);
+        t1 = std::min(std::max(t1, t0), parents[depth-1].second);
+        }
+
+      parents.resize(depth);
+      parents.emplace_back(t0, t1);
+
+      os << ",\n{\"name\":";
+      JsonString(os, eventNames[evt->NameId]);
+      os << ",\"cat\":\"sensei\",\"ph\":\"X\",\"pid\":" << rank
+        << ",\"tid\":" << i << ",\"ts\":" << (t0 + shift)*1.0e6
+        << ",\"dur\":" << (t1 - t0)*1.0e6 << ",\"args\":{\"depth\":"
+        << evt->Depth;
+
+      if (evt->NumBytes >= 0)
+        os << ",\"bytes\":" << evt->NumBytes;
+
+      for (size_t j = 0; j < nCounters; ++j)
+        os << ",\"" << counters[j]->Name << "\":" << evt->Counters[j];
+
+      if ((cycles >= 0) && (instructions >= 0) && (evt->Counters[cycles] > 0))
+        os << ",\"ipc\":" << double(evt->Counters[instructions])/evt->Counters[cycles];
+
+      if (memory)
+        {
+        os << ",\"rss delta KiB\":" << evt->Memory[Event::RSS]
+          << ",\"peak rss delta KiB\":" << evt->Memory[Event::PEAK_RSS]
+          << ",\"peak rss KiB\":" << evt->Memory[Event::PEAK];
+        if (evt->Memory[Event::ALLOCATED] >= 0)
+          os << ",\"allocated bytes\":" << evt->Memory[Event::ALLOCATED];
+        }
+
+      os << "}}";
+
+      double dt = evt->Time[Event::DELTA];
+      if ((evt->NumBytes > 0) && (dt > 0.0))
+        {
+        bandwidth.emplace_back(t0, evt->NumBytes/dt/1.0e6);
+        bandwidth.emplace_back(t1, 0.0);
+        }
+      }
+
+    std::stable_sort(bandwidth.begin(), bandwidth.end(),
+      [](const std::pair<double,double> &l, const std::pair<double,double> &r)
+      { return l.first < r.first; });
+
+    for (const std::pair<double,double> &bw : bandwidth)
+      {
+      os << ",\n{\"name\":\"bandwidth thread " << i << "\",\"ph\":\"C\",\"pid\":"
+        << rank << ",\"tid\":" << i << ",\"ts\":" << (bw.first + shift)*1.0e6
+        << ",\"args\":{\"MB/s\":" << bw.second << "}}";
+      }
+    }
+}
+
+// discard the statistics of all threads
+static void ClearStats()
+{
+  std::lock_guard<std::mutex> lock(buffersMutex);
+  for (std::unique_ptr<ThreadBuffer> &tb : buffers)
+    {
+    std::lock_guard<std::mutex> statsLock(tb->StatsMutex);
+    tb->Stats.clear();
+    tb->Values.clear();
+    }
+}
+
+// merge the statistics held in the given member of all thread's buffers by
+// name. other threads may continue to log events
+template <typename stats_t>
+static void GatherStats(std::vector<stats_t> ThreadBuffer::*member,
+  std::map<std::string, stats_t> &stats)
+{
+  std::vector<stats_t> merged;
+  {
+  std::lock_guard<std::mutex> lock(buffersMutex);
+  for (const std::unique_ptr<ThreadBuffer> &tb : buffers)
+    {
+    std::lock_guard<std::mutex> statsLock(tb->StatsMutex);
+    const std::vector<stats_t> &tbStats = (*tb).*member;
+    size_t nNames = tbStats.size();
+    if (merged.size() < nNames)
+      merged.resize(nNames);
+    for (size_t i = 0; i < nNames; ++i)
+      merged[i].Merge(tbStats[i]);
+    }
+  }
+
+  std::lock_guard<std::mutex> lock(namesMutex);
+  size_t nNames = merged.size();
+  for (size_t i = 0; i < nNames; ++i)
+    {
+    if (merged[i].Count)
+      stats[names[i]] = merged[i];
+    }
+}
+
+#if defined(SENSEI_HAS_MPI)
+// add the names logged on any rank to the map, so that it holds the same
+// names in the same order on all ranks
+template <typename stats_t>
+static void GlobalizeNames(std::map<std::string, stats_t> &stats, int rank,
+  int nRanks)
+{
+  std::string localNames;
+  for (auto &it : stats)
+    localNames.append(it.first.c_str(), it.first.size() + 1);
+
+  int nBytes = localNames.size();
+  std::vector<int> counts(nRanks), displs(nRanks);
+  MPI_Gather(&nBytes, 1, MPI_INT, counts.data(), 1, MPI_INT, 0, comm);
+
+  int total = 0;
+  for (int i = 0; i < nRanks; ++i)
+    {
+    displs[i] = total;
+    total += counts[i];
+    }
+
+  std::vector<char> allNames(rank == 0 ? total : 0);
+  MPI_Gatherv(localNames.data(), nBytes, MPI_CHAR, allNames.data(),
+    counts.data(), displs.data(), MPI_CHAR, 0, comm);
+
+  std::string globalNames;
+  if (rank == 0)
+    {
+    std::set<std::string> uniqueNames;
+    for (int i = 0; i < total; i += strlen(allNames.data() + i) + 1)
+      uniqueNames.insert(allNames.data() + i);
+
+    for (const std::string &name : uniqueNames)
+      globalNames.append(name.c_str(), name.size() + 1);
+    }
+
+  nBytes = globalNames.size();
+  MPI_Bcast(&nBytes, 1, MPI_INT, 0, comm);
+  globalNames.resize(nBytes);
+  MPI_Bcast(&globalNames[0], nBytes, MPI_CHAR, 0, comm);
+
+  for (int i = 0; i < nBytes; i += strlen(globalNames.c_str() + i) + 1)
+    stats[globalNames.c_str() + i];
+}
+#endif
+
+/** Reduce the statistics of all ranks, and on rank 0 write a report. One
+ * line is written for each event name logged on any rank. The imbalance is
+ * the greatest time spent in the event by a rank over the mean time of the
+ * ranks that logged it. Percentiles are estimated from the histogram. The
+ * values recorded with RecordValue follow in a section of their own.
+ */
+static void ToStats(std::ostream &os, int report, double elapsed)
+{
+  std::map<std::string, EventStats> stats;
+  GatherStats(&ThreadBuffer::Stats, stats);
+
+  std::map<std::string, ValueStats> values;
+  GatherStats(&ThreadBuffer::Values, values);
+
+  int rank = 0;
+  int nRanks = 1;
+#if defined(SENSEI_HAS_MPI)
+  int ini = 0, fin = 0;
+  MPI_Initialized(&ini);
+  MPI_Finalized(&fin);
+  bool useMpi = ini && !fin;
+  if (useMpi)
+    {
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &nRanks);
+    }
+
+  // make a list of the names logged on any rank, the same on all ranks
+  if (useMpi && (nRanks > 1))
+    {
+    GlobalizeNames(stats, rank, nRanks);
+    GlobalizeNames(values, rank, nRanks);
+    }
+#endif
+
+  // pack the statistics by how they are reduced
+  size_t nNames = stats.size();
+  size_t nBins = EventStats::NumBins;
+  size_t nCounters = counters.size();
+  size_t nSums = 8 + nCounters;
+
+  std::vector<double> sums(nSums*nNames);
+  std::vector<double> maxs(3*nNames);
+  std::vector<double> mins(nNames);
+  std::vector<uint64_t> hists(nBins*nNames);
+
+  size_t i = 0;
+  for (auto &it : stats)
+    {
+    const EventStats &st = it.second;
+    double *sum = sums.data() + nSums*i;
+    sum[0] = st.Count;
+    sum[1] = st.Sum;
+    sum[2] = st.Count ? st.M2 + st.Sum*st.Sum/st.Count : 0.0;
+    sum[3] = st.Bytes;
+    sum[4] = st.Count ? 1.0 : 0.0;
+    sum[5] = st.Memory[Event::RSS];
+    sum[6] = st.Memory[Event::PEAK_RSS];
+    sum[7] = st.Memory[Event::ALLOCATED];
+    std::copy(st.Counters, st.Counters + nCounters, sum + 8);
+    maxs[3*i    ] = st.Max;
+    maxs[3*i + 1] = st.Sum;
+    maxs[3*i + 2] = st.Memory[Event::PEAK];
+    mins[i] = st.Min;
+    std::copy(st.Hist, st.Hist + nBins, hists.begin() + nBins*i);
+    ++i;
+    }
+
+#if defined(SENSEI_HAS_MPI)
+  if (useMpi && (nRanks > 1))
+    {
+    MPI_Reduce(rank ? sums.data() : MPI_IN_PLACE, sums.data(), sums.size(),
+      MPI_DOUBLE, MPI_SUM, 0, comm);
+    MPI_Reduce(rank ? maxs.data() : MPI_IN_PLACE, maxs.data(), maxs.size(),
+      MPI_DOUBLE, MPI_MAX, 0, comm);
+    MPI_Reduce(rank ? mins.data() : MPI_IN_PLACE, mins.data(), mins.size(),
+      MPI_DOUBLE, MPI_MIN, 0, comm);
+    MPI_Reduce(rank ? hists.data() : MPI_IN_PLACE, hists.data(), hists.size(),
+      MPI_UINT64_T, MPI_SUM, 0, comm);
+    }
+#endif
+
+  // the count and total, min, and max of the values
+  size_t nValues = values.size();
+  std::vector<double> valSums(2*nValues);
+  std::vector<double> valMins(nValues);
+  std::vector<double> valMaxs(nValues);
+
+  i = 0;
+  for (auto &it : values)
+    {
+    valSums[2*i] = it.second.Count;
+    valSums[2*i + 1] = it.second.Sum;
+    valMins[i] = it.second.Min;
+    valMaxs[i] = it.second.Max;
+    ++i;
+    }
+
+#if defined(SENSEI_HAS_MPI)
+  if (useMpi && (nRanks > 1) && nValues)
+    {
+    MPI_Reduce(rank ? valSums.data() : MPI_IN_PLACE, valSums.data(),
+      valSums.size(), MPI_DOUBLE, MPI_SUM, 0, comm);
+    MPI_Reduce(rank ? valMins.data() : MPI_IN_PLACE, valMins.data(),
+      valMins.size(), MPI_DOUBLE, MPI_MIN, 0, comm);
+    MPI_Reduce(rank ? valMaxs.data() : MPI_IN_PLACE, valMaxs.data(),
+      valMaxs.size(), MPI_DOUBLE, MPI_MAX, 0, comm);
+    }
+#endif
+
+  if (rank != 0)
+    return;
+
+  // with the counters, the instructions per cycle and bytes per cycle are
+  // derived when cycles and instructions are recorded
+  int cycles = GetCounterIndex("cycles");
+  int instructions = GetCounterIndex("instructions");
+
+  os << "# report " << report << ", " << elapsed << " seconds, "
+    << nRanks << " ranks" << std::endl
+    << "# name, count, total, min, mean, max, std dev, p50, p90, p99, "
+       "imbalance, bytes";
+
+  for (size_t j = 0; j < nCounters; ++j)
+    os << ", " << counters[j]->Name;
+
+  if ((cycles >= 0) && (instructions >= 0))
+    os << ", ipc";
+
+  if (cycles >= 0)
+    os << ", bytes per cycle";
+
+  // with memory use, the change in resident set size and peak resident set
+  // size summed over the events, the greatest peak at the end of an event,
+  // and the bytes allocated in the events
+  bool memory = loggingEnabled & 0x10;
+  if (memory)
+    os << ", rss delta KiB, peak rss delta KiB, peak rss KiB, allocated bytes";
+
+  os << std::endl;
+
+  os.precision(6);
+  os.setf(std::ios::scientific, std::ios::floatfield);
+
+  i = 0;
+  for (auto &it : stats)
+    {
+    const double *sumi = sums.data() + nSums*i;
+    double count = sumi[0];
+    double sum = sumi[1];
+    double mean = sum / count;
+    double var = std::max(0.0, sumi[2]/count - mean*mean);
+    double rankMean = sum / sumi[4];
+
+    // estimate percentiles from the histogram
+    double pct[3] = {0.5, 0.9, 0.99};
+    double vals[3] = {0.0};
+    const uint64_t *hist = hists.data() + nBins*i;
+    uint64_t cum = 0;
+    int k = 0;
+    for (size_t j = 0; (j < nBins) && (k < 3); ++j)
+      {
+      cum += hist[j];
+      while ((k < 3) && (cum >= pct[k]*count))
+        {
+        vals[k] = std::min(maxs[3*i], std::max(mins[i],
+          EventStats::GetBinCenter(j)));
+        ++k;
+        }
+      }
+
+    os << "\"" << it.first << "\", " << (long)count << ", " << sum << ", "
+      << mins[i] << ", " << mean << ", " << maxs[3*i] << ", "
+      << std::sqrt(var) << ", " << vals[0] << ", " << vals[1] << ", "
+      << vals[2] << ", " << maxs[3*i + 1]/rankMean << ", "
+      << (long long)sumi[3];
+
+    const double *ctr = sumi + 8;
+    for (size_t j = 0; j < nCounters; ++j)
+      os << ", " << ctr[j];
+
+    if ((cycles >= 0) && (instructions >= 0))
+      os << ", " << (ctr[cycles] > 0.0 ? ctr[instructions]/ctr[cycles] : 0.0);
+
+    if (cycles >= 0)
+      os << ", " << (ctr[cycles] > 0.0 ? sumi[3]/ctr[cycles] : 0.0);
+
+    if (memory)
+      {
+      os << ", " << (long long)sumi[5] << ", " << (long long)sumi[6] << ", "
+        << (long long)maxs[3*i + 2] << ", ";
+      if (allocatedBytes)
+        os << (long long)sumi[7];
+      else
+        os << -1;
+      }
+
+    os << std::endl;
+
+    ++i;
+    }
+
+  if (!nValues)
+    return;
+
+  os << "# values" << std::endl
+    << "# name, count, total, min, mean, max" << std::endl;
+
+  i = 0;
+  for (auto &it : values)
+    {
+    double count = valSums[2*i];
+    os << "\"" << it.first << "\", " << (long)count << ", " << valSums[2*i + 1]
+      << ", " << valMins[i] << ", " << valSums[2*i + 1]/count << ", "
+      << valMaxs[i] << std::endl;
+    ++i;
+    }
+}
+
+// get the calling thread's buffer
+static ThreadBuffer *GetThreadBuffer()
+{
+  ThreadBuffer *tb = threadBuffer.Buffer;
+  if (!tb)
+    {
+    std::lock_guard<std::mutex> lock(buffersMutex);
+    if (freeBuffers.empty())
+      {
+      buffers.emplace_back(new ThreadBuffer);
+      tb = buffers.back().get();
+      }
+    else
+      {
+      tb = freeBuffers.back();
+      freeBuffers.pop_back();
+
+      // the counters of the previous owner count that thread
+      tb->CloseCounters();
+      }
+    tb->Tid = std::this_thread::get_id();
+    threadBuffer.Buffer = tb;
+    }
+  return tb;
+}
+
+// --------------------------------------------------------------------------
+ThreadBuffer::ThreadBuffer() : Size(0), CountersOpened(false)
+{
+  this->Active.reserve(64);
+  this->Chunks.emplace_back(new Event[ChunkSize]);
+  for (size_t i = 0; i < CacheSize; ++i)
+    this->Cache[i] = CacheEntry{nullptr, nullptr, -1};
+}
+
+// --------------------------------------------------------------------------
+int ThreadBuffer::GetNameId(const char *name)
+{
+  // names are usually string literals, but may be held in a buffer that is
+  // reused for other names, hence the comparison
+  CacheEntry &ent = this->Cache[(reinterpret_cast<uintptr_t>(name) >> 3) % CacheSize];
+  if ((ent.Address != name) || strcmp(ent.Name, name))
+    {
+    ent.Address = name;
+    ent.Id = InternName(name, &ent.Name);
+    }
+  return ent.Id;
+}
+
+// --------------------------------------------------------------------------
+void ThreadBuffer::ReadCounters(long long *vals)
+{
+  int nCounters = counters.size();
+  for (int i = 0; i < MaxCounters; ++i)
+    vals[i] = 0;
+
+#if defined(__linux__)
+  if (!this->CountersOpened)
+    {
+    this->CountersOpened = true;
+
+    // the counters are opened as a group so that they are read at once.
+    // only user space is counted so that this works without privileges
+    std::vector<int> fds;
+    for (int i = 0; i < nCounters; ++i)
+      {
+      struct perf_event_attr attr;
+      memset(&attr, 0, sizeof(attr));
+      attr.size = sizeof(attr);
+      attr.type = counters[i]->Type;
+      attr.config = counters[i]->Config;
+      attr.exclude_kernel = 1;
+      attr.exclude_hv = 1;
+      attr.read_format = PERF_FORMAT_GROUP;
+
+      int fd = syscall(__NR_perf_event_open, &attr, 0, -1,
+        fds.empty() ? -1 : fds[0], 0);
+
+      if (fd < 0)
+        {
+        if (!countersUnavailable.exchange(1))
+          SENSEI_WARNING("The \"" << counters[i]->Name << "\" performance"
+            " counter is not available (" << strerror(errno) << "). Zeros"
+            " are reported for the counters.")
+        for (int ofd : fds)
+          close(ofd);
+        fds.clear();
+        break;
+        }
+
+      fds.push_back(fd);
+      }
+
+    this->CounterFds = fds;
+    }
+
+  if (!this->CounterFds.empty())
+    {
+    uint64_t buf[1 + MaxCounters];
+    if ((read(this->CounterFds[0], buf, sizeof(buf)) > 0) &&
+      (buf[0] == uint64_t(nCounters)))
+      {
+      for (int i = 0; i < nCounters; ++i)
+        vals[i] = buf[1 + i];
+      }
+    }
 #else
-  (void)str;
+  (void)nCounters;
 #endif
 }
+
+// --------------------------------------------------------------------------
+void ThreadBuffer::CloseCounters()
+{
+#if defined(__linux__)
+  for (int fd : this->CounterFds)
+    close(fd);
+#endif
+  this->CounterFds.clear();
+  this->CountersOpened = false;
+}
+
+// --------------------------------------------------------------------------
+void EventStats::Merge(const EventStats &other)
+{
+  if (!other.Count)
+    return;
+
+  long count = this->Count + other.Count;
+  double delta = other.Mean - this->Mean;
+
+  this->M2 += other.M2 + delta*delta*this->Count*other.Count/count;
+  this->Mean += delta*other.Count/count;
+  this->Count = count;
+  this->Sum += other.Sum;
+  this->Min = std::min(this->Min, other.Min);
+  this->Max = std::max(this->Max, other.Max);
+  this->Bytes += other.Bytes;
+
+  for (int i = 0; i < NumBins; ++i)
+    this->Hist[i] += other.Hist[i];
+
+  for (int i = 0; i < MaxCounters; ++i)
+    this->Counters[i] += other.Counters[i];
+
+  this->Memory[Event::RSS] += other.Memory[Event::RSS];
+  this->Memory[Event::PEAK_RSS] += other.Memory[Event::PEAK_RSS];
+  this->Memory[Event::PEAK] = std::max(this->Memory[Event::PEAK],
+    other.Memory[Event::PEAK]);
+  this->Memory[Event::ALLOCATED] += other.Memory[Event::ALLOCATED];
+}
+
+// --------------------------------------------------------------------------
+int EventStats::GetBin(double dt)
+{
+  if (dt <= 0.0)
+    return 0;
+
+  // dt = m 2^e with m in [0.5, 1)
+  int e = 0;
+  double m = frexp(dt, &e);
+
+  int bin = 4*(e + 30) + int((m - 0.5)*8.0);
+
+  return std::max(0, std::min(NumBins - 1, bin));
+}
+
+// --------------------------------------------------------------------------
+double EventStats::GetBinCenter(int bin)
+{
+  double m = 0.5 + 0.125*(bin % 4);
+  int e = bin/4 - 30;
+  return std::sqrt(ldexp(m, e)*ldexp(m + 0.125, e));
+}
+
+// --------------------------------------------------------------------------
+ThreadBufferHandle::~ThreadBufferHandle()
+{
+  if (this->Buffer)
+    {
+    std::lock_guard<std::mutex> lock(buffersMutex);
+    freeBuffers.push_back(this->Buffer);
+    }
+}
+
+//-----------------------------------------------------------------------------
+void Event::ToStream(std::ostream &str, int rank, const std::string &name,
+  double timeOffset) const
+{
+  str << rank << ", " << this->Tid << ", \"" << name << "\", "
+    << this->Time[START] + timeOffset << ", " << this->Time[END] + timeOffset
+    << ", " << this->Time[DELTA] << ", " << this->NumBytes  << ", "
+    << this->Depth;
+
+  int nCounters = counters.size();
+  for (int i = 0; i < nCounters; ++i)
+    str << ", " << this->Counters[i];
+
+  if (loggingEnabled & 0x10)
+    {
+    for (int i = 0; i < 4; ++i)
+      str << ", " << this->Memory[i];
+    }
+
+  str << std::endl;
+}
 #endif
 }
 
@@ -145,6 +1219,140 @@ void Profiler::SetTimerLogFile(const std::string &file)
 #endif
 }
 
+// ----------------------------------------------------------------------------
+void Profiler::SetStatisticsFile(const std::string &file)
+{
+#if defined(ENABLE_PROFILER)
+  impl::statsLogFile = file;
+#else
+  (void)file;
+#endif
+}
+
+// ----------------------------------------------------------------------------
+int Profiler::WriteStatistics()
+{
+#if defined(ENABLE_PROFILER)
+  if (impl::loggingEnabled & 0x04)
+    {
+    double now = impl::getSystemTime();
+    if (impl::statsStartTime < 0.0)
+      impl::statsStartTime = now;
+
+    std::ostringstream oss;
+    impl::ToStats(oss, impl::statsReport, now - impl::statsStartTime);
+
+    int ierr = 0;
+    if (impl::GetRank() == 0)
+      ierr = Profiler::WriteCStdio(impl::statsLogFile.c_str(),
+        impl::statsReport ? "a" : "w", oss.str());
+
+    impl::statsReport += 1;
+
+    return ierr;
+    }
+#endif
+  return 0;
+}
+
+// ----------------------------------------------------------------------------
+void Profiler::SetStatisticsInterval(int steps)
+{
+#if defined(ENABLE_PROFILER)
+  impl::statsInterval = steps;
+#else
+  (void)steps;
+#endif
+}
+
+// ----------------------------------------------------------------------------
+int Profiler::EndStep()
+{
+#if defined(ENABLE_PROFILER)
+  if ((impl::loggingEnabled & 0x04) && (impl::statsInterval > 0))
+    {
+    impl::statsSteps += 1;
+    if ((impl::statsSteps % impl::statsInterval) == 0)
+      return Profiler::WriteStatistics();
+    }
+#endif
+  return 0;
+}
+
+// ----------------------------------------------------------------------------
+int Profiler::SetCounters(const std::string &names)
+{
+#if defined(ENABLE_PROFILER)
+  std::vector<const impl::CounterType*> counters;
+
+  size_t n = sizeof(impl::counterTypes)/sizeof(impl::CounterType);
+
+  std::istringstream iss(names);
+  std::string name;
+  while (std::getline(iss, name, ','))
+    {
+    name.erase(0, name.find_first_not_of(" \t"));
+    name.erase(name.find_last_not_of(" \t") + 1);
+
+    size_t i = 0;
+    while ((i < n) && (name != impl::counterTypes[i].Name))
+      ++i;
+
+    if (name.empty() || (i == n))
+      {
+      SENSEI_ERROR("Invalid performance counter \"" << name << "\"")
+      return -1;
+      }
+
+    counters.push_back(impl::counterTypes + i);
+    }
+
+  if (counters.size() > size_t(impl::MaxCounters))
+    {
+    SENSEI_ERROR("At most " << impl::MaxCounters
+      << " performance counters may be recorded")
+    return -1;
+    }
+
+  impl::counters = counters;
+  impl::countersUnavailable = 0;
+#else
+  (void)names;
+#endif
+  return 0;
+}
+
+// ----------------------------------------------------------------------------
+int Profiler::SetLogFormat(int format)
+{
+#if defined(ENABLE_PROFILER)
+  if ((format < FORMAT_CSV) || (format > FORMAT_CHROME))
+    {
+    SENSEI_ERROR("Invalid log format " << format)
+    return -1;
+    }
+  impl::logFormat = format;
+#else
+  (void)format;
+#endif
+  return 0;
+}
+
+// ----------------------------------------------------------------------------
+int Profiler::SetLogFormat(const std::string &format)
+{
+  if (format == "csv")
+    return Profiler::SetLogFormat(FORMAT_CSV);
+  else if (format == "binary")
+    return Profiler::SetLogFormat(FORMAT_BINARY);
+  else if (format == "chrome")
+    return Profiler::SetLogFormat(FORMAT_CHROME);
+
+  SENSEI_ERROR("Invalid log format \"" << format
+    << "\". Use one of csv, binary, or chrome")
+  return -1;
+}
+
 // ----------------------------------------------------------------------------
 void Profiler::SetMemProfLogFile(const std::string &file)
 {
@@ -170,22 +1378,19 @@ int Profiler::Validate()
 {
   int ierr = 0;
 #if defined(ENABLE_PROFILER)
-  if (impl::loggingEnabled & 0x01)
+  if (impl::loggingEnabled & 0x05)
     {
 #if !defined(NDEBUG)
-    impl::threadMapType::iterator tmit = impl::activeEvents.begin();
-    impl::threadMapType::iterator tmend = impl::activeEvents.end();
-    for (; tmit != tmend; ++tmit)
+    std::lock_guard<std::mutex> lock(impl::buffersMutex);
+    for (const std::unique_ptr<impl::ThreadBuffer> &tb : impl::buffers)
       {
-      unsigned int nLeft = tmit->second.size();
+      unsigned int nLeft = tb->Active.size();
       if (nLeft > 0)
         {
         std::ostringstream oss;
-        impl::eventLogType::iterator it = tmit->second.begin();
-        impl::eventLogType::iterator end = tmit->second.end();
-        for (; it != end; ++it)
-          it->ToStream(oss);
-        SENSEI_ERROR("Thread " << tmit->first << " has " << nLeft
+        for (const impl::Event &evt : tb->Active)
+          evt.ToStream(oss, 0, impl::GetName(evt.NameId), 0.0);
+        SENSEI_ERROR("Thread " << tb->Tid << " has " << nLeft
           << " unmatched active events. " << std::endl
           << oss.str())
         ierr += 1;
@@ -207,13 +1412,17 @@ int Profiler::ToStream(std::ostream &os)
     os.precision(std::numeric_limits<double>::digits10 + 2);
     os.setf(std::ios::scientific, std::ios::floatfield);
 
-    // not locking this as it's intended to be accessed only from the main
-    // thread, and all other threads are required to be finished by now
-    impl::eventLogType::iterator iter = impl::eventLog.begin();
-    impl::eventLogType::iterator end = impl::eventLog.end();
+    int rank = impl::GetRank();
 
-    for (; iter != end; ++iter)
-      iter->ToStream(os);
+    // merge the events of all threads in the order they ended
+    std::vector<const impl::Event*> events;
+    std::vector<std::string> names;
+    impl::GatherEvents(events, names);
+
+    double timeOffset = impl::getTimeOffset();
+
+    for (const impl::Event *evt : events)
+      evt->ToStream(os, rank, names[evt->NameId], timeOffset);
     }
 #else
   (void)os;
@@ -245,11 +1454,36 @@ int Profiler::Initialize()
   // look for overrides in the environment
   char *tmp = nullptr;
   if ((tmp = getenv("PROFILER_ENABLE")))
-    impl::loggingEnabled = atoi(tmp);
+    impl::loggingEnabled = strtol(tmp, nullptr, 0);
 
   if ((tmp = getenv("PROFILER_LOG_FILE")))
     impl::timerLogFile = tmp;
 
+  if ((tmp = getenv("PROFILER_LOG_FORMAT")))
+    Profiler::SetLogFormat(tmp);
+
+  if ((tmp = getenv("PROFILER_STATS_FILE")))
+    impl::statsLogFile = tmp;
+
+  if ((tmp = getenv("PROFILER_STATS_INTERVAL")))
+    impl::statsInterval = atoi(tmp);
+
+  if ((tmp = getenv("PROFILER_COUNTERS")))
+    Profiler::SetCounters(tmp);
+
+  if ((impl::loggingEnabled & 0x08) && impl::counters.empty())
+    Profiler::SetCounters("cycles,instructions,cache-misses,branch-misses");
+
+#if !defined(_WIN32)
+  // the allocation counter is used when it has been preloaded
+  impl::allocatedBytes = reinterpret_cast<impl::AllocatedBytesFunc>(
+    dlsym(RTLD_DEFAULT, "sensei_allocated_bytes"));
+#endif
+
+  impl::statsStartTime = impl::getSystemTime();
+  impl::statsReport = 0;
+  impl::statsSteps = 0;
+
   if ((tmp = getenv("MEMPROF_LOG_FILE")))
     impl::memProf.SetFilename(tmp);
 
@@ -263,9 +1497,18 @@ int Profiler::Initialize()
   if ((rank == 0) && impl::loggingEnabled)
     std::cerr << "Profiler configured with Event logging "
       << (impl::loggingEnabled & 0x01 ? "enabled" : "disabled")
-      << " and memory logging " << (impl::loggingEnabled & 0x02 ? "enabled" : "disabled")
-      << ", timer log file \"" << impl::timerLogFile
-      << "\", memory profiler log file \"" << impl::memProf.GetFilename()
+      << ", memory logging " << (impl::loggingEnabled & 0x02 ? "enabled" : "disabled")
+      << ", event statistics " << (impl::loggingEnabled & 0x04 ? "enabled" : "disabled")
+      << ", performance counters " << (impl::loggingEnabled & 0x08 ? "enabled" : "disabled")
+      << " and event memory use " << (impl::loggingEnabled & 0x10 ?
+      (impl::allocatedBytes ? "enabled with allocations" : "enabled") : "disabled")
+      << ", statistics file \"" << impl::statsLogFile
+      << "\"" << (impl::statsInterval > 0 ? " written every " +
+      std::to_string(impl::statsInterval) + " steps" : std::string())
+      << ", timer log file \"" << impl::timerLogFile << "\" in "
+      << (impl::logFormat == FORMAT_BINARY ? "binary" :
+      (impl::logFormat == FORMAT_CHROME ? "chrome" : "csv")) << " format"
+      << ", memory profiler log file \"" << impl::memProf.GetFilename()
       << "\", sampling interval " << impl::memProf.GetInterval()
       << " seconds" << std::endl;
 #endif
@@ -330,11 +1573,51 @@ int Profiler::WriteMpiIo(MPI_Comm comm, const char *fileName,
 int Profiler::Flush()
 {
 #if defined(ENABLE_PROFILER)
-  std::ostringstream oss;
-  Profiler::ToStream(oss);
-  Profiler::WriteCStdio(impl::timerLogFile.c_str(), "a", oss.str());
+  if (impl::loggingEnabled & 0x01)
+    {
+    if (impl::logFormat == FORMAT_BINARY)
+      {
+      // sections may be concatenated
+      std::string str;
+      impl::ToBinary(impl::GetRank(), str);
+      Profiler::WriteCStdio(impl::timerLogFile.c_str(), "a", str);
+      }
+    else if (impl::logFormat == FORMAT_CHROME)
+      {
+      // replace the closing bracket of an existing trace
+      double timeOffset = impl::getTimeOffset();
+      if (impl::chromeTimeOrigin < 0.0)
+        impl::chromeTimeOrigin = impl::GetStartTime(timeOffset);
+
+      std::ostringstream oss;
+      impl::ToChrome(oss, impl::GetRank(), impl::chromeTimeOrigin, timeOffset);
+      oss << "\n]\n";
+
+      FILE *fh = fopen(impl::timerLogFile.c_str(), "r+");
+      char end[2] = {0};
+      if (fh && !fseek(fh, -2, SEEK_END) && (fread(end, 1, 2, fh) == 2) &&
+        (end[0] == ']') && !fseek(fh, -2, SEEK_END))
+        {
+        std::string str = ",\n" + oss.str();
+        fwrite(str.c_str(), 1, str.size(), fh);
+        fclose(fh);
+        }
+      else
+        {
+        if (fh)
+          fclose(fh);
+        Profiler::WriteCStdio(impl::timerLogFile.c_str(), "w", "[\n" + oss.str());
+        }
+      }
+    else
+      {
+      std::ostringstream oss;
+      Profiler::ToStream(oss);
+      Profiler::WriteCStdio(impl::timerLogFile.c_str(), "a", oss.str());
+      }
+    }
   Profiler::Validate();
-  impl::eventLog.clear();
+  impl::ClearEvents();
 #endif
   return 0;
 }
@@ -344,7 +1627,7 @@ int Profiler::WriteCStdio(const char *fileName, const char *mode,
   const std::string &str)
 {
 #if defined(ENABLE_PROFILER)
-  if (impl::loggingEnabled & 0x01)
+  if (impl::loggingEnabled & 0x05)
     {
     FILE *fh = fopen(fileName, mode);
     if (!fh)
@@ -391,21 +1674,68 @@ int Profiler::Finalize()
       MPI_Comm_rank(impl::comm, &rank);
 #endif
 
-    // serialize the logged events in CSV format
-    std::ostringstream oss;
+    int nRanks = 1;
+#if defined(SENSEI_HAS_MPI)
+    if (ok)
+      MPI_Comm_size(impl::comm, &nRanks);
+#endif
+
+    // serialize the logged events. the ranks' parts are written in rank
+    // order to a single file
+    std::string str;
+    if (impl::logFormat == FORMAT_BINARY)
+      {
+      impl::ToBinary(rank, str);
+      }
+    else if (impl::logFormat == FORMAT_CHROME)
+      {
+      // times are relative to the earliest event on any rank
+      double timeOffset = impl::getTimeOffset();
+      impl::chromeTimeOrigin = impl::GetStartTime(timeOffset);
+#if defined(SENSEI_HAS_MPI)
+      if (ok)
+        MPI_Allreduce(MPI_IN_PLACE, &impl::chromeTimeOrigin, 1,
+          MPI_DOUBLE, MPI_MIN, impl::comm);
+#endif
+      std::ostringstream oss;
+      oss << (rank == 0 ? "[\n" : ",\n");
+      impl::ToChrome(oss, rank, impl::chromeTimeOrigin, timeOffset);
+      if (rank == nRanks - 1)
+        oss << "\n]\n";
+      str = oss.str();
+      }
+    else
+      {
+      std::ostringstream oss;
 
-    if (rank == 0)
-      oss << "# rank, thread, Name, start Time, end Time, delta, bytes, Depth" << std::endl;
+      if (rank == 0)
+        {
+        oss << "# rank, thread, Name, start Time, end Time, delta, bytes, Depth";
+        for (const impl::CounterType *ctr : impl::counters)
+          oss << ", " << ctr->Name;
+        if (impl::loggingEnabled & 0x10)
+          oss << ", rss delta KiB, peak rss delta KiB, peak rss KiB, allocated bytes";
+        oss << std::endl;
+        }
 
-    Profiler::ToStream(oss);
+      Profiler::ToStream(oss);
+      str = oss.str();
+      }
 
     // free up resources
-    impl::eventLog.clear();
+    impl::ClearEvents();
 
     if (ok)
-      Profiler::WriteMpiIo(impl::comm, impl::timerLogFile.c_str(), oss.str());
+      Profiler::WriteMpiIo(impl::comm, impl::timerLogFile.c_str(), str);
     else
-      Profiler::WriteCStdio(impl::timerLogFile.c_str(), "w", oss.str());
+      Profiler::WriteCStdio(impl::timerLogFile.c_str(), "w", str);
+    }
+
+  // output the statistics of the whole run
+  if (impl::loggingEnabled & 0x04)
+    {
+    Profiler::WriteStatistics();
+    impl::ClearStats();
     }
 
   // output the memory use profile and clean up resources
@@ -425,8 +1755,7 @@ int Profiler::Finalize()
 bool Profiler::Enabled()
 {
 #if defined(ENABLE_PROFILER)
-  std::lock_guard<std::mutex> lock(impl::eventLogMutex);
-  return impl::loggingEnabled & 0x01;
+  return impl::loggingEnabled & 0x05;
 #else
   return false;
 #endif
@@ -436,7 +1765,6 @@ bool Profiler::Enabled()
 void Profiler::Enable(int arg)
 {
 #if defined(ENABLE_PROFILER)
-  std::lock_guard<std::mutex> lock(impl::eventLogMutex);
   impl::loggingEnabled = arg;
 #else
   (void)arg;
@@ -447,7 +1775,6 @@ void Profiler::Enable(int arg)
 void Profiler::Disable()
 {
 #if defined(ENABLE_PROFILER)
-  std::lock_guard<std::mutex> lock(impl::eventLogMutex);
   impl::loggingEnabled = 0x00;
 #endif
 }
@@ -456,15 +1783,30 @@ void Profiler::Disable()
 int Profiler::StartEvent(const char* eventname, long long nbytes)
 {
 #if defined(ENABLE_PROFILER)
-  if (impl::loggingEnabled & 0x01)
+  int enabled = impl::loggingEnabled;
+  if (enabled & 0x05)
     {
+    impl::ThreadBuffer *tb = impl::GetThreadBuffer();
+
     impl::Event evt;
-    evt.Name = eventname;
-    evt.Time[impl::Event::START] = impl::getSystemTime();
+    evt.NameId = tb->GetNameId(eventname);
     evt.NumBytes = nbytes;
+    evt.Depth = tb->Active.size();
+    evt.Tid = tb->Tid;
+
+    if (enabled & 0x10)
+      impl::StartMemory(evt.Memory);
+    else
+      memset(evt.Memory, 0, sizeof(evt.Memory));
 
-    std::lock_guard<std::mutex> lock(impl::eventLogMutex);
-    impl::activeEvents[evt.Tid].push_back(evt);
+    if (enabled & 0x08)
+      tb->ReadCounters(evt.Counters);
+    else
+      memset(evt.Counters, 0, sizeof(evt.Counters));
+
+    evt.Time[impl::Event::START] = impl::getSystemTime();
+
+    tb->Active.push_back(evt);
     }
 #else
   (void)eventname;
@@ -473,46 +1815,75 @@ int Profiler::StartEvent(const char* eventname, long long nbytes)
   return 0;
 }
 
+//-----------------------------------------------------------------------------
+int Profiler::RecordValue(const char *name, double value)
+{
+#if defined(ENABLE_PROFILER)
+  if (impl::loggingEnabled & 0x04)
+    {
+    impl::ThreadBuffer *tb = impl::GetThreadBuffer();
+    tb->AddValue(tb->GetNameId(name), value);
+    }
+#else
+  (void)name;
+  (void)value;
+#endif
+  return 0;
+}
+
 //-----------------------------------------------------------------------------
 int Profiler::EndEvent(const char* eventname, long long nbytes)
 {
 #if defined(ENABLE_PROFILER)
-  if (impl::loggingEnabled & 0x01)
+  int enabled = impl::loggingEnabled;
+  if (enabled & 0x05)
     {
     // get end Time
     double endTime = impl::getSystemTime();
 
     // get this thread's Event log
-    std::thread::id tid = std::this_thread::get_id();
-
-    std::lock_guard<std::mutex> lock(impl::eventLogMutex);
-    impl::threadMapType::iterator iter = impl::activeEvents.find(tid);
-    if (iter == impl::activeEvents.end())
+    impl::ThreadBuffer *tb = impl::GetThreadBuffer();
+    if (tb->Active.empty())
       {
       SENSEI_ERROR("failed to end Event \"" << eventname
-        << "\" thread  " << tid << " has no events")
+        << "\" thread  " << tb->Tid << " has no events")
       return -1;
       }
 
-    impl::Event evt(std::move(iter->second.back()));
-    iter->second.pop_back();
+    impl::Event evt = tb->Active.back();
+    tb->Active.pop_back();
+
+    if (enabled & 0x08)
+      {
+      long long counters[impl::MaxCounters];
+      tb->ReadCounters(counters);
+      for (int i = 0; i < impl::MaxCounters; ++i)
+        evt.Counters[i] = counters[i] - evt.Counters[i];
+      }
+
+    if (enabled & 0x10)
+      impl::EndMemory(evt.Memory);
 
 #ifdef NDEBUG
     (void)eventname;
 #else
-    if (strcmp(eventname, evt.Name.c_str()) != 0)
+    if (tb->GetNameId(eventname) != evt.NameId)
       {
       SENSEI_ERROR("Mismatched startEvent/endEvent. Expecting: '"
-        << evt.Name << "' Got: '" << eventname << "'")
+        << impl::GetName(evt.NameId) << "' Got: '" << eventname << "'")
       abort();
       }
 #endif
     evt.Time[impl::Event::END] = endTime;
     evt.Time[impl::Event::DELTA] = endTime - evt.Time[impl::Event::START];
     evt.NumBytes = nbytes;
-    evt.Depth = iter->second.size();
 
-    impl::eventLog.emplace_back(std::move(evt));
+    if (enabled & 0x01)
+      tb->Append(evt);
+
+    if (enabled & 0x04)
+      tb->AddStats(evt.NameId, evt.Time[impl::Event::DELTA], nbytes,
+        evt.Counters, evt.Memory);
     }
 #else
   (void)eventname;
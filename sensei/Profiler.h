@@ -14,7 +14,8 @@ namespace sensei
 
 // A class containing methods managing memory and time profiling
 // Each timed event logs rank, event name, start and end time, and
-// duration.
+// duration. Events are recorded in per-thread buffers without locking,
+// the buffers are merged when the log is written.
 class SENSEI_EXPORT Profiler
 {
 public:
@@ -28,7 +29,14 @@ public:
   //   PROFILER_ENABLE     : bit mask turns on or off logging,
   //               0x01 -- event profiling enabled
   //               0x02 -- memory profiling enabled
+  //               0x04 -- event statistics enabled
+  //               0x08 -- performance counters recorded with events
+  //               0x10 -- memory use recorded with events
   //   PROFILER_LOG_FILE   : path to write timer log to
+  //   PROFILER_LOG_FORMAT : format of the timer log, csv, binary, or chrome
+  //   PROFILER_STATS_FILE : path to write event statistics to
+  //   PROFILER_STATS_INTERVAL : number of steps between statistics reports
+  //   PROFILER_COUNTERS   : comma separated performance counters
   //   MEMPROF_LOG_FILE    : path to write memory profiler log to
   //   MEMPROF_INTERVAL    : number of seconds between memory recordings
   //
@@ -54,6 +62,85 @@ public:
   // default value; Timer.csv
   static void SetTimerLogFile(const std::string &fileName);
 
+  // The formats of the timer log.
+  //
+  //   FORMAT_CSV    -- one line per event, see ToStream
+  //   FORMAT_BINARY -- a compact log. Each rank writes a section, in
+  //                    rank order, made of a header: char[8] "SENSEIPF",
+  //                    uint32 version (1), int32 rank, double the offset
+  //                    of the times from the epoch, uint32 number of names,
+  //                    then for each name a uint32 length and the
+  //                    characters, followed by uint64 number of events and
+  //                    the events: int32 name index, int32 depth, int64
+  //                    bytes, double start time, double end time, uint64
+  //                    thread. Native byte order.
+  //   FORMAT_CHROME -- Chrome trace event JSON, for chrome://tracing and
+  //                    Perfetto. Each rank is a process and each of its
+  //                    threads a track. The bandwidth of events that
+  //                    report a number of bytes is shown in a counter.
+  //
+  enum {FORMAT_CSV=0, FORMAT_BINARY=1, FORMAT_CHROME=2};
+
+  // Sets the format of the timer log, one of the above or its name in lower
+  // case. overriden by PROFILER_LOG_FORMAT environment variable
+  // default value: FORMAT_CSV
+  static int SetLogFormat(int format);
+  static int SetLogFormat(const std::string &format);
+
+  // Sets the path to write the event statistics to
+  // overriden by PROFILER_STATS_FILE environment variable
+  // default value: timer_stats.csv
+  static void SetStatisticsFile(const std::string &fileName);
+
+  // Reduce the event statistics over all ranks and append a report to the
+  // statistics file. With event statistics enabled, each thread keeps the
+  // count, total, min, max, variance, bytes and a histogram of the duration
+  // of the events with a given name, rather than the events themselves, so
+  // memory use does not grow with the length of the run. The reports are
+  // cumulative. This is a collective call with respect to the timer's
+  // communicator. It is called by Finalize, by EndStep every statistics
+  // interval, and may be called by the application. Other threads may log
+  // events meanwhile, their events in progress are counted in a later
+  // report.
+  static int WriteStatistics();
+
+  // Sets the number of steps between the statistics reports written by
+  // EndStep. Zero or less writes a report only at Finalize.
+  // overriden by PROFILER_STATS_INTERVAL environment variable
+  // default value: 0
+  static void SetStatisticsInterval(int steps);
+
+  // Marks the end of a step. With event statistics enabled and an interval
+  // set, WriteStatistics is called every interval steps. ConfigurableAnalysis
+  // calls this at the end of each Execute. This is a collective call with
+  // respect to the timer's communicator, all ranks must count the same
+  // steps.
+  static int EndStep();
+
+  // With memory use recorded, the change in resident set size and in peak
+  // resident set size over each event is added to the event log and the
+  // statistics, along with the peak resident set size at its end. These are
+  // for the process, not the thread. When libsenseiAllocationCounter is
+  // loaded with LD_PRELOAD, the bytes allocated by the thread during each
+  // event are also reported, see AllocationCounter.cxx. With event
+  // statistics this gives the bytes allocated and peak memory use of each
+  // analysis and adaptor.
+
+  // Sets the performance counters recorded with each event, a comma
+  // separated list of up to 4 of: cycles, instructions, cache-references,
+  // cache-misses, branches, branch-misses, stalled-cycles-frontend,
+  // stalled-cycles-backend, task-clock, page-faults, context-switches,
+  // cpu-migrations. The counters are read with Linux perf_event_open at the
+  // start and end of each event, counting the calling thread in user space,
+  // and their change is added to the event log and the statistics. The
+  // counts include reading the counters, a system call at each end. The
+  // instructions per cycle and bytes per cycle are derived in the
+  // statistics. When the counters are not available a warning is issued
+  // and zeros are reported. This must be called before events are logged.
+  // overriden by PROFILER_COUNTERS environment variable
+  // default value: cycles,instructions,cache-misses,branch-misses
+  static int SetCounters(const std::string &names);
+
   // Sets the path to write the timer log to
   // overriden by MEMPROF_LOG_FILE environment variable
   // default value: MemProfLog.csv
@@ -65,11 +152,12 @@ public:
 
   // Enable/Disable logging. Overriden by PROFILER_ENABLE environment
   // variable. In the default format a CSV file is generated capturing each
-  // ranks timer events. default value: disabled
+  // ranks timer events. See Initialize for the bits of the argument.
+  // default value: disabled
   static void Enable(int arg = 0x03);
   static void Disable();
 
-  // return true if loggin is enabled.
+  // return true if event logging or statistics are enabled.
   static bool Enabled();
 
   // @brief Log start of an event.
@@ -85,6 +173,16 @@ public:
   // must match when calling endEvent() to mark the end of the event.
   static int EndEvent(const char *eventname, long long nbytes=-1ll);
 
+  // @brief Record a value, such as a ratio or a count, that is not the
+  // duration of an event.
+  //
+  // With event statistics enabled, the count, total, min, mean, and max of
+  // the values recorded with a given name are reduced over all ranks and
+  // written in a "values" section of the statistics report, apart from the
+  // event statistics. Otherwise the value is ignored. Values are not part
+  // of the event log.
+  static int RecordValue(const char *name, double value);
+
   // write contents of the string to the file.
   static int WriteCStdio(const char *fileName, const char *mode,
      const std::string &str);
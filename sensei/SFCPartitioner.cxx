@@ -0,0 +1,247 @@
+#include "SFCPartitioner.h"
+#include "Profiler.h"
+
+#include <pugixml.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <sstream>
+
+namespace sensei
+{
+
+namespace
+{
+const char *curveNames[] = {"hilbert", "morton"};
+
+// bits of each coordinate in the keys, 3 coordinates fit in 64 bits
+const int keyBits = 21;
+
+// convert the coordinates in place to the transpose of the Hilbert index,
+// after J. Skilling, Programming the Hilbert curve, AIP Conf. Proc. 707, 2004
+void HilbertTranspose(uint32_t x[3])
+{
+  uint32_t m = 1u << (keyBits - 1);
+
+  // inverse undo
+  for (uint32_t q = m; q > 1; q >>= 1)
+    {
+    uint32_t p = q - 1;
+    for (int i = 0; i < 3; ++i)
+      {
+      if (x[i] & q)
+        {
+        x[0] ^= p;
+        }
+      else
+        {
+        uint32_t t = (x[0] ^ x[i]) & p;
+        x[0] ^= t;
+        x[i] ^= t;
+        }
+      }
+    }
+
+  // gray encode
+  for (int i = 1; i < 3; ++i)
+    x[i] ^= x[i-1];
+
+  uint32_t t = 0;
+  for (uint32_t q = m; q > 1; q >>= 1)
+    {
+    if (x[2] & q)
+      t ^= q - 1;
+    }
+
+  for (int i = 0; i < 3; ++i)
+    x[i] ^= t;
+}
+
+// interleave the bits of the coordinates, most significant first
+uint64_t Interleave(const uint32_t x[3])
+{
+  uint64_t key = 0;
+  for (int b = keyBits - 1; b >= 0; --b)
+    {
+    for (int i = 0; i < 3; ++i)
+      key = (key << 1) | ((x[i] >> b) & 1u);
+    }
+  return key;
+}
+}
+
+// --------------------------------------------------------------------------
+int SFCPartitioner::SetCurve(int curve)
+{
+  if ((curve < CURVE_HILBERT) || (curve > CURVE_MORTON))
+    {
+    SENSEI_ERROR("Invalid curve " << curve)
+    return -1;
+    }
+
+  this->Curve = curve;
+  return 0;
+}
+
+// --------------------------------------------------------------------------
+int SFCPartitioner::SetCurve(const std::string &curve)
+{
+  for (int i = CURVE_HILBERT; i <= CURVE_MORTON; ++i)
+    {
+    if (curve == curveNames[i])
+      return this->SetCurve(i);
+    }
+
+  SENSEI_ERROR("Invalid curve \"" << curve << "\". Use one of hilbert or morton")
+  return -1;
+}
+
+// --------------------------------------------------------------------------
+int SFCPartitioner::GetBlockCenters(const MeshMetadataPtr &md,
+  std::vector<std::array<double,3>> &centers)
+{
+  unsigned int nBlocks = md->NumBlocks;
+  centers.resize(nBlocks);
+
+  if (md->BlockBounds.size() == nBlocks)
+    {
+    for (unsigned int i = 0; i < nBlocks; ++i)
+      {
+      const std::array<double,6> &bds = md->BlockBounds[i];
+      for (int j = 0; j < 3; ++j)
+        centers[i][j] = 0.5*(bds[2*j] + bds[2*j+1]);
+      }
+    return 0;
+    }
+
+  if (md->BlockExtents.size() == nBlocks)
+    {
+    // AMR extents are in the index space of the block's level, bring them
+    // to the coarsest level
+    bool amr = (md->BlockLevel.size() == nBlocks) &&
+      (md->RefRatio.size() == unsigned(md->NumLevels));
+
+    for (unsigned int i = 0; i < nBlocks; ++i)
+      {
+      std::array<double,3> scale = {{1.0, 1.0, 1.0}};
+      for (int l = 0; amr && (l < md->BlockLevel[i]); ++l)
+        {
+        for (int j = 0; j < 3; ++j)
+          scale[j] *= md->RefRatio[l][j];
+        }
+
+      const std::array<int,6> &ext = md->BlockExtents[i];
+      for (int j = 0; j < 3; ++j)
+        centers[i][j] = 0.5*(ext[2*j] + ext[2*j+1] + 1)/scale[j];
+      }
+    return 0;
+    }
+
+  SENSEI_ERROR("The SFCPartitioner requires the bounds or extents of each"
+    " block, but the metadata for mesh \"" << md->MeshName
+    << "\" does not have them")
+  return -1;
+}
+
+// --------------------------------------------------------------------------
+int SFCPartitioner::GetBlockOrder(const MeshMetadataPtr &md,
+  std::vector<unsigned int> &order)
+{
+  std::vector<std::array<double,3>> centers;
+  if (this->GetBlockCenters(md, centers))
+    return -1;
+
+  unsigned int nBlocks = centers.size();
+
+  // the box containing the centers
+  std::array<double,3> lo, hi;
+  lo.fill(std::numeric_limits<double>::max());
+  hi.fill(std::numeric_limits<double>::lowest());
+
+  for (unsigned int i = 0; i < nBlocks; ++i)
+    {
+    for (int j = 0; j < 3; ++j)
+      {
+      lo[j] = std::min(lo[j], centers[i][j]);
+      hi[j] = std::max(hi[j], centers[i][j]);
+      }
+    }
+
+  // the key of each center, on a grid of 2^keyBits cells spanning the box.
+  // the same scale is used in all directions so that distances are
+  // preserved
+  double len = 0.0;
+  for (int j = 0; nBlocks && (j < 3); ++j)
+    len = std::max(len, hi[j] - lo[j]);
+
+  double maxCoord = double((1u << keyBits) - 1);
+  double scale = len > 0.0 ? maxCoord/len : 0.0;
+
+  std::vector<uint64_t> keys(nBlocks);
+  for (unsigned int i = 0; i < nBlocks; ++i)
+    {
+    uint32_t x[3];
+    for (int j = 0; j < 3; ++j)
+      x[j] = uint32_t(std::min(maxCoord, (centers[i][j] - lo[j])*scale));
+
+    if (this->Curve == CURVE_HILBERT)
+      HilbertTranspose(x);
+
+    keys[i] = Interleave(x);
+    }
+
+  // blocks with the same key keep their relative order
+  order.resize(nBlocks);
+  for (unsigned int i = 0; i < nBlocks; ++i)
+    order[i] = i;
+
+  std::stable_sort(order.begin(), order.end(),
+    [&keys](unsigned int a, unsigned int b) { return keys[a] < keys[b]; });
+
+  return 0;
+}
+
+// --------------------------------------------------------------------------
+int SFCPartitioner::GetPartition(MPI_Comm comm, const MeshMetadataPtr &mdIn,
+  MeshMetadataPtr &mdOut)
+{
+  TimeEvent<128> mark("SFCPartitioner::GetPartition");
+
+  mdOut = mdIn->NewCopy();
+
+  int nRanks = 1;
+  MPI_Comm_size(comm, &nRanks);
+
+  std::vector<double> costs;
+  std::vector<unsigned int> order;
+  if (this->GetBlockCosts(mdOut, costs) || this->GetBlockOrder(mdOut, order))
+    return -1;
+
+  mdOut->BlockOwner.resize(mdOut->NumBlocks);
+
+  SplitPrefix(order, costs, nRanks, mdOut->BlockOwner);
+
+  this->UpdateImbalance(mdOut, costs, nRanks);
+
+  return 0;
+}
+
+// --------------------------------------------------------------------------
+int SFCPartitioner::Initialize(pugi::xml_node &node)
+{
+  TimeEvent<128> mark("SFCPartitioner::Initialize");
+
+  std::ostringstream oss;
+  if (this->SetCurve(node.attribute("curve").as_string("hilbert")) ||
+    this->InitializeCostModel(node, oss))
+    return -1;
+
+  oss << " curve=" << curveNames[this->Curve];
+
+  SENSEI_STATUS("Configured SFCPartitioner " << oss.str())
+
+  return 0;
+}
+
+}
@@ -26,6 +26,13 @@ con_t Sum(const std::vector<con_t> &vec)
   return sum;
 }
 
+// --------------------------------------------------------------------------
+template<typename con_t>
+void Append(std::vector<con_t> &out, const std::vector<con_t> &in)
+{
+  out.insert(out.end(), in.begin(), in.end());
+}
+
 // --------------------------------------------------------------------------
 template<typename con_t, unsigned long n>
 void InitializeRange(std::array<con_t,n> &out)
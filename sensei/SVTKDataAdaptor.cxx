@@ -2,6 +2,9 @@
 #include "SVTKUtils.h"
 #include "Error.h"
 #include "MeshMetadata.h"
+#include "MeshMetadataMap.h"
+#include "DataRequirements.h"
+#include "Profiler.h"
 
 #include <svtkCompositeDataIterator.h>
 #include <svtkCompositeDataSet.h>
@@ -76,6 +79,105 @@ int SVTKDataAdaptor::GetDataObject(const std::string &meshName,
   return 0;
 }
 
+//----------------------------------------------------------------------------
+int SVTKDataAdaptor::SetDataObjects(DataAdaptor *data,
+  const DataRequirements &reqs, bool deepCopy)
+{
+  TimeEvent<128> mark("SVTKDataAdaptor::SetDataObjects");
+
+  // with no requirements specified fetch everything
+  DataRequirements allReqs;
+  const DataRequirements *pReqs = &reqs;
+  if (reqs.Empty())
+    {
+    if (allReqs.Initialize(data, false))
+      {
+      SENSEI_ERROR("Failed to determine the available meshes and arrays")
+      return -1;
+      }
+    pReqs = &allReqs;
+    }
+
+  // ghost zones are fetched when the simulation provides them
+  MeshMetadataMap mdMap;
+  if (mdMap.Initialize(data))
+    {
+    SENSEI_ERROR("Failed to get metadata")
+    return -1;
+    }
+
+  this->ReleaseData();
+  this->SetDataTime(data->GetDataTime());
+  this->SetDataTimeStep(data->GetDataTimeStep());
+
+  MeshRequirementsIterator mit = pReqs->GetMeshRequirementsIterator();
+  for (; mit; ++mit)
+    {
+    const std::string &meshName = mit.MeshName();
+
+    MeshMetadataPtr mmd;
+    if (mdMap.GetMeshMetadata(meshName, mmd))
+      {
+      SENSEI_ERROR("Failed to get metadata for mesh \"" << meshName << "\"")
+      return -1;
+      }
+
+    svtkDataObject *dobj = nullptr;
+    if (data->GetMesh(meshName, mit.StructureOnly(), dobj))
+      {
+      SENSEI_ERROR("Failed to get mesh \"" << meshName << "\"")
+      return -1;
+      }
+
+    // not all ranks need to have data
+    if (!dobj)
+      {
+      this->SetDataObject(meshName, nullptr);
+      continue;
+      }
+
+    ArrayRequirementsIterator ait = pReqs->GetArrayRequirementsIterator(meshName);
+    for (; ait; ++ait)
+      {
+      if (data->AddArray(dobj, meshName, ait.Association(), ait.Array()))
+        {
+        SENSEI_ERROR("Failed to add " << SVTKUtils::GetAttributesName(ait.Association())
+          << " data array \"" << ait.Array() << "\" to mesh \"" << meshName << "\"")
+        dobj->Delete();
+        return -1;
+        }
+      }
+
+    if ((mmd->NumGhostCells || SVTKUtils::AMR(mmd)) &&
+      data->AddGhostCellsArray(dobj, meshName))
+      {
+      SENSEI_ERROR("Failed to add ghost cells to mesh \"" << meshName << "\"")
+      dobj->Delete();
+      return -1;
+      }
+
+    if (mmd->NumGhostNodes && data->AddGhostNodesArray(dobj, meshName))
+      {
+      SENSEI_ERROR("Failed to add ghost nodes to mesh \"" << meshName << "\"")
+      dobj->Delete();
+      return -1;
+      }
+
+    if (deepCopy)
+      {
+      svtkDataObject *dcpy = dobj->NewInstance();
+      dcpy->DeepCopy(dobj);
+      dobj->Delete();
+      dobj = dcpy;
+      }
+
+    this->SetDataObject(meshName, dobj);
+    dobj->Delete();
+    }
+
+  return 0;
+}
+
 //----------------------------------------------------------------------------
 int SVTKDataAdaptor::GetNumberOfMeshes(unsigned int &numMeshes)
 {
@@ -239,6 +341,56 @@ int SVTKDataAdaptor::AddArray(svtkDataObject* mesh, const std::string &meshName,
   return 0;
 }
 
+//----------------------------------------------------------------------------
+int SVTKDataAdaptor::AddGhostNodesArray(svtkDataObject* mesh,
+  const std::string &meshName)
+{
+  return this->AddGhostArray(mesh, meshName, svtkDataObject::POINT);
+}
+
+//----------------------------------------------------------------------------
+int SVTKDataAdaptor::AddGhostCellsArray(svtkDataObject* mesh,
+  const std::string &meshName)
+{
+  return this->AddGhostArray(mesh, meshName, svtkDataObject::CELL);
+}
+
+//----------------------------------------------------------------------------
+int SVTKDataAdaptor::AddGhostArray(svtkDataObject* mesh,
+  const std::string &meshName, int association)
+{
+  // define helper function to add the array to the mesh. blocks without
+  // ghost zones are skipped
+  SVTKUtils::BinaryDatasetFunction addArray =
+    [&](svtkDataSet *ds, svtkDataSet *dsOut) -> int
+    {
+    svtkFieldData *dsa = SVTKUtils::GetAttributes(ds, association);
+    svtkFieldData *dsaOut = SVTKUtils::GetAttributes(dsOut, association);
+
+    if (svtkDataArray *da = dsa->GetArray("svtkGhostType"))
+      dsaOut->AddArray(da);
+
+    return 0;
+    };
+
+  // get the cached copy of the mesh
+  svtkDataObject *dobj = nullptr;
+  if (this->GetDataObject(meshName, dobj))
+    {
+    SENSEI_ERROR("Failed to get mesh \"" << meshName << "\"")
+    return -1;
+    }
+
+  // apply the helper function
+  if (SVTKUtils::Apply(dobj, mesh, addArray))
+    {
+    SENSEI_ERROR("Failed to add ghost zones to mesh \"" << meshName  << "\"")
+    return -1;
+    }
+
+  return 0;
+}
+
 // TODO
 /*
 //----------------------------------------------------------------------------
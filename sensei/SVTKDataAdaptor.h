@@ -8,6 +8,8 @@ class svtkDataObject;
 
 namespace sensei
 {
+class DataRequirements;
+
 /**  A sensei::DataAdaptor for a svtkDataObject.  To use this data adaptor for
  * codes that produce a svtkDataObject natively. Once simply passes the
  * svtkDataObject instance to this class and one then connect it to the
@@ -41,6 +43,20 @@ public:
    */
   int GetDataObject(const std::string &meshName, svtkDataObject *&dobj);
 
+  /** Fetches the meshes, arrays, and ghost zones named in the requirements
+   * from another data adaptor and stores them along with the time and time
+   * step. When the requirements are empty everything the other adaptor
+   * provides is fetched. When \c deepCopy is set the data is copied so that
+   * the other adaptor's data may be modified or released afterwards.
+   *
+   *  @param[in] data the data adaptor to fetch from
+   *  @param[in] reqs the meshes and arrays to fetch
+   *  @param[in] deepCopy if true copy the data
+   *  @returns zero if successful
+   */
+  int SetDataObjects(DataAdaptor *data, const DataRequirements &reqs,
+    bool deepCopy);
+
 
   int GetNumberOfMeshes(unsigned int &numMeshes) override;
   int GetMeshMetadata(unsigned int id, MeshMetadataPtr &metadata) override;
@@ -53,12 +69,23 @@ public:
   int AddArray(svtkDataObject* mesh, const std::string &meshName,
     int association, const std::string &arrayName) override;
 
+  /// adds the svtkGhostType array of the cached mesh when it has one
+  int AddGhostNodesArray(svtkDataObject* mesh,
+    const std::string &meshName) override;
+
+  int AddGhostCellsArray(svtkDataObject* mesh,
+    const std::string &meshName) override;
+
   int ReleaseData() override;
 
 protected:
   SVTKDataAdaptor();
   ~SVTKDataAdaptor();
 
+  // adds the svtkGhostType array with the given association, if present
+  int AddGhostArray(svtkDataObject* mesh, const std::string &meshName,
+    int association);
+
 private:
   SVTKDataAdaptor(const SVTKDataAdaptor&); // Not implemented.
   void operator=(const SVTKDataAdaptor&); // Not implemented.
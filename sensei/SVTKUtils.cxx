@@ -64,6 +64,11 @@
 #include <svtkCallbackCommand.h>
 #include <svtkVersionMacros.h>
 #include <svtkType.h>
+#include <svtkInformation.h>
+#include <svtkInformationDoubleVectorKey.h>
+#include <svtkSMPTools.h>
+#include <svtkSMPThreadLocal.h>
+#include <svtkAtomic.h>
 #if defined(ENABLE_VTK_IO)
 #include <vtkXMLUnstructuredGridWriter.h>
 #endif
@@ -120,6 +125,9 @@
 
 #include <sstream>
 #include <functional>
+#include <limits>
+#include <mutex>
+#include <array>
 #include <mpi.h>
 
 using svtkDataObjectPtr = svtkSmartPointer<svtkDataObject>;
@@ -625,23 +633,328 @@ int GetArrayMetadata(svtkDataSetAttributes *dsa, int centering,
   return 0;
 }
 
+namespace
+{
+// Stands in for the ghost array of a block that has no ghost zones, with this
+// type the ghost masking compiles away.
+struct NoGhosts
+{
+  unsigned char operator[](svtkIdType) const { return 0; }
+};
+
+// Stands in for the stride of a contiguous array so that the compiler sees
+// unit stride accesses.
+struct UnitStride
+{
+  operator svtkIdType() const { return 1; }
+};
+
+/* Computes the range of the valid values in [start, end) of a strided array
+ * and accumulates it into minVal and maxVal. A min and max is kept per lane
+ * so that the inner loop is element wise and vectorizes. Ghosted values are
+ * masked with a select rather than a branch for the same reason. NaNs fail
+ * both comparisons and are skipped without a test.
+ */
+template <typename data_t, typename stride_t, typename ghost_t>
+void RangeKernel(const data_t *data, stride_t stride, ghost_t ghosts,
+  svtkIdType start, svtkIdType end, data_t &minVal, data_t &maxVal)
+{
+  constexpr svtkIdType nLanes = 16;
+
+  data_t laneMin[nLanes];
+  data_t laneMax[nLanes];
+  for (svtkIdType k = 0; k < nLanes; ++k)
+    {
+    laneMin[k] = minVal;
+    laneMax[k] = maxVal;
+    }
+
+  svtkIdType nFull = start + (end - start) / nLanes * nLanes;
+  for (svtkIdType i = start; i < nFull; i += nLanes)
+    {
+    for (svtkIdType k = 0; k < nLanes; ++k)
+      {
+      data_t value = data[(i + k)*stride];
+      bool valid = ghosts[i + k] == 0;
+      laneMin[k] = (valid && (value < laneMin[k])) ? value : laneMin[k];
+      laneMax[k] = (valid && (value > laneMax[k])) ? value : laneMax[k];
+      }
+    }
+
+  for (svtkIdType i = nFull; i < end; ++i)
+    {
+    data_t value = data[i*stride];
+    bool valid = ghosts[i] == 0;
+    laneMin[0] = (valid && (value < laneMin[0])) ? value : laneMin[0];
+    laneMax[0] = (valid && (value > laneMax[0])) ? value : laneMax[0];
+    }
+
+  for (svtkIdType k = 0; k < nLanes; ++k)
+    {
+    minVal = laneMin[k] < minVal ? laneMin[k] : minVal;
+    maxVal = laneMax[k] > maxVal ? laneMax[k] : maxVal;
+    }
+}
+
+// Runs the range kernel over chunks of the array with svtkSMPTools
+template <typename data_t, typename ghost_t>
+struct RangeFunctor
+{
+  RangeFunctor(const data_t *data, svtkIdType stride, ghost_t ghosts)
+    : Data(data), Stride(stride), Ghosts(ghosts) {}
+
+  void Initialize()
+  {
+    std::array<data_t,2> &rng = this->Range.Local();
+    rng[0] = std::numeric_limits<data_t>::max();
+    rng[1] = std::numeric_limits<data_t>::lowest();
+  }
+
+  void operator()(svtkIdType start, svtkIdType end)
+  {
+    std::array<data_t,2> &rng = this->Range.Local();
+    if (this->Stride == 1)
+      RangeKernel(this->Data, UnitStride(), this->Ghosts, start, end, rng[0], rng[1]);
+    else
+      RangeKernel(this->Data, this->Stride, this->Ghosts, start, end, rng[0], rng[1]);
+  }
+
+  void Reduce() {}
+
+  const data_t *Data;
+  svtkIdType Stride;
+  ghost_t Ghosts;
+  svtkSMPThreadLocal<std::array<data_t,2>> Range;
+};
+
+template <typename data_t, typename ghost_t>
+void ComputeRange(const data_t *data, svtkIdType stride, ghost_t ghosts,
+  svtkIdType nTuples, double range[2])
+{
+  RangeFunctor<data_t, ghost_t> func(data, stride, ghosts);
+  svtkSMPTools::For(0, nTuples, 32768, func);
+
+  data_t minVal = std::numeric_limits<data_t>::max();
+  data_t maxVal = std::numeric_limits<data_t>::lowest();
+  for (const std::array<data_t,2> &rng : func.Range)
+    {
+    minVal = std::min(minVal, rng[0]);
+    maxVal = std::max(maxVal, rng[1]);
+    }
+
+  if (minVal <= maxVal)
+    {
+    range[0] = minVal;
+    range[1] = maxVal;
+    }
+}
+
+// The cached ranges are stored in the array's information as tuples of
+// component, array modified time, ghost array modified time, min, and max.
+svtkInformationDoubleVectorKey *VALID_RANGE()
+{
+  static svtkInformationDoubleVectorKey *key =
+    new svtkInformationDoubleVectorKey("VALID_RANGE", "sensei::SVTKUtils");
+  return key;
+}
+
+// serializes access to the cached ranges, arrays are shared by analyses
+// running concurrently
+std::mutex rangeCacheMutex;
+}
+
+// --------------------------------------------------------------------------
+int GetArrayRange(svtkDataArray *da, svtkUnsignedCharArray *ghosts, int comp,
+  double range[2])
+{
+  range[0] = std::numeric_limits<double>::max();
+  range[1] = std::numeric_limits<double>::lowest();
+
+  int nComps = da->GetNumberOfComponents();
+  svtkIdType nTuples = da->GetNumberOfTuples();
+
+  if ((comp < 0) || (comp >= nComps))
+    {
+    SENSEI_ERROR("Invalid component " << comp << " of array \""
+      << (da->GetName() ? da->GetName() : "") << "\" with "
+      << nComps << " components")
+    return -1;
+    }
+
+  if (ghosts && (ghosts->GetNumberOfTuples() != nTuples))
+    {
+    SENSEI_ERROR("The ghost array has " << ghosts->GetNumberOfTuples()
+      << " values but array \"" << (da->GetName() ? da->GetName() : "")
+      << "\" has " << nTuples)
+    return -1;
+    }
+
+  // look for a cached range. the information is created before the modified
+  // time is read, as creating it modifies the array
+  svtkInformation *info = nullptr;
+  double arrayTime = 0.0;
+  double ghostTime = ghosts ? double(ghosts->GetMTime()) : 0.0;
+  {
+  std::lock_guard<std::mutex> lock(rangeCacheMutex);
+
+  info = da->GetInformation();
+  arrayTime = double(da->GetMTime());
+
+  int n = info->Length(VALID_RANGE());
+  double *cache = info->Get(VALID_RANGE());
+  for (int i = 0; i < n; i += 5)
+    {
+    if ((cache[i] == comp) && (cache[i + 1] == arrayTime) &&
+      (cache[i + 2] == ghostTime))
+      {
+      range[0] = cache[i + 3];
+      range[1] = cache[i + 4];
+      return 0;
+      }
+    }
+  }
+
+  // compute the range
+  const unsigned char *pGhosts = ghosts ? ghosts->GetPointer(0) : nullptr;
+
+  switch (da->GetDataType())
+    {
+    svtkTemplateMacro(
+      using SOA_ARRAY_TT = svtkSOADataArrayTemplate<SVTK_TT>;
+
+      const SVTK_TT *pData = nullptr;
+      svtkIdType stride = 1;
+      SOA_ARRAY_TT *soaDa = nullptr;
+
+      if (da->HasStandardMemoryLayout())
+        {
+        pData = static_cast<const SVTK_TT*>(da->GetVoidPointer(0)) + comp;
+        stride = nComps;
+        }
+      else if ((soaDa = dynamic_cast<SOA_ARRAY_TT*>(da)))
+        {
+        pData = soaDa->GetComponentArrayPointer(comp);
+        }
+
+      if (pData && pGhosts)
+        {
+        ComputeRange(pData, stride, pGhosts, nTuples, range);
+        }
+      else if (pData)
+        {
+        ComputeRange(pData, stride, NoGhosts(), nTuples, range);
+        }
+      else
+        {
+        // other layouts are read through the virtual API
+        for (svtkIdType i = 0; i < nTuples; ++i)
+          {
+          double value = da->GetComponent(i, comp);
+          if (!(pGhosts && pGhosts[i]) && (value == value))
+            {
+            range[0] = std::min(range[0], value);
+            range[1] = std::max(range[1], value);
+            }
+          }
+        }
+      );
+    default:
+      {
+      SENSEI_ERROR("Unsupported array type " << da->GetClassName())
+      return -1;
+      }
+    }
+
+  // cache the range, replacing any out of date range of this component
+  {
+  std::lock_guard<std::mutex> lock(rangeCacheMutex);
+
+  int n = info->Length(VALID_RANGE());
+  double *cache = info->Get(VALID_RANGE());
+
+  std::vector<double> entries;
+  entries.reserve(n + 5);
+  for (int i = 0; i < n; i += 5)
+    {
+    if (cache[i] != comp)
+      entries.insert(entries.end(), cache + i, cache + i + 5);
+    }
+
+  double entry[5] = {double(comp), arrayTime, ghostTime, range[0], range[1]};
+  entries.insert(entries.end(), entry, entry + 5);
+
+  info->Set(VALID_RANGE(), entries.data(), int(entries.size()));
+  }
+
+  return 0;
+}
+
 // --------------------------------------------------------------------------
 int GetArrayMetadata(svtkDataSetAttributes *dsa,
   std::vector<std::array<double,2>> &arrayRange)
 {
+  svtkUnsignedCharArray *ghosts = dynamic_cast<svtkUnsignedCharArray*>(
+    dsa->GetArray("svtkGhostType"));
+
   int na = dsa->GetNumberOfArrays();
   for (int i = 0; i < na; ++i)
     {
     svtkDataArray *da = dsa->GetArray(i);
 
     double rng[2];
-    da->GetRange(rng);
+    if (GetArrayRange(da, da == ghosts ? nullptr : ghosts, 0, rng))
+      return -1;
 
     arrayRange.emplace_back(std::array<double,2>({rng[0], rng[1]}));
     }
   return 0;
 }
 
+// --------------------------------------------------------------------------
+int GetArrayRanges(svtkCompositeDataSet *cd)
+{
+  // the arrays of all local blocks, and their ghost arrays
+  std::vector<std::pair<svtkDataArray*, svtkUnsignedCharArray*>> arrays;
+
+  svtkCompositeDataIteratorPtr cdit;
+  cdit.TakeReference(cd->NewIterator());
+  for (cdit->InitTraversal(); !cdit->IsDoneWithTraversal(); cdit->GoToNextItem())
+    {
+    svtkDataSet *ds = dynamic_cast<svtkDataSet*>(cdit->GetCurrentDataObject());
+    if (!ds)
+      continue;
+
+    for (svtkDataSetAttributes *dsa :
+      {(svtkDataSetAttributes*)ds->GetPointData(), (svtkDataSetAttributes*)ds->GetCellData()})
+      {
+      svtkUnsignedCharArray *ghosts = dynamic_cast<svtkUnsignedCharArray*>(
+        dsa->GetArray("svtkGhostType"));
+
+      int na = dsa->GetNumberOfArrays();
+      for (int i = 0; i < na; ++i)
+        {
+        svtkDataArray *da = dsa->GetArray(i);
+        arrays.emplace_back(da, da == ghosts ? nullptr : ghosts);
+        }
+      }
+    }
+
+  // compute the ranges in parallel over the arrays. the array ranges are
+  // computed serially, unless there is only one
+  svtkAtomic<int> ierr(0);
+  svtkSMPTools::For(0, arrays.size(), 1, [&](svtkIdType first, svtkIdType last)
+    {
+    for (svtkIdType i = first; i < last; ++i)
+      {
+      double rng[2];
+      if (GetArrayRange(arrays[i].first, arrays[i].second, 0, rng))
+        ierr = -1;
+      }
+    });
+
+  return ierr;
+}
+
 // --------------------------------------------------------------------------
 int GetArrayMetadata(svtkDataSet *ds, MeshMetadataPtr &metadata)
 {
@@ -735,8 +1048,9 @@ int GetBlockMetadata(int rank, int id, svtkDataSet *ds,
   if (flags.BlockArrayRangeSet())
     {
     std::vector<std::array<double,2>> arrayRange;
-    GetArrayMetadata(ds->GetPointData(), arrayRange);
-    GetArrayMetadata(ds->GetCellData(), arrayRange);
+    if (GetArrayMetadata(ds->GetPointData(), arrayRange) ||
+      GetArrayMetadata(ds->GetCellData(), arrayRange))
+      return -1;
     blockArrayRange.emplace_back(std::move(arrayRange));
     }
 
@@ -778,6 +1092,15 @@ int GetMetadata(MPI_Comm comm, svtkCompositeDataSet *cd, MeshMetadataPtr metadat
       metadata->CoordinateType = ps->GetPoints()->GetData()->GetDataType();
     }
 
+  // compute the array ranges of all the blocks in parallel. these are
+  // cached and picked up below
+  if (metadata->Flags.BlockArrayRangeSet() && SVTKUtils::GetArrayRanges(cd))
+    {
+    SENSEI_ERROR("Failed to compute the array ranges")
+    cdit->Delete();
+    return -1;
+    }
+
   // get block metadata
   int numBlocks = 0;
   int numBlocksLocal = 0;
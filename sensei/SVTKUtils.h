@@ -12,6 +12,7 @@ class svtkFieldData;
 class svtkCellData;
 class svtkPointData;
 class svtkDataArray;
+class svtkUnsignedCharArray;
 class svtkTypeInt64Array;
 class svtkTypeInt32Array;
 class svtkCellArray;
@@ -190,6 +191,25 @@ SENSEI_EXPORT
 int GetGhostLayerMetadata(svtkDataObject *mesh,
   int &nGhostCellLayers, int &nGhostNodeLayers);
 
+/** Computes the range of the valid values of a component of an array. NaNs
+ * and the values in ghost zones, where the ghost array is non-zero, are
+ * skipped. The ghost array may be null. The range is computed in parallel
+ * with svtkSMPTools by a vectorized kernel, and is cached on the array. The
+ * cached range is returned until the array or the ghost array is modified.
+ * If there are no valid values the range is [max, lowest]. This is the way
+ * analyses should obtain the range of the valid data of a block.
+ */
+SENSEI_EXPORT
+int GetArrayRange(svtkDataArray *da, svtkUnsignedCharArray *ghosts, int comp,
+  double range[2]);
+
+/** Computes and caches the ranges of the first component of the arrays of
+ * all the local blocks of a composite dataset, skipping the values in ghost
+ * zones. The arrays are processed in parallel.
+ */
+SENSEI_EXPORT
+int GetArrayRanges(svtkCompositeDataSet *cd);
+
 /*** Get  metadata, note that data set variant is not meant to be used on blocks
  * of a multi-block
  */
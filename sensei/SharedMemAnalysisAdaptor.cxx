@@ -0,0 +1,230 @@
+#include "SharedMemAnalysisAdaptor.h"
+
+#include "SharedMemSchema.h"
+#include "DataAdaptor.h"
+#include "MeshMetadataMap.h"
+#include "SVTKUtils.h"
+#include "Profiler.h"
+#include "Error.h"
+
+#include <svtkCompositeDataSet.h>
+#include <svtkDataObject.h>
+#include <svtkObjectFactory.h>
+
+#include <mpi.h>
+#include <vector>
+#include <pugixml.hpp>
+
+namespace sensei
+{
+
+//----------------------------------------------------------------------------
+senseiNewMacro(SharedMemAnalysisAdaptor);
+
+//----------------------------------------------------------------------------
+SharedMemAnalysisAdaptor::SharedMemAnalysisAdaptor() :
+  Stream(new senseiSharedMem::OutputStream), StreamName("sensei"), NumSlots(2)
+{
+}
+
+//----------------------------------------------------------------------------
+SharedMemAnalysisAdaptor::~SharedMemAnalysisAdaptor()
+{
+  delete this->Stream;
+}
+
+//-----------------------------------------------------------------------------
+int SharedMemAnalysisAdaptor::SetDataRequirements(const DataRequirements &reqs)
+{
+  this->Requirements = reqs;
+  return 0;
+}
+
+//-----------------------------------------------------------------------------
+int SharedMemAnalysisAdaptor::AddDataRequirement(const std::string &meshName,
+  int association, const std::vector<std::string> &arrays)
+{
+  this->Requirements.AddRequirement(meshName, association, arrays);
+  return 0;
+}
+
+//-----------------------------------------------------------------------------
+int SharedMemAnalysisAdaptor::FetchFromProducer(
+  sensei::DataAdaptor *dataAdaptor,
+  std::vector<svtkCompositeDataSetPtr> &objects,
+  std::vector<MeshMetadataPtr> &metadata)
+{
+  // include the full suite of metadata for the end-point partitioners
+  MeshMetadataFlags flags;
+  flags.SetBlockDecomp();
+  flags.SetBlockSize();
+  flags.SetBlockBounds();
+  flags.SetBlockExtents();
+  flags.SetBlockArrayRange();
+
+  MeshMetadataMap mdm;
+  if (mdm.Initialize(dataAdaptor, flags))
+    {
+    SENSEI_ERROR("Failed to get metadata")
+    return -1;
+    }
+
+  // only the required meshes and arrays are shared
+  MeshRequirementsIterator mit =
+    this->Requirements.GetMeshRequirementsIterator();
+
+  while (mit)
+    {
+    MeshMetadataPtr mdIn;
+    if (mdm.GetMeshMetadata(mit.MeshName(), mdIn))
+      {
+      SENSEI_ERROR("Failed to get mesh metadata for mesh \""
+        << mit.MeshName() << "\"")
+      return -1;
+      }
+
+    MeshMetadataPtr mdOut = mdIn->NewCopy();
+    mdOut->ClearArrayInfo();
+
+    svtkDataObject *dobj = nullptr;
+    if (dataAdaptor->GetMesh(mit.MeshName(), mit.StructureOnly(), dobj))
+      {
+      SENSEI_ERROR("Failed to get mesh \"" << mit.MeshName() << "\"")
+      return -1;
+      }
+
+    if ((mdIn->NumGhostCells || SVTKUtils::AMR(mdIn)) &&
+        dataAdaptor->AddGhostCellsArray(dobj, mit.MeshName()))
+      {
+      SENSEI_ERROR("Failed to get ghost cells for mesh \"" << mit.MeshName() << "\"")
+      return -1;
+      }
+
+    if (mdIn->NumGhostNodes && dataAdaptor->AddGhostNodesArray(dobj, mit.MeshName()))
+      {
+      SENSEI_ERROR("Failed to get ghost nodes for mesh \"" << mit.MeshName() << "\"")
+      return -1;
+      }
+
+    ArrayRequirementsIterator ait =
+      this->Requirements.GetArrayRequirementsIterator(mit.MeshName());
+
+    while (ait)
+      {
+      const std::string arrayName = ait.Array();
+      if (mdOut->CopyArrayInfo(mdIn, arrayName)
+        || dataAdaptor->AddArray(dobj, mit.MeshName(),
+         ait.Association(), arrayName))
+        {
+        SENSEI_ERROR("Failed to add "
+          << SVTKUtils::GetAttributesName(ait.Association())
+          << " data array \"" << arrayName << "\" to mesh \""
+          << mit.MeshName() << "\"")
+        return -1;
+        }
+
+      ++ait;
+      }
+
+    // the receivers partition the data using the global view
+    MPI_Comm comm = this->GetCommunicator();
+    mdOut->GlobalizeView(comm);
+
+    svtkCompositeDataSetPtr cds = SVTKUtils::AsCompositeData(comm, dobj);
+
+    objects.push_back(cds);
+    metadata.push_back(mdOut);
+
+    ++mit;
+    }
+
+  return 0;
+}
+
+//----------------------------------------------------------------------------
+bool SharedMemAnalysisAdaptor::Execute(DataAdaptor* dataAdaptor, DataAdaptor** daOut)
+{
+  TimeEvent<128> mark("SharedMemAnalysisAdaptor::Execute");
+
+  // we currently do not return anything
+  if (daOut)
+    {
+    daOut = nullptr;
+    }
+
+  // if no data requirements are given, share everything
+  if (this->Requirements.Empty())
+    {
+    if (this->Requirements.Initialize(dataAdaptor, false))
+      {
+      SENSEI_ERROR("Failed to initialze dataAdaptor description")
+      return false;
+      }
+    SENSEI_WARNING("No subset specified. Sharing all available data")
+    }
+
+  std::vector<svtkCompositeDataSetPtr> objects;
+  std::vector<MeshMetadataPtr> metadata;
+
+  if (this->FetchFromProducer(dataAdaptor, objects, metadata))
+    {
+    SENSEI_ERROR("Failed to fetch data from the producer")
+    return false;
+    }
+
+  // create the ring the first time through
+  if (!this->Stream->IsOpen() && this->Stream->Open(this->GetCommunicator(),
+    this->StreamName, this->NumSlots))
+    {
+    SENSEI_ERROR("Failed to open the shared memory stream \""
+      << this->StreamName << "\"")
+    return false;
+    }
+
+  if (this->Stream->Write(dataAdaptor->GetDataTimeStep(),
+    dataAdaptor->GetDataTime(), metadata, objects))
+    {
+    SENSEI_ERROR("Failed to write step " << dataAdaptor->GetDataTimeStep()
+      << " to the shared memory stream \"" << this->StreamName << "\"")
+    return false;
+    }
+
+  return true;
+}
+
+//----------------------------------------------------------------------------
+int SharedMemAnalysisAdaptor::Initialize(pugi::xml_node &node)
+{
+  TimeEvent<128> mark("SharedMemAnalysisAdaptor::Initialize");
+
+  this->SetStreamName(node.attribute("name").as_string("sensei"));
+  this->SetNumberOfSlots(node.attribute("slots").as_int(2));
+
+  if (this->NumSlots < 1)
+    {
+    SENSEI_ERROR("At least one slot is required, not " << this->NumSlots)
+    return -1;
+    }
+
+  DataRequirements req;
+  if (req.Initialize(node))
+    {
+    SENSEI_ERROR("Failed to initialize the shared memory transport.")
+    return -1;
+    }
+  this->SetDataRequirements(req);
+
+  SENSEI_STATUS("Configured SharedMemAnalysisAdaptor name=\""
+    << this->StreamName << "\" slots=" << this->NumSlots)
+
+  return 0;
+}
+
+//----------------------------------------------------------------------------
+int SharedMemAnalysisAdaptor::Finalize()
+{
+  TimeEvent<128> mark("SharedMemAnalysisAdaptor::Finalize");
+  return this->Stream->Close();
+}
+
+}
@@ -0,0 +1,112 @@
+#ifndef SharedMemAnalysisAdaptor_h
+#define SharedMemAnalysisAdaptor_h
+
+#include "AnalysisAdaptor.h"
+#include "DataRequirements.h"
+#include "MeshMetadata.h"
+#include "SVTKUtils.h"
+
+#include <vector>
+#include <string>
+#include <mpi.h>
+
+/// @cond
+namespace senseiSharedMem { class OutputStream; }
+namespace pugi { class xml_node; }
+/// @endcond
+
+namespace sensei
+{
+/** The write side of the shared memory transport. Each step is copied once
+ * into POSIX shared memory, where an end point running on the same node maps
+ * it with sensei::SharedMemDataAdaptor. Each rank keeps a ring of slots, a
+ * slot is reused once all of the end point's ranks have released the step
+ * in it. When the end point falls behind by the number of slots Execute
+ * waits for it. The first Execute waits for the end point to connect.
+ */
+class SENSEI_EXPORT SharedMemAnalysisAdaptor : public AnalysisAdaptor
+{
+public:
+  /// constructs a new SharedMemAnalysisAdaptor instance.
+  static SharedMemAnalysisAdaptor* New();
+
+  senseiTypeMacro(SharedMemAnalysisAdaptor, AnalysisAdaptor);
+
+  /// @name runtime configuration
+  /// @{
+
+  /** initialize from an XML representation. The attributes are name, the
+   * name of the stream, and slots, the number of steps that may be in
+   * flight. Data requirements are given in mesh elements.
+   */
+  int Initialize(pugi::xml_node &parent);
+
+  /** Set the name of the stream. The receiver must use the same name. The
+   * default is "sensei".
+   */
+  void SetStreamName(const std::string &name)
+  { this->StreamName = name; }
+
+  /// Get the name of the stream.
+  std::string GetStreamName() const
+  { return this->StreamName; }
+
+  /** Set the number of steps that may be in flight. More slots let the
+   * simulation run further ahead of the end point at the cost of more
+   * memory. The default is 2.
+   */
+  void SetNumberOfSlots(int n)
+  { this->NumSlots = n; }
+
+  /// Get the number of slots.
+  int GetNumberOfSlots() const
+  { return this->NumSlots; }
+
+  /** Adds a set of sensei::DataRequirements. Data requirements tell the
+   * adaptor what to fetch from the simulation and share. If none are given
+   * then all available data is fetched and shared.
+   */
+  int SetDataRequirements(const DataRequirements &reqs);
+
+  /** Add an indivudal data requirement.
+
+   * @param[in] meshName    the name of the mesh to fetch and share
+   * @param[in] association the type of data array to fetch and share
+   *                        svtkDataObject::POINT or svtkDataObject::CELL
+   * @param[in] arrays      a list of arrays to fetch and share
+   * @returns zero if successful.
+   */
+  int AddDataRequirement(const std::string &meshName,
+    int association, const std::vector<std::string> &arrays);
+
+  /// @}
+
+  /// Copies the current step into shared memory.
+  bool Execute(DataAdaptor* data, DataAdaptor** result) override;
+
+  /// Marks the end of the stream and waits for the end point to release
+  /// the steps in flight.
+  int Finalize() override;
+
+protected:
+  SharedMemAnalysisAdaptor();
+  ~SharedMemAnalysisAdaptor();
+
+  // fetch meshes and metadata objects from the simulation
+  int FetchFromProducer(sensei::DataAdaptor *da,
+    std::vector<svtkCompositeDataSetPtr> &objects,
+    std::vector<MeshMetadataPtr> &metadata);
+
+  senseiSharedMem::OutputStream *Stream;
+  sensei::DataRequirements Requirements;
+  std::string StreamName;
+  int NumSlots;
+
+private:
+  SharedMemAnalysisAdaptor(const SharedMemAnalysisAdaptor&) = delete;
+  void operator=(const SharedMemAnalysisAdaptor&) = delete;
+};
+
+}
+
+#endif
@@ -0,0 +1,348 @@
+#include "SharedMemDataAdaptor.h"
+#include "SharedMemSchema.h"
+#include "MeshMetadata.h"
+#include "Partitioner.h"
+#include "BlockPartitioner.h"
+#include "SVTKUtils.h"
+#include "Profiler.h"
+#include "Error.h"
+
+#include <svtkDataObject.h>
+#include <svtkMultiBlockDataSet.h>
+#include <svtkObjectFactory.h>
+
+#include <pugixml.hpp>
+
+#include <map>
+
+namespace sensei
+{
+struct SharedMemDataAdaptor::InternalsType
+{
+  InternalsType() : StreamName("sensei"), Timeout(120.0), Good(-1) {}
+
+  senseiSharedMem::InputStream Stream;
+  std::string StreamName;
+  double Timeout;
+
+  // 0 until the end of the stream, or an error, is reached
+  int Good;
+
+  // receiver layouts computed by the partitioner for the current step
+  std::map<unsigned int, MeshMetadataPtr> ReceiverMetadata;
+
+  // receiver layouts of static meshes, computed by the partitioner once
+  std::map<unsigned int, MeshMetadataPtr> StaticReceiverMetadata;
+};
+
+//----------------------------------------------------------------------------
+senseiNewMacro(SharedMemDataAdaptor);
+
+//----------------------------------------------------------------------------
+SharedMemDataAdaptor::SharedMemDataAdaptor() : Internals(new InternalsType)
+{
+}
+
+//----------------------------------------------------------------------------
+SharedMemDataAdaptor::~SharedMemDataAdaptor()
+{
+  delete this->Internals;
+}
+
+//----------------------------------------------------------------------------
+void SharedMemDataAdaptor::SetStreamName(const std::string &name)
+{
+  this->Internals->StreamName = name;
+}
+
+//----------------------------------------------------------------------------
+void SharedMemDataAdaptor::SetTimeout(double timeout)
+{
+  this->Internals->Timeout = timeout;
+}
+
+//----------------------------------------------------------------------------
+int SharedMemDataAdaptor::Initialize(pugi::xml_node &node)
+{
+  TimeEvent<128> mark("SharedMemDataAdaptor::Initialize");
+
+  // let the base class handle initialization of the partitioner etc
+  if (this->InTransitDataAdaptor::Initialize(node))
+    {
+    SENSEI_ERROR("Failed to intialize the SharedMemDataAdaptor")
+    return -1;
+    }
+
+  this->SetStreamName(node.attribute("name").as_string("sensei"));
+  this->SetTimeout(node.attribute("timeout").as_double(120.0));
+
+  SENSEI_STATUS("Configured SharedMemDataAdaptor name=\""
+    << this->Internals->StreamName << "\" timeout=" << this->Internals->Timeout)
+
+  return 0;
+}
+
+//----------------------------------------------------------------------------
+int SharedMemDataAdaptor::Finalize()
+{
+  TimeEvent<128> mark("SharedMemDataAdaptor::Finalize");
+  return 0;
+}
+
+//----------------------------------------------------------------------------
+int SharedMemDataAdaptor::OpenStream()
+{
+  TimeEvent<128> mark("SharedMemDataAdaptor::OpenStream");
+
+  if (this->Internals->Stream.Open(this->GetCommunicator(),
+    this->Internals->StreamName, this->Internals->Timeout))
+    {
+    SENSEI_ERROR("Failed to open the shared memory stream \""
+      << this->Internals->StreamName << "\"")
+    return -1;
+    }
+
+  // wait for the first step
+  if (this->UpdateTimeStep())
+    return -1;
+
+  return 0;
+}
+
+//----------------------------------------------------------------------------
+int SharedMemDataAdaptor::StreamGood()
+{
+  return this->Internals->Good;
+}
+
+//----------------------------------------------------------------------------
+int SharedMemDataAdaptor::CloseStream()
+{
+  TimeEvent<128> mark("SharedMemDataAdaptor::CloseStream");
+
+  this->Internals->Stream.Close();
+  this->Internals->Good = -1;
+  this->Internals->ReceiverMetadata.clear();
+  this->Internals->StaticReceiverMetadata.clear();
+
+  return 0;
+}
+
+//----------------------------------------------------------------------------
+int SharedMemDataAdaptor::AdvanceStream()
+{
+  TimeEvent<128> mark("SharedMemDataAdaptor::AdvanceStream");
+
+  // the current step is done with, release it if that has not been done
+  if (this->Internals->Stream.EndStep())
+    return -1;
+
+  return this->UpdateTimeStep();
+}
+
+//----------------------------------------------------------------------------
+int SharedMemDataAdaptor::UpdateTimeStep()
+{
+  TimeEvent<128> mark("SharedMemDataAdaptor::UpdateTimeStep");
+
+  this->Internals->ReceiverMetadata.clear();
+
+  int ierr = this->Internals->Stream.BeginStep();
+  this->Internals->Good = ierr ? -1 : 0;
+
+  if (ierr < 0)
+    {
+    SENSEI_ERROR("Failed to update time step")
+    return -1;
+    }
+
+  if (ierr > 0)
+    {
+    SENSEI_STATUS("End of stream detected")
+    return 1;
+    }
+
+  this->SetDataTimeStep(this->Internals->Stream.GetTimeStep());
+  this->SetDataTime(this->Internals->Stream.GetTime());
+
+  return 0;
+}
+
+//----------------------------------------------------------------------------
+int SharedMemDataAdaptor::GetSenderMeshMetadata(unsigned int id,
+  MeshMetadataPtr &metadata)
+{
+  TimeEvent<128> mark("SharedMemDataAdaptor::GetSenderMeshMetadata");
+  if (this->Internals->Stream.GetSenderMeshMetadata(id, metadata))
+    {
+    SENSEI_ERROR("Failed to get metadata for object " << id)
+    return -1;
+    }
+
+  return 0;
+}
+
+//----------------------------------------------------------------------------
+int SharedMemDataAdaptor::GetNumberOfMeshes(unsigned int &numMeshes)
+{
+  TimeEvent<128> mark("SharedMemDataAdaptor::GetNumberOfMeshes");
+  numMeshes = this->Internals->Stream.GetNumberOfMeshes();
+  return 0;
+}
+
+//----------------------------------------------------------------------------
+int SharedMemDataAdaptor::GetMeshMetadata(unsigned int id, MeshMetadataPtr &metadata)
+{
+  TimeEvent<128> mark("SharedMemDataAdaptor::GetMeshMetadata");
+
+  // check if an analysis told us how the data should land by
+  // passing in reciever metadata
+  if (!this->GetReceiverMeshMetadata(id, metadata))
+    return 0;
+
+  // we did this already this step, return cached layout
+  std::map<unsigned int, MeshMetadataPtr>::iterator it =
+    this->Internals->ReceiverMetadata.find(id);
+  if (it != this->Internals->ReceiverMetadata.end())
+    {
+    metadata = it->second;
+    return 0;
+    }
+
+  MeshMetadataPtr senderMd;
+  if (this->GetSenderMeshMetadata(id, senderMd))
+    {
+    SENSEI_ERROR("Failed to get sender metadata")
+    return -1;
+    }
+
+  // the layout of a static mesh does not change
+  it = this->Internals->StaticReceiverMetadata.find(id);
+  if (senderMd->StaticMesh && (it != this->Internals->StaticReceiverMetadata.end()))
+    {
+    metadata = it->second;
+    this->Internals->ReceiverMetadata[id] = metadata;
+    return 0;
+    }
+
+  // get the partitioner, default to the block partitioner
+  PartitionerPtr part = this->GetPartitioner();
+  if (!part)
+    part = BlockPartitioner::New();
+
+  MeshMetadataPtr receiverMd;
+  if (part->GetPartition(this->GetCommunicator(), senderMd, receiverMd))
+    {
+    SENSEI_ERROR("Failed to determine a suitable layout to receive the data")
+    return -1;
+    }
+
+  this->Internals->ReceiverMetadata[id] = receiverMd;
+
+  if (senderMd->StaticMesh)
+    this->Internals->StaticReceiverMetadata[id] = receiverMd;
+
+  metadata = receiverMd;
+
+  return 0;
+}
+
+//----------------------------------------------------------------------------
+int SharedMemDataAdaptor::GetMeshLayout(const std::string &meshName,
+  MeshMetadataPtr &senderMd, MeshMetadataPtr &receiverMd)
+{
+  unsigned int nMeshes = this->Internals->Stream.GetNumberOfMeshes();
+  for (unsigned int id = 0; id < nMeshes; ++id)
+    {
+    if (this->GetSenderMeshMetadata(id, senderMd))
+      return -1;
+
+    if (senderMd->MeshName == meshName)
+      return this->GetMeshMetadata(id, receiverMd);
+    }
+
+  SENSEI_ERROR("No mesh named \"" << meshName << "\"")
+  return -1;
+}
+
+//----------------------------------------------------------------------------
+int SharedMemDataAdaptor::GetMesh(const std::string &meshName,
+   bool structureOnly, svtkDataObject *&mesh)
+{
+  TimeEvent<128> mark("SharedMemDataAdaptor::GetMesh");
+
+  mesh = nullptr;
+
+  MeshMetadataPtr senderMd;
+  MeshMetadataPtr receiverMd;
+  svtkMultiBlockDataSet *mbds = nullptr;
+
+  if (this->GetMeshLayout(meshName, senderMd, receiverMd) ||
+    this->Internals->Stream.ReadMesh(senderMd, receiverMd, structureOnly, mbds))
+    {
+    SENSEI_ERROR("Failed to read mesh \"" << meshName << "\"")
+    return -1;
+    }
+
+  mesh = mbds;
+
+  return 0;
+}
+
+//----------------------------------------------------------------------------
+int SharedMemDataAdaptor::AddGhostNodesArray(svtkDataObject *mesh,
+  const std::string &meshName)
+{
+  TimeEvent<128> mark("SharedMemDataAdaptor::AddGhostNodesArray");
+  return AddArray(mesh, meshName, svtkDataObject::POINT, "svtkGhostType");
+}
+
+//----------------------------------------------------------------------------
+int SharedMemDataAdaptor::AddGhostCellsArray(svtkDataObject *mesh,
+  const std::string &meshName)
+{
+  TimeEvent<128> mark("SharedMemDataAdaptor::AddGhostCellsArray");
+  return AddArray(mesh, meshName, svtkDataObject::CELL, "svtkGhostType");
+}
+
+//----------------------------------------------------------------------------
+int SharedMemDataAdaptor::AddArray(svtkDataObject* mesh,
+  const std::string &meshName, int association, const std::string& arrayName)
+{
+  TimeEvent<128> mark("SharedMemDataAdaptor::AddArray");
+
+  // the mesh should never be null. there must have been an error
+  // upstream.
+  svtkMultiBlockDataSet *mbds = dynamic_cast<svtkMultiBlockDataSet*>(mesh);
+  if (!mbds)
+    {
+    SENSEI_ERROR("Invalid mesh object")
+    return -1;
+    }
+
+  MeshMetadataPtr senderMd;
+  MeshMetadataPtr receiverMd;
+
+  if (this->GetMeshLayout(meshName, senderMd, receiverMd) ||
+    this->Internals->Stream.ReadArray(senderMd, receiverMd, association,
+      arrayName, mbds))
+    {
+    SENSEI_ERROR("Failed to read " << SVTKUtils::GetAttributesName(association)
+      << " data array \"" << arrayName << "\" from mesh \"" << meshName << "\"")
+    return -1;
+    }
+
+  return 0;
+}
+
+//----------------------------------------------------------------------------
+int SharedMemDataAdaptor::ReleaseData()
+{
+  TimeEvent<128> mark("SharedMemDataAdaptor::ReleaseData");
+
+  // let the simulation reuse the step's slots. arrays handed out keep
+  // their memory mapped until they are deleted.
+  return this->Internals->Stream.EndStep();
+}
+
+}
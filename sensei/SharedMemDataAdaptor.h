@@ -0,0 +1,84 @@
+#ifndef sensei_SharedMemDataAdaptor_h
+#define sensei_SharedMemDataAdaptor_h
+
+#include "InTransitDataAdaptor.h"
+
+#include <string>
+#include <mpi.h>
+
+namespace sensei
+{
+
+/** The read side of the shared memory transport. The steps written by
+ * sensei::SharedMemAnalysisAdaptor on the same node are mapped from POSIX
+ * shared memory, and their arrays are used in place, without copies. A step
+ * is released for reuse by the simulation by ReleaseData, or at the latest
+ * when the stream is advanced. Arrays handed out from a step remain valid
+ * after the step is released, for as long as they are referenced.
+ */
+class SENSEI_EXPORT SharedMemDataAdaptor : public sensei::InTransitDataAdaptor
+{
+public:
+  static SharedMemDataAdaptor *New();
+  senseiTypeMacro(SharedMemDataAdaptor, sensei::InTransitDataAdaptor);
+
+  /// Set the name of the stream. This is the name given to the
+  /// sensei::SharedMemAnalysisAdaptor. The default is "sensei".
+  void SetStreamName(const std::string &name);
+
+  /// Set the number of seconds to wait for the simulation to create the
+  /// stream. A value of 0 waits indefinitely. The default is 120.
+  void SetTimeout(double timeout);
+
+  /// SENSEI InTransitDataAdaptor control API
+  int Initialize(pugi::xml_node &parent) override;
+  int Finalize() override;
+
+  int OpenStream() override;
+  int CloseStream() override;
+  int AdvanceStream() override;
+  int StreamGood() override;
+
+  /// SENSEI InTransitDataAdaptor explicit paritioning API
+  int GetSenderMeshMetadata(unsigned int id, MeshMetadataPtr &metadata) override;
+
+  /// SENSEI DataAdaptor API
+  int GetNumberOfMeshes(unsigned int &numMeshes) override;
+
+  int GetMeshMetadata(unsigned int id, MeshMetadataPtr &metadata) override;
+
+  int GetMesh(const std::string &meshName, bool structureOnly,
+    svtkDataObject *&mesh) override;
+
+  int AddGhostNodesArray(svtkDataObject* mesh, const std::string &meshName) override;
+  int AddGhostCellsArray(svtkDataObject* mesh, const std::string &meshName) override;
+
+  int AddArray(svtkDataObject* mesh, const std::string &meshName,
+    int association, const std::string &arrayName) override;
+
+  int ReleaseData() override;
+
+protected:
+  SharedMemDataAdaptor();
+  ~SharedMemDataAdaptor();
+
+  // waits for the next step, and updates the time step and time values
+  // stored in the base class information object. returns 1 at the end of
+  // the stream.
+  int UpdateTimeStep();
+
+  // get the sender and receiver layouts of a mesh
+  int GetMeshLayout(const std::string &meshName, MeshMetadataPtr &senderMd,
+    MeshMetadataPtr &receiverMd);
+
+private:
+  struct InternalsType;
+  InternalsType *Internals;
+
+  SharedMemDataAdaptor(const SharedMemDataAdaptor&) = delete;
+  void operator=(const SharedMemDataAdaptor&) = delete;
+};
+
+}
+
+#endif
@@ -0,0 +1,1504 @@
+#include "SharedMemSchema.h"
+#include "BinaryStream.h"
+#include "MeshMetadata.h"
+#include "SVTKUtils.h"
+#include "Profiler.h"
+#include "Error.h"
+
+#include <svtkCellArray.h>
+#include <svtkCompositeDataIterator.h>
+#include <svtkDataArray.h>
+#include <svtkDataObject.h>
+#include <svtkDataSet.h>
+#include <svtkFieldData.h>
+#include <svtkImageData.h>
+#include <svtkMultiBlockDataSet.h>
+#include <svtkPoints.h>
+#include <svtkPolyData.h>
+#include <svtkRectilinearGrid.h>
+#include <svtkSmartPointer.h>
+#include <svtkStructuredGrid.h>
+#include <svtkUnsignedCharArray.h>
+#include <svtkUnstructuredGrid.h>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <mutex>
+#include <new>
+#include <sstream>
+#include <thread>
+
+namespace
+{
+// marks a control segment that is ready for use
+const unsigned long CONTROL_MAGIC = 0x53454e5345493031ul;
+
+// the alignment of the arrays in a data segment
+const unsigned long ALIGNMENT = 64;
+
+static_assert((ATOMIC_LONG_LOCK_FREE == 2) && (ATOMIC_INT_LOCK_FREE == 2),
+  "The shared memory transport requires lock free atomics");
+
+// a slot in a sender's ring. Sequence is one more than the sequence number
+// of the step in the slot, 0 when the slot has not been used. Readers is the
+// number of receivers that have yet to release the step.
+struct SlotType
+{
+  std::atomic<unsigned long> Sequence;
+  std::atomic<int> Readers;
+  unsigned long Size;
+};
+
+// the control segment of a sender. Magic is set by the sender last, once
+// the rest has been initialized. NumReceivers is set by the receivers when
+// they connect. Closed is one more than the number of steps sent, set when
+// the sender closes the stream.
+struct ControlType
+{
+  std::atomic<unsigned long> Magic;
+  int NumSenders;
+  int NumSlots;
+  std::atomic<int> NumReceivers;
+  std::atomic<unsigned long> Closed;
+  SlotType Slots[1];
+};
+
+// --------------------------------------------------------------------------
+unsigned long ControlSize(int nSlots)
+{
+  return sizeof(ControlType) + (nSlots - 1)*sizeof(SlotType);
+}
+
+// --------------------------------------------------------------------------
+std::string ControlName(const std::string &name, int rank)
+{
+  std::ostringstream oss;
+  oss << "/" << name << "." << rank;
+  return oss.str();
+}
+
+// --------------------------------------------------------------------------
+std::string DataName(const std::string &name, int rank, int slot)
+{
+  std::ostringstream oss;
+  oss << "/" << name << "." << rank << "." << slot;
+  return oss.str();
+}
+
+// --------------------------------------------------------------------------
+unsigned long Align(unsigned long n)
+{
+  return (n + ALIGNMENT - 1)/ALIGNMENT*ALIGNMENT;
+}
+
+// polls a condition, yielding at first and then sleeping for increasing
+// periods up to a millisecond
+class Backoff
+{
+public:
+  Backoff() : Count(0) {}
+
+  void Wait()
+  {
+    if (this->Count < 64)
+      {
+      std::this_thread::yield();
+      }
+    else
+      {
+      std::this_thread::sleep_for(std::chrono::microseconds(
+        std::min(1000, 10*(this->Count - 63))));
+      }
+    this->Count += 1;
+  }
+
+private:
+  int Count;
+};
+
+// the segments referenced by arrays handed out by the receiver, by the
+// address of the arrays' values. A segment stays mapped until all of its
+// arrays have released their values.
+std::mutex &GetArraySegmentsMutex()
+{
+  static std::mutex mtx;
+  return mtx;
+}
+
+std::multimap<void*, senseiSharedMem::SegmentPtr> &GetArraySegments()
+{
+  static std::multimap<void*, senseiSharedMem::SegmentPtr> segments;
+  return segments;
+}
+
+// --------------------------------------------------------------------------
+void ReleaseArray(void *ptr)
+{
+  senseiSharedMem::SegmentPtr segment;
+    {
+    std::lock_guard<std::mutex> lock(GetArraySegmentsMutex());
+    std::multimap<void*, senseiSharedMem::SegmentPtr> &segments = GetArraySegments();
+    std::multimap<void*, senseiSharedMem::SegmentPtr>::iterator it = segments.find(ptr);
+    if (it != segments.end())
+      {
+      segment = std::move(it->second);
+      segments.erase(it);
+      }
+    }
+  // the segment is unmapped here when this was the last reference
+}
+
+// the arrays of a step to be copied into a data segment, in the order of
+// the array records
+using ArrayList = std::vector<svtkSmartPointer<svtkDataArray>>;
+
+// --------------------------------------------------------------------------
+int AddArray(senseiSharedMem::BlockRecord &rec, ArrayList &arrays,
+  int association, const std::string &name, svtkDataArray *da)
+{
+  if (!da)
+    return 0;
+
+  if (da->GetDataType() == SVTK_BIT)
+    {
+    SENSEI_ERROR("The bit array \"" << name << "\" can not be shared")
+    return -1;
+    }
+
+  // arrays with other layouts are copied into the standard layout
+  svtkSmartPointer<svtkDataArray> aos = da;
+  if (!da->HasStandardMemoryLayout())
+    {
+    aos.TakeReference(svtkDataArray::CreateDataArray(da->GetDataType()));
+    aos->DeepCopy(da);
+    }
+
+  senseiSharedMem::ArrayRecord arec = {association, name, da->GetDataType(),
+    da->GetNumberOfComponents(), long(da->GetNumberOfTuples()), 0};
+
+  rec.Arrays.push_back(arec);
+  arrays.push_back(aos);
+
+  return 0;
+}
+
+// --------------------------------------------------------------------------
+int AddCells(senseiSharedMem::BlockRecord &rec, ArrayList &arrays,
+  const std::string &name, svtkCellArray *cells)
+{
+  if (!cells)
+    return 0;
+
+  int assoc = senseiSharedMem::ArrayRecord::STRUCTURE;
+  if (AddArray(rec, arrays, assoc, name + "_offsets", cells->GetOffsetsArray()) ||
+    AddArray(rec, arrays, assoc, name + "_connectivity", cells->GetConnectivityArray()))
+    return -1;
+
+  return 0;
+}
+
+// --------------------------------------------------------------------------
+int AddPoints(senseiSharedMem::BlockRecord &rec, ArrayList &arrays,
+  svtkPoints *points)
+{
+  if (!points)
+    return 0;
+
+  return AddArray(rec, arrays, senseiSharedMem::ArrayRecord::STRUCTURE,
+    "points", points->GetData());
+}
+
+// --------------------------------------------------------------------------
+int PackBlock(svtkDataSet *ds, int blockId, senseiSharedMem::BlockRecord &rec,
+  ArrayList &arrays)
+{
+  rec.BlockId = blockId;
+  rec.BlockType = ds->GetDataObjectType();
+  rec.Extent = {{0, -1, 0, -1, 0, -1}};
+  rec.Origin = {{0.0, 0.0, 0.0}};
+  rec.Spacing = {{1.0, 1.0, 1.0}};
+
+  int assoc = senseiSharedMem::ArrayRecord::STRUCTURE;
+
+  // the structure
+  if (svtkImageData *im = dynamic_cast<svtkImageData*>(ds))
+    {
+    im->GetExtent(rec.Extent.data());
+    im->GetOrigin(rec.Origin.data());
+    im->GetSpacing(rec.Spacing.data());
+    }
+  else if (svtkRectilinearGrid *rg = dynamic_cast<svtkRectilinearGrid*>(ds))
+    {
+    rg->GetExtent(rec.Extent.data());
+    if (AddArray(rec, arrays, assoc, "x_coordinates", rg->GetXCoordinates()) ||
+      AddArray(rec, arrays, assoc, "y_coordinates", rg->GetYCoordinates()) ||
+      AddArray(rec, arrays, assoc, "z_coordinates", rg->GetZCoordinates()))
+      return -1;
+    }
+  else if (svtkStructuredGrid *sg = dynamic_cast<svtkStructuredGrid*>(ds))
+    {
+    sg->GetExtent(rec.Extent.data());
+    if (AddPoints(rec, arrays, sg->GetPoints()))
+      return -1;
+    }
+  else if (svtkPolyData *pd = dynamic_cast<svtkPolyData*>(ds))
+    {
+    if (AddPoints(rec, arrays, pd->GetPoints()) ||
+      AddCells(rec, arrays, "verts", pd->GetVerts()) ||
+      AddCells(rec, arrays, "lines", pd->GetLines()) ||
+      AddCells(rec, arrays, "polys", pd->GetPolys()) ||
+      AddCells(rec, arrays, "strips", pd->GetStrips()))
+      return -1;
+    }
+  else if (svtkUnstructuredGrid *ug = dynamic_cast<svtkUnstructuredGrid*>(ds))
+    {
+    if (ug->GetFaces())
+      {
+      SENSEI_ERROR("Polyhedral cells in block " << blockId << " can not be shared")
+      return -1;
+      }
+
+    if (AddPoints(rec, arrays, ug->GetPoints()) ||
+      AddArray(rec, arrays, assoc, "cell_types", ug->GetCellTypesArray()) ||
+      AddCells(rec, arrays, "cells", ug->GetCells()))
+      return -1;
+    }
+  else
+    {
+    SENSEI_ERROR("Block " << blockId << " is a " << ds->GetClassName()
+      << " which can not be shared")
+    return -1;
+    }
+
+  // the point and cell data arrays
+  for (int association : {svtkDataObject::POINT, svtkDataObject::CELL})
+    {
+    svtkFieldData *atts = sensei::SVTKUtils::GetAttributes(ds, association);
+    int nArrays = atts->GetNumberOfArrays();
+    for (int i = 0; i < nArrays; ++i)
+      {
+      svtkDataArray *da = atts->GetArray(i);
+      if (!da || !da->GetName())
+        continue;
+
+      if (AddArray(rec, arrays, association, da->GetName(), da))
+        return -1;
+      }
+    }
+
+  return 0;
+}
+
+// --------------------------------------------------------------------------
+int NewCells(const senseiSharedMem::SegmentPtr &segment,
+  const senseiSharedMem::BlockRecord &rec, const std::string &name,
+  svtkCellArray *&cells)
+{
+  cells = nullptr;
+
+  int assoc = senseiSharedMem::ArrayRecord::STRUCTURE;
+  const senseiSharedMem::ArrayRecord *offsRec = rec.GetArray(assoc, name + "_offsets");
+  const senseiSharedMem::ArrayRecord *connRec = rec.GetArray(assoc, name + "_connectivity");
+  if (!offsRec || !connRec)
+    return 0;
+
+  svtkDataArray *offs = senseiSharedMem::NewArray(segment, *offsRec);
+  svtkDataArray *conn = senseiSharedMem::NewArray(segment, *connRec);
+
+  cells = svtkCellArray::New();
+
+  int ierr = 0;
+  if (!offs || !conn || !cells->SetData(offs, conn))
+    {
+    SENSEI_ERROR("Failed to create the " << name << " of block " << rec.BlockId)
+    cells->Delete();
+    cells = nullptr;
+    ierr = -1;
+    }
+
+  if (offs)
+    offs->Delete();
+
+  if (conn)
+    conn->Delete();
+
+  return ierr;
+}
+
+// --------------------------------------------------------------------------
+int NewPoints(const senseiSharedMem::SegmentPtr &segment,
+  const senseiSharedMem::BlockRecord &rec, svtkPoints *&points)
+{
+  points = nullptr;
+
+  const senseiSharedMem::ArrayRecord *ptsRec =
+    rec.GetArray(senseiSharedMem::ArrayRecord::STRUCTURE, "points");
+  if (!ptsRec)
+    return 0;
+
+  svtkDataArray *da = senseiSharedMem::NewArray(segment, *ptsRec);
+  if (!da)
+    return -1;
+
+  points = svtkPoints::New();
+  points->SetData(da);
+  da->Delete();
+
+  return 0;
+}
+
+// --------------------------------------------------------------------------
+int NewBlock(const senseiSharedMem::SegmentPtr &segment,
+  const senseiSharedMem::BlockRecord &rec, bool structureOnly,
+  svtkDataObject *&block)
+{
+  block = sensei::SVTKUtils::NewDataObject(rec.BlockType);
+  if (!block)
+    {
+    SENSEI_ERROR("Failed to create block " << rec.BlockId
+      << " of type " << rec.BlockType)
+    return -1;
+    }
+
+  int assoc = senseiSharedMem::ArrayRecord::STRUCTURE;
+  int ierr = 0;
+
+  if (svtkImageData *im = dynamic_cast<svtkImageData*>(block))
+    {
+    im->SetExtent(const_cast<int*>(rec.Extent.data()));
+    im->SetOrigin(rec.Origin.data());
+    im->SetSpacing(rec.Spacing.data());
+    }
+  else if (svtkRectilinearGrid *rg = dynamic_cast<svtkRectilinearGrid*>(block))
+    {
+    rg->SetExtent(const_cast<int*>(rec.Extent.data()));
+
+    const char *names[] = {"x_coordinates", "y_coordinates", "z_coordinates"};
+    for (int i = 0; i < 3; ++i)
+      {
+      const senseiSharedMem::ArrayRecord *crec = rec.GetArray(assoc, names[i]);
+      svtkDataArray *coords = crec ? senseiSharedMem::NewArray(segment, *crec) : nullptr;
+      if (!coords)
+        {
+        SENSEI_ERROR("Failed to create the " << names[i]
+          << " of block " << rec.BlockId)
+        ierr = -1;
+        break;
+        }
+
+      if (i == 0)
+        rg->SetXCoordinates(coords);
+      else if (i == 1)
+        rg->SetYCoordinates(coords);
+      else
+        rg->SetZCoordinates(coords);
+
+      coords->Delete();
+      }
+    }
+  else if (svtkStructuredGrid *sg = dynamic_cast<svtkStructuredGrid*>(block))
+    {
+    sg->SetExtent(const_cast<int*>(rec.Extent.data()));
+
+    svtkPoints *points = nullptr;
+    if (!structureOnly && !(ierr = NewPoints(segment, rec, points)) && points)
+      {
+      sg->SetPoints(points);
+      points->Delete();
+      }
+    }
+  else if (svtkPolyData *pd = dynamic_cast<svtkPolyData*>(block))
+    {
+    if (!structureOnly)
+      {
+      svtkPoints *points = nullptr;
+      if (!(ierr = NewPoints(segment, rec, points)) && points)
+        {
+        pd->SetPoints(points);
+        points->Delete();
+        }
+
+      const char *names[] = {"verts", "lines", "polys", "strips"};
+      for (int i = 0; !ierr && (i < 4); ++i)
+        {
+        svtkCellArray *cells = nullptr;
+        if ((ierr = NewCells(segment, rec, names[i], cells)) || !cells)
+          continue;
+
+        if (i == 0)
+          pd->SetVerts(cells);
+        else if (i == 1)
+          pd->SetLines(cells);
+        else if (i == 2)
+          pd->SetPolys(cells);
+        else
+          pd->SetStrips(cells);
+
+        cells->Delete();
+        }
+      }
+    }
+  else if (svtkUnstructuredGrid *ug = dynamic_cast<svtkUnstructuredGrid*>(block))
+    {
+    if (!structureOnly)
+      {
+      svtkPoints *points = nullptr;
+      if (!(ierr = NewPoints(segment, rec, points)) && points)
+        {
+        ug->SetPoints(points);
+        points->Delete();
+        }
+
+      svtkCellArray *cells = nullptr;
+      const senseiSharedMem::ArrayRecord *trec = rec.GetArray(assoc, "cell_types");
+      if (!ierr && trec && !(ierr = NewCells(segment, rec, "cells", cells)) && cells)
+        {
+        svtkDataArray *types = senseiSharedMem::NewArray(segment, *trec);
+        svtkUnsignedCharArray *uctypes = svtkUnsignedCharArray::SafeDownCast(types);
+        if (uctypes)
+          {
+          ug->SetCells(uctypes, cells);
+          }
+        else
+          {
+          SENSEI_ERROR("Failed to create the cell types of block " << rec.BlockId)
+          ierr = -1;
+          }
+
+        if (types)
+          types->Delete();
+
+        cells->Delete();
+        }
+      }
+    }
+  else
+    {
+    SENSEI_ERROR("Block " << rec.BlockId << " is a " << block->GetClassName()
+      << " which can not be shared")
+    ierr = -1;
+    }
+
+  if (ierr)
+    {
+    block->Delete();
+    block = nullptr;
+    return -1;
+    }
+
+  return 0;
+}
+}
+
+namespace senseiSharedMem
+{
+
+// --------------------------------------------------------------------------
+SegmentPtr Segment::Create(const std::string &name, unsigned long size)
+{
+  // a segment left behind by an earlier step or run is replaced. a receiver
+  // that still has it mapped keeps its memory
+  shm_unlink(name.c_str());
+
+  int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, S_IRUSR | S_IWUSR);
+  if (fd < 0)
+    {
+    SENSEI_ERROR("Failed to create the shared memory segment \"" << name
+      << "\". " << strerror(errno))
+    return nullptr;
+    }
+
+  if (ftruncate(fd, size))
+    {
+    SENSEI_ERROR("Failed to size the shared memory segment \"" << name
+      << "\" to " << size << " bytes. " << strerror(errno))
+    close(fd);
+    shm_unlink(name.c_str());
+    return nullptr;
+    }
+
+  void *data = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+
+  if (data == MAP_FAILED)
+    {
+    SENSEI_ERROR("Failed to map the shared memory segment \"" << name
+      << "\". " << strerror(errno))
+    shm_unlink(name.c_str());
+    return nullptr;
+    }
+
+  return SegmentPtr(new Segment(static_cast<unsigned char*>(data), size));
+}
+
+// --------------------------------------------------------------------------
+SegmentPtr Segment::Open(const std::string &name, bool shared,
+  unsigned long minSize)
+{
+  int fd = shm_open(name.c_str(), shared ? O_RDWR : O_RDONLY, 0);
+  if (fd < 0)
+    {
+    if (errno != ENOENT)
+      {
+      SENSEI_ERROR("Failed to open the shared memory segment \"" << name
+        << "\". " << strerror(errno))
+      }
+    return nullptr;
+    }
+
+  // the segment may not have been sized yet
+  struct stat st;
+  if (fstat(fd, &st) || (st.st_size < 1) ||
+    ((unsigned long)st.st_size < minSize))
+    {
+    close(fd);
+    return nullptr;
+    }
+
+  unsigned long size = st.st_size;
+
+  // a private mapping of a step lets analyses modify the arrays in place
+  // without the changes being seen by the other receivers
+  void *data = mmap(nullptr, size, PROT_READ | PROT_WRITE,
+    shared ? MAP_SHARED : MAP_PRIVATE, fd, 0);
+  close(fd);
+
+  if (data == MAP_FAILED)
+    {
+    SENSEI_ERROR("Failed to map the shared memory segment \"" << name
+      << "\". " << strerror(errno))
+    return nullptr;
+    }
+
+  return SegmentPtr(new Segment(static_cast<unsigned char*>(data), size));
+}
+
+// --------------------------------------------------------------------------
+Segment::~Segment()
+{
+  munmap(this->Data, this->Size);
+}
+
+// --------------------------------------------------------------------------
+svtkDataArray *NewArray(const SegmentPtr &segment, const ArrayRecord &rec)
+{
+  svtkDataArray *da = svtkDataArray::CreateDataArray(rec.Type);
+  if (!da || !da->HasStandardMemoryLayout() || (rec.Type == SVTK_BIT))
+    {
+    SENSEI_ERROR("Failed to create the array \"" << rec.Name
+      << "\" of type " << rec.Type)
+    if (da)
+      da->Delete();
+    return nullptr;
+    }
+
+  da->SetName(rec.Name.c_str());
+  da->SetNumberOfComponents(rec.NumComponents);
+
+  svtkIdType n = svtkIdType(rec.NumTuples)*rec.NumComponents;
+  if (n < 1)
+    return da;
+
+  if (rec.Offset + n*da->GetDataTypeSize() > segment->GetSize())
+    {
+    SENSEI_ERROR("The array \"" << rec.Name << "\" extends past the end"
+      " of the shared memory segment")
+    da->Delete();
+    return nullptr;
+    }
+
+  // use the values in place. the segment stays mapped until the array
+  // releases them
+  void *ptr = segment->GetData() + rec.Offset;
+    {
+    std::lock_guard<std::mutex> lock(GetArraySegmentsMutex());
+    GetArraySegments().emplace(ptr, segment);
+    }
+
+  da->SetVoidArray(ptr, n, 0, svtkAbstractArray::SVTK_DATA_ARRAY_USER_DEFINED);
+  da->SetArrayFreeFunction(ReleaseArray);
+
+  return da;
+}
+
+// --------------------------------------------------------------------------
+const ArrayRecord *BlockRecord::GetArray(int association,
+  const std::string &name) const
+{
+  unsigned int nArrays = this->Arrays.size();
+  for (unsigned int i = 0; i < nArrays; ++i)
+    {
+    const ArrayRecord &rec = this->Arrays[i];
+    if ((rec.Association == association) && (rec.Name == name))
+      return &rec;
+    }
+  return nullptr;
+}
+
+// --------------------------------------------------------------------------
+int StepRecord::ToStream(sensei::BinaryStream &str) const
+{
+  str.Pack(this->TimeStep);
+  str.Pack(this->Time);
+
+  unsigned int nMeshes = this->MeshNames.size();
+  str.Pack(nMeshes);
+
+  for (unsigned int j = 0; j < nMeshes; ++j)
+    {
+    str.Pack(this->MeshNames[j]);
+
+    int hasMd = (j < this->Metadata.size()) && this->Metadata[j];
+    str.Pack(hasMd);
+    if (hasMd)
+      this->Metadata[j]->ToStream(str);
+
+    const std::vector<BlockRecord> &blocks = this->Blocks[j];
+    unsigned int nBlocks = blocks.size();
+    str.Pack(nBlocks);
+
+    for (unsigned int i = 0; i < nBlocks; ++i)
+      {
+      const BlockRecord &brec = blocks[i];
+      str.Pack(brec.BlockId);
+      str.Pack(brec.BlockType);
+      str.Pack(brec.Extent);
+      str.Pack(brec.Origin);
+      str.Pack(brec.Spacing);
+
+      unsigned int nArrays = brec.Arrays.size();
+      str.Pack(nArrays);
+
+      for (unsigned int k = 0; k < nArrays; ++k)
+        {
+        const ArrayRecord &arec = brec.Arrays[k];
+        str.Pack(arec.Association);
+        str.Pack(arec.Name);
+        str.Pack(arec.Type);
+        str.Pack(arec.NumComponents);
+        str.Pack(arec.NumTuples);
+        str.Pack(arec.Offset);
+        }
+      }
+    }
+
+  return 0;
+}
+
+// --------------------------------------------------------------------------
+int StepRecord::FromStream(sensei::BinaryStream &str)
+{
+  str.Unpack(this->TimeStep);
+  str.Unpack(this->Time);
+
+  unsigned int nMeshes = 0;
+  str.Unpack(nMeshes);
+
+  this->MeshNames.resize(nMeshes);
+  this->Metadata.assign(nMeshes, nullptr);
+  this->Blocks.resize(nMeshes);
+
+  for (unsigned int j = 0; j < nMeshes; ++j)
+    {
+    str.Unpack(this->MeshNames[j]);
+
+    int hasMd = 0;
+    str.Unpack(hasMd);
+    if (hasMd)
+      {
+      this->Metadata[j] = sensei::MeshMetadata::New();
+      this->Metadata[j]->FromStream(str);
+      }
+
+    unsigned int nBlocks = 0;
+    str.Unpack(nBlocks);
+
+    std::vector<BlockRecord> &blocks = this->Blocks[j];
+    blocks.resize(nBlocks);
+
+    for (unsigned int i = 0; i < nBlocks; ++i)
+      {
+      BlockRecord &brec = blocks[i];
+      str.Unpack(brec.BlockId);
+      str.Unpack(brec.BlockType);
+      str.Unpack(brec.Extent);
+      str.Unpack(brec.Origin);
+      str.Unpack(brec.Spacing);
+
+      unsigned int nArrays = 0;
+      str.Unpack(nArrays);
+
+      brec.Arrays.resize(nArrays);
+      for (unsigned int k = 0; k < nArrays; ++k)
+        {
+        ArrayRecord &arec = brec.Arrays[k];
+        str.Unpack(arec.Association);
+        str.Unpack(arec.Name);
+        str.Unpack(arec.Type);
+        str.Unpack(arec.NumComponents);
+        str.Unpack(arec.NumTuples);
+        str.Unpack(arec.Offset);
+        }
+      }
+    }
+
+  return 0;
+}
+
+// --------------------------------------------------------------------------
+struct OutputStream::InternalsType
+{
+  InternalsType() : Comm(MPI_COMM_NULL), Rank(0), Sequence(0),
+    Control(nullptr) {}
+
+  MPI_Comm Comm;
+  int Rank;
+  std::string Name;
+  unsigned long Sequence;
+  SegmentPtr ControlSegment;
+  ControlType *Control;
+};
+
+// --------------------------------------------------------------------------
+OutputStream::OutputStream() : Internals(new InternalsType)
+{
+}
+
+// --------------------------------------------------------------------------
+OutputStream::~OutputStream()
+{
+  delete this->Internals;
+}
+
+// --------------------------------------------------------------------------
+bool OutputStream::IsOpen()
+{
+  return this->Internals->Control != nullptr;
+}
+
+// --------------------------------------------------------------------------
+int OutputStream::Open(MPI_Comm comm, const std::string &name, int nSlots)
+{
+  sensei::TimeEvent<128> mark("senseiSharedMem::OutputStream::Open");
+
+  if (nSlots < 1)
+    {
+    SENSEI_ERROR("At least one slot is required, not " << nSlots)
+    return -1;
+    }
+
+  InternalsType *internals = this->Internals;
+
+  int nRanks = 1;
+  MPI_Comm_rank(comm, &internals->Rank);
+  MPI_Comm_size(comm, &nRanks);
+
+  internals->Comm = comm;
+  internals->Name = name;
+  internals->Sequence = 0;
+
+  std::string ctlName = ControlName(name, internals->Rank);
+
+  SegmentPtr segment = Segment::Create(ctlName, ControlSize(nSlots));
+  if (!segment)
+    return -1;
+
+  ControlType *ctl = reinterpret_cast<ControlType*>(segment->GetData());
+
+  new (&ctl->Magic) std::atomic<unsigned long>(0);
+  ctl->NumSenders = nRanks;
+  ctl->NumSlots = nSlots;
+  new (&ctl->NumReceivers) std::atomic<int>(0);
+  new (&ctl->Closed) std::atomic<unsigned long>(0);
+
+  for (int i = 0; i < nSlots; ++i)
+    {
+    new (&ctl->Slots[i].Sequence) std::atomic<unsigned long>(0);
+    new (&ctl->Slots[i].Readers) std::atomic<int>(0);
+    ctl->Slots[i].Size = 0;
+    }
+
+  // the receivers may use the segment now
+  ctl->Magic.store(CONTROL_MAGIC, std::memory_order_release);
+
+  internals->ControlSegment = segment;
+  internals->Control = ctl;
+
+  return 0;
+}
+
+// --------------------------------------------------------------------------
+int OutputStream::Write(unsigned long timeStep, double time,
+  const std::vector<sensei::MeshMetadataPtr> &metadata,
+  const std::vector<svtkCompositeDataSetPtr> &objects)
+{
+  sensei::TimeEvent<128> mark("senseiSharedMem::OutputStream::Write");
+
+  InternalsType *internals = this->Internals;
+  ControlType *ctl = internals->Control;
+  if (!ctl)
+    {
+    SENSEI_ERROR("The stream is not open")
+    return -1;
+    }
+
+  // describe the local blocks and gather their arrays
+  StepRecord step;
+  step.TimeStep = timeStep;
+  step.Time = time;
+
+  ArrayList arrays;
+
+  unsigned int nMeshes = metadata.size();
+  step.MeshNames.resize(nMeshes);
+  step.Blocks.resize(nMeshes);
+
+  // the global view of the metadata is only needed once
+  if (internals->Rank == 0)
+    step.Metadata = metadata;
+
+  for (unsigned int j = 0; j < nMeshes; ++j)
+    {
+    step.MeshNames[j] = metadata[j]->MeshName;
+
+    svtkCompositeDataIterator *it = objects[j]->NewIterator();
+    it->SetSkipEmptyNodes(1);
+    for (it->InitTraversal(); !it->IsDoneWithTraversal(); it->GoToNextItem())
+      {
+      svtkDataSet *ds = dynamic_cast<svtkDataSet*>(it->GetCurrentDataObject());
+      if (!ds)
+        continue;
+
+      int bid = std::max(0, int(it->GetCurrentFlatIndex() - 1));
+
+      BlockRecord brec;
+      if (PackBlock(ds, bid, brec, arrays))
+        {
+        SENSEI_ERROR("Failed to share block " << bid << " of mesh \""
+          << step.MeshNames[j] << "\"")
+        it->Delete();
+        return -1;
+        }
+
+      step.Blocks[j].push_back(brec);
+      }
+    it->Delete();
+    }
+
+  // size the table of contents, the array offsets are a fixed size so
+  // the size does not depend on their values
+  sensei::BinaryStream toc;
+  step.ToStream(toc);
+
+  unsigned long headerSize = 2*sizeof(unsigned long);
+  unsigned long offset = Align(headerSize + toc.Size());
+
+  unsigned int q = 0;
+  for (unsigned int j = 0; j < nMeshes; ++j)
+    {
+    std::vector<BlockRecord> &blocks = step.Blocks[j];
+    unsigned int nBlocks = blocks.size();
+    for (unsigned int i = 0; i < nBlocks; ++i)
+      {
+      std::vector<ArrayRecord> &arecs = blocks[i].Arrays;
+      unsigned int nArrays = arecs.size();
+      for (unsigned int k = 0; k < nArrays; ++k, ++q)
+        {
+        svtkDataArray *da = arrays[q];
+        arecs[k].Offset = offset;
+        offset = Align(offset + da->GetNumberOfValues()*da->GetDataTypeSize());
+        }
+      }
+    }
+
+  unsigned long size = offset;
+
+  toc.Clear();
+  step.ToStream(toc);
+
+  // wait for the receivers to connect
+  Backoff connecting;
+  while (ctl->NumReceivers.load(std::memory_order_acquire) < 1)
+    connecting.Wait();
+
+  // wait for the receivers to release the slot
+  int slot = internals->Sequence % ctl->NumSlots;
+  SlotType &slt = ctl->Slots[slot];
+
+    {
+    sensei::TimeEvent<128> waitMark("senseiSharedMem::OutputStream::WaitForSlot");
+    Backoff releasing;
+    while (slt.Readers.load(std::memory_order_acquire) > 0)
+      releasing.Wait();
+    }
+
+  // copy the step into a new segment
+  SegmentPtr segment = Segment::Create(
+    DataName(internals->Name, internals->Rank, slot), size);
+  if (!segment)
+    return -1;
+
+  unsigned char *data = segment->GetData();
+
+  unsigned long header[2] = {toc.Size(), Align(headerSize + toc.Size())};
+  memcpy(data, header, headerSize);
+  memcpy(data + headerSize, toc.GetData(), toc.Size());
+
+  q = 0;
+  for (unsigned int j = 0; j < nMeshes; ++j)
+    {
+    std::vector<BlockRecord> &blocks = step.Blocks[j];
+    unsigned int nBlocks = blocks.size();
+    for (unsigned int i = 0; i < nBlocks; ++i)
+      {
+      std::vector<ArrayRecord> &arecs = blocks[i].Arrays;
+      unsigned int nArrays = arecs.size();
+      for (unsigned int k = 0; k < nArrays; ++k, ++q)
+        {
+        svtkDataArray *da = arrays[q];
+        if (unsigned long nBytes = da->GetNumberOfValues()*da->GetDataTypeSize())
+          memcpy(data + arecs[k].Offset, da->GetVoidPointer(0), nBytes);
+        }
+      }
+    }
+
+  segment.reset();
+
+  // publish the step
+  slt.Size = size;
+  slt.Readers.store(ctl->NumReceivers.load(std::memory_order_acquire),
+    std::memory_order_relaxed);
+  slt.Sequence.store(internals->Sequence + 1, std::memory_order_release);
+
+  internals->Sequence += 1;
+
+  return 0;
+}
+
+// --------------------------------------------------------------------------
+int OutputStream::Close()
+{
+  sensei::TimeEvent<128> mark("senseiSharedMem::OutputStream::Close");
+
+  InternalsType *internals = this->Internals;
+  ControlType *ctl = internals->Control;
+  if (!ctl)
+    return 0;
+
+  // mark the end of the stream
+  ctl->Closed.store(internals->Sequence + 1, std::memory_order_release);
+
+  // the steps in flight are still needed by the receivers
+  int nSlots = ctl->NumSlots;
+  for (int i = 0; i < nSlots; ++i)
+    {
+    Backoff releasing;
+    while (ctl->Slots[i].Readers.load(std::memory_order_acquire) > 0)
+      releasing.Wait();
+
+    shm_unlink(DataName(internals->Name, internals->Rank, i).c_str());
+    }
+
+  shm_unlink(ControlName(internals->Name, internals->Rank).c_str());
+
+  internals->Control = nullptr;
+  internals->ControlSegment.reset();
+
+  return 0;
+}
+
+// --------------------------------------------------------------------------
+// the first sender's segment holds the metadata, the others are mapped
+// when their blocks are needed
+struct SenderStep
+{
+  SenderStep() : Mapped(false) {}
+
+  bool Mapped;
+  SegmentPtr Data;
+  StepRecord Record;
+  std::map<std::pair<std::string, int>, const BlockRecord*> Blocks;
+};
+
+struct InputStream::InternalsType
+{
+  InternalsType() : Comm(MPI_COMM_NULL), Rank(0), Sequence(0),
+    HaveStep(false) {}
+
+  // map a sender's segment for the current step
+  int GetSenderStep(int sender, SenderStep *&step);
+
+  // find a block of a mesh in a sender's segment
+  int GetBlock(int sender, const std::string &meshName, int blockId,
+    SegmentPtr &segment, const BlockRecord *&rec);
+
+  MPI_Comm Comm;
+  int Rank;
+  std::string Name;
+  unsigned long Sequence;
+  bool HaveStep;
+  std::vector<SegmentPtr> ControlSegments;
+  std::vector<ControlType*> Controls;
+  std::vector<SenderStep> Steps;
+};
+
+// --------------------------------------------------------------------------
+int InputStream::InternalsType::GetSenderStep(int sender, SenderStep *&step)
+{
+  step = nullptr;
+
+  if ((sender < 0) || (sender >= int(this->Steps.size())))
+    {
+    SENSEI_ERROR("Invalid sender " << sender)
+    return -1;
+    }
+
+  SenderStep &sstep = this->Steps[sender];
+  if (!sstep.Mapped)
+    {
+    sensei::TimeEvent<128> mark("senseiSharedMem::InputStream::MapStep");
+
+    ControlType *ctl = this->Controls[sender];
+    int slot = this->Sequence % ctl->NumSlots;
+
+    std::string name = DataName(this->Name, sender, slot);
+    unsigned long headerSize = 2*sizeof(unsigned long);
+
+    SegmentPtr segment = Segment::Open(name, false, ctl->Slots[slot].Size);
+    if (!segment)
+      {
+      SENSEI_ERROR("Failed to map step " << this->Sequence << " of sender "
+        << sender << " from \"" << name << "\"")
+      return -1;
+      }
+
+    unsigned long header[2] = {0, 0};
+    memcpy(header, segment->GetData(), headerSize);
+
+    if (headerSize + header[0] > segment->GetSize())
+      {
+      SENSEI_ERROR("The segment \"" << name << "\" is corrupt")
+      return -1;
+      }
+
+    sensei::BinaryStream toc;
+    toc.Resize(header[0]);
+    memcpy(toc.GetData(), segment->GetData() + headerSize, header[0]);
+    toc.SetReadPos(0);
+    toc.SetWritePos(header[0]);
+
+    sstep.Record.FromStream(toc);
+    sstep.Data = segment;
+
+    unsigned int nMeshes = sstep.Record.MeshNames.size();
+    for (unsigned int j = 0; j < nMeshes; ++j)
+      {
+      const std::vector<BlockRecord> &blocks = sstep.Record.Blocks[j];
+      unsigned int nBlocks = blocks.size();
+      for (unsigned int i = 0; i < nBlocks; ++i)
+        {
+        sstep.Blocks[std::make_pair(sstep.Record.MeshNames[j],
+          blocks[i].BlockId)] = &blocks[i];
+        }
+      }
+
+    sstep.Mapped = true;
+    }
+
+  step = &sstep;
+
+  return 0;
+}
+
+// --------------------------------------------------------------------------
+int InputStream::InternalsType::GetBlock(int sender,
+  const std::string &meshName, int blockId, SegmentPtr &segment,
+  const BlockRecord *&rec)
+{
+  SenderStep *step = nullptr;
+  if (this->GetSenderStep(sender, step))
+    return -1;
+
+  std::map<std::pair<std::string, int>, const BlockRecord*>::iterator it =
+    step->Blocks.find(std::make_pair(meshName, blockId));
+
+  if (it == step->Blocks.end())
+    {
+    SENSEI_ERROR("Sender " << sender << " does not have block "
+      << blockId << " of mesh \"" << meshName << "\"")
+    return -1;
+    }
+
+  segment = step->Data;
+  rec = it->second;
+
+  return 0;
+}
+
+// --------------------------------------------------------------------------
+InputStream::InputStream() : Internals(new InternalsType)
+{
+}
+
+// --------------------------------------------------------------------------
+InputStream::~InputStream()
+{
+  this->Close();
+  delete this->Internals;
+}
+
+// --------------------------------------------------------------------------
+int InputStream::Open(MPI_Comm comm, const std::string &name, double timeout)
+{
+  sensei::TimeEvent<128> mark("senseiSharedMem::InputStream::Open");
+
+  InternalsType *internals = this->Internals;
+
+  int nRanks = 1;
+  MPI_Comm_rank(comm, &internals->Rank);
+  MPI_Comm_size(comm, &nRanks);
+
+  internals->Comm = comm;
+  internals->Name = name;
+  internals->Sequence = 0;
+  internals->HaveStep = false;
+
+  // map a sender's control segment once the sender has initialized it
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+  auto openControl = [&](int sender) -> SegmentPtr
+    {
+    std::string ctlName = ControlName(name, sender);
+    Backoff connecting;
+    while (1)
+      {
+      SegmentPtr segment = Segment::Open(ctlName, true, ControlSize(1));
+      if (segment && (reinterpret_cast<ControlType*>(segment->GetData())->Magic.load(
+        std::memory_order_acquire) == CONTROL_MAGIC))
+        return segment;
+
+      std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+      if ((timeout > 0.0) && (elapsed.count() > timeout))
+        {
+        SENSEI_ERROR("Timed out after " << timeout << " seconds waiting for \""
+          << ctlName << "\"")
+        return nullptr;
+        }
+
+      connecting.Wait();
+      }
+    };
+
+  // the first sender gives the number of senders
+  int nSenders = 0;
+  if (internals->Rank == 0)
+    {
+    if (SegmentPtr segment = openControl(0))
+      nSenders = reinterpret_cast<ControlType*>(segment->GetData())->NumSenders;
+    }
+
+  MPI_Bcast(&nSenders, 1, MPI_INT, 0, comm);
+  if (nSenders < 1)
+    return -1;
+
+  internals->ControlSegments.resize(nSenders);
+  internals->Controls.resize(nSenders);
+
+  int ierr = 0;
+  for (int j = 0; !ierr && (j < nSenders); ++j)
+    {
+    SegmentPtr segment = openControl(j);
+    if (!segment)
+      {
+      ierr = -1;
+      break;
+      }
+
+    ControlType *ctl = reinterpret_cast<ControlType*>(segment->GetData());
+    if (segment->GetSize() < ControlSize(ctl->NumSlots))
+      {
+      SENSEI_ERROR("The control segment of sender " << j << " is corrupt")
+      ierr = -1;
+      break;
+      }
+
+    internals->ControlSegments[j] = segment;
+    internals->Controls[j] = ctl;
+    }
+
+  MPI_Allreduce(MPI_IN_PLACE, &ierr, 1, MPI_INT, MPI_MIN, comm);
+  if (ierr)
+    {
+    internals->ControlSegments.clear();
+    internals->Controls.clear();
+    return -1;
+    }
+
+  // all of the receivers have connected, the senders may start
+  if (internals->Rank == 0)
+    {
+    for (int j = 0; j < nSenders; ++j)
+      internals->Controls[j]->NumReceivers.store(nRanks, std::memory_order_release);
+    }
+
+  internals->Steps.resize(nSenders);
+
+  return 0;
+}
+
+// --------------------------------------------------------------------------
+int InputStream::BeginStep()
+{
+  sensei::TimeEvent<128> mark("senseiSharedMem::InputStream::BeginStep");
+
+  InternalsType *internals = this->Internals;
+  if (internals->Controls.empty())
+    {
+    SENSEI_ERROR("The stream is not open")
+    return -1;
+    }
+
+  if (internals->HaveStep)
+    return 0;
+
+  // wait for every sender to publish the step, or close the stream.
+  // the senders publish their last step before closing, so all of the
+  // receivers see the same end
+  unsigned long seq = internals->Sequence;
+  int nSenders = internals->Controls.size();
+  for (int j = 0; j < nSenders; ++j)
+    {
+    ControlType *ctl = internals->Controls[j];
+    SlotType &slt = ctl->Slots[seq % ctl->NumSlots];
+
+    Backoff waiting;
+    while (1)
+      {
+      unsigned long closed = ctl->Closed.load(std::memory_order_acquire);
+
+      if (slt.Sequence.load(std::memory_order_acquire) == seq + 1)
+        break;
+
+      if (closed && (seq + 1 >= closed))
+        return 1;
+
+      waiting.Wait();
+      }
+    }
+
+  internals->HaveStep = true;
+
+  // the first sender's segment has the metadata
+  SenderStep *step = nullptr;
+  if (internals->GetSenderStep(0, step))
+    return -1;
+
+  return 0;
+}
+
+// --------------------------------------------------------------------------
+int InputStream::EndStep()
+{
+  sensei::TimeEvent<128> mark("senseiSharedMem::InputStream::EndStep");
+
+  InternalsType *internals = this->Internals;
+  if (!internals->HaveStep)
+    return 0;
+
+  // arrays handed out hold their own references to the segments
+  unsigned int nSenders = internals->Steps.size();
+  for (unsigned int j = 0; j < nSenders; ++j)
+    internals->Steps[j] = SenderStep();
+
+  // let the senders reuse the slots
+  unsigned long seq = internals->Sequence;
+  for (unsigned int j = 0; j < nSenders; ++j)
+    {
+    ControlType *ctl = internals->Controls[j];
+    ctl->Slots[seq % ctl->NumSlots].Readers.fetch_sub(1, std::memory_order_acq_rel);
+    }
+
+  internals->Sequence += 1;
+  internals->HaveStep = false;
+
+  return 0;
+}
+
+// --------------------------------------------------------------------------
+int InputStream::Close()
+{
+  if (this->Internals->Controls.empty())
+    return 0;
+
+  sensei::TimeEvent<128> mark("senseiSharedMem::InputStream::Close");
+
+  this->EndStep();
+
+  this->Internals->Steps.clear();
+  this->Internals->Controls.clear();
+  this->Internals->ControlSegments.clear();
+
+  return 0;
+}
+
+// --------------------------------------------------------------------------
+bool InputStream::HasStep()
+{
+  return this->Internals->HaveStep;
+}
+
+// --------------------------------------------------------------------------
+unsigned long InputStream::GetTimeStep()
+{
+  return this->Internals->HaveStep ?
+    this->Internals->Steps[0].Record.TimeStep : 0;
+}
+
+// --------------------------------------------------------------------------
+double InputStream::GetTime()
+{
+  return this->Internals->HaveStep ?
+    this->Internals->Steps[0].Record.Time : 0.0;
+}
+
+// --------------------------------------------------------------------------
+unsigned int InputStream::GetNumberOfMeshes()
+{
+  return this->Internals->HaveStep ?
+    this->Internals->Steps[0].Record.MeshNames.size() : 0;
+}
+
+// --------------------------------------------------------------------------
+int InputStream::GetSenderMeshMetadata(unsigned int id,
+  sensei::MeshMetadataPtr &md)
+{
+  if (id >= this->GetNumberOfMeshes())
+    {
+    SENSEI_ERROR("Invalid mesh id " << id)
+    return -1;
+    }
+
+  md = this->Internals->Steps[0].Record.Metadata[id];
+  if (!md)
+    {
+    SENSEI_ERROR("No metadata for mesh " << id)
+    return -1;
+    }
+
+  return 0;
+}
+
+// --------------------------------------------------------------------------
+int InputStream::ReadMesh(const sensei::MeshMetadataPtr &senderMd,
+  const sensei::MeshMetadataPtr &receiverMd, bool structureOnly,
+  svtkMultiBlockDataSet *&mesh)
+{
+  sensei::TimeEvent<128> mark("senseiSharedMem::InputStream::ReadMesh");
+
+  InternalsType *internals = this->Internals;
+
+  mesh = nullptr;
+
+  if (!internals->HaveStep)
+    {
+    SENSEI_ERROR("No step is available")
+    return -1;
+    }
+
+  svtkMultiBlockDataSet *mbds = svtkMultiBlockDataSet::New();
+  mbds->SetNumberOfBlocks(receiverMd->NumBlocks);
+
+  for (int i = 0; i < receiverMd->NumBlocks; ++i)
+    {
+    if (receiverMd->BlockOwner[i] != internals->Rank)
+      continue;
+
+    SegmentPtr segment;
+    const BlockRecord *rec = nullptr;
+    svtkDataObject *block = nullptr;
+
+    if (internals->GetBlock(senderMd->BlockOwner[i], senderMd->MeshName,
+      senderMd->BlockIds[i], segment, rec) ||
+      NewBlock(segment, *rec, structureOnly, block))
+      {
+      SENSEI_ERROR("Failed to read block " << senderMd->BlockIds[i]
+        << " of mesh \"" << senderMd->MeshName << "\"")
+      mbds->Delete();
+      return -1;
+      }
+
+    mbds->SetBlock(receiverMd->BlockIds[i], block);
+    block->Delete();
+    }
+
+  mesh = mbds;
+
+  return 0;
+}
+
+// --------------------------------------------------------------------------
+int InputStream::ReadArray(const sensei::MeshMetadataPtr &senderMd,
+  const sensei::MeshMetadataPtr &receiverMd, int association,
+  const std::string &arrayName, svtkMultiBlockDataSet *mesh)
+{
+  sensei::TimeEvent<128> mark("senseiSharedMem::InputStream::ReadArray");
+
+  InternalsType *internals = this->Internals;
+
+  if (!internals->HaveStep)
+    {
+    SENSEI_ERROR("No step is available")
+    return -1;
+    }
+
+  for (int i = 0; i < receiverMd->NumBlocks; ++i)
+    {
+    if (receiverMd->BlockOwner[i] != internals->Rank)
+      continue;
+
+    svtkDataSet *ds = dynamic_cast<svtkDataSet*>(
+      mesh->GetBlock(receiverMd->BlockIds[i]));
+
+    if (!ds)
+      {
+      SENSEI_ERROR("Block " << receiverMd->BlockIds[i] << " of mesh \""
+        << senderMd->MeshName << "\" is missing")
+      return -1;
+      }
+
+    SegmentPtr segment;
+    const BlockRecord *rec = nullptr;
+    if (internals->GetBlock(senderMd->BlockOwner[i], senderMd->MeshName,
+      senderMd->BlockIds[i], segment, rec))
+      return -1;
+
+    const ArrayRecord *arec = rec->GetArray(association, arrayName);
+    if (!arec)
+      {
+      SENSEI_ERROR("Block " << senderMd->BlockIds[i] << " of mesh \""
+        << senderMd->MeshName << "\" has no "
+        << sensei::SVTKUtils::GetAttributesName(association)
+        << " data array \"" << arrayName << "\"")
+      return -1;
+      }
+
+    svtkDataArray *da = NewArray(segment, *arec);
+    if (!da)
+      return -1;
+
+    sensei::SVTKUtils::GetAttributes(ds, association)->AddArray(da);
+    da->Delete();
+    }
+
+  return 0;
+}
+
+}
@@ -0,0 +1,205 @@
+#ifndef SharedMemSchema_h
+#define SharedMemSchema_h
+
+#include "MeshMetadata.h"
+#include "SVTKUtils.h"
+
+#include <svtkCompositeDataSet.h>
+
+#include <mpi.h>
+#include <array>
+#include <map>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+class svtkDataArray;
+class svtkDataObject;
+class svtkMultiBlockDataSet;
+
+/// @file SharedMemSchema.h
+/// The shared memory in transit transport. Each sending rank owns a control
+/// segment named "/<name>.<rank>" holding a ring of slots, and for each slot
+/// a data segment named "/<name>.<rank>.<slot>" holding a step. A data
+/// segment starts with a table of contents describing the meshes, blocks
+/// and arrays of the step, followed by the arrays' values each aligned to
+/// 64 bytes. The slots are handed between the sender and the receivers with
+/// atomic operations, no locks are taken. A slot is free when all the
+/// receivers have released the step in it. The sender creates a new data
+/// segment each time a slot is reused, so the memory of an earlier step
+/// stays valid for as long as a receiver has it mapped.
+namespace senseiSharedMem
+{
+
+/// A mapped POSIX shared memory segment. The segment is unmapped when the
+/// last reference to it goes away.
+class Segment
+{
+public:
+  /// create a new segment of the given size, replacing any with the same
+  /// name, and map it for reading and writing.
+  static std::shared_ptr<Segment> Create(const std::string &name,
+    unsigned long size);
+
+  /// map an existing segment. When shared is not set the mapping is
+  /// private, writes to it are not seen by other processes. Returns nullptr
+  /// if the segment does not exist or is smaller than minSize.
+  static std::shared_ptr<Segment> Open(const std::string &name, bool shared,
+    unsigned long minSize);
+
+  ~Segment();
+
+  unsigned char *GetData() { return this->Data; }
+  unsigned long GetSize() { return this->Size; }
+
+private:
+  Segment(unsigned char *data, unsigned long size) : Data(data), Size(size) {}
+  Segment(const Segment &) = delete;
+  void operator=(const Segment &) = delete;
+
+  unsigned char *Data;
+  unsigned long Size;
+};
+
+using SegmentPtr = std::shared_ptr<Segment>;
+
+/// the location of an array's values in a data segment. Association is
+/// svtkDataObject::POINT or CELL for attribute arrays, and STRUCTURE for
+/// the arrays of the points, coordinates and cells.
+struct ArrayRecord
+{
+  enum { STRUCTURE = -1 };
+
+  int Association;
+  std::string Name;
+  int Type;
+  int NumComponents;
+  long NumTuples;
+  unsigned long Offset;
+};
+
+/// a block in a data segment
+struct BlockRecord
+{
+  int BlockId;
+  int BlockType;
+  std::array<int,6> Extent;
+  std::array<double,3> Origin;
+  std::array<double,3> Spacing;
+  std::vector<ArrayRecord> Arrays;
+
+  // find an array, returns nullptr if it is not present
+  const ArrayRecord *GetArray(int association, const std::string &name) const;
+};
+
+/// the table of contents of a data segment. The metadata is only stored in
+/// the first sender's segment.
+struct StepRecord
+{
+  unsigned long TimeStep;
+  double Time;
+  std::vector<std::string> MeshNames;
+  std::vector<sensei::MeshMetadataPtr> Metadata;
+  std::vector<std::vector<BlockRecord>> Blocks;
+
+  int ToStream(sensei::BinaryStream &str) const;
+  int FromStream(sensei::BinaryStream &str);
+};
+
+/// The sending side. Open, Write, and Close are called by all the sending
+/// ranks.
+class OutputStream
+{
+public:
+  OutputStream();
+  ~OutputStream();
+
+  /// create this rank's control segment with the given number of slots
+  int Open(MPI_Comm comm, const std::string &name, int nSlots);
+
+  /// copy a step into the next slot. The first call waits for the
+  /// receivers to connect, later calls wait for the slot to be released
+  /// when the receivers are behind.
+  int Write(unsigned long timeStep, double time,
+    const std::vector<sensei::MeshMetadataPtr> &metadata,
+    const std::vector<svtkCompositeDataSetPtr> &objects);
+
+  /// mark the end of the stream, wait for the receivers to release the
+  /// steps in flight, and remove the segments.
+  int Close();
+
+  /// true between Open and Close
+  bool IsOpen();
+
+private:
+  OutputStream(const OutputStream &) = delete;
+  void operator=(const OutputStream &) = delete;
+
+  struct InternalsType;
+  InternalsType *Internals;
+};
+
+/// The receiving side. Open, BeginStep, EndStep, and Close are called by all
+/// the receiving ranks.
+class InputStream
+{
+public:
+  InputStream();
+  ~InputStream();
+
+  /// map the senders' control segments, waiting up to timeout seconds for
+  /// the senders to create them.
+  int Open(MPI_Comm comm, const std::string &name, double timeout);
+
+  /// wait for the next step. Returns 0 when a step is available, 1 at the
+  /// end of the stream, and -1 on error.
+  int BeginStep();
+
+  /// release the current step, if any, so that its slots can be reused.
+  /// Arrays handed out from the step remain valid.
+  int EndStep();
+
+  /// release the current step and unmap the control segments
+  int Close();
+
+  /// true when a step is held, from BeginStep until EndStep
+  bool HasStep();
+
+  /// the current step's time and time step
+  unsigned long GetTimeStep();
+  double GetTime();
+
+  /// the current step's meshes, as laid out by the senders
+  unsigned int GetNumberOfMeshes();
+  int GetSenderMeshMetadata(unsigned int id, sensei::MeshMetadataPtr &md);
+
+  /// create the receiver's blocks of a mesh. Points and cells are skipped
+  /// when structureOnly is set. The receiver's layout is given by its
+  /// metadata, its blocks are read from the senders given in the senders'
+  /// metadata.
+  int ReadMesh(const sensei::MeshMetadataPtr &senderMd,
+    const sensei::MeshMetadataPtr &receiverMd, bool structureOnly,
+    svtkMultiBlockDataSet *&mesh);
+
+  /// add an array to each of the receiver's blocks of a mesh
+  int ReadArray(const sensei::MeshMetadataPtr &senderMd,
+    const sensei::MeshMetadataPtr &receiverMd, int association,
+    const std::string &arrayName, svtkMultiBlockDataSet *mesh);
+
+private:
+  InputStream(const InputStream &) = delete;
+  void operator=(const InputStream &) = delete;
+
+  struct InternalsType;
+  InternalsType *Internals;
+};
+
+/// create an array that uses the values of an array record in place. The
+/// array holds a reference to the segment, which stays mapped until the
+/// array releases its values.
+svtkDataArray *NewArray(const SegmentPtr &segment, const ArrayRecord &rec);
+
+}
+
+#endif
@@ -0,0 +1,352 @@
+#include "WeightedPartitioner.h"
+#include "SVTKUtils.h"
+#include "XMLUtils.h"
+#include "STLUtils.h"
+#include "Profiler.h"
+
+#include <svtkDataObject.h>
+
+#include <pugixml.hpp>
+
+#include <algorithm>
+#include <functional>
+#include <queue>
+#include <sstream>
+#include <tuple>
+
+namespace sensei
+{
+using namespace STLUtils; // for operator<<
+
+namespace
+{
+const char *costModelNames[] = {"cells", "points", "bytes", "weights"};
+const char *methodNames[] = {"lpt", "prefix"};
+
+// the load of a rank while blocks are assigned. the least loaded rank is
+// taken first, ties go to the rank with fewer blocks and then the lower rank
+// so that the result is the same on all ranks
+using RankLoad = std::tuple<double, int, int>;
+}
+
+// --------------------------------------------------------------------------
+int WeightedPartitioner::SetCostModel(int model)
+{
+  if ((model < COST_CELLS) || (model > COST_WEIGHTS))
+    {
+    SENSEI_ERROR("Invalid cost model " << model)
+    return -1;
+    }
+
+  this->CostModel = model;
+  return 0;
+}
+
+// --------------------------------------------------------------------------
+int WeightedPartitioner::SetCostModel(const std::string &model)
+{
+  for (int i = COST_CELLS; i <= COST_WEIGHTS; ++i)
+    {
+    if (model == costModelNames[i])
+      return this->SetCostModel(i);
+    }
+
+  SENSEI_ERROR("Invalid cost model \"" << model << "\". Use one of "
+    "cells, points, bytes, or weights")
+  return -1;
+}
+
+// --------------------------------------------------------------------------
+int WeightedPartitioner::SetMethod(int method)
+{
+  if ((method < METHOD_LPT) || (method > METHOD_PREFIX))
+    {
+    SENSEI_ERROR("Invalid method " << method)
+    return -1;
+    }
+
+  this->Method = method;
+  return 0;
+}
+
+// --------------------------------------------------------------------------
+int WeightedPartitioner::SetMethod(const std::string &method)
+{
+  for (int i = METHOD_LPT; i <= METHOD_PREFIX; ++i)
+    {
+    if (method == methodNames[i])
+      return this->SetMethod(i);
+    }
+
+  SENSEI_ERROR("Invalid method \"" << method << "\". Use one of lpt or prefix")
+  return -1;
+}
+
+// --------------------------------------------------------------------------
+int WeightedPartitioner::GetBlockCosts(const MeshMetadataPtr &md, int model,
+  std::vector<double> &costs)
+{
+  unsigned int nBlocks = md->NumBlocks;
+  costs.assign(nBlocks, 0.0);
+
+  if (model == COST_WEIGHTS)
+    {
+    if (this->BlockWeights.size() != nBlocks)
+      {
+      SENSEI_ERROR("The mesh has " << nBlocks << " blocks but "
+        << this->BlockWeights.size() << " block weights were provided")
+      return -1;
+      }
+
+    costs = this->BlockWeights;
+    return 0;
+    }
+
+  bool needCells = (model == COST_CELLS) || (model == COST_BYTES);
+  bool needPoints = (model == COST_POINTS) || (model == COST_BYTES);
+
+  if ((needCells && (md->BlockNumCells.size() != nBlocks)) ||
+    (needPoints && (md->BlockNumPoints.size() != nBlocks)))
+    {
+    SENSEI_ERROR("The " << costModelNames[model]
+      << " cost model requires the number of "
+      << (needCells && needPoints ? "points and cells" : (needCells ? "cells" : "points"))
+      << " in each block, but the metadata for mesh \"" << md->MeshName
+      << "\" does not have them")
+    return -1;
+    }
+
+  if (model == COST_CELLS)
+    {
+    for (unsigned int i = 0; i < nBlocks; ++i)
+      costs[i] = md->BlockNumCells[i];
+    return 0;
+    }
+
+  if (model == COST_POINTS)
+    {
+    for (unsigned int i = 0; i < nBlocks; ++i)
+      costs[i] = md->BlockNumPoints[i];
+    return 0;
+    }
+
+  // the bytes of the arrays, by default all of them
+  std::vector<int> arrayIds;
+  if (this->Arrays.empty())
+    {
+    for (int j = 0; j < md->NumArrays; ++j)
+      arrayIds.push_back(j);
+    }
+  else
+    {
+    unsigned int nArrays = this->Arrays.size();
+    for (unsigned int k = 0; k < nArrays; ++k)
+      {
+      std::vector<std::string>::iterator it =
+        std::find(md->ArrayName.begin(), md->ArrayName.end(), this->Arrays[k]);
+
+      if (it == md->ArrayName.end())
+        {
+        SENSEI_ERROR("No array named \"" << this->Arrays[k]
+          << "\" on mesh \"" << md->MeshName << "\"")
+        return -1;
+        }
+
+      arrayIds.push_back(it - md->ArrayName.begin());
+      }
+    }
+
+  unsigned int nIds = arrayIds.size();
+  for (unsigned int k = 0; k < nIds; ++k)
+    {
+    int j = arrayIds[k];
+
+    double elemSize = md->ArrayComponents[j] *
+      double(SVTKUtils::Size(md->ArrayType[j]));
+
+    const std::vector<long> &nElem =
+      md->ArrayCentering[j] == svtkDataObject::CELL ?
+        md->BlockNumCells : md->BlockNumPoints;
+
+    for (unsigned int i = 0; i < nBlocks; ++i)
+      costs[i] += elemSize*nElem[i];
+    }
+
+  return 0;
+}
+
+// --------------------------------------------------------------------------
+int WeightedPartitioner::GetPartition(MPI_Comm comm, const MeshMetadataPtr &mdIn,
+  MeshMetadataPtr &mdOut)
+{
+  TimeEvent<128> mark("WeightedPartitioner::GetPartition");
+
+  mdOut = mdIn->NewCopy();
+
+  int nRanks = 1;
+  MPI_Comm_size(comm, &nRanks);
+
+  std::vector<double> costs;
+  if (this->GetBlockCosts(mdOut, costs))
+    return -1;
+
+  unsigned int nBlocks = mdOut->NumBlocks;
+  mdOut->BlockOwner.resize(nBlocks);
+
+  std::vector<unsigned int> order(nBlocks);
+  for (unsigned int i = 0; i < nBlocks; ++i)
+    order[i] = i;
+
+  if (this->Method == METHOD_LPT)
+    {
+    // take the blocks in order of decreasing cost
+    std::stable_sort(order.begin(), order.end(),
+      [&costs](unsigned int a, unsigned int b) { return costs[a] > costs[b]; });
+
+    // and give each to the least loaded rank
+    std::priority_queue<RankLoad, std::vector<RankLoad>,
+      std::greater<RankLoad>> ranks;
+
+    for (int j = 0; j < nRanks; ++j)
+      ranks.push(RankLoad(0.0, 0, j));
+
+    for (unsigned int k = 0; k < nBlocks; ++k)
+      {
+      unsigned int i = order[k];
+
+      RankLoad rl = ranks.top();
+      ranks.pop();
+
+      int rank = std::get<2>(rl);
+      mdOut->BlockOwner[i] = rank;
+
+      ranks.push(RankLoad(std::get<0>(rl) + costs[i], std::get<1>(rl) + 1, rank));
+      }
+    }
+  else
+    {
+    SplitPrefix(order, costs, nRanks, mdOut->BlockOwner);
+    }
+
+  this->UpdateImbalance(mdOut, costs, nRanks);
+
+  return 0;
+}
+
+// --------------------------------------------------------------------------
+void WeightedPartitioner::SplitPrefix(const std::vector<unsigned int> &order,
+  const std::vector<double> &costs, int nRanks, std::vector<int> &owner)
+{
+  // each block goes to the rank whose share of the total cost contains
+  // the center of the block's cost in the prefix sum. this keeps
+  // consecutive blocks together
+  unsigned int nBlocks = order.size();
+
+  double total = 0.0;
+  for (unsigned int i = 0; i < nBlocks; ++i)
+    total += costs[i];
+
+  double prefix = 0.0;
+  for (unsigned int k = 0; k < nBlocks; ++k)
+    {
+    unsigned int i = order[k];
+
+    if (total > 0.0)
+      owner[i] = std::min(nRanks - 1,
+        int((prefix + 0.5*costs[i])/total*nRanks));
+    else
+      owner[i] = int((long(k)*nRanks)/nBlocks);
+
+    prefix += costs[i];
+    }
+}
+
+// --------------------------------------------------------------------------
+void WeightedPartitioner::UpdateImbalance(const MeshMetadataPtr &md,
+  const std::vector<double> &costs, int nRanks)
+{
+  std::vector<double> loads(nRanks, 0.0);
+  for (int i = 0; i < md->NumBlocks; ++i)
+    loads[md->BlockOwner[i]] += costs[i];
+
+  // the largest load over the mean load
+  double total = 0.0;
+  double maxLoad = 0.0;
+  for (int j = 0; j < nRanks; ++j)
+    {
+    total += loads[j];
+    maxLoad = std::max(maxLoad, loads[j]);
+    }
+
+  this->Imbalance = total > 0.0 ? maxLoad*nRanks/total : 1.0;
+
+  std::string valueName = std::string(this->GetClassName()) + "::Imbalance";
+  Profiler::RecordValue(valueName.c_str(), this->Imbalance);
+
+  if (this->Verbose)
+    {
+    std::ostringstream oss;
+    oss << "loads=" << loads;
+    SENSEI_STATUS(<< this->GetClassName() << " partitioned " << md->NumBlocks
+      << " blocks of mesh \"" << md->MeshName << "\" over " << nRanks
+      << " ranks by " << costModelNames[this->CostModel] << ", imbalance="
+      << this->Imbalance << " " << oss.str())
+    }
+}
+
+// --------------------------------------------------------------------------
+int WeightedPartitioner::InitializeCostModel(pugi::xml_node &node,
+  std::ostream &config)
+{
+  if (this->SetCostModel(node.attribute("cost").as_string(costModelNames[this->CostModel])))
+    return -1;
+
+  this->Verbose = node.attribute("verbose").as_int(0);
+
+  this->Arrays.clear();
+  pugi::xml_attribute arrays = node.attribute("arrays");
+  if (arrays)
+    XMLUtils::ParseList(arrays.value(), this->Arrays);
+
+  this->BlockWeights.clear();
+  if (this->CostModel == COST_WEIGHTS)
+    {
+    if (XMLUtils::RequireChild(node, "block_weights"))
+      return -1;
+
+    if (XMLUtils::ParseNumeric(node.child("block_weights"), this->BlockWeights))
+      {
+      SENSEI_ERROR("Failed to parse the block_weights array")
+      return -1;
+      }
+    }
+
+  config << "cost=" << costModelNames[this->CostModel];
+
+  if (!this->Arrays.empty())
+    config << " arrays=" << this->Arrays;
+
+  if (!this->BlockWeights.empty())
+    config << " block_weights=" << this->BlockWeights;
+
+  return 0;
+}
+
+// --------------------------------------------------------------------------
+int WeightedPartitioner::Initialize(pugi::xml_node &node)
+{
+  TimeEvent<128> mark("WeightedPartitioner::Initialize");
+
+  std::ostringstream oss;
+  if (this->SetMethod(node.attribute("method").as_string("lpt")) ||
+    this->InitializeCostModel(node, oss))
+    return -1;
+
+  oss << " method=" << methodNames[this->Method];
+
+  SENSEI_STATUS("Configured WeightedPartitioner " << oss.str())
+
+  return 0;
+}
+
+}
@@ -0,0 +1,125 @@
+#ifndef sensei_WeightedPartitioner_h
+#define sensei_WeightedPartitioner_h
+
+#include "Partitioner.h"
+
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace sensei
+{
+
+class WeightedPartitioner;
+using WeightedPartitionerPtr = std::shared_ptr<sensei::WeightedPartitioner>;
+
+/// @class WeightedPartitioner
+/// The weighted partitioner distributes blocks to ranks such that the sum of
+/// a per-block cost is balanced. The cost of a block is its number of cells,
+/// its number of points, the number of bytes in its arrays, or a user
+/// provided weight. Blocks are assigned either by the longest processing
+/// time (LPT) greedy method, where blocks are taken in order of decreasing
+/// cost and each is given to the least loaded rank, or by splitting the
+/// prefix sum of the costs into contiguous ranges of near equal cost, which
+/// keeps consecutive blocks together. The assignment depends only on the
+/// metadata, so every rank computes the same partition.
+///
+/// The achieved imbalance, the largest load over the mean load, is recorded
+/// with Profiler::RecordValue as "WeightedPartitioner::Imbalance", and is
+/// returned by GetImbalance. A value of 1 is a perfect balance.
+///
+/// XML attributes:
+///
+///   cost    -- cells, points, bytes, or weights. default: cells
+///   method  -- lpt or prefix. default: lpt
+///   arrays  -- comma separated names of the arrays counted by the bytes
+///              cost. default: all arrays
+///   verbose -- report the loads when non-zero. default: 0
+///
+/// The weights are given in a `block_weights` child element, one per block.
+class SENSEI_EXPORT WeightedPartitioner : public sensei::Partitioner
+{
+public:
+  static sensei::WeightedPartitionerPtr New()
+  { return WeightedPartitionerPtr(new WeightedPartitioner); }
+
+  const char *GetClassName() override { return "WeightedPartitioner"; }
+
+  /// the quantity that is balanced
+  enum {COST_CELLS=0, COST_POINTS=1, COST_BYTES=2, COST_WEIGHTS=3};
+
+  /// the way blocks are assigned
+  enum {METHOD_LPT=0, METHOD_PREFIX=1};
+
+  /// Set/get the cost model, one of the above or its name in lower case.
+  int SetCostModel(int model);
+  int SetCostModel(const std::string &model);
+  int GetCostModel() { return this->CostModel; }
+
+  /// Set/get the method, one of the above or its name in lower case.
+  int SetMethod(int method);
+  int SetMethod(const std::string &method);
+  int GetMethod() { return this->Method; }
+
+  /// Set/get the arrays counted by the bytes cost model. When empty all
+  /// arrays are counted.
+  void SetArrays(const std::vector<std::string> &arrays) { this->Arrays = arrays; }
+  void GetArrays(std::vector<std::string> &arrays) { arrays = this->Arrays; }
+
+  /// Set/get the per block weights used by the weights cost model. There
+  /// must be one weight for each block.
+  void SetBlockWeights(const std::vector<double> &weights) { this->BlockWeights = weights; }
+  void GetBlockWeights(std::vector<double> &weights) { weights = this->BlockWeights; }
+
+  /// Get the imbalance, the largest load over the mean load, of the last
+  /// partition.
+  double GetImbalance() { return this->Imbalance; }
+
+  /// Initialize from XML
+  int Initialize(pugi::xml_node &node) override;
+
+  /// given an existing partitioning of data passed in the first MeshMetadata
+  /// argument,return a new partittioning in the second MeshMetadata argument.
+  /// the blocks are distributed such that the cost on each rank is balanced.
+  int GetPartition(MPI_Comm comm, const sensei::MeshMetadataPtr &in,
+    sensei::MeshMetadataPtr &out) override;
+
+protected:
+  WeightedPartitioner() : CostModel(COST_CELLS), Method(METHOD_LPT),
+    Imbalance(1.0) {}
+
+  WeightedPartitioner(const WeightedPartitioner &) = default;
+
+  // compute the cost of each block from the metadata, using the given or
+  // the current cost model
+  int GetBlockCosts(const sensei::MeshMetadataPtr &md, int model,
+    std::vector<double> &costs);
+
+  int GetBlockCosts(const sensei::MeshMetadataPtr &md,
+    std::vector<double> &costs)
+  { return this->GetBlockCosts(md, this->CostModel, costs); }
+
+  // initialize the cost model from the cost, arrays, and verbose attributes
+  // and the block_weights element, and describe it in config
+  int InitializeCostModel(pugi::xml_node &node, std::ostream &config);
+
+  // assign the blocks, taken in the given order, to contiguous ranges of
+  // near equal cost
+  static void SplitPrefix(const std::vector<unsigned int> &order,
+    const std::vector<double> &costs, int nRanks, std::vector<int> &owner);
+
+  // compute the imbalance of the partition in the metadata, record it with
+  // the Profiler, and report the loads when verbose
+  void UpdateImbalance(const sensei::MeshMetadataPtr &md,
+    const std::vector<double> &costs, int nRanks);
+
+  int CostModel;
+  int Method;
+  std::vector<std::string> Arrays;
+  std::vector<double> BlockWeights;
+  double Imbalance;
+};
+
+}
+
+#endif
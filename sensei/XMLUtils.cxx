@@ -160,5 +160,21 @@ int ParseNameValuePairs(const pugi::xml_node &node,
   return 0;
 }
 
+//----------------------------------------------------------------------------
+int ParseList(const std::string &strData, std::vector<std::string> &items)
+{
+  std::string delims = " ,\t\n";
+
+  std::size_t curr = strData.find_first_not_of(delims, 0);
+  while (curr != std::string::npos)
+    {
+    std::size_t next = strData.find_first_of(delims, curr + 1);
+    items.push_back(strData.substr(curr, next - curr));
+    curr = strData.find_first_not_of(delims, next);
+    }
+
+  return items.size();
+}
+
 }
 }
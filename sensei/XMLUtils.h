@@ -121,6 +121,12 @@ int ParseNumeric(const pugi::xml_node &node, std::array<num_t,n> &numData)
 int ParseNameValuePairs(const pugi::xml_node &node,
   std::vector<std::string> &names, std::vector<std::string> &values);
 
+/** split a comma or white space separated list, such as the value of an
+ * attribute, into its items. returns the number of items found.
+ */
+SENSEI_EXPORT
+int ParseList(const std::string &strData, std::vector<std::string> &items);
+
 }
 }
 #endif
@@ -13,6 +13,7 @@
 #include <iostream>
 #include <sstream>
 #include <random>
+#include <cstring>
 
 using std::cerr;
 using std::endl;
@@ -22,6 +23,9 @@ using std::endl;
 int gnx = 100;
 int gny = 100;
 
+// when set the mesh is reported as static in the metadata
+int staticMesh = 0;
+
 
 // generate random Gaussian
 template<typename n_t>
@@ -62,6 +66,7 @@ int getMeshMetadata(unsigned int i, sensei::MeshMetadataPtr &mdp)
   mdp->NumBlocks = nRanks;
   mdp->NumBlocksLocal = {1};
   mdp->NumArrays = 1;
+  mdp->StaticMesh = staticMesh;
 
   mdp->ArrayName = {"values"};
   mdp->ArrayCentering = {svtkDataObject::CELL};
@@ -150,15 +155,19 @@ int addArray(svtkDataObject *mesh, const std::string &meshName,
 
 int main(int argc, char **argv)
 {
-  MPI_Init(&argc, &argv);
+  // asynchronous analyses make MPI calls from a worker thread
+  int provided = 0;
+  MPI_Init_thread(&argc, &argv, MPI_THREAD_MULTIPLE, &provided);
 
-  if (argc != 2)
+  if ((argc < 2) || (argc > 3) || ((argc == 3) && strcmp(argv[2], "static")))
     {
-    SENSEI_ERROR("need an xml config on the command line")
+    SENSEI_ERROR("usage: simpleTestDriver config.xml [static]")
     MPI_Abort(MPI_COMM_WORLD, -1);
     return -1;
     }
 
+  staticMesh = argc == 3;
+
   sensei::ProgrammableDataAdaptor *da = sensei::ProgrammableDataAdaptor::New();
   da->SetGetNumberOfMeshesCallback(getNumMeshes);
   da->SetGetMeshMetadataCallback(getMeshMetadata);
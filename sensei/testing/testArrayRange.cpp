@@ -0,0 +1,221 @@
+#include "SVTKUtils.h"
+#include "MeshMetadata.h"
+#include "Error.h"
+
+#include <svtkDoubleArray.h>
+#include <svtkFloatArray.h>
+#include <svtkIntArray.h>
+#include <svtkUnsignedCharArray.h>
+#include <svtkSOADataArrayTemplate.h>
+#include <svtkImageData.h>
+#include <svtkPointData.h>
+#include <svtkCellData.h>
+#include <svtkMultiBlockDataSet.h>
+#include <svtkSmartPointer.h>
+
+#include <mpi.h>
+#include <cmath>
+#include <limits>
+#include <random>
+#include <vector>
+#include <sstream>
+#include <iostream>
+
+// Validates SVTKUtils::GetArrayRange against a direct calculation for
+// interleaved and contiguous multi-component arrays, integer arrays, NaNs and
+// ghost zones, checks that cached ranges are refreshed when the array or
+// ghost array is modified, and that the block array ranges in the mesh
+// metadata skip ghost zones. Reports the throughput of the computed and
+// cached ranges.
+
+// the range of the valid values computed directly
+void Reference(svtkDataArray *da, svtkUnsignedCharArray *ghosts, int comp,
+  double range[2])
+{
+  range[0] = std::numeric_limits<double>::max();
+  range[1] = std::numeric_limits<double>::lowest();
+
+  svtkIdType nTuples = da->GetNumberOfTuples();
+  for (svtkIdType i = 0; i < nTuples; ++i)
+    {
+    double value = da->GetComponent(i, comp);
+    if ((ghosts && ghosts->GetValue(i)) || std::isnan(value))
+      continue;
+
+    range[0] = std::min(range[0], value);
+    range[1] = std::max(range[1], value);
+    }
+}
+
+int Check(const char *label, svtkDataArray *da, svtkUnsignedCharArray *ghosts,
+  int comp)
+{
+  double ref[2];
+  Reference(da, ghosts, comp, ref);
+
+  double rng[2];
+  if (sensei::SVTKUtils::GetArrayRange(da, ghosts, comp, rng) ||
+    (rng[0] != ref[0]) || (rng[1] != ref[1]))
+    {
+    SENSEI_ERROR("The range of " << label << " component " << comp
+      << " is [" << rng[0] << ", " << rng[1] << "] not ["
+      << ref[0] << ", " << ref[1] << "]")
+    return -1;
+    }
+
+  return 0;
+}
+
+int main(int argc, char **argv)
+{
+  MPI_Init(&argc, &argv);
+
+  int rank = 0;
+  MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+
+  svtkIdType n = argc > 1 ? atol(argv[1]) : 1000003;
+
+  std::mt19937 gen(rank);
+  std::normal_distribution<double> dist(0.0, 100.0);
+
+  int err = 0;
+
+  // an interleaved 3 component array, a contiguous 3 component array, a
+  // single component float array with NaNs, and an integer array
+  svtkSmartPointer<svtkDoubleArray> d = svtkSmartPointer<svtkDoubleArray>::New();
+  d->SetName("d");
+  d->SetNumberOfComponents(3);
+  d->SetNumberOfTuples(n);
+
+  using svtkFloatSOAArray = svtkSOADataArrayTemplate<float>;
+  svtkSmartPointer<svtkFloatSOAArray> s = svtkSmartPointer<svtkFloatSOAArray>::New();
+  s->SetName("s");
+  s->SetNumberOfComponents(3);
+  s->SetNumberOfTuples(n);
+
+  svtkSmartPointer<svtkFloatArray> f = svtkSmartPointer<svtkFloatArray>::New();
+  f->SetName("f");
+  f->SetNumberOfTuples(n);
+
+  svtkSmartPointer<svtkIntArray> k = svtkSmartPointer<svtkIntArray>::New();
+  k->SetName("k");
+  k->SetNumberOfTuples(n);
+
+  // every seventh value is a ghost, ghosts hold the extreme values
+  svtkSmartPointer<svtkUnsignedCharArray> g = svtkSmartPointer<svtkUnsignedCharArray>::New();
+  g->SetName("svtkGhostType");
+  g->SetNumberOfTuples(n);
+
+  for (svtkIdType i = 0; i < n; ++i)
+    {
+    bool ghost = (i % 7) == 3;
+    g->SetValue(i, ghost ? 1 : 0);
+
+    for (int j = 0; j < 3; ++j)
+      {
+      double v = ghost ? (j + 1)*1.0e6*(i % 2 ? 1.0 : -1.0) : dist(gen);
+      d->SetTypedComponent(i, j, v);
+      s->SetTypedComponent(i, j, float(v));
+      }
+
+    f->SetValue(i, (i % 11) == 5 ? std::numeric_limits<float>::quiet_NaN() :
+      (ghost ? -1.0e8f : float(dist(gen))));
+
+    k->SetValue(i, ghost ? 1 << 30 : int(dist(gen)));
+    }
+
+  for (int j = 0; j < 3; ++j)
+    {
+    err |= Check("d", d, nullptr, j);
+    err |= Check("d", d, g, j);
+    err |= Check("s", s, nullptr, j);
+    err |= Check("s", s, g, j);
+    }
+
+  err |= Check("f", f, nullptr, 0);
+  err |= Check("f", f, g, 0);
+  err |= Check("k", k, nullptr, 0);
+  err |= Check("k", k, g, 0);
+
+  // an invalid component is reported
+  double rng[2];
+  std::ostringstream os;
+  std::streambuf *buf = std::cerr.rdbuf(os.rdbuf());
+  int ierr = sensei::SVTKUtils::GetArrayRange(f, nullptr, 1, rng);
+  std::cerr.rdbuf(buf);
+  if (!ierr)
+    {
+    SENSEI_ERROR("An invalid component was accepted")
+    err = -1;
+    }
+
+  // modifying the array or the ghosts refreshes the cached range
+  f->SetValue(1, 1.0e9f);
+  f->Modified();
+  err |= Check("modified f", f, g, 0);
+
+  g->SetValue(3, 0);
+  g->Modified();
+  err |= Check("f with modified ghosts", f, g, 0);
+  err |= Check("modified d", d, g, 0);
+
+  // the throughput of the computed and cached ranges
+  double t0 = MPI_Wtime();
+  d->Modified();
+  sensei::SVTKUtils::GetArrayRange(d, g, 0, rng);
+  double t1 = MPI_Wtime();
+  sensei::SVTKUtils::GetArrayRange(d, g, 0, rng);
+  double t2 = MPI_Wtime();
+
+  // the block ranges in the metadata skip the ghost zones
+  svtkSmartPointer<svtkImageData> im = svtkSmartPointer<svtkImageData>::New();
+  im->SetDimensions(int(n), 1, 1);
+  im->GetPointData()->AddArray(f);
+  im->GetPointData()->AddArray(d);
+  im->GetPointData()->AddArray(g);
+
+  svtkSmartPointer<svtkMultiBlockDataSet> mb = svtkSmartPointer<svtkMultiBlockDataSet>::New();
+  mb->SetNumberOfBlocks(1);
+  mb->SetBlock(0, im);
+
+  sensei::MeshMetadataPtr md = sensei::MeshMetadata::New();
+  md->Flags.SetBlockArrayRange();
+  if (sensei::SVTKUtils::GetMetadata(MPI_COMM_SELF, mb, md) ||
+    (md->BlockArrayRange.size() != 1) || (md->BlockArrayRange[0].size() != 3))
+    {
+    SENSEI_ERROR("Failed to get the block array ranges")
+    err = -1;
+    }
+  else
+    {
+    double ref[2];
+    Reference(f, g, 0, ref);
+    if ((md->BlockArrayRange[0][0][0] != ref[0]) ||
+      (md->BlockArrayRange[0][0][1] != ref[1]))
+      {
+      SENSEI_ERROR("The block array range [" << md->BlockArrayRange[0][0][0]
+        << ", " << md->BlockArrayRange[0][0][1] << "] includes ghost zones")
+      err = -1;
+      }
+
+    if ((md->BlockArrayRange[0][2][0] != 0.0) ||
+      (md->BlockArrayRange[0][2][1] != 1.0))
+      {
+      SENSEI_ERROR("The range of the ghost array is incorrect")
+      err = -1;
+      }
+    }
+
+  if (rank == 0)
+    {
+    std::cerr << "Range of " << n << " values, computed "
+      << n/(t1 - t0)/1.0e6 << " Mvalues/s, cached "
+      << (t2 - t1)*1.0e6 << " us" << std::endl;
+    }
+
+  MPI_Allreduce(MPI_IN_PLACE, &err, 1, MPI_INT, MPI_MIN, MPI_COMM_WORLD);
+
+  MPI_Finalize();
+
+  return err ? -1 : 0;
+}
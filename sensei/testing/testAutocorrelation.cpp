@@ -0,0 +1,301 @@
+#include "Autocorrelation.h"
+#include "SVTKDataAdaptor.h"
+#include "Error.h"
+
+#include <svtkFloatArray.h>
+#include <svtkDoubleArray.h>
+#include <svtkSOADataArrayTemplate.h>
+#include <svtkImageData.h>
+#include <svtkMultiBlockDataSet.h>
+#include <svtkPointData.h>
+#include <svtkSmartPointer.h>
+
+#include <mpi.h>
+#include <cmath>
+#include <vector>
+#include <string>
+#include <sstream>
+#include <cstdlib>
+#include <iostream>
+
+// Validates the autocorrelation with a cap on the number of blocks in memory
+// against the in memory calculation, and of double precision and multi
+// component arrays against a single precision array with the same values.
+// Reports the throughput with each cap. Pass the window, the number of blocks
+// per rank, the number of threads, and the directory for the blocks that do
+// not fit in memory on the command line to use this as a benchmark, for
+// example:
+//
+//     mpiexec -np 2 testAutocorrelation 64 16 4 /local/scratch
+
+// the extent of each block
+const int nx = 32;
+const int ny = 24;
+const int nz = 8;
+
+// a multi-block data set holding the local blocks. the blocks of a rank are
+// stacked in z and the values change with the step. the same values are
+// stored in: f a float array, d a double array, v the second component of an
+// interleaved 3 component array, s the third component of a 3 component
+// array with each component stored contiguously. a holds the magnitude of
+// the components of v and s.
+sensei::SVTKDataAdaptor *NewDataAdaptor(int rank, int nRanks,
+  int blocksPerRank, int step)
+{
+  svtkSmartPointer<svtkMultiBlockDataSet> mb =
+    svtkSmartPointer<svtkMultiBlockDataSet>::New();
+
+  mb->SetNumberOfBlocks(nRanks*blocksPerRank);
+
+  for (int i = 0; i < blocksPerRank; ++i)
+    {
+    int bid = rank*blocksPerRank + i;
+    int z0 = bid*nz;
+
+    long nVals = nx*ny*nz;
+
+    svtkSmartPointer<svtkFloatArray> f = svtkSmartPointer<svtkFloatArray>::New();
+    f->SetName("f");
+    f->SetNumberOfTuples(nVals);
+
+    svtkSmartPointer<svtkDoubleArray> d = svtkSmartPointer<svtkDoubleArray>::New();
+    d->SetName("d");
+    d->SetNumberOfTuples(nVals);
+
+    svtkSmartPointer<svtkDoubleArray> v = svtkSmartPointer<svtkDoubleArray>::New();
+    v->SetName("v");
+    v->SetNumberOfComponents(3);
+    v->SetNumberOfTuples(nVals);
+
+    using svtkFloatSOAArray = svtkSOADataArrayTemplate<float>;
+    svtkSmartPointer<svtkFloatSOAArray> sa = svtkSmartPointer<svtkFloatSOAArray>::New();
+    sa->SetName("s");
+    sa->SetNumberOfComponents(3);
+    sa->SetNumberOfTuples(nVals);
+
+    svtkSmartPointer<svtkFloatArray> a = svtkSmartPointer<svtkFloatArray>::New();
+    a->SetName("a");
+    a->SetNumberOfTuples(nVals);
+
+    for (int k = 0; k < nz; ++k)
+      {
+      for (int j = 0; j < ny; ++j)
+        {
+        for (int l = 0; l < nx; ++l)
+          {
+          float r = std::sqrt(float((l - nx/2)*(l - nx/2) + (j - ny/2)*(j - ny/2)));
+          float val = std::sin(0.3f*step*(1.0f + 0.1f*(z0 + k)) + 0.2f*r);
+
+          long q = (k*ny + j)*nx + l;
+          f->SetValue(q, val);
+          d->SetValue(q, val);
+          v->SetTypedComponent(q, 0, 0.0);
+          v->SetTypedComponent(q, 1, val);
+          v->SetTypedComponent(q, 2, 0.0);
+          sa->SetTypedComponent(q, 0, 0.0f);
+          sa->SetTypedComponent(q, 1, 0.0f);
+          sa->SetTypedComponent(q, 2, val);
+          a->SetValue(q, std::fabs(val));
+          }
+        }
+      }
+
+    svtkSmartPointer<svtkImageData> im = svtkSmartPointer<svtkImageData>::New();
+    im->SetExtent(0, nx - 1, 0, ny - 1, z0, z0 + nz - 1);
+    im->GetPointData()->AddArray(f);
+    im->GetPointData()->AddArray(d);
+    im->GetPointData()->AddArray(v);
+    im->GetPointData()->AddArray(sa);
+    im->GetPointData()->AddArray(a);
+
+    mb->SetBlock(bid, im);
+    }
+
+  sensei::SVTKDataAdaptor *data = sensei::SVTKDataAdaptor::New();
+  data->SetCommunicator(MPI_COMM_WORLD);
+  data->SetDataObject("mesh", mb);
+
+  return data;
+}
+
+// runs the analysis, returns the time spent in Execute. the results printed
+// by Finalize are captured on rank 0
+double Compute(const std::string &array, int comp, int window,
+  int blocksPerRank, int nSteps, int nThreads, int maxBlocks,
+  const std::string &storageDir, int &err, std::string &res)
+{
+  int rank = 0;
+  int nRanks = 1;
+  MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+  MPI_Comm_size(MPI_COMM_WORLD, &nRanks);
+
+  sensei::Autocorrelation *ac = sensei::Autocorrelation::New();
+  ac->SetCommunicator(MPI_COMM_WORLD);
+
+  if (ac->Initialize(window, "mesh", svtkDataObject::POINT, array, 3,
+    nThreads, maxBlocks, storageDir))
+    {
+    err = -1;
+    ac->Delete();
+    return 0.0;
+    }
+
+  ac->SetComponent(comp);
+
+  double dt = 0.0;
+  for (int i = 0; i < nSteps; ++i)
+    {
+    sensei::SVTKDataAdaptor *data = NewDataAdaptor(rank, nRanks, blocksPerRank, i);
+
+    MPI_Barrier(MPI_COMM_WORLD);
+    double t0 = MPI_Wtime();
+
+    if (!ac->Execute(data, nullptr))
+      err = -1;
+
+    MPI_Barrier(MPI_COMM_WORLD);
+    dt += MPI_Wtime() - t0;
+
+    data->ReleaseData();
+    data->Delete();
+    }
+
+  std::ostringstream os;
+  std::streambuf *buf = std::cerr.rdbuf(os.rdbuf());
+
+  ac->Finalize();
+
+  std::cerr.rdbuf(buf);
+  res = os.str();
+
+  ac->Delete();
+
+  return dt;
+}
+
+int main(int argc, char **argv)
+{
+  MPI_Init(&argc, &argv);
+
+  int window = argc > 1 ? atoi(argv[1]) : 6;
+  int blocksPerRank = argc > 2 ? atoi(argv[2]) : 6;
+  int nThreads = argc > 3 ? atoi(argv[3]) : 2;
+  std::string storageDir = argc > 4 ? argv[4] : "/tmp";
+  int nSteps = 2*window + 1;
+
+  int rank = 0;
+  int nRanks = 1;
+  MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+  MPI_Comm_size(MPI_COMM_WORLD, &nRanks);
+
+  int err = 0;
+
+  // all blocks in memory
+  std::string ref;
+  double dtRef = Compute("f", 0, window, blocksPerRank, nSteps, nThreads, -1,
+    storageDir, err, ref);
+
+  if ((rank == 0) && (ref.find("Max autocorrelations for") == std::string::npos))
+    {
+    SENSEI_ERROR("No autocorrelations were reported")
+    err = -1;
+    }
+
+  // a cap on the number of blocks in memory gives the same results
+  std::vector<int> caps = {1, nThreads, (blocksPerRank + 1)/2};
+  std::vector<double> dt;
+
+  for (int cap : caps)
+    {
+    std::string res;
+    dt.push_back(Compute("f", 0, window, blocksPerRank, nSteps, nThreads, cap,
+      storageDir, err, res));
+
+    if ((rank == 0) && (res != ref))
+      {
+      SENSEI_ERROR("The results with " << cap
+        << " blocks in memory differ from the in memory results")
+      err = -1;
+      }
+    }
+
+  // other types and layouts of the same values give the same results
+  struct Case
+  {
+    const char *Array;
+    int Component;
+  };
+
+  std::vector<Case> cases = {{"d", 0}, {"v", 1}, {"s", 2}};
+
+  for (const Case &c : cases)
+    {
+    std::string res;
+    Compute(c.Array, c.Component, window, blocksPerRank, nSteps, nThreads,
+      -1, storageDir, err, res);
+
+    if ((rank == 0) && (res != ref))
+      {
+      SENSEI_ERROR("The results for component " << c.Component
+        << " of array " << c.Array << " differ from the float array")
+      err = -1;
+      }
+    }
+
+  // the magnitude of the components
+  std::string magRef;
+  Compute("a", 0, window, blocksPerRank, nSteps, nThreads, -1, storageDir,
+    err, magRef);
+
+  for (const char *array : {"v", "s"})
+    {
+    std::string res;
+    Compute(array, sensei::Autocorrelation::MAGNITUDE, window, blocksPerRank,
+      nSteps, nThreads, -1, storageDir, err, res);
+
+    if ((rank == 0) && (res != magRef))
+      {
+      SENSEI_ERROR("The results for the magnitude of array " << array
+        << " differ from the float array")
+      err = -1;
+      }
+    }
+
+  // a directory that does not exist is reported
+  sensei::Autocorrelation *ac = sensei::Autocorrelation::New();
+  ac->SetCommunicator(MPI_COMM_WORLD);
+
+  std::ostringstream os;
+  std::streambuf *buf = std::cerr.rdbuf(os.rdbuf());
+
+  if (!ac->Initialize(window, "mesh", svtkDataObject::POINT, "f", 3,
+    nThreads, 1, storageDir + "/does/not/exist"))
+    err = -1;
+
+  std::cerr.rdbuf(buf);
+  ac->Delete();
+
+  if (rank == 0)
+    {
+    double mib = double(nx*ny*nz)*window*2*sizeof(float)/1024.0/1024.0;
+    double nCells = double(nx*ny*nz)*blocksPerRank*nRanks*nSteps;
+
+    std::cerr << "Autocorrelation of " << blocksPerRank << " blocks of "
+      << mib << " MiB per rank, window " << window << ", " << nThreads
+      << " threads, " << nRanks << " ranks" << std::endl
+      << "  all blocks in memory " << nCells/dtRef << " cells/s" << std::endl;
+
+    for (size_t i = 0; i < caps.size(); ++i)
+      {
+      std::cerr << "  " << caps[i] << " blocks in memory " << nCells/dt[i]
+        << " cells/s, " << 100.0*dtRef/dt[i] << "% of the in memory rate"
+        << std::endl;
+      }
+    }
+
+  MPI_Allreduce(MPI_IN_PLACE, &err, 1, MPI_INT, MPI_MIN, MPI_COMM_WORLD);
+
+  MPI_Finalize();
+
+  return err ? -1 : 0;
+}
@@ -0,0 +1,170 @@
+#include "MeshMetadata.h"
+#include "MPIUtils.h"
+#include "STLUtils.h"
+#include "Error.h"
+
+#include <mpi.h>
+#include <vector>
+#include <array>
+#include <cstdlib>
+#include <iostream>
+
+// Validates MeshMetadata::GlobalizeView against the field by field gather
+// and reports the time taken by each. Pass the number of repetitions on the
+// command line to use this as a benchmark, for example:
+//
+//     mpiexec -np 1024 testGlobalizeView 1000
+
+// the global view built one field at a time
+void GlobalizeViewByField(MPI_Comm comm, sensei::MeshMetadataPtr &md)
+{
+  using namespace sensei;
+
+  MPIUtils::GlobalViewV(comm, md->BlockOwner);
+  MPIUtils::GlobalViewV(comm, md->BlockIds);
+  MPIUtils::GlobalViewV(comm, md->NumBlocksLocal);
+  MPIUtils::GlobalViewV(comm, md->BlockNumPoints);
+  MPIUtils::GlobalViewV(comm, md->BlockNumCells);
+  MPIUtils::GlobalViewV(comm, md->BlockCellArraySize);
+  MPIUtils::GlobalViewV(comm, md->BlockExtents);
+  MPIUtils::GlobalViewV(comm, md->BlockBounds);
+  MPIUtils::GlobalViewV(comm, md->BlockArrayRange);
+  MPIUtils::GlobalViewV(comm, md->BlockLevel);
+
+  MPIUtils::GlobalCounts(comm, md->BlocksPerLevel);
+
+  STLUtils::ReduceRange(md->BlockBounds, md->Bounds);
+  STLUtils::ReduceRange(md->BlockExtents, md->Extent);
+  STLUtils::ReduceRange(md->BlockArrayRange, md->ArrayRange);
+
+  md->NumBlocks = STLUtils::Sum(md->NumBlocksLocal);
+  md->NumPoints = STLUtils::Sum(md->BlockNumPoints);
+  md->NumCells = STLUtils::Sum(md->BlockNumCells);
+  md->CellArraySize = STLUtils::Sum(md->BlockCellArraySize);
+
+  md->GlobalView = true;
+}
+
+// a local view with a different number of blocks on each rank
+sensei::MeshMetadataPtr NewLocalView(int rank)
+{
+  sensei::MeshMetadataPtr md = sensei::MeshMetadata::New();
+
+  md->MeshName = "mesh";
+  md->NumArrays = 2;
+  md->ArrayName = {"a", "b"};
+  md->BlocksPerLevel = {rank % 3 + 1, 1};
+
+  int nLocal = rank % 3 + 2;
+  md->NumBlocksLocal = {nLocal};
+
+  for (int i = 0; i < nLocal; ++i)
+    {
+    int bid = 4*rank + i;
+    md->BlockOwner.push_back(rank);
+    md->BlockIds.push_back(bid);
+    md->BlockNumPoints.push_back(8*(bid + 1));
+    md->BlockNumCells.push_back(bid + 1);
+    md->BlockCellArraySize.push_back(9*(bid + 1));
+    md->BlockExtents.push_back({0, bid, 0, 1, 0, 1});
+    md->BlockBounds.push_back({-double(bid), double(bid), 0., 1., 0., 1.});
+    md->BlockArrayRange.push_back({{-1.0*bid, 1.0*bid}, {0.0, 2.0*bid}});
+    md->BlockLevel.push_back(i % 2);
+    }
+
+  return md;
+}
+
+// compare the parts of the metadata touched by GlobalizeView
+int Compare(const sensei::MeshMetadataPtr &a, const sensei::MeshMetadataPtr &b)
+{
+  if ((a->BlockOwner != b->BlockOwner) || (a->BlockIds != b->BlockIds) ||
+    (a->NumBlocksLocal != b->NumBlocksLocal) ||
+    (a->BlockNumPoints != b->BlockNumPoints) ||
+    (a->BlockNumCells != b->BlockNumCells) ||
+    (a->BlockCellArraySize != b->BlockCellArraySize) ||
+    (a->BlockExtents != b->BlockExtents) || (a->BlockBounds != b->BlockBounds) ||
+    (a->BlockArrayRange != b->BlockArrayRange) ||
+    (a->BlockLevel != b->BlockLevel) || (a->BlocksPerLevel != b->BlocksPerLevel) ||
+    (a->Bounds != b->Bounds) || (a->Extent != b->Extent) ||
+    (a->ArrayRange != b->ArrayRange) || (a->NumBlocks != b->NumBlocks) ||
+    (a->NumPoints != b->NumPoints) || (a->NumCells != b->NumCells) ||
+    (a->CellArraySize != b->CellArraySize) || (a->GlobalView != b->GlobalView))
+    return -1;
+
+  return 0;
+}
+
+int main(int argc, char **argv)
+{
+  MPI_Init(&argc, &argv);
+
+  int nIts = argc > 1 ? atoi(argv[1]) : 10;
+
+  int rank = 0;
+  int nRanks = 1;
+
+  MPI_Comm comm = MPI_COMM_WORLD;
+  MPI_Comm_rank(comm, &rank);
+  MPI_Comm_size(comm, &nRanks);
+
+  int err = 0;
+
+  // check that the packed exchange gives the same result
+  sensei::MeshMetadataPtr ref = NewLocalView(rank);
+  GlobalizeViewByField(comm, ref);
+
+  sensei::MeshMetadataPtr md = NewLocalView(rank);
+  md->GlobalizeView(comm);
+
+  if (Compare(md, ref))
+    {
+    SENSEI_ERROR("The global view differs from the reference")
+    err = -1;
+    }
+
+  // check the global view is only built on the root
+  int root = nRanks - 1;
+  md = NewLocalView(rank);
+  md->GlobalizeView(comm, root);
+
+  if (((rank == root) && Compare(md, ref)) ||
+    ((rank != root) && (md->GlobalView || Compare(md, NewLocalView(rank)))))
+    {
+    SENSEI_ERROR("The rooted global view is incorrect")
+    err = -1;
+    }
+
+  // time both approaches
+  double t0 = MPI_Wtime();
+  for (int i = 0; i < nIts; ++i)
+    {
+    md = NewLocalView(rank);
+    GlobalizeViewByField(comm, md);
+    }
+
+  double t1 = MPI_Wtime();
+  for (int i = 0; i < nIts; ++i)
+    {
+    md = NewLocalView(rank);
+    md->GlobalizeView(comm);
+    }
+
+  double t2 = MPI_Wtime();
+
+  double dt[2] = {(t1 - t0)/nIts, (t2 - t1)/nIts};
+  MPI_Allreduce(MPI_IN_PLACE, dt, 2, MPI_DOUBLE, MPI_MAX, comm);
+
+  if (rank == 0)
+    {
+    std::cerr << "GlobalizeView on " << nRanks << " ranks, by field "
+      << dt[0] << " s, packed " << dt[1] << " s, speed up "
+      << dt[0]/dt[1] << std::endl;
+    }
+
+  MPI_Allreduce(MPI_IN_PLACE, &err, 1, MPI_INT, MPI_MIN, comm);
+
+  MPI_Finalize();
+
+  return err ? -1 : 0;
+}
@@ -133,14 +133,21 @@ int main(int argc, char **argv)
      "normal", "");
 
   analysisAdaptor->Execute(dataAdaptor, nullptr);
-  dataAdaptor->Delete();
-
 
   sensei::Histogram::Data result;
   analysisAdaptor->GetHistogram(result);
 
   int status = validateHistogram(result.BinMin, result.BinMax, result.Histogram);
 
+  // the range reported in the metadata gives the same result in one pass
+  analysisAdaptor->SetRangeMode(sensei::Histogram::RANGE_METADATA);
+  analysisAdaptor->Execute(dataAdaptor, nullptr);
+  dataAdaptor->Delete();
+
+  analysisAdaptor->GetHistogram(result);
+
+  status |= validateHistogram(result.BinMin, result.BinMax, result.Histogram);
+
   analysisAdaptor->Finalize();
   analysisAdaptor->Delete();
 
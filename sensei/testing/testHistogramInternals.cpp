@@ -0,0 +1,323 @@
+#include "HistogramInternals.h"
+#include "Error.h"
+
+#include <svtkDoubleArray.h>
+#include <svtkFloatArray.h>
+#include <svtkIntArray.h>
+#include <svtkUnsignedCharArray.h>
+#include <svtkSmartPointer.h>
+
+#include <mpi.h>
+#include <random>
+#include <vector>
+#include <cstdlib>
+#include <iostream>
+
+// Validates the threaded CPU histogram against the serial one and reports the
+// time taken by each. Pass the number of values per block, the number of
+// repetitions, and the number of threads on the command line to use this as
+// a benchmark, for example:
+//
+//     mpiexec -np 2 testHistogramInternals 100000000 10 32
+
+using svtkDataArrayPtr = svtkSmartPointer<svtkDataArray>;
+using svtkUnsignedCharArrayPtr = svtkSmartPointer<svtkUnsignedCharArray>;
+
+// normally distributed values, when requested every 7th value is a ghost
+// with a value far outside of the range of the valid values
+template <typename array_t>
+void NewBlock(std::mt19937 &gen, long nVals, bool withGhosts,
+  std::vector<svtkDataArrayPtr> &arrays,
+  std::vector<svtkUnsignedCharArrayPtr> &ghostArrays)
+{
+  std::normal_distribution<double> dist(5.0, 2.0);
+
+  svtkSmartPointer<array_t> vals = svtkSmartPointer<array_t>::New();
+  vals->SetNumberOfTuples(nVals);
+
+  svtkUnsignedCharArrayPtr ghosts = svtkUnsignedCharArrayPtr::New();
+  ghosts->SetNumberOfTuples(nVals);
+
+  for (long i = 0; i < nVals; ++i)
+    {
+    bool ghost = withGhosts && (i % 7 == 3);
+    vals->SetValue(i, ghost ? 1.0e30 : dist(gen));
+    ghosts->SetValue(i, ghost ? 1 : 0);
+    }
+
+  arrays.push_back(vals.GetPointer());
+  ghostArrays.push_back(ghosts);
+}
+
+// the result of a histogram calculation
+struct Result
+{
+  bool operator==(const Result &o) const
+  {
+    return (this->BinMin == o.BinMin) && (this->BinMax == o.BinMax) &&
+      (this->Hist == o.Hist) && (this->Underflow == o.Underflow) &&
+      (this->Overflow == o.Overflow);
+  }
+
+  bool operator!=(const Result &o) const { return !(*this == o); }
+
+  double BinMin = 0.0;
+  double BinMax = 0.0;
+  std::vector<unsigned int> Hist;
+  unsigned int Underflow = 0;
+  unsigned int Overflow = 0;
+};
+
+// computes the histogram of the blocks, returns the time taken. the range is
+// computed from the data unless rangeMax is greater than rangeMin
+double Compute(sensei::HistogramInternals &internals, double rangeMin,
+  double rangeMax, const std::vector<svtkDataArrayPtr> &arrays,
+  const std::vector<svtkUnsignedCharArrayPtr> &ghosts, int &err, Result &res)
+{
+  internals.Initialize();
+
+  if (rangeMax > rangeMin)
+    {
+    if (internals.SetRange(rangeMin, rangeMax))
+      err = -1;
+    }
+  else
+    {
+    internals.ClearRange();
+    }
+
+  size_t nBlocks = arrays.size();
+  for (size_t i = 0; i < nBlocks; ++i)
+    {
+    // the first block is passed without a ghost array
+    if (internals.AddLocalData(arrays[i], i ? ghosts[i].GetPointer() : nullptr))
+      err = -1;
+    }
+
+  if (internals.ComputeHistogram())
+    err = -1;
+
+  int nBins = 0;
+  double binWidth = 0.0;
+  internals.GetHistogram(nBins, res.BinMin, res.BinMax, binWidth, res.Hist,
+    res.Underflow, res.Overflow);
+  internals.Clear();
+
+  return 0.0;
+}
+
+// as above, with a new instance
+double Compute(MPI_Comm comm, int deviceId, int nThreads, int nBins,
+  double rangeMin, double rangeMax, const std::vector<svtkDataArrayPtr> &arrays,
+  const std::vector<svtkUnsignedCharArrayPtr> &ghosts, int &err, Result &res)
+{
+  MPI_Barrier(comm);
+  double t0 = MPI_Wtime();
+
+  sensei::HistogramInternals internals(comm, deviceId, nBins);
+  internals.SetNumberOfThreads(nThreads);
+
+  Compute(internals, rangeMin, rangeMax, arrays, ghosts, err, res);
+
+  return MPI_Wtime() - t0;
+}
+
+int main(int argc, char **argv)
+{
+  MPI_Init(&argc, &argv);
+
+  long nVals = argc > 1 ? atol(argv[1]) : 100000;
+  int nIts = argc > 2 ? atoi(argv[2]) : 5;
+  int nThreads = argc > 3 ? atoi(argv[3]) : 4;
+
+  int rank = 0;
+  int nRanks = 1;
+
+  MPI_Comm comm = MPI_COMM_WORLD;
+  MPI_Comm_rank(comm, &rank);
+  MPI_Comm_size(comm, &nRanks);
+
+  // a few blocks per rank. the last block is smaller than the number of
+  // threads.
+  std::mt19937 gen(rank);
+  std::vector<svtkDataArrayPtr> arrays;
+  std::vector<svtkUnsignedCharArrayPtr> ghosts;
+
+  NewBlock<svtkDoubleArray>(gen, nVals, false, arrays, ghosts);
+  NewBlock<svtkDoubleArray>(gen, nVals/3 + 1, true, arrays, ghosts);
+  NewBlock<svtkDoubleArray>(gen, 2, true, arrays, ghosts);
+
+  int err = 0;
+  int nBins = 32;
+
+  using sensei::HistogramInternals;
+
+  // time both approaches
+  double dt[2] = {0.0, 0.0};
+  Result res[2];
+
+  for (int i = 0; i < nIts; ++i)
+    {
+    dt[0] += Compute(comm, HistogramInternals::DEVICE_CPU, 1, nBins,
+      0.0, 0.0, arrays, ghosts, err, res[0]);
+
+    dt[1] += Compute(comm, HistogramInternals::DEVICE_CPU_THREADS, nThreads,
+      nBins, 0.0, 0.0, arrays, ghosts, err, res[1]);
+    }
+
+  // check that the threaded calculation gives the same result
+  if ((rank == 0) && (res[0] != res[1]))
+    {
+    SENSEI_ERROR("The threaded histogram differs from the serial one")
+    err = -1;
+    }
+
+  // add a block of single precision data
+  NewBlock<svtkFloatArray>(gen, nVals, true, arrays, ghosts);
+
+  Compute(comm, HistogramInternals::DEVICE_CPU, 1, nBins,
+    0.0, 0.0, arrays, ghosts, err, res[0]);
+
+  Compute(comm, HistogramInternals::DEVICE_CPU_THREADS, nThreads, nBins,
+    0.0, 0.0, arrays, ghosts, err, res[1]);
+
+  if ((rank == 0) && (res[0] != res[1]))
+    {
+    SENSEI_ERROR("The threaded histogram of mixed types differs from the serial one")
+    err = -1;
+    }
+
+  // a fixed range equal to the computed range gives the same result
+  MPI_Bcast(&res[0].BinMin, 1, MPI_DOUBLE, 0, comm);
+  MPI_Bcast(&res[0].BinMax, 1, MPI_DOUBLE, 0, comm);
+
+  double rangeMin = res[0].BinMin;
+  double rangeMax = res[0].BinMax;
+  Result autoRes = res[0];
+
+  for (int i = 0; i < 2; ++i)
+    {
+    Compute(comm, i ? HistogramInternals::DEVICE_CPU_THREADS :
+      HistogramInternals::DEVICE_CPU, nThreads, nBins, rangeMin, rangeMax,
+      arrays, ghosts, err, res[i]);
+
+    if ((rank == 0) && (res[i] != autoRes))
+      {
+      SENSEI_ERROR("The histogram with a fixed range differs on device " << i)
+      err = -1;
+      }
+    }
+
+  // values outside of a narrower range are counted in the under and overflow
+  double width = (rangeMax - rangeMin)/4.0;
+  rangeMin += width;
+  rangeMax -= width;
+
+  for (int i = 0; i < 2; ++i)
+    {
+    Compute(comm, i ? HistogramInternals::DEVICE_CPU_THREADS :
+      HistogramInternals::DEVICE_CPU, nThreads, nBins, rangeMin, rangeMax,
+      arrays, ghosts, err, res[i]);
+    }
+
+  if (rank == 0)
+    {
+    unsigned int nValid = 0;
+    for (unsigned int count : autoRes.Hist)
+      nValid += count;
+
+    unsigned int nBinned = res[0].Underflow + res[0].Overflow;
+    for (unsigned int count : res[0].Hist)
+      nBinned += count;
+
+    if ((res[0] != res[1]) || (nBinned != nValid) ||
+      (res[0].Underflow == 0) || (res[0].Overflow == 0))
+      {
+      SENSEI_ERROR("The under and overflow are incorrect")
+      err = -1;
+      }
+    }
+
+  // an instance used for several steps gives the same result, and after the
+  // first step makes no allocations
+  for (int i = 0; i < 2; ++i)
+    {
+    int deviceId = i ? HistogramInternals::DEVICE_CPU_THREADS :
+      HistogramInternals::DEVICE_CPU;
+
+    HistogramInternals internals(comm, deviceId, nBins);
+    internals.SetNumberOfThreads(nThreads);
+
+    Result stepRes;
+    Compute(internals, 0.0, 0.0, arrays, ghosts, err, stepRes);
+    Compute(internals, rangeMin, rangeMax, arrays, ghosts, err, stepRes);
+
+    if ((rank == 0) && (stepRes != res[i]))
+      {
+      SENSEI_ERROR("The reused instance gives a different result on device " << i)
+      err = -1;
+      }
+
+    Compute(internals, 0.0, 0.0, arrays, ghosts, err, stepRes);
+
+    if ((rank == 0) && (stepRes != autoRes))
+      {
+      SENSEI_ERROR("The reused instance did not recompute the range on device " << i)
+      err = -1;
+      }
+
+    if (internals.GetNumberOfAllocations() || internals.GetNumberOfBytesAllocated())
+      {
+      SENSEI_ERROR("The reused instance made " << internals.GetNumberOfAllocations()
+        << " allocations on device " << i)
+      err = -1;
+      }
+    }
+
+  // integer data with a fixed range narrower than the number of bins. the
+  // bins are narrower than 1 and the values 0 to 9 land in every other bin,
+  // the maximum in the last bin, and the values above the range overflow
+  svtkSmartPointer<svtkIntArray> ints = svtkSmartPointer<svtkIntArray>::New();
+  ints->SetNumberOfTuples(100);
+  for (int i = 0; i < 100; ++i)
+    ints->SetValue(i, i % 10);
+
+  std::vector<svtkDataArrayPtr> intArrays(1, ints.GetPointer());
+  std::vector<svtkUnsignedCharArrayPtr> intGhosts(1);
+
+  unsigned int nEach = 10*nRanks;
+  std::vector<unsigned int> intHist({nEach, 0, nEach, 0, nEach, 0, nEach, 0,
+    nEach, nEach});
+
+  for (int i = 0; i < 2; ++i)
+    {
+    Compute(comm, i ? HistogramInternals::DEVICE_CPU_THREADS :
+      HistogramInternals::DEVICE_CPU, nThreads, 10, 0.0, 5.0,
+      intArrays, intGhosts, err, res[i]);
+
+    if ((rank == 0) && ((res[i].Hist != intHist) ||
+      (res[i].Underflow != 0) || (res[i].Overflow != 4*nEach)))
+      {
+      SENSEI_ERROR("The histogram of integer data with narrow bins is "
+        "incorrect on device " << i)
+      err = -1;
+      }
+    }
+
+  dt[0] /= nIts;
+  dt[1] /= nIts;
+  MPI_Allreduce(MPI_IN_PLACE, dt, 2, MPI_DOUBLE, MPI_MAX, comm);
+
+  if (rank == 0)
+    {
+    std::cerr << "Histogram of " << nVals << " values per block on " << nRanks
+      << " ranks, serial " << dt[0] << " s, " << nThreads << " threads "
+      << dt[1] << " s, speed up " << dt[0]/dt[1] << std::endl;
+    }
+
+  MPI_Allreduce(MPI_IN_PLACE, &err, 1, MPI_INT, MPI_MIN, comm);
+
+  MPI_Finalize();
+
+  return err ? -1 : 0;
+}
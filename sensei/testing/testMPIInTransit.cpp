@@ -0,0 +1,429 @@
+#include "ConfigurableAnalysis.h"
+#include "ConfigurableInTransitDataAdaptor.h"
+#include "SVTKDataAdaptor.h"
+#include "MPIManager.h"
+#include "MeshMetadata.h"
+#include "Error.h"
+
+#include <svtkCellArray.h>
+#include <svtkCellType.h>
+#include <svtkCellData.h>
+#include <svtkDataObject.h>
+#include <svtkDoubleArray.h>
+#include <svtkImageData.h>
+#include <svtkMultiBlockDataSet.h>
+#include <svtkPointData.h>
+#include <svtkPoints.h>
+#include <svtkUnstructuredGrid.h>
+
+#include <mpi.h>
+#include <cstdlib>
+#include <string>
+#include <iostream>
+
+// Validates and times an in transit transport between two programs sharing
+// MPI_COMM_WORLD. The first half of the ranks send an image and an
+// unstructured mesh, two blocks of each per rank, through the transport
+// configured in the first XML file. The second half of the ranks receive them
+// through the transport configured in the second XML file, and check the
+// structure and the values on each step. The time the senders spend sending
+// and the receivers' throughput are reported, so that the MPI transport can
+// be compared with the others. Run with an even number of ranks, at least 2.
+//
+// usage: testMPIInTransit write.xml read.xml [steps] [points per side]
+
+const int nBlocksPerSender = 2;
+
+// the value of an array element
+double Value(int step, int block, long i)
+{
+  return 1.0e9*step + 1.0e7*block + i;
+}
+
+// an image block of nx^3 points
+svtkImageData *NewImage(int step, int block, int nx)
+{
+  svtkImageData *im = svtkImageData::New();
+  im->SetExtent(block*(nx - 1), (block + 1)*(nx - 1), 0, nx - 1, 0, nx - 1);
+  im->SetOrigin(1.0, 2.0, 3.0);
+  im->SetSpacing(0.5, 0.25, 0.125);
+
+  long nPts = long(nx)*nx*nx;
+
+  svtkDoubleArray *da = svtkDoubleArray::New();
+  da->SetName("data");
+  da->SetNumberOfTuples(nPts);
+  for (long i = 0; i < nPts; ++i)
+    da->SetValue(i, Value(step, block, i));
+
+  im->GetPointData()->AddArray(da);
+  da->Delete();
+
+  return im;
+}
+
+// an unstructured block of a tetrahedron and a triangle
+svtkUnstructuredGrid *NewUnstructured(int step, int block)
+{
+  svtkPoints *pts = svtkPoints::New();
+  pts->SetDataTypeToDouble();
+  pts->InsertNextPoint(block, 0.0, 0.0);
+  pts->InsertNextPoint(block + 1.0, 0.0, 0.0);
+  pts->InsertNextPoint(block, 1.0, 0.0);
+  pts->InsertNextPoint(block, 0.0, 1.0);
+  pts->InsertNextPoint(block + 1.0, 1.0, 0.0);
+
+  svtkUnstructuredGrid *ug = svtkUnstructuredGrid::New();
+  ug->SetPoints(pts);
+  pts->Delete();
+
+  svtkIdType tet[] = {0, 1, 2, 3};
+  svtkIdType tri[] = {1, 4, 2};
+  ug->Allocate(2);
+  ug->InsertNextCell(SVTK_TETRA, 4, tet);
+  ug->InsertNextCell(SVTK_TRIANGLE, 3, tri);
+
+  svtkDoubleArray *da = svtkDoubleArray::New();
+  da->SetName("data");
+  da->SetNumberOfTuples(2);
+  da->SetValue(0, Value(step, block, 0));
+  da->SetValue(1, Value(step, block, 1));
+
+  ug->GetCellData()->AddArray(da);
+  da->Delete();
+
+  return ug;
+}
+
+// --------------------------------------------------------------------------
+int Send(MPI_Comm comm, const std::string &xml, int nSteps, int nx)
+{
+  int rank = 0;
+  int nRanks = 1;
+  MPI_Comm_rank(comm, &rank);
+  MPI_Comm_size(comm, &nRanks);
+
+  sensei::ConfigurableAnalysis *aa = sensei::ConfigurableAnalysis::New();
+  if (aa->Initialize(xml))
+    {
+    SENSEI_ERROR("Failed to initialize the analysis from " << xml)
+    aa->Delete();
+    return -1;
+    }
+
+  sensei::SVTKDataAdaptor *da = sensei::SVTKDataAdaptor::New();
+
+  int nBlocks = nRanks*nBlocksPerSender;
+
+  int ierr = 0;
+  double sendTime = 0.0;
+  for (int step = 0; !ierr && (step < nSteps); ++step)
+    {
+    svtkMultiBlockDataSet *image = svtkMultiBlockDataSet::New();
+    image->SetNumberOfBlocks(nBlocks);
+
+    svtkMultiBlockDataSet *unstructured = svtkMultiBlockDataSet::New();
+    unstructured->SetNumberOfBlocks(nBlocks);
+
+    for (int i = 0; i < nBlocksPerSender; ++i)
+      {
+      int block = rank*nBlocksPerSender + i;
+
+      svtkImageData *im = NewImage(step, block, nx);
+      image->SetBlock(block, im);
+      im->Delete();
+
+      svtkUnstructuredGrid *ug = NewUnstructured(step, block);
+      unstructured->SetBlock(block, ug);
+      ug->Delete();
+      }
+
+    da->SetDataTimeStep(step);
+    da->SetDataTime(0.5*step);
+    da->SetDataObject("image", image);
+    da->SetDataObject("unstructured", unstructured);
+
+    image->Delete();
+    unstructured->Delete();
+
+    // the time the simulation is held up by the transport
+    double t0 = MPI_Wtime();
+
+    if (!aa->Execute(da, nullptr))
+      {
+      SENSEI_ERROR("Failed to send step " << step)
+      ierr = -1;
+      }
+
+    sendTime += MPI_Wtime() - t0;
+
+    da->ReleaseData();
+    }
+
+  if (aa->Finalize())
+    ierr = -1;
+
+  aa->Delete();
+  da->Delete();
+
+  MPI_Allreduce(MPI_IN_PLACE, &sendTime, 1, MPI_DOUBLE, MPI_MAX, comm);
+
+  if (!ierr && (rank == 0))
+    std::cerr << "Sent " << nSteps << " steps from " << nRanks << " ranks in "
+      << sendTime << " s, " << sendTime/nSteps << " s per step" << std::endl;
+
+  return ierr;
+}
+
+// --------------------------------------------------------------------------
+int CheckImage(sensei::DataAdaptor *da, int step, int nx, long &nBytes)
+{
+  svtkDataObject *mesh = nullptr;
+  if (da->GetMesh("image", false, mesh) ||
+    da->AddArray(mesh, "image", svtkDataObject::POINT, "data"))
+    {
+    SENSEI_ERROR("Failed to get the image")
+    if (mesh)
+      mesh->Delete();
+    return -1;
+    }
+
+  svtkMultiBlockDataSet *mbds = dynamic_cast<svtkMultiBlockDataSet*>(mesh);
+  long nPts = long(nx)*nx*nx;
+
+  int ierr = 0;
+  unsigned int nBlocks = mbds ? mbds->GetNumberOfBlocks() : 0;
+  for (unsigned int block = 0; !ierr && (block < nBlocks); ++block)
+    {
+    svtkImageData *im = dynamic_cast<svtkImageData*>(mbds->GetBlock(block));
+    if (!im)
+      continue;
+
+    int ext[6];
+    im->GetExtent(ext);
+
+    double x0[3];
+    im->GetOrigin(x0);
+
+    double dx[3];
+    im->GetSpacing(dx);
+
+    if ((ext[0] != int(block)*(nx - 1)) || (ext[1] != int(block + 1)*(nx - 1)) ||
+      (ext[3] != nx - 1) || (ext[5] != nx - 1) || (x0[0] != 1.0) ||
+      (x0[2] != 3.0) || (dx[0] != 0.5) || (dx[2] != 0.125))
+      {
+      SENSEI_ERROR("Wrong structure in block " << block << " step " << step)
+      ierr = -1;
+      break;
+      }
+
+    svtkDataArray *data = im->GetPointData()->GetArray("data");
+    if (!data || (data->GetNumberOfTuples() != nPts))
+      {
+      SENSEI_ERROR("Missing data in block " << block << " step " << step)
+      ierr = -1;
+      break;
+      }
+
+    for (long i = 0; i < nPts; ++i)
+      {
+      if (data->GetTuple1(i) != Value(step, block, i))
+        {
+        SENSEI_ERROR("Wrong value at " << i << " in block " << block
+          << " step " << step << " " << data->GetTuple1(i) << " != "
+          << Value(step, block, i))
+        ierr = -1;
+        break;
+        }
+      }
+
+    nBytes += nPts*data->GetDataTypeSize();
+    }
+
+  mesh->Delete();
+
+  return ierr;
+}
+
+// --------------------------------------------------------------------------
+int CheckUnstructured(sensei::DataAdaptor *da, int step)
+{
+  svtkDataObject *mesh = nullptr;
+  if (da->GetMesh("unstructured", false, mesh) ||
+    da->AddArray(mesh, "unstructured", svtkDataObject::CELL, "data"))
+    {
+    SENSEI_ERROR("Failed to get the unstructured mesh")
+    if (mesh)
+      mesh->Delete();
+    return -1;
+    }
+
+  svtkMultiBlockDataSet *mbds = dynamic_cast<svtkMultiBlockDataSet*>(mesh);
+
+  int ierr = 0;
+  unsigned int nBlocks = mbds ? mbds->GetNumberOfBlocks() : 0;
+  for (unsigned int block = 0; !ierr && (block < nBlocks); ++block)
+    {
+    svtkUnstructuredGrid *ug =
+      dynamic_cast<svtkUnstructuredGrid*>(mbds->GetBlock(block));
+    if (!ug)
+      continue;
+
+    svtkIdType npts = 0;
+    const svtkIdType *pts = nullptr;
+
+    double x[3];
+    ug->GetPoint(4, x);
+
+    if ((ug->GetNumberOfPoints() != 5) || (ug->GetNumberOfCells() != 2) ||
+      (ug->GetCellType(0) != SVTK_TETRA) || (ug->GetCellType(1) != SVTK_TRIANGLE) ||
+      (x[0] != block + 1.0) || (x[1] != 1.0))
+      {
+      SENSEI_ERROR("Wrong structure in block " << block << " step " << step)
+      ierr = -1;
+      break;
+      }
+
+    ug->GetCells()->GetCellAtId(1, npts, pts);
+    if ((npts != 3) || (pts[0] != 1) || (pts[1] != 4) || (pts[2] != 2))
+      {
+      SENSEI_ERROR("Wrong connectivity in block " << block << " step " << step)
+      ierr = -1;
+      break;
+      }
+
+    svtkDataArray *data = ug->GetCellData()->GetArray("data");
+    if (!data || (data->GetNumberOfTuples() != 2) ||
+      (data->GetTuple1(0) != Value(step, block, 0)) ||
+      (data->GetTuple1(1) != Value(step, block, 1)))
+      {
+      SENSEI_ERROR("Wrong data in block " << block << " step " << step)
+      ierr = -1;
+      break;
+      }
+    }
+
+  mesh->Delete();
+
+  return ierr;
+}
+
+// --------------------------------------------------------------------------
+int Receive(MPI_Comm comm, const std::string &xml, int nSteps, int nx)
+{
+  int rank = 0;
+  int nRanks = 1;
+  MPI_Comm_rank(comm, &rank);
+  MPI_Comm_size(comm, &nRanks);
+
+  sensei::ConfigurableInTransitDataAdaptor *da =
+    sensei::ConfigurableInTransitDataAdaptor::New();
+
+  if (da->Initialize(xml))
+    {
+    SENSEI_ERROR("Failed to initialize the transport from " << xml)
+    da->Delete();
+    return -1;
+    }
+
+  double t0 = MPI_Wtime();
+
+  if (da->OpenStream())
+    {
+    SENSEI_ERROR("Failed to open the stream")
+    da->Delete();
+    return -1;
+    }
+
+  int ierr = 0;
+  int step = 0;
+  long nBytes = 0;
+  while (!ierr && (da->StreamGood() == 0))
+    {
+    if ((da->GetDataTimeStep() != step) ||
+      (da->GetDataTime() != 0.5*step))
+      {
+      SENSEI_ERROR("Wrong time step " << da->GetDataTimeStep()
+        << " expected " << step)
+      ierr = -1;
+      break;
+      }
+
+    if (CheckImage(da, step, nx, nBytes) || CheckUnstructured(da, step))
+      {
+      ierr = -1;
+      break;
+      }
+
+    da->ReleaseData();
+
+    ++step;
+
+    if (da->AdvanceStream() < 0)
+      ierr = -1;
+    }
+
+  double recvTime = MPI_Wtime() - t0;
+
+  if (!ierr && (step != nSteps))
+    {
+    SENSEI_ERROR("Received " << step << " steps, expected " << nSteps)
+    ierr = -1;
+    }
+
+  da->CloseStream();
+  da->Finalize();
+  da->Delete();
+
+  MPI_Allreduce(MPI_IN_PLACE, &nBytes, 1, MPI_LONG, MPI_SUM, comm);
+  MPI_Allreduce(MPI_IN_PLACE, &recvTime, 1, MPI_DOUBLE, MPI_MAX, comm);
+
+  if (!ierr && (rank == 0))
+    std::cerr << "Received " << step << " steps on " << nRanks << " ranks, "
+      << nBytes/1048576.0 << " MiB in " << recvTime << " s, "
+      << nBytes/1048576.0/recvTime << " MiB/s" << std::endl;
+
+  return ierr;
+}
+
+// --------------------------------------------------------------------------
+int main(int argc, char **argv)
+{
+  MPI_Init(&argc, &argv);
+
+  int rank = 0;
+  int nRanks = 1;
+  MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+  MPI_Comm_size(MPI_COMM_WORLD, &nRanks);
+
+  if ((argc < 3) || (nRanks < 2) || (nRanks % 2))
+    {
+    SENSEI_ERROR("usage: testMPIInTransit write.xml read.xml [steps]"
+      " [points per side]. Run with an even number of ranks, not " << nRanks)
+    MPI_Finalize();
+    return -1;
+    }
+
+  int nSteps = argc > 3 ? atoi(argv[3]) : 4;
+  int nx = argc > 4 ? atoi(argv[4]) : 8;
+
+  int sender = rank < nRanks/2;
+
+  // each side runs on its own ranks, as it would in MPMD mode. the
+  // adaptors are created on the split communicator.
+  MPI_Comm comm = MPI_COMM_NULL;
+  MPI_Comm_split(MPI_COMM_WORLD, sender ? 0 : 1, rank, &comm);
+  sensei::MPIManager::SetDefaultCommunicator(comm);
+
+  int ierr = sender ? Send(comm, argv[1], nSteps, nx) :
+    Receive(comm, argv[2], nSteps, nx);
+
+  sensei::MPIManager::SetDefaultCommunicator(MPI_COMM_WORLD);
+
+  MPI_Allreduce(MPI_IN_PLACE, &ierr, 1, MPI_INT, MPI_MIN, MPI_COMM_WORLD);
+
+  MPI_Comm_free(&comm);
+  MPI_Finalize();
+
+  return ierr ? -1 : 0;
+}
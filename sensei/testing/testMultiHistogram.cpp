@@ -0,0 +1,322 @@
+#include "MultiHistogram.h"
+#include "SVTKDataAdaptor.h"
+#include "Error.h"
+
+#include <svtkDoubleArray.h>
+#include <svtkFloatArray.h>
+#include <svtkUnsignedCharArray.h>
+#include <svtkImageData.h>
+#include <svtkPointData.h>
+#include <svtkSmartPointer.h>
+
+#include <mpi.h>
+#include <random>
+#include <vector>
+#include <string>
+#include <limits>
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+// Validates the joint histogram against a direct calculation, with dense
+// and sparse storage, one and several threads, a vector array, weights, a
+// fixed range, and enough bins that the sparse reduction is used.
+
+// the values of each dimension on this rank, the weights, and the ghost zones
+struct Values
+{
+  std::vector<std::vector<double>> Dims;
+  std::vector<double> Weights;
+  std::vector<unsigned char> Ghosts;
+};
+
+// two correlated normally distributed arrays, a vector array with the same
+// values, a weight array, and ghost zones. the ghost zones have values far
+// outside of the range of the valid values.
+sensei::SVTKDataAdaptor *NewDataAdaptor(int rank, Values &vals)
+{
+  int nx = 40;
+  int ny = 25;
+  long nVals = nx*ny;
+
+  std::mt19937 gen(rank);
+  std::normal_distribution<double> dist(0.0, 1.0);
+  std::uniform_real_distribution<double> wdist(0.0, 2.0);
+
+  svtkSmartPointer<svtkDoubleArray> a = svtkSmartPointer<svtkDoubleArray>::New();
+  a->SetName("a");
+  a->SetNumberOfTuples(nVals);
+
+  svtkSmartPointer<svtkFloatArray> b = svtkSmartPointer<svtkFloatArray>::New();
+  b->SetName("b");
+  b->SetNumberOfTuples(nVals);
+
+  svtkSmartPointer<svtkDoubleArray> v = svtkSmartPointer<svtkDoubleArray>::New();
+  v->SetName("v");
+  v->SetNumberOfComponents(2);
+  v->SetNumberOfTuples(nVals);
+
+  svtkSmartPointer<svtkDoubleArray> w = svtkSmartPointer<svtkDoubleArray>::New();
+  w->SetName("w");
+  w->SetNumberOfTuples(nVals);
+
+  svtkSmartPointer<svtkUnsignedCharArray> g = svtkSmartPointer<svtkUnsignedCharArray>::New();
+  g->SetName("svtkGhostType");
+  g->SetNumberOfTuples(nVals);
+
+  vals.Dims.resize(2);
+  for (long i = 0; i < nVals; ++i)
+    {
+    bool ghost = (i % 5) == 2;
+
+    double av = ghost ? 1.0e30 : dist(gen);
+    float bv = ghost ? -1.0e30f : float(0.5*av + 0.5*dist(gen));
+    double wv = wdist(gen);
+
+    a->SetValue(i, av);
+    b->SetValue(i, bv);
+    v->SetTypedComponent(i, 0, av);
+    v->SetTypedComponent(i, 1, bv);
+    w->SetValue(i, wv);
+    g->SetValue(i, ghost ? 1 : 0);
+
+    vals.Dims[0].push_back(av);
+    vals.Dims[1].push_back(bv);
+    vals.Weights.push_back(wv);
+    vals.Ghosts.push_back(ghost ? 1 : 0);
+    }
+
+  svtkSmartPointer<svtkImageData> im = svtkSmartPointer<svtkImageData>::New();
+  im->SetDimensions(nx, ny, 1);
+  im->GetPointData()->AddArray(a);
+  im->GetPointData()->AddArray(b);
+  im->GetPointData()->AddArray(v);
+  im->GetPointData()->AddArray(w);
+  im->GetPointData()->AddArray(g);
+
+  sensei::SVTKDataAdaptor *data = sensei::SVTKDataAdaptor::New();
+  data->SetCommunicator(MPI_COMM_WORLD);
+  data->SetDataObject("mesh", im);
+
+  return data;
+}
+
+// the histogram computed directly on rank 0. the range of a dimension is
+// computed when its min is greater than its max.
+void Reference(MPI_Comm comm, const Values &vals, const std::vector<int> &nBins,
+  std::vector<double> binMin, std::vector<double> binMax, bool weighted,
+  sensei::MultiHistogram::Data &res)
+{
+  size_t nDims = nBins.size();
+  size_t nVals = vals.Ghosts.size();
+
+  for (size_t j = 0; j < nDims; ++j)
+    {
+    if (binMin[j] > binMax[j])
+      {
+      for (size_t i = 0; i < nVals; ++i)
+        {
+        if (!vals.Ghosts[i])
+          {
+          binMin[j] = std::min(binMin[j], vals.Dims[j][i]);
+          binMax[j] = std::max(binMax[j], vals.Dims[j][i]);
+          }
+        }
+      binMin[j] = -binMin[j];
+      MPI_Allreduce(MPI_IN_PLACE, &binMin[j], 1, MPI_DOUBLE, MPI_MAX, comm);
+      MPI_Allreduce(MPI_IN_PLACE, &binMax[j], 1, MPI_DOUBLE, MPI_MAX, comm);
+      binMin[j] = -binMin[j];
+      }
+    }
+
+  size_t totalBins = 1;
+  for (size_t j = 0; j < nDims; ++j)
+    totalBins *= nBins[j];
+
+  std::vector<double> bins(totalBins + 1, 0.0);
+  for (size_t i = 0; i < nVals; ++i)
+    {
+    if (vals.Ghosts[i])
+      continue;
+
+    size_t index = 0;
+    size_t stride = 1;
+    bool inRange = true;
+    for (size_t j = 0; j < nDims; ++j)
+      {
+      double val = vals.Dims[j][i];
+      double width = (binMax[j] - binMin[j]) / nBins[j];
+      inRange = inRange && (val >= binMin[j]) && (val <= binMax[j]);
+      size_t bin = inRange ? std::min(size_t(nBins[j] - 1),
+        size_t((val - binMin[j]) / width)) : 0;
+      index += bin*stride;
+      stride *= nBins[j];
+      }
+
+    bins[inRange ? index : totalBins] += weighted ? vals.Weights[i] : 1.0;
+    }
+
+  int rank = 0;
+  MPI_Comm_rank(comm, &rank);
+
+  MPI_Reduce(rank == 0 ? MPI_IN_PLACE : bins.data(), bins.data(),
+    totalBins + 1, MPI_DOUBLE, MPI_SUM, 0, comm);
+
+  res = sensei::MultiHistogram::Data();
+  res.NumberOfBins = nBins;
+  res.BinMin = binMin;
+  res.BinMax = binMax;
+  res.OutOfRange = bins[totalBins];
+  for (size_t i = 0; i < totalBins; ++i)
+    {
+    if (bins[i] != 0.0)
+      {
+      res.Index.push_back(i);
+      res.Count.push_back(bins[i]);
+      }
+    }
+}
+
+// compare two histograms, the sums of weights may differ by round off
+int Compare(const sensei::MultiHistogram::Data &a,
+  const sensei::MultiHistogram::Data &b)
+{
+  if ((a.NumberOfBins != b.NumberOfBins) || (a.Index != b.Index) ||
+    (a.Count.size() != b.Count.size()))
+    return -1;
+
+  size_t nDims = a.NumberOfBins.size();
+  for (size_t i = 0; i < nDims; ++i)
+    {
+    if ((std::fabs(a.BinMin[i] - b.BinMin[i]) > 1.0e-6) ||
+      (std::fabs(a.BinMax[i] - b.BinMax[i]) > 1.0e-6))
+      return -1;
+    }
+
+  size_t nOccupied = a.Count.size();
+  for (size_t i = 0; i < nOccupied; ++i)
+    {
+    if (std::fabs(a.Count[i] - b.Count[i]) > 1.0e-9*std::fabs(b.Count[i]))
+      return -1;
+    }
+
+  if (std::fabs(a.OutOfRange - b.OutOfRange) > 1.0e-9*std::fabs(b.OutOfRange))
+    return -1;
+
+  return 0;
+}
+
+// compute the histogram with the analysis
+int Compute(sensei::SVTKDataAdaptor *data, const std::vector<std::string> &arrays,
+  const std::vector<int> &nBins, const std::string &range,
+  const std::string &weights, int storage, int nThreads,
+  sensei::MultiHistogram::Data &res)
+{
+  sensei::MultiHistogram *hist = sensei::MultiHistogram::New();
+  hist->SetCommunicator(MPI_COMM_WORLD);
+
+  int ierr = 0;
+  if (hist->Initialize("mesh", svtkDataObject::POINT, arrays, nBins, "") ||
+    hist->SetRange(range) || hist->SetStorage(storage))
+    ierr = -1;
+
+  hist->SetWeightArrayName(weights);
+  hist->SetNumberOfThreads(nThreads);
+
+  if (!ierr && !hist->Execute(data, nullptr))
+    ierr = -1;
+
+  hist->GetHistogram(res);
+  hist->Finalize();
+  hist->Delete();
+
+  return ierr;
+}
+
+int main(int argc, char **argv)
+{
+  MPI_Init(&argc, &argv);
+
+  int rank = 0;
+  MPI_Comm comm = MPI_COMM_WORLD;
+  MPI_Comm_rank(comm, &rank);
+
+  Values vals;
+  sensei::SVTKDataAdaptor *data = NewDataAdaptor(rank, vals);
+
+  using sensei::MultiHistogram;
+
+  double lo = std::numeric_limits<double>::max();
+  double hi = std::numeric_limits<double>::lowest();
+
+  int err = 0;
+
+  // the range computed from the data, dense and sparse storage give the
+  // same result, as does the vector array
+  std::vector<int> nBins = {16, 12};
+
+  MultiHistogram::Data ref;
+  Reference(comm, vals, nBins, {lo, lo}, {hi, hi}, false, ref);
+
+  struct Case
+  {
+    std::vector<std::string> Arrays;
+    int Storage;
+    int NumberOfThreads;
+  };
+
+  std::vector<Case> cases = {{{"a", "b"}, MultiHistogram::STORAGE_DENSE, 1},
+    {{"a", "b"}, MultiHistogram::STORAGE_SPARSE, 3},
+    {{"a", "b"}, MultiHistogram::STORAGE_AUTO, 4},
+    {{"v"}, MultiHistogram::STORAGE_AUTO, 2}};
+
+  for (size_t i = 0; i < cases.size(); ++i)
+    {
+    MultiHistogram::Data res;
+    if (Compute(data, cases[i].Arrays, nBins, "auto", "", cases[i].Storage,
+      cases[i].NumberOfThreads, res) || ((rank == 0) && Compare(res, ref)))
+      {
+      SENSEI_ERROR("The histogram is incorrect in case " << i)
+      err = -1;
+      }
+    }
+
+  // weights and a fixed range in the first dimension
+  Reference(comm, vals, nBins, {-1.0, lo}, {1.0, hi}, true, ref);
+
+  for (int i = 0; i < 2; ++i)
+    {
+    MultiHistogram::Data res;
+    if (Compute(data, {"a", "b"}, nBins, "-1,1;auto", "w",
+      i ? MultiHistogram::STORAGE_SPARSE : MultiHistogram::STORAGE_DENSE,
+      2, res) || ((rank == 0) && (Compare(res, ref) || (res.OutOfRange <= 0.0))))
+      {
+      SENSEI_ERROR("The weighted histogram is incorrect with storage " << i)
+      err = -1;
+      }
+    }
+
+  // few occupied bins, only these are reduced
+  nBins = {500, 400};
+  Reference(comm, vals, nBins, {lo, lo}, {hi, hi}, false, ref);
+
+  for (int i = 0; i < 2; ++i)
+    {
+    MultiHistogram::Data res;
+    if (Compute(data, {"a", "b"}, nBins, "auto", "",
+      i ? MultiHistogram::STORAGE_SPARSE : MultiHistogram::STORAGE_AUTO,
+      2, res) || ((rank == 0) && Compare(res, ref)))
+      {
+      SENSEI_ERROR("The sparse histogram is incorrect with storage " << i)
+      err = -1;
+      }
+    }
+
+  data->Delete();
+
+  MPI_Allreduce(MPI_IN_PLACE, &err, 1, MPI_INT, MPI_MIN, comm);
+
+  MPI_Finalize();
+
+  return err ? -1 : 0;
+}
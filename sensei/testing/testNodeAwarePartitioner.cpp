@@ -0,0 +1,318 @@
+#include "NodeAwarePartitioner.h"
+#include "BlockPartitioner.h"
+#include "ConfigurablePartitioner.h"
+#include "MeshMetadata.h"
+#include "Error.h"
+
+#include <svtkDataObject.h>
+#include <svtkType.h>
+
+#include <pugixml.hpp>
+
+#include <mpi.h>
+#include <cmath>
+#include <vector>
+#include <string>
+#include <sstream>
+#include <iostream>
+
+// Validates the NodeAwarePartitioner. 8 sending ranks, each with 8 blocks,
+// send to receivers that are split over two nodes, half of the senders on
+// each. The layout of the nodes is set by a subclass so that two nodes can
+// be tested on one. When the data is evenly spread all of it stays on the
+// node, when it is not the tolerance limits the imbalance and the remainder
+// crosses nodes. The reported fraction kept on the node must match the
+// partition, and be at least that expected. The nodes are also found with
+// MPI_Comm_split_type and the host name exchange, where all the receivers are
+// on this node.
+
+const int nSenders = 8;
+const int nBlocksPerSender = 8;
+
+// receivers j < n/2 and senders j < 4 are on node 0, the others on node n/2.
+// a single receiver is alone on node 0
+class TwoNodePartitioner : public sensei::NodeAwarePartitioner
+{
+public:
+  static std::shared_ptr<TwoNodePartitioner> New()
+  { return std::shared_ptr<TwoNodePartitioner>(new TwoNodePartitioner); }
+
+  static int ReceiverNode(int rank, int nRanks)
+  { return (nRanks > 1) && (rank >= nRanks/2) ? nRanks/2 : 0; }
+
+  static int SenderNode(int sender, int nRanks)
+  { return sender < nSenders/2 ? 0 : (nRanks > 1 ? nRanks/2 : -1); }
+
+protected:
+  TwoNodePartitioner() { this->SetSenderRanksPerNode(nSenders/2); }
+
+  int GetNodes(MPI_Comm comm, int nSend, std::vector<int> &receiverNodes,
+    std::vector<int> &senderNodes) override
+  {
+    int nRanks = 1;
+    MPI_Comm_size(comm, &nRanks);
+
+    receiverNodes.resize(nRanks);
+    for (int j = 0; j < nRanks; ++j)
+      receiverNodes[j] = ReceiverNode(j, nRanks);
+
+    senderNodes.resize(nSend);
+    for (int j = 0; j < nSend; ++j)
+      senderNodes[j] = SenderNode(j, nRanks);
+
+    return 0;
+  }
+};
+
+// the fraction of the bytes kept on the node by the partition
+double OnNode(const sensei::MeshMetadataPtr &mdIn,
+  const sensei::MeshMetadataPtr &mdOut, int nRanks)
+{
+  double onNode = 0.0;
+  double total = 0.0;
+  for (int i = 0; i < mdIn->NumBlocks; ++i)
+    {
+    double bytes = 4.0*mdIn->BlockNumCells[i];
+    total += bytes;
+    if (TwoNodePartitioner::SenderNode(mdIn->BlockOwner[i], nRanks) ==
+      TwoNodePartitioner::ReceiverNode(mdOut->BlockOwner[i], nRanks))
+      onNode += bytes;
+    }
+  return onNode/total;
+}
+
+// the largest load over the mean load and the largest block over the mean
+void Imbalance(const sensei::MeshMetadataPtr &mdIn,
+  const sensei::MeshMetadataPtr &mdOut, int nRanks, double &imbalance,
+  double &largest)
+{
+  std::vector<double> loads(nRanks, 0.0);
+  double total = 0.0;
+  largest = 0.0;
+  for (int i = 0; i < mdIn->NumBlocks; ++i)
+    {
+    loads[mdOut->BlockOwner[i]] += mdIn->BlockNumCells[i];
+    total += mdIn->BlockNumCells[i];
+    largest = std::max(largest, double(mdIn->BlockNumCells[i]));
+    }
+
+  imbalance = 0.0;
+  for (int j = 0; j < nRanks; ++j)
+    imbalance = std::max(imbalance, loads[j]*nRanks/total);
+
+  largest *= nRanks/total;
+}
+
+sensei::MeshMetadataPtr NewMetadata(int heavy)
+{
+  sensei::MeshMetadataPtr md = sensei::MeshMetadata::New();
+  md->MeshName = "mesh";
+  md->NumBlocks = nSenders*nBlocksPerSender;
+  md->NumBlocksLocal.assign(nSenders, nBlocksPerSender);
+  md->NumArrays = 1;
+  md->ArrayName = {"data"};
+  md->ArrayCentering = {svtkDataObject::CELL};
+  md->ArrayComponents = {1};
+  md->ArrayType = {SVTK_FLOAT};
+
+  for (int i = 0; i < md->NumBlocks; ++i)
+    {
+    int sender = i / nBlocksPerSender;
+    long nCells = 1000*(1 + (i % nBlocksPerSender))*(sender < nSenders/2 ? heavy : 1);
+
+    md->BlockIds.push_back(i);
+    md->BlockOwner.push_back(sender);
+    md->BlockNumCells.push_back(nCells);
+    md->BlockNumPoints.push_back(2*nCells);
+    }
+
+  return md;
+}
+
+int Check(const char *label, const sensei::NodeAwarePartitionerPtr &part,
+  const sensei::MeshMetadataPtr &md, double minOnNode, double &onNode)
+{
+  int nRanks = 1;
+  MPI_Comm_size(MPI_COMM_WORLD, &nRanks);
+
+  sensei::MeshMetadataPtr mdOut;
+  if (part->GetPartition(MPI_COMM_WORLD, md, mdOut))
+    {
+    SENSEI_ERROR("Failed to partition the " << label << " data")
+    return -1;
+    }
+
+  // every rank computes the same partition
+  std::vector<int> owner0(mdOut->BlockOwner);
+  MPI_Bcast(owner0.data(), owner0.size(), MPI_INT, 0, MPI_COMM_WORLD);
+  int same = owner0 == mdOut->BlockOwner;
+  MPI_Allreduce(MPI_IN_PLACE, &same, 1, MPI_INT, MPI_MIN, MPI_COMM_WORLD);
+  if (!same)
+    {
+    SENSEI_ERROR("The partition of the " << label << " data differs between ranks")
+    return -1;
+    }
+
+  // the balance is within the tolerance, give or take a block
+  double imbalance = 0.0;
+  double largest = 0.0;
+  Imbalance(md, mdOut, nRanks, imbalance, largest);
+  if (imbalance > 1.0 + part->GetTolerance() + largest)
+    {
+    SENSEI_ERROR("The partition of the " << label << " data has imbalance "
+      << imbalance << " tolerance " << part->GetTolerance())
+    return -1;
+    }
+
+  onNode = part->GetOnNodeFraction();
+  if (std::abs(onNode - OnNode(md, mdOut, nRanks)) > 1.0e-12)
+    {
+    SENSEI_ERROR("The fraction kept on the node, " << onNode
+      << ", was reported as " << OnNode(md, mdOut, nRanks))
+    return -1;
+    }
+
+  if (onNode < minOnNode)
+    {
+    SENSEI_ERROR("The partition of the " << label << " data kept " << onNode
+      << " on the node, at least " << minOnNode << " was expected")
+    return -1;
+    }
+
+  int rank = 0;
+  MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+  if (rank == 0)
+    {
+    std::cerr << label << " kept " << onNode << " on the node, imbalance "
+      << imbalance << std::endl;
+    }
+
+  return 0;
+}
+
+int main(int argc, char **argv)
+{
+  MPI_Init(&argc, &argv);
+
+  int rank = 0;
+  int nRanks = 1;
+  MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+  MPI_Comm_size(MPI_COMM_WORLD, &nRanks);
+
+  int err = 0;
+
+  // a single receiver gets all the data, half of which is on its node
+  bool split = nRanks > 1;
+  bool even = (nRanks % 2) == 0;
+
+  sensei::BlockPartitionerPtr block = sensei::BlockPartitioner::New();
+  std::shared_ptr<TwoNodePartitioner> part = TwoNodePartitioner::New();
+
+  // evenly spread data stays on the node
+  sensei::MeshMetadataPtr md = NewMetadata(1);
+  sensei::MeshMetadataPtr mdBlock;
+  block->GetPartition(MPI_COMM_WORLD, md, mdBlock);
+
+  double onNode = 0.0;
+  err |= Check("even", part, md,
+    std::max(OnNode(md, mdBlock, nRanks), split ? (even ? 1.0 : 0.0) : 0.5),
+    onNode);
+
+  // unevenly spread data stays on the node as far as the tolerance allows
+  // 3/4 of the data is on node 0. with an even number of receivers, half
+  // are on node 0 and take up to 1.1/2 of it, the other half keep their 1/4
+  md = NewMetadata(3);
+
+  part->SetTolerance(0.1);
+  err |= Check("uneven", part, md, (even || !split) ? 0.75 : 0.5, onNode);
+
+  if (split && (onNode >= 1.0))
+    {
+    SENSEI_ERROR("All of the uneven data was kept on the node")
+    err = -1;
+    }
+
+  part->SetTolerance(1.0e6);
+  err |= Check("uneven, large tolerance", part, md,
+    split ? 1.0 : 0.5, onNode);
+
+  // the nodes found by MPI, all of the receivers are on this node. with 4
+  // senders per node the first half of the senders are on this node
+  std::ostringstream xml;
+  xml << "<partitioner type=\"node_aware\" sender_ranks_per_node=\""
+    << nSenders/2 << "\" tolerance=\"1.0e6\" cost=\"cells\"/>";
+
+  pugi::xml_document doc;
+  doc.load_string(xml.str().c_str());
+  pugi::xml_node node = doc.child("partitioner");
+
+  sensei::ConfigurablePartitionerPtr config = sensei::ConfigurablePartitioner::New();
+  sensei::MeshMetadataPtr mdConfig;
+  if (config->Initialize(node) ||
+    config->GetPartition(MPI_COMM_WORLD, md, mdConfig))
+    {
+    SENSEI_ERROR("Failed to partition with a configured node_aware partitioner")
+    err = -1;
+    }
+
+  // with the senders' host names, the even senders are on this node
+  std::vector<char> host(MPI_MAX_PROCESSOR_NAME, '\0');
+  int len = 0;
+  MPI_Get_processor_name(host.data(), &len);
+
+  std::vector<std::string> hosts;
+  for (int j = 0; j < nSenders; ++j)
+    hosts.push_back(j % 2 ? std::string("elsewhere") : std::string(host.data()));
+
+  sensei::NodeAwarePartitionerPtr hostPart = sensei::NodeAwarePartitioner::New();
+  hostPart->SetSenderHosts(hosts);
+
+  sensei::MeshMetadataPtr mdHost;
+  if (hostPart->GetPartition(MPI_COMM_WORLD, md, mdHost))
+    {
+    SENSEI_ERROR("Failed to partition with sender host names")
+    err = -1;
+    }
+  else
+    {
+    double evenBytes = 0.0;
+    double total = 0.0;
+    for (int i = 0; i < md->NumBlocks; ++i)
+      {
+      total += md->BlockNumCells[i];
+      if ((md->BlockOwner[i] % 2) == 0)
+        evenBytes += md->BlockNumCells[i];
+      }
+
+    if (std::abs(hostPart->GetOnNodeFraction() - evenBytes/total) > 1.0e-12)
+      {
+      SENSEI_ERROR("With sender host names " << hostPart->GetOnNodeFraction()
+        << " was kept on the node, not " << evenBytes/total)
+      err = -1;
+      }
+    }
+
+  // a configuration without the senders' layout is reported
+  std::ostringstream os;
+  std::streambuf *buf = std::cerr.rdbuf(os.rdbuf());
+
+  pugi::xml_document badDoc;
+  badDoc.load_string("<partitioner type=\"node_aware\"/>");
+  pugi::xml_node badNode = badDoc.child("partitioner");
+  sensei::ConfigurablePartitionerPtr badConfig = sensei::ConfigurablePartitioner::New();
+  int bad = badConfig->Initialize(badNode);
+
+  std::cerr.rdbuf(buf);
+
+  if (!bad)
+    {
+    SENSEI_ERROR("A configuration without the sender layout was accepted")
+    err = -1;
+    }
+
+  MPI_Allreduce(MPI_IN_PLACE, &err, 1, MPI_INT, MPI_MIN, MPI_COMM_WORLD);
+
+  MPI_Finalize();
+
+  return err ? -1 : 0;
+}
@@ -0,0 +1,521 @@
+#include "Profiler.h"
+#include "Error.h"
+
+#include <mpi.h>
+#include <thread>
+#include <vector>
+#include <string>
+#include <sstream>
+#include <map>
+#include <set>
+#include <cstring>
+#include <cerrno>
+#include <cstdlib>
+#include <cstdint>
+#include <fstream>
+#include <iterator>
+#include <iostream>
+#include <dlfcn.h>
+#include <unistd.h>
+
+// Validates the events logged by several threads, and reports the cost of
+// an event with one and with several threads. Pass the number of events per
+// thread and the number of threads on the command line to use this as a
+// benchmark, for example:
+//
+//     mpiexec -np 2 testProfiler 1000000 8
+//
+// The logs are written to a temporary directory under TMPDIR, or /tmp, that
+// is removed when they have been checked.
+//
+// An optional third argument selects the log format, csv, binary, or chrome,
+// or stats to collect event statistics, performance counters, and memory use
+// in place of the log. The binary and chrome logs and the statistics written at finalize
+// are validated.
+
+// logs nested events. each outer event holds nInner events, alternately
+// named by a reused buffer and by a literal, and records its index as a value
+void LogEvents(int nOuter, int nInner)
+{
+  for (int i = 0; i < nOuter; ++i)
+    {
+    sensei::TimeEvent<64> outer("testProfiler::Outer");
+    sensei::Profiler::RecordValue("testProfiler::Value", i);
+    for (int j = 0; j < nInner; ++j)
+      {
+      if (j % 2)
+        {
+        sensei::TimeEvent<64> inner("testProfiler::", (j % 4 == 1) ? "A" : "B");
+        }
+      else
+        {
+        sensei::Profiler::StartEvent("testProfiler::C");
+        sensei::Profiler::EndEvent("testProfiler::C", j);
+        }
+      }
+    }
+}
+
+// returns the time per event of nEvents events on each of nThreads threads
+double TimeEvents(MPI_Comm comm, int nThreads, int nEvents)
+{
+  MPI_Barrier(comm);
+  double t0 = MPI_Wtime();
+
+  std::vector<std::thread> threads;
+  for (int i = 0; i < nThreads; ++i)
+    {
+    threads.emplace_back([nEvents]()
+      {
+      for (int j = 0; j < nEvents; ++j)
+        {
+        sensei::Profiler::StartEvent("testProfiler::Time");
+        sensei::Profiler::EndEvent("testProfiler::Time");
+        }
+      });
+    }
+
+  for (std::thread &t : threads)
+    t.join();
+
+  double dt = MPI_Wtime() - t0;
+  MPI_Allreduce(MPI_IN_PLACE, &dt, 1, MPI_DOUBLE, MPI_MAX, comm);
+
+  return dt / nEvents;
+}
+
+// the name and depth of each logged event, and the threads that logged them
+struct Summary
+{
+  std::map<std::string, long> Count;
+  std::map<std::string, std::set<int>> Depth;
+  std::map<std::string, long long> Bytes;
+  std::set<std::string> Threads;
+};
+
+int Summarize(const std::string &log, Summary &sum)
+{
+  std::istringstream is(log);
+  std::string line;
+  while (std::getline(is, line))
+    {
+    // rank, thread, "name", start, end, delta, bytes, depth
+    size_t q0 = line.find('"');
+    size_t q1 = line.find('"', q0 + 1);
+    if ((q0 == std::string::npos) || (q1 == std::string::npos))
+      return -1;
+
+    std::string name = line.substr(q0 + 1, q1 - q0 - 1);
+    std::string thread = line.substr(line.find(',') + 2, q0 - line.find(',') - 4);
+
+    std::istringstream fields(line.substr(q1 + 2));
+    double t[3] = {0.0};
+    long long bytes = 0;
+    int depth = 0;
+    char sep;
+    fields >> t[0] >> sep >> t[1] >> sep >> t[2] >> sep >> bytes >> sep >> depth;
+
+    if (!fields || (t[1] < t[0]))
+      return -1;
+
+    sum.Count[name] += 1;
+    sum.Depth[name].insert(depth);
+    sum.Bytes[name] += bytes;
+    sum.Threads.insert(thread);
+    }
+
+  return 0;
+}
+
+// count the events in each section of a binary log
+int ReadBinary(const std::string &log, std::vector<long> &counts)
+{
+  size_t pos = 0;
+  auto read = [&](void *val, size_t n) -> bool
+    {
+    if (pos + n > log.size())
+      return false;
+    memcpy(val, log.data() + pos, n);
+    pos += n;
+    return true;
+    };
+
+  while (pos < log.size())
+    {
+    char magic[8];
+    uint32_t version = 0;
+    int32_t rank = -1;
+    double offset = 0.0;
+    uint32_t nNames = 0;
+    if (!read(magic, 8) || strncmp(magic, "SENSEIPF", 8) ||
+      !read(&version, 4) || (version != 1) || !read(&rank, 4) ||
+      (rank != int(counts.size())) || !read(&offset, 8) || !read(&nNames, 4))
+      return -1;
+
+    for (uint32_t i = 0; i < nNames; ++i)
+      {
+      uint32_t len = 0;
+      if (!read(&len, 4) || (pos + len > log.size()))
+        return -1;
+      pos += len;
+      }
+
+    uint64_t nEvents = 0;
+    if (!read(&nEvents, 8))
+      return -1;
+
+    for (uint64_t i = 0; i < nEvents; ++i)
+      {
+      int32_t ids[2];
+      int64_t bytes;
+      double t[2];
+      uint64_t thread;
+      if (!read(ids, 8) || !read(&bytes, 8) || !read(t, 16) ||
+        !read(&thread, 8) || (uint32_t(ids[0]) >= nNames) || (t[1] < t[0]))
+        return -1;
+      }
+
+    counts.push_back(nEvents);
+    }
+
+  return 0;
+}
+
+// count the occurrences of a string
+long Count(const std::string &str, const std::string &sub)
+{
+  long n = 0;
+  for (size_t pos = str.find(sub); pos != std::string::npos;
+    pos = str.find(sub, pos + sub.size()))
+    ++n;
+  return n;
+}
+
+// check the structure of a chrome trace and count the complete events
+int ReadChrome(const std::string &log, int nRanks, long &nEvents)
+{
+  if ((log.size() < 4) || log.compare(0, 2, "[\n") ||
+    log.compare(log.size() - 3, 3, "\n]\n"))
+    return -1;
+
+  long depth = 0;
+  for (char c : log)
+    {
+    depth += (c == '{') - (c == '}');
+    if (depth < 0)
+      return -1;
+    }
+
+  nEvents = Count(log, "\"ph\":\"X\"");
+
+  if (depth || (Count(log, "\"process_name\"") != nRanks) ||
+    (Count(log, "\"ph\":\"C\"") == 0))
+    return -1;
+
+  return 0;
+}
+
+// the statistics of each event in the last report of a statistics file:
+// count, total, min, mean, max, std dev, p50, p90, p99, imbalance, bytes,
+// followed by the performance counters and the memory use. and those of
+// each recorded value: count, total, min, mean, max
+int ReadStats(const std::string &fileName,
+  std::map<std::string, std::vector<double>> &stats,
+  std::map<std::string, std::vector<double>> &values, int &nReports)
+{
+  std::ifstream ifs(fileName);
+  std::string line;
+  nReports = 0;
+  bool inValues = false;
+  while (std::getline(ifs, line))
+    {
+    if (line.compare(0, 8, "# report") == 0)
+      {
+      stats.clear();
+      values.clear();
+      inValues = false;
+      ++nReports;
+      }
+
+    if (line == "# values")
+      inValues = true;
+
+    if (line.empty() || (line[0] != '"'))
+      continue;
+
+    size_t q1 = line.find('"', 1);
+    if (q1 == std::string::npos)
+      return -1;
+
+    std::vector<double> &vals = (inValues ? values : stats)[line.substr(1, q1 - 1)];
+    std::istringstream fields(line.substr(q1 + 2));
+    double val = 0.0;
+    char sep;
+    while (fields >> val)
+      {
+      vals.push_back(val);
+      fields >> sep;
+      }
+
+    if (vals.size() < (inValues ? 5u : 11u))
+      return -1;
+    }
+
+  return 0;
+}
+
+// check that the statistics are consistent
+bool Consistent(const std::vector<double> &st)
+{
+  double lo = st[2]*(1.0 - 1.0e-6);
+  double hi = st[4]*(1.0 + 1.0e-6);
+  return (st[0] > 0) && (lo <= st[3]) && (st[3] <= hi) &&
+    (lo <= st[6]) && (st[6] <= st[7]) && (st[7] <= st[8]) && (st[8] <= hi) &&
+    (st[5] >= 0.0) && (st[9] >= 1.0 - 1.0e-6);
+}
+
+int main(int argc, char **argv)
+{
+  MPI_Init(&argc, &argv);
+
+  int nEvents = argc > 1 ? atoi(argv[1]) : 20000;
+  int nThreads = argc > 2 ? atoi(argv[2]) : 4;
+  std::string format = argc > 3 ? argv[3] : "csv";
+
+  int rank = 0;
+  int nRanks = 1;
+  MPI_Comm comm = MPI_COMM_WORLD;
+  MPI_Comm_rank(comm, &rank);
+  MPI_Comm_size(comm, &nRanks);
+
+  bool stats = format == "stats";
+  bool counted = dlsym(RTLD_DEFAULT, "sensei_allocated_bytes");
+
+  // the logs are written to a temporary directory that is removed when
+  // they have been checked
+  std::string logDir;
+  if (rank == 0)
+    {
+    const char *tmp = getenv("TMPDIR");
+    std::string dirTemplate = std::string(tmp ? tmp : "/tmp") + "/testProfilerXXXXXX";
+    if (mkdtemp(&dirTemplate[0]))
+      logDir = dirTemplate;
+    else
+      SENSEI_ERROR("Failed to create a temporary directory. " << strerror(errno))
+    }
+
+  int nChars = logDir.size();
+  MPI_Bcast(&nChars, 1, MPI_INT, 0, comm);
+  if (nChars == 0)
+    {
+    MPI_Finalize();
+    return -1;
+    }
+  logDir.resize(nChars);
+  MPI_Bcast(&logDir[0], nChars, MPI_CHAR, 0, comm);
+
+  std::string logFile = logDir + "/testProfiler_" + std::to_string(nRanks) +
+    (counted ? "_allocations." : ".") + format;
+
+  sensei::Profiler::SetCommunicator(comm);
+  sensei::Profiler::SetTimerLogFile(logFile);
+  sensei::Profiler::SetStatisticsFile(logFile);
+  sensei::Profiler::Enable(stats ? 0x1c : 0x01);
+
+  // an unknown counter is reported
+  std::ostringstream errs;
+  std::streambuf *buf = std::cerr.rdbuf(errs.rdbuf());
+  int err = sensei::Profiler::SetCounters("cycles,bogus") ? 0 : -1;
+  std::cerr.rdbuf(buf);
+
+  if ((!stats && sensei::Profiler::SetLogFormat(format)) ||
+    (stats && sensei::Profiler::SetCounters("task-clock, page-faults")))
+    err = -1;
+
+  sensei::Profiler::Initialize();
+
+#if defined(ENABLE_PROFILER)
+  // events from several threads, including threads that have exited
+  int nOuter = 50;
+  int nInner = 20;
+
+  for (int k = 0; k < 2; ++k)
+    {
+    std::vector<std::thread> threads;
+    for (int i = 0; i < nThreads; ++i)
+      threads.emplace_back(LogEvents, nOuter, nInner);
+
+    for (std::thread &t : threads)
+      t.join();
+    }
+
+  LogEvents(nOuter, nInner);
+
+  long nRuns = 2*nThreads + 1;
+  long long bytes = 0;
+  for (int j = 0; j < nInner; j += 2)
+    bytes += j;
+
+  std::ostringstream os;
+  sensei::Profiler::ToStream(os);
+
+  if (stats)
+    {
+    // memory allocated and touched in an event is attributed to it. the
+    // allocations are counted when the allocation counter is preloaded
+    long allocSize = 32l*1024*1024;
+    {
+    sensei::TimeEvent<64> evt("testProfiler::Allocate");
+    std::vector<char> buf(allocSize, 1);
+    volatile char c = buf[allocSize/2];
+    (void)c;
+    }
+
+    double allocated = counted ? double(nRanks)*allocSize : -1.0;
+
+    // no events are kept, a report is written
+    int nReports = 0;
+    std::map<std::string, std::vector<double>> st;
+    std::map<std::string, std::vector<double>> vals;
+    if (!os.str().empty() || sensei::Profiler::WriteStatistics() ||
+      ((rank == 0) && (ReadStats(logFile, st, vals, nReports) || (nReports != 1) ||
+      (st["testProfiler::Outer"][0] != nRanks*nRuns*nOuter) ||
+      (st["testProfiler::A"][0] != nRanks*nRuns*nOuter*nInner/4) ||
+      (st["testProfiler::C"][0] != nRanks*nRuns*nOuter*nInner/2) ||
+      (st["testProfiler::C"][10] != nRanks*nRuns*nOuter*bytes) ||
+      (st["testProfiler::Outer"].size() != 17) ||
+      (st["testProfiler::Allocate"][14] < nRanks*allocSize/2048) ||
+      (st["testProfiler::Allocate"][15] < allocSize/1024) ||
+      ((allocated < 0.0) && (st["testProfiler::Allocate"][16] != -1.0)) ||
+      ((allocated > 0.0) && (st["testProfiler::Allocate"][16] < allocated)) ||
+      !Consistent(st["testProfiler::Outer"]) || !Consistent(st["testProfiler::C"]) ||
+      (st["testProfiler::Outer"][1] < st["testProfiler::A"][1]))))
+      {
+      SENSEI_ERROR("The event statistics are incorrect")
+      err = -1;
+      }
+
+    // the recorded values are reported apart from the events
+    std::vector<double> expected({double(nRanks*nRuns*nOuter),
+      nRanks*nRuns*nOuter*(nOuter - 1)/2.0, 0.0, (nOuter - 1)/2.0,
+      double(nOuter - 1)});
+
+    if ((rank == 0) && (st.count("testProfiler::Value") ||
+      (vals["testProfiler::Value"] != expected)))
+      {
+      SENSEI_ERROR("The recorded values are incorrect")
+      err = -1;
+      }
+
+    // with an interval set a report is written every interval steps
+    sensei::Profiler::SetStatisticsInterval(2);
+    for (int i = 0; i < 3; ++i)
+      sensei::Profiler::EndStep();
+
+    if ((rank == 0) && (ReadStats(logFile, st, vals, nReports) || (nReports != 2)))
+      {
+      SENSEI_ERROR("The periodic statistics report was not written")
+      err = -1;
+      }
+    }
+
+  Summary sum;
+  if (!stats && Summarize(os.str(), sum))
+    {
+    SENSEI_ERROR("Failed to parse the log")
+    err = -1;
+    }
+
+  if (!stats && ((sum.Count["testProfiler::Outer"] != nRuns*nOuter) ||
+    (sum.Count["testProfiler::A"] != nRuns*nOuter*nInner/4) ||
+    (sum.Count["testProfiler::B"] != nRuns*nOuter*nInner/4) ||
+    (sum.Count["testProfiler::C"] != nRuns*nOuter*nInner/2) ||
+    (sum.Depth["testProfiler::Outer"] != std::set<int>{0}) ||
+    (sum.Depth["testProfiler::A"] != std::set<int>{1}) ||
+    (sum.Depth["testProfiler::C"] != std::set<int>{1}) ||
+    (sum.Bytes["testProfiler::C"] != nRuns*nOuter*bytes) ||
+    (sum.Threads.size() < 2)))
+    {
+    SENSEI_ERROR("The logged events are incorrect")
+    err = -1;
+    }
+
+  if (sensei::Profiler::Validate())
+    {
+    SENSEI_ERROR("Unmatched events were found")
+    err = -1;
+    }
+#endif
+
+  // time events with one and several threads
+  double dt[2] = {TimeEvents(comm, 1, nEvents),
+    TimeEvents(comm, nThreads, nEvents)};
+
+  if (rank == 0)
+    {
+    std::cerr << "Profiler event cost, 1 thread " << dt[0]*1.0e9
+      << " ns, " << nThreads << " threads " << dt[1]*1.0e9 << " ns"
+      << std::endl;
+    }
+
+  sensei::Profiler::Finalize();
+
+#if defined(ENABLE_PROFILER)
+  // every event logged on every rank is in the log
+  long nLogged = nRuns*nOuter*(nInner + 1) + long(nThreads + 1)*nEvents;
+
+  if ((rank == 0) && stats)
+    {
+    // the last report covers the whole run
+    int nReports = 0;
+    std::map<std::string, std::vector<double>> st;
+    std::map<std::string, std::vector<double>> vals;
+    if (ReadStats(logFile, st, vals, nReports) || (nReports != 3) ||
+      (st["testProfiler::Outer"][0] != nRanks*nRuns*nOuter) ||
+      (st["testProfiler::Time"][0] != nRanks*nLogged - nRanks*nRuns*nOuter*(nInner + 1)) ||
+      !Consistent(st["testProfiler::Time"]))
+      {
+      SENSEI_ERROR("The final event statistics are incorrect")
+      err = -1;
+      }
+    }
+  else if ((rank == 0) && (format != "csv"))
+    {
+    std::ifstream ifs(logFile, std::ios::binary);
+    std::string log((std::istreambuf_iterator<char>(ifs)),
+      std::istreambuf_iterator<char>());
+
+    if (format == "binary")
+      {
+      std::vector<long> counts;
+      if (ReadBinary(log, counts) || (counts.size() != size_t(nRanks)) ||
+        (counts != std::vector<long>(nRanks, nLogged)))
+        {
+        SENSEI_ERROR("The binary log is incorrect")
+        err = -1;
+        }
+      }
+    else
+      {
+      long nTraced = 0;
+      if (ReadChrome(log, nRanks, nTraced) || (nTraced != nRanks*nLogged))
+        {
+        SENSEI_ERROR("The chrome trace is incorrect")
+        err = -1;
+        }
+      }
+    }
+#endif
+
+  MPI_Allreduce(MPI_IN_PLACE, &err, 1, MPI_INT, MPI_MIN, comm);
+
+  if (rank == 0)
+    {
+    remove(logFile.c_str());
+    rmdir(logDir.c_str());
+    }
+
+  MPI_Finalize();
+
+  return err ? -1 : 0;
+}
@@ -0,0 +1,278 @@
+#include "SFCPartitioner.h"
+#include "BlockPartitioner.h"
+#include "ConfigurablePartitioner.h"
+#include "MeshMetadata.h"
+#include "Error.h"
+
+#include <pugixml.hpp>
+
+#include <mpi.h>
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <random>
+#include <vector>
+#include <sstream>
+#include <iostream>
+
+// Validates the SFCPartitioner on a 8x8x8 grid of blocks numbered in a
+// random order. Consecutive blocks along the Hilbert curve must be face
+// neighbors, both when the blocks are described by their bounds and by
+// their extents. The partition must be the same on all ranks and on every
+// call, balanced, and must keep far more neighboring blocks on the same rank
+// than the block partitioner.
+
+const int nSide = 8;
+
+// the block's position in the grid
+std::array<int,3> Position(const sensei::MeshMetadataPtr &md, int i)
+{
+  std::array<int,3> pos;
+  for (int j = 0; j < 3; ++j)
+    pos[j] = int(std::floor(md->BlockBounds[i][2*j]/2.0));
+  return pos;
+}
+
+// the number of pairs of face neighbors on the same rank
+int SharedFaces(const sensei::MeshMetadataPtr &md)
+{
+  std::vector<int> owner(nSide*nSide*nSide);
+  for (int i = 0; i < md->NumBlocks; ++i)
+    {
+    std::array<int,3> p = Position(md, i);
+    owner[(p[2]*nSide + p[1])*nSide + p[0]] = md->BlockOwner[i];
+    }
+
+  int shared = 0;
+  for (int k = 0; k < nSide; ++k)
+    for (int j = 0; j < nSide; ++j)
+      for (int i = 0; i < nSide; ++i)
+        {
+        int id = (k*nSide + j)*nSide + i;
+        shared += (i + 1 < nSide) && (owner[id] == owner[id + 1]);
+        shared += (j + 1 < nSide) && (owner[id] == owner[id + nSide]);
+        shared += (k + 1 < nSide) && (owner[id] == owner[id + nSide*nSide]);
+        }
+
+  return shared;
+}
+
+// consecutive blocks along the Hilbert curve are face neighbors
+int CheckHilbert(const char *label, const sensei::MeshMetadataPtr &md,
+  const std::vector<unsigned int> &order)
+{
+  std::vector<unsigned int> ids(order);
+  std::sort(ids.begin(), ids.end());
+  for (int i = 0; i < md->NumBlocks; ++i)
+    {
+    if (ids[i] != unsigned(i))
+      {
+      SENSEI_ERROR("The " << label << " order is not a permutation of the blocks")
+      return -1;
+      }
+    }
+
+  for (int i = 1; i < md->NumBlocks; ++i)
+    {
+    std::array<int,3> a = Position(md, order[i-1]);
+    std::array<int,3> b = Position(md, order[i]);
+
+    int dist = std::abs(a[0] - b[0]) + std::abs(a[1] - b[1]) + std::abs(a[2] - b[2]);
+    if (dist != 1)
+      {
+      SENSEI_ERROR("Blocks " << order[i-1] << " and " << order[i]
+        << " are consecutive on the " << label << " curve but not neighbors")
+      return -1;
+      }
+    }
+
+  return 0;
+}
+
+int main(int argc, char **argv)
+{
+  MPI_Init(&argc, &argv);
+
+  int rank = 0;
+  int nRanks = 1;
+  MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+  MPI_Comm_size(MPI_COMM_WORLD, &nRanks);
+
+  // blocks of 2x2x2 cells in a random order
+  int nBlocks = nSide*nSide*nSide;
+  std::vector<int> ids(nBlocks);
+  for (int i = 0; i < nBlocks; ++i)
+    ids[i] = i;
+
+  std::mt19937 gen(11);
+  std::shuffle(ids.begin(), ids.end(), gen);
+
+  sensei::MeshMetadataPtr md = sensei::MeshMetadata::New();
+  md->MeshName = "mesh";
+  md->NumBlocks = nBlocks;
+  for (int q = 0; q < nBlocks; ++q)
+    {
+    int i = ids[q] % nSide;
+    int j = (ids[q] / nSide) % nSide;
+    int k = ids[q] / (nSide*nSide);
+
+    md->BlockIds.push_back(q);
+    md->BlockOwner.push_back(0);
+    md->BlockNumCells.push_back(8);
+    md->BlockNumPoints.push_back(27);
+    md->BlockBounds.push_back({{2.0*i, 2.0*i + 2.0, 2.0*j, 2.0*j + 2.0,
+      2.0*k, 2.0*k + 2.0}});
+    md->BlockExtents.push_back({{2*i, 2*i + 1, 2*j, 2*j + 1, 2*k, 2*k + 1}});
+    }
+
+  int err = 0;
+
+  // the curves
+  sensei::SFCPartitionerPtr part = sensei::SFCPartitioner::New();
+
+  std::vector<unsigned int> order;
+  if (part->GetBlockOrder(md, order) || CheckHilbert("bounds", md, order))
+    err = -1;
+
+  sensei::MeshMetadataPtr mdExt = md->NewCopy();
+  mdExt->BlockBounds.clear();
+  std::vector<unsigned int> orderExt;
+  if (part->GetBlockOrder(mdExt, orderExt) || (orderExt != order))
+    {
+    SENSEI_ERROR("The order from the extents differs from the bounds")
+    err = -1;
+    }
+
+  part->SetCurve("morton");
+  std::vector<unsigned int> orderMorton;
+  if (part->GetBlockOrder(md, orderMorton) || (orderMorton == order))
+    {
+    SENSEI_ERROR("The Morton order is the same as the Hilbert order")
+    err = -1;
+    }
+
+  // the partitions
+  sensei::BlockPartitionerPtr block = sensei::BlockPartitioner::New();
+  sensei::MeshMetadataPtr mdBlock;
+  block->GetPartition(MPI_COMM_WORLD, md, mdBlock);
+  int blockShared = SharedFaces(mdBlock);
+
+  for (const char *curve : {"hilbert", "morton"})
+    {
+    part->SetCurve(curve);
+
+    sensei::MeshMetadataPtr mdOut;
+    if (part->GetPartition(MPI_COMM_WORLD, md, mdOut))
+      {
+      SENSEI_ERROR("Failed to partition along the " << curve << " curve")
+      err = -1;
+      continue;
+      }
+
+    // the same on every rank
+    std::vector<int> owner0(mdOut->BlockOwner);
+    MPI_Bcast(owner0.data(), owner0.size(), MPI_INT, 0, MPI_COMM_WORLD);
+    int same = owner0 == mdOut->BlockOwner;
+
+    // and every step, whatever the current owners
+    sensei::MeshMetadataPtr mdNext = mdOut->NewCopy();
+    sensei::MeshMetadataPtr mdNextOut;
+    part->GetPartition(MPI_COMM_WORLD, mdNext, mdNextOut);
+    same &= mdNextOut->BlockOwner == mdOut->BlockOwner;
+
+    MPI_Allreduce(MPI_IN_PLACE, &same, 1, MPI_INT, MPI_MIN, MPI_COMM_WORLD);
+    if (!same)
+      {
+      SENSEI_ERROR("The " << curve << " partition is not deterministic")
+      err = -1;
+      }
+
+    if (part->GetImbalance() > 1.0 + double(nRanks)/nBlocks)
+      {
+      SENSEI_ERROR("The " << curve << " partition is not balanced, imbalance "
+        << part->GetImbalance())
+      err = -1;
+      }
+
+    int shared = SharedFaces(mdOut);
+    if ((nRanks > 1) && (shared <= 2*blockShared))
+      {
+      SENSEI_ERROR("The " << curve << " partition keeps " << shared
+        << " neighbors together, the block partitioner " << blockShared)
+      err = -1;
+      }
+
+    if (rank == 0)
+      {
+      std::cerr << curve << " shared faces " << shared << " block partitioner "
+        << blockShared << " imbalance " << part->GetImbalance() << std::endl;
+      }
+    }
+
+  // weighted segments, the first blocks are heavy
+  std::vector<double> weights(nBlocks, 1.0);
+  for (int i = 0; i < nBlocks/8; ++i)
+    weights[i] = 20.0;
+
+  std::ostringstream xml;
+  xml << "<partitioner type=\"sfc\" curve=\"hilbert\" cost=\"weights\">"
+    << "<block_weights>";
+  for (int i = 0; i < nBlocks; ++i)
+    xml << weights[i] << " ";
+  xml << "</block_weights></partitioner>";
+
+  pugi::xml_document doc;
+  doc.load_string(xml.str().c_str());
+  pugi::xml_node node = doc.child("partitioner");
+
+  sensei::ConfigurablePartitionerPtr config = sensei::ConfigurablePartitioner::New();
+  sensei::MeshMetadataPtr mdConfig;
+  if (config->Initialize(node) ||
+    config->GetPartition(MPI_COMM_WORLD, md, mdConfig))
+    {
+    SENSEI_ERROR("Failed to partition with a configured sfc partitioner")
+    err = -1;
+    }
+  else
+    {
+    std::vector<double> loads(nRanks, 0.0);
+    for (int i = 0; i < nBlocks; ++i)
+      loads[mdConfig->BlockOwner[i]] += weights[i];
+
+    double maxLoad = *std::max_element(loads.begin(), loads.end());
+    double total = 0.0;
+    for (int i = 0; i < nRanks; ++i)
+      total += loads[i];
+
+    if (maxLoad*nRanks/total > 1.0 + 20.0*nRanks/total)
+      {
+      SENSEI_ERROR("The weighted sfc partition is not balanced, imbalance "
+        << maxLoad*nRanks/total)
+      err = -1;
+      }
+    }
+
+  // a mesh without bounds or extents is reported
+  std::ostringstream os;
+  std::streambuf *buf = std::cerr.rdbuf(os.rdbuf());
+
+  sensei::MeshMetadataPtr mdBad = md->NewCopy();
+  mdBad->BlockBounds.clear();
+  mdBad->BlockExtents.clear();
+  sensei::MeshMetadataPtr mdBadOut;
+  int bad = part->GetPartition(MPI_COMM_WORLD, mdBad, mdBadOut);
+
+  std::cerr.rdbuf(buf);
+
+  if (!bad)
+    {
+    SENSEI_ERROR("A mesh without bounds or extents was accepted")
+    err = -1;
+    }
+
+  MPI_Allreduce(MPI_IN_PLACE, &err, 1, MPI_INT, MPI_MIN, MPI_COMM_WORLD);
+
+  MPI_Finalize();
+
+  return err ? -1 : 0;
+}
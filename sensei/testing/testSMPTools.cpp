@@ -0,0 +1,153 @@
+#include "Error.h"
+
+#include <svtkSMPTools.h>
+#include <svtkSMPThreadLocal.h>
+#include <svtkAtomic.h>
+#include <svtkDoubleArray.h>
+#include <svtkSmartPointer.h>
+
+#include <vector>
+#include <thread>
+#include <string>
+#include <algorithm>
+#include <iostream>
+
+// Validates svtkSMPTools::For and the thread local storage and atomics of the
+// SMP backend SVTK was built with. Each index must be visited exactly once,
+// with nested loops, and after the number of threads is changed. The number
+// of threads is set by SVTK_SMP_MAX_THREADS in the test's environment.
+
+// counts the visits to each index, the number of indices visited by each
+// thread, and the threads that took part
+struct Visit
+{
+  Visit(std::vector<int> &visits, bool nested)
+    : Visits(visits), Nested(nested), Total(0) {}
+
+  void Initialize()
+  {
+    this->Count.Local() = 0;
+    this->Threads.Local() = std::this_thread::get_id();
+  }
+
+  void operator()(svtkIdType first, svtkIdType last)
+  {
+    for (svtkIdType i = first; i < last; ++i)
+      {
+      // each index is touched by one thread only
+      ++this->Visits[i];
+      ++this->Count.Local();
+      ++this->Total;
+
+      if (this->Nested && ((i % 100) == 0))
+        {
+        svtkAtomic<int> inner(0);
+        svtkSMPTools::For(0, 50, [&inner](svtkIdType b, svtkIdType e)
+          { inner += int(e - b); });
+
+        if (inner != 50)
+          this->Visits[i] = -1000;
+        }
+      }
+  }
+
+  void Reduce() {}
+
+  std::vector<int> &Visits;
+  bool Nested;
+  svtkAtomic<svtkIdType> Total;
+  svtkSMPThreadLocal<svtkIdType> Count;
+  svtkSMPThreadLocal<std::thread::id> Threads;
+};
+
+int Check(svtkIdType n, svtkIdType grain, bool nested)
+{
+  std::vector<int> visits(n, 0);
+  Visit visit(visits, nested);
+
+  if (grain)
+    svtkSMPTools::For(0, n, grain, visit);
+  else
+    svtkSMPTools::For(0, n, visit);
+
+  if (std::any_of(visits.begin(), visits.end(), [](int v){ return v != 1; }))
+    {
+    SENSEI_ERROR("Indices were not visited exactly once, n=" << n
+      << " grain=" << grain << " nested=" << nested)
+    return -1;
+    }
+
+  svtkIdType total = 0;
+  for (svtkIdType count : visit.Count)
+    total += count;
+
+  if ((total != n) || (visit.Total != n))
+    {
+    SENSEI_ERROR("The thread local counts sum to " << total
+      << " and the atomic count is " << visit.Total << " not " << n)
+    return -1;
+    }
+
+  size_t nThreads = visit.Threads.size();
+  if (nThreads > size_t(svtkSMPTools::GetEstimatedNumberOfThreads()))
+    {
+    SENSEI_ERROR("More threads took part, " << nThreads << ", than the "
+      << svtkSMPTools::GetEstimatedNumberOfThreads() << " available")
+    return -1;
+    }
+
+  return 0;
+}
+
+int main(int, char **)
+{
+  int err = 0;
+
+  std::cerr << "svtkSMPTools backend " << SVTK_SMP_BACKEND << " with "
+    << svtkSMPTools::GetEstimatedNumberOfThreads() << " threads" << std::endl;
+
+  // a range of sizes and grains, including ranges smaller than a grain
+  // and ranges that do not divide evenly
+  for (svtkIdType n : {0, 1, 7, 1000, 100003})
+    {
+    for (svtkIdType grain : {0, 1, 3, 64, 200000})
+      err |= Check(n, grain, false);
+    }
+
+  // For called from inside For
+  err |= Check(10000, 10, true);
+
+  // changing the number of threads
+  for (int nThreads : {3, 1, 2})
+    {
+    svtkSMPTools::Initialize(nThreads);
+    if (std::string(SVTK_SMP_BACKEND) == "STDThread")
+      {
+      if (svtkSMPTools::GetEstimatedNumberOfThreads() != nThreads)
+        {
+        SENSEI_ERROR("Initialize(" << nThreads << ") gave "
+          << svtkSMPTools::GetEstimatedNumberOfThreads() << " threads")
+        err = -1;
+        }
+      }
+    err |= Check(100003, 0, false);
+    }
+
+  // a parallel algorithm in SVTK, the range of an array
+  svtkIdType n = 1000003;
+  svtkSmartPointer<svtkDoubleArray> da = svtkSmartPointer<svtkDoubleArray>::New();
+  da->SetNumberOfTuples(n);
+  for (svtkIdType i = 0; i < n; ++i)
+    da->SetValue(i, double((i*7919) % n) - 100.0);
+
+  double range[2];
+  da->GetRange(range);
+  if ((range[0] != -100.0) || (range[1] != double(n - 1) - 100.0))
+    {
+    SENSEI_ERROR("The array range [" << range[0] << ", " << range[1]
+      << "] is incorrect")
+    err = -1;
+    }
+
+  return err ? -1 : 0;
+}
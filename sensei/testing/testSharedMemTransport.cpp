@@ -0,0 +1,453 @@
+#include "SharedMemAnalysisAdaptor.h"
+#include "SharedMemDataAdaptor.h"
+#include "SVTKDataAdaptor.h"
+#include "MeshMetadata.h"
+#include "Error.h"
+
+#include <svtkCellArray.h>
+#include <svtkCellType.h>
+#include <svtkCellData.h>
+#include <svtkDataObject.h>
+#include <svtkDoubleArray.h>
+#include <svtkImageData.h>
+#include <svtkIdTypeArray.h>
+#include <svtkMultiBlockDataSet.h>
+#include <svtkPointData.h>
+#include <svtkPoints.h>
+#include <svtkSmartPointer.h>
+#include <svtkUnstructuredGrid.h>
+
+#include <unistd.h>
+#include <mpi.h>
+#include <string>
+#include <utility>
+#include <vector>
+#include <sstream>
+#include <iostream>
+
+// Validates the shared memory transport. The first half of the ranks send an
+// image and an unstructured mesh, two blocks of each per rank, over more
+// steps than there are slots, so that the slots are reused. The second half
+// of the ranks receive them with the default block partitioner. The values
+// of the structure and of the arrays are checked on each step. Arrays must
+// be used in place, two reads in the same step share their values, and must
+// remain valid after their step is released and the slot is overwritten.
+// The end of the stream must be seen after the last step. Run with an even
+// number of ranks, at least 2.
+
+const int nSteps = 6;
+const int nSlots = 2;
+const int nBlocksPerSender = 2;
+const int nx = 5;
+
+// the value of an array element
+double Value(int step, int block, int i)
+{
+  return 10000.0*step + 100.0*block + i;
+}
+
+// an image block of nx^3 points
+svtkImageData *NewImage(int step, int block)
+{
+  svtkImageData *im = svtkImageData::New();
+  im->SetExtent(block*(nx - 1), (block + 1)*(nx - 1), 0, nx - 1, 0, nx - 1);
+  im->SetOrigin(1.0, 2.0, 3.0);
+  im->SetSpacing(0.5, 0.25, 0.125);
+
+  svtkDoubleArray *da = svtkDoubleArray::New();
+  da->SetName("data");
+  da->SetNumberOfTuples(nx*nx*nx);
+  for (int i = 0; i < nx*nx*nx; ++i)
+    da->SetValue(i, Value(step, block, i));
+
+  im->GetPointData()->AddArray(da);
+  da->Delete();
+
+  return im;
+}
+
+// an unstructured block of a tetrahedron and a triangle
+svtkUnstructuredGrid *NewUnstructured(int step, int block)
+{
+  svtkPoints *pts = svtkPoints::New();
+  pts->SetDataTypeToDouble();
+  pts->InsertNextPoint(block, 0.0, 0.0);
+  pts->InsertNextPoint(block + 1.0, 0.0, 0.0);
+  pts->InsertNextPoint(block, 1.0, 0.0);
+  pts->InsertNextPoint(block, 0.0, 1.0);
+  pts->InsertNextPoint(block + 1.0, 1.0, 0.0);
+
+  svtkUnstructuredGrid *ug = svtkUnstructuredGrid::New();
+  ug->SetPoints(pts);
+  pts->Delete();
+
+  svtkIdType tet[] = {0, 1, 2, 3};
+  svtkIdType tri[] = {1, 4, 2};
+  ug->Allocate(2);
+  ug->InsertNextCell(SVTK_TETRA, 4, tet);
+  ug->InsertNextCell(SVTK_TRIANGLE, 3, tri);
+
+  svtkDoubleArray *da = svtkDoubleArray::New();
+  da->SetName("data");
+  da->SetNumberOfTuples(2);
+  da->SetValue(0, Value(step, block, 0));
+  da->SetValue(1, Value(step, block, 1));
+
+  ug->GetCellData()->AddArray(da);
+  da->Delete();
+
+  return ug;
+}
+
+// --------------------------------------------------------------------------
+int Send(MPI_Comm comm, const std::string &name,
+  sensei::SharedMemAnalysisAdaptor *aa, sensei::SVTKDataAdaptor *da)
+{
+  int rank = 0;
+  int nRanks = 1;
+  MPI_Comm_rank(comm, &rank);
+  MPI_Comm_size(comm, &nRanks);
+
+  aa->SetCommunicator(comm);
+  aa->SetStreamName(name);
+  aa->SetNumberOfSlots(nSlots);
+  aa->AddDataRequirement("image", svtkDataObject::POINT, {"data"});
+  aa->AddDataRequirement("unstructured", svtkDataObject::CELL, {"data"});
+
+  da->SetCommunicator(comm);
+
+  int nBlocks = nRanks*nBlocksPerSender;
+
+  int ierr = 0;
+  for (int step = 0; !ierr && (step < nSteps); ++step)
+    {
+    svtkMultiBlockDataSet *image = svtkMultiBlockDataSet::New();
+    image->SetNumberOfBlocks(nBlocks);
+
+    svtkMultiBlockDataSet *unstructured = svtkMultiBlockDataSet::New();
+    unstructured->SetNumberOfBlocks(nBlocks);
+
+    for (int i = 0; i < nBlocksPerSender; ++i)
+      {
+      int block = rank*nBlocksPerSender + i;
+
+      svtkImageData *im = NewImage(step, block);
+      image->SetBlock(block, im);
+      im->Delete();
+
+      svtkUnstructuredGrid *ug = NewUnstructured(step, block);
+      unstructured->SetBlock(block, ug);
+      ug->Delete();
+      }
+
+    da->SetDataTimeStep(step);
+    da->SetDataTime(0.5*step);
+    da->SetDataObject("image", image);
+    da->SetDataObject("unstructured", unstructured);
+
+    image->Delete();
+    unstructured->Delete();
+
+    // the simulation's data is released and modified after each step
+    if (!aa->Execute(da, nullptr))
+      {
+      SENSEI_ERROR("Failed to send step " << step)
+      ierr = -1;
+      }
+
+    da->ReleaseData();
+    }
+
+  if (aa->Finalize())
+    ierr = -1;
+
+  return ierr;
+}
+
+// an array kept after its step was released, and the block it came from
+using HeldArray = std::pair<int, svtkSmartPointer<svtkDataArray>>;
+
+// --------------------------------------------------------------------------
+int CheckImage(sensei::SharedMemDataAdaptor *da, int step,
+  std::vector<HeldArray> &held)
+{
+  svtkDataObject *mesh = nullptr;
+  if (da->GetMesh("image", false, mesh) ||
+    da->AddArray(mesh, "image", svtkDataObject::POINT, "data"))
+    {
+    SENSEI_ERROR("Failed to get the image")
+    return -1;
+    }
+
+  // a second read shares the values of the first
+  svtkDataObject *mesh2 = nullptr;
+  if (da->GetMesh("image", true, mesh2) ||
+    da->AddArray(mesh2, "image", svtkDataObject::POINT, "data"))
+    {
+    SENSEI_ERROR("Failed to get the image again")
+    if (mesh2)
+      mesh2->Delete();
+    mesh->Delete();
+    return -1;
+    }
+
+  svtkMultiBlockDataSet *mbds = dynamic_cast<svtkMultiBlockDataSet*>(mesh);
+  svtkMultiBlockDataSet *mbds2 = dynamic_cast<svtkMultiBlockDataSet*>(mesh2);
+
+  int ierr = 0;
+  unsigned int nBlocks = mbds->GetNumberOfBlocks();
+  for (unsigned int block = 0; !ierr && (block < nBlocks); ++block)
+    {
+    svtkImageData *im = dynamic_cast<svtkImageData*>(mbds->GetBlock(block));
+    if (!im)
+      continue;
+
+    int ext[6];
+    im->GetExtent(ext);
+
+    double x0[3];
+    im->GetOrigin(x0);
+
+    double dx[3];
+    im->GetSpacing(dx);
+
+    if ((ext[0] != int(block)*(nx - 1)) || (ext[1] != int(block + 1)*(nx - 1)) ||
+      (ext[3] != nx - 1) || (ext[5] != nx - 1) || (x0[0] != 1.0) ||
+      (x0[2] != 3.0) || (dx[0] != 0.5) || (dx[2] != 0.125))
+      {
+      SENSEI_ERROR("Wrong structure in block " << block << " step " << step)
+      ierr = -1;
+      break;
+      }
+
+    svtkDataArray *data = im->GetPointData()->GetArray("data");
+    if (!data || (data->GetNumberOfTuples() != nx*nx*nx))
+      {
+      SENSEI_ERROR("Missing data in block " << block << " step " << step)
+      ierr = -1;
+      break;
+      }
+
+    for (int i = 0; i < nx*nx*nx; ++i)
+      {
+      if (data->GetTuple1(i) != Value(step, block, i))
+        {
+        SENSEI_ERROR("Wrong value at " << i << " in block " << block
+          << " step " << step << " " << data->GetTuple1(i) << " != "
+          << Value(step, block, i))
+        ierr = -1;
+        break;
+        }
+      }
+
+    svtkImageData *im2 = dynamic_cast<svtkImageData*>(mbds2->GetBlock(block));
+    svtkDataArray *data2 = im2 ? im2->GetPointData()->GetArray("data") : nullptr;
+    if (!data2 || (data2->GetVoidPointer(0) != data->GetVoidPointer(0)))
+      {
+      SENSEI_ERROR("The data was copied in block " << block << " step " << step)
+      ierr = -1;
+      break;
+      }
+
+    held.push_back(HeldArray(block, data));
+    }
+
+  mesh->Delete();
+  mesh2->Delete();
+
+  return ierr;
+}
+
+// --------------------------------------------------------------------------
+int CheckUnstructured(sensei::SharedMemDataAdaptor *da, int step)
+{
+  svtkDataObject *mesh = nullptr;
+  if (da->GetMesh("unstructured", false, mesh) ||
+    da->AddArray(mesh, "unstructured", svtkDataObject::CELL, "data"))
+    {
+    SENSEI_ERROR("Failed to get the unstructured mesh")
+    return -1;
+    }
+
+  svtkMultiBlockDataSet *mbds = dynamic_cast<svtkMultiBlockDataSet*>(mesh);
+
+  int ierr = 0;
+  unsigned int nBlocks = mbds->GetNumberOfBlocks();
+  for (unsigned int block = 0; !ierr && (block < nBlocks); ++block)
+    {
+    svtkUnstructuredGrid *ug =
+      dynamic_cast<svtkUnstructuredGrid*>(mbds->GetBlock(block));
+    if (!ug)
+      continue;
+
+    svtkIdType npts = 0;
+    const svtkIdType *pts = nullptr;
+
+    double x[3];
+    ug->GetPoint(4, x);
+
+    if ((ug->GetNumberOfPoints() != 5) || (ug->GetNumberOfCells() != 2) ||
+      (ug->GetCellType(0) != SVTK_TETRA) || (ug->GetCellType(1) != SVTK_TRIANGLE) ||
+      (x[0] != block + 1.0) || (x[1] != 1.0))
+      {
+      SENSEI_ERROR("Wrong structure in block " << block << " step " << step)
+      ierr = -1;
+      break;
+      }
+
+    ug->GetCells()->GetCellAtId(1, npts, pts);
+    if ((npts != 3) || (pts[0] != 1) || (pts[1] != 4) || (pts[2] != 2))
+      {
+      SENSEI_ERROR("Wrong connectivity in block " << block << " step " << step)
+      ierr = -1;
+      break;
+      }
+
+    svtkDataArray *data = ug->GetCellData()->GetArray("data");
+    if (!data || (data->GetNumberOfTuples() != 2) ||
+      (data->GetTuple1(0) != Value(step, block, 0)) ||
+      (data->GetTuple1(1) != Value(step, block, 1)))
+      {
+      SENSEI_ERROR("Wrong data in block " << block << " step " << step)
+      ierr = -1;
+      break;
+      }
+    }
+
+  mesh->Delete();
+
+  return ierr;
+}
+
+// --------------------------------------------------------------------------
+int Receive(MPI_Comm comm, const std::string &name,
+  sensei::SharedMemDataAdaptor *da)
+{
+  int rank = 0;
+  MPI_Comm_rank(comm, &rank);
+
+  da->SetCommunicator(comm);
+  da->SetStreamName(name);
+  da->SetTimeout(60.0);
+
+  if (da->OpenStream())
+    {
+    SENSEI_ERROR("Failed to open the stream")
+    return -1;
+    }
+
+  // arrays from earlier steps, these must outlive their steps
+  std::vector<std::vector<HeldArray>> held;
+
+  int ierr = 0;
+  int step = 0;
+  while (!ierr && (da->StreamGood() == 0))
+    {
+    if ((da->GetDataTimeStep() != step) ||
+      (da->GetDataTime() != 0.5*step))
+      {
+      SENSEI_ERROR("Wrong time step " << da->GetDataTimeStep()
+        << " expected " << step)
+      ierr = -1;
+      break;
+      }
+
+    held.emplace_back();
+    if (CheckImage(da, step, held.back()) || CheckUnstructured(da, step))
+      {
+      ierr = -1;
+      break;
+      }
+
+    // release the step so that the senders reuse its slot
+    da->ReleaseData();
+
+    // check the arrays held from earlier steps
+    for (int j = 0; !ierr && (j <= step); ++j)
+      {
+      unsigned int nHeld = held[j].size();
+      for (unsigned int i = 0; i < nHeld; ++i)
+        {
+        int block = held[j][i].first;
+        svtkDataArray *data = held[j][i].second;
+        if ((data->GetTuple1(0) != Value(j, block, 0)) ||
+          (data->GetTuple1(nx*nx*nx - 1) != Value(j, block, nx*nx*nx - 1)))
+          {
+          SENSEI_ERROR("The array held from block " << block << " step " << j
+            << " was modified after step " << step)
+          ierr = -1;
+          break;
+          }
+        }
+      }
+
+    ++step;
+
+    if (da->AdvanceStream() < 0)
+      ierr = -1;
+    }
+
+  if (!ierr && (step != nSteps))
+    {
+    SENSEI_ERROR("Received " << step << " steps, expected " << nSteps)
+    ierr = -1;
+    }
+
+  da->CloseStream();
+  da->Finalize();
+
+  if (!ierr && (rank == 0))
+    SENSEI_STATUS("Received " << step << " steps")
+
+  return ierr;
+}
+
+// --------------------------------------------------------------------------
+int main(int argc, char **argv)
+{
+  MPI_Init(&argc, &argv);
+
+  int rank = 0;
+  int nRanks = 1;
+  MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+  MPI_Comm_size(MPI_COMM_WORLD, &nRanks);
+
+  if ((nRanks < 2) || (nRanks % 2))
+    {
+    SENSEI_ERROR("Run with an even number of ranks, not " << nRanks)
+    MPI_Finalize();
+    return -1;
+    }
+
+  // a name unique to this run
+  int pid = getpid();
+  MPI_Bcast(&pid, 1, MPI_INT, 0, MPI_COMM_WORLD);
+
+  std::ostringstream oss;
+  oss << "testSharedMem" << pid;
+  std::string name = oss.str();
+
+  // the adaptors are constructed on all ranks as their constructors are
+  // collective over MPI_COMM_WORLD
+  sensei::SharedMemAnalysisAdaptor *aa = sensei::SharedMemAnalysisAdaptor::New();
+  sensei::SVTKDataAdaptor *sda = sensei::SVTKDataAdaptor::New();
+  sensei::SharedMemDataAdaptor *rda = sensei::SharedMemDataAdaptor::New();
+
+  int sender = rank < nRanks/2;
+
+  MPI_Comm comm = MPI_COMM_NULL;
+  MPI_Comm_split(MPI_COMM_WORLD, sender, rank, &comm);
+
+  int ierr = sender ? Send(comm, name, aa, sda) : Receive(comm, name, rda);
+
+  aa->Delete();
+  sda->Delete();
+  rda->Delete();
+
+  MPI_Allreduce(MPI_IN_PLACE, &ierr, 1, MPI_INT, MPI_MIN, MPI_COMM_WORLD);
+
+  MPI_Comm_free(&comm);
+  MPI_Finalize();
+
+  return ierr ? -1 : 0;
+}
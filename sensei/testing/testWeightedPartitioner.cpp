@@ -0,0 +1,251 @@
+#include "WeightedPartitioner.h"
+#include "BlockPartitioner.h"
+#include "ConfigurablePartitioner.h"
+#include "MeshMetadata.h"
+#include "Error.h"
+
+#include <svtkDataObject.h>
+#include <svtkType.h>
+
+#include <pugixml.hpp>
+
+#include <mpi.h>
+#include <algorithm>
+#include <random>
+#include <vector>
+#include <string>
+#include <sstream>
+#include <iostream>
+
+// Validates the WeightedPartitioner. Blocks whose sizes vary by 100x are
+// partitioned by cells, points, the bytes of named arrays, and user provided
+// weights, with the LPT and prefix sum methods. The partitions must be the
+// same on all ranks, the reported imbalance must match the loads, the prefix
+// sum method must keep consecutive blocks together, and the result must be
+// no worse balanced than the block partitioner's.
+
+// the largest load over the mean load
+double Imbalance(const sensei::MeshMetadataPtr &md,
+  const std::vector<double> &costs, int nRanks)
+{
+  std::vector<double> loads(nRanks, 0.0);
+  double total = 0.0;
+  for (int i = 0; i < md->NumBlocks; ++i)
+    {
+    loads[md->BlockOwner[i]] += costs[i];
+    total += costs[i];
+    }
+  return *std::max_element(loads.begin(), loads.end())*nRanks/total;
+}
+
+int Check(const char *label, sensei::WeightedPartitionerPtr &part,
+  const sensei::MeshMetadataPtr &mdIn, const std::vector<double> &costs,
+  double blockImbalance)
+{
+  int nRanks = 1;
+  MPI_Comm_size(MPI_COMM_WORLD, &nRanks);
+
+  sensei::MeshMetadataPtr mdOut;
+  if (part->GetPartition(MPI_COMM_WORLD, mdIn, mdOut))
+    {
+    SENSEI_ERROR("Failed to partition by " << label)
+    return -1;
+    }
+
+  // the input is not modified
+  if (mdIn->BlockOwner[1] != 0)
+    {
+    SENSEI_ERROR("The input metadata was modified by " << label)
+    return -1;
+    }
+
+  // every rank computes the same partition
+  std::vector<int> owner0(mdOut->BlockOwner);
+  MPI_Bcast(owner0.data(), owner0.size(), MPI_INT, 0, MPI_COMM_WORLD);
+  int same = owner0 == mdOut->BlockOwner;
+  MPI_Allreduce(MPI_IN_PLACE, &same, 1, MPI_INT, MPI_MIN, MPI_COMM_WORLD);
+  if (!same)
+    {
+    SENSEI_ERROR("The partition by " << label << " differs between ranks")
+    return -1;
+    }
+
+  for (int i = 0; i < mdOut->NumBlocks; ++i)
+    {
+    if ((mdOut->BlockOwner[i] < 0) || (mdOut->BlockOwner[i] >= nRanks))
+      {
+      SENSEI_ERROR("Block " << i << " was assigned to rank "
+        << mdOut->BlockOwner[i] << " by " << label)
+      return -1;
+      }
+    }
+
+  double imbalance = Imbalance(mdOut, costs, nRanks);
+  if (std::abs(imbalance - part->GetImbalance()) > 1.0e-9)
+    {
+    SENSEI_ERROR("The imbalance of " << label << " was reported as "
+      << part->GetImbalance() << " not " << imbalance)
+    return -1;
+    }
+
+  if (imbalance > blockImbalance)
+    {
+    SENSEI_ERROR("The imbalance of " << label << ", " << imbalance
+      << ", is worse than the block partitioner's " << blockImbalance)
+    return -1;
+    }
+
+  if (part->GetMethod() == sensei::WeightedPartitioner::METHOD_PREFIX)
+    {
+    if (!std::is_sorted(mdOut->BlockOwner.begin(), mdOut->BlockOwner.end()))
+      {
+      SENSEI_ERROR("The blocks assigned by " << label << " are not contiguous")
+      return -1;
+      }
+    }
+
+  int rank = 0;
+  MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+  if (rank == 0)
+    {
+    std::cerr << label << " imbalance " << imbalance << " block partitioner "
+      << blockImbalance << std::endl;
+    }
+
+  return 0;
+}
+
+int main(int argc, char **argv)
+{
+  MPI_Init(&argc, &argv);
+
+  int nRanks = 1;
+  MPI_Comm_size(MPI_COMM_WORLD, &nRanks);
+
+  // blocks whose sizes vary by 100x, as in an AMR mesh. the large blocks are
+  // clustered so that contiguous ranges of equal numbers of blocks are badly
+  // balanced
+  int nBlocks = 64;
+  std::mt19937 gen(7);
+  std::uniform_real_distribution<double> dist(1.0, 100.0);
+
+  sensei::MeshMetadataPtr md = sensei::MeshMetadata::New();
+  md->MeshName = "mesh";
+  md->NumBlocks = nBlocks;
+  md->NumArrays = 2;
+  md->ArrayName = {"pressure", "velocity"};
+  md->ArrayCentering = {svtkDataObject::CELL, svtkDataObject::POINT};
+  md->ArrayComponents = {1, 3};
+  md->ArrayType = {SVTK_FLOAT, SVTK_DOUBLE};
+
+  for (int i = 0; i < nBlocks; ++i)
+    {
+    long nCells = long(1000*(i < nBlocks/4 ? dist(gen) : 1.0 + dist(gen)/50.0));
+    md->BlockIds.push_back(i);
+    md->BlockOwner.push_back(0);
+    md->BlockNumCells.push_back(nCells);
+    md->BlockNumPoints.push_back(nCells + 2*long(std::sqrt(double(nCells))) + 1);
+    }
+
+  std::vector<double> cells(md->BlockNumCells.begin(), md->BlockNumCells.end());
+  std::vector<double> points(md->BlockNumPoints.begin(), md->BlockNumPoints.end());
+
+  std::vector<double> bytes(nBlocks);
+  for (int i = 0; i < nBlocks; ++i)
+    bytes[i] = 24.0*md->BlockNumPoints[i];
+
+  std::vector<double> weights(nBlocks);
+  for (int i = 0; i < nBlocks; ++i)
+    weights[i] = (i % 5) == 0 ? 50.0 : 1.0;
+
+  // the balance achieved by the block partitioner
+  sensei::BlockPartitionerPtr block = sensei::BlockPartitioner::New();
+  sensei::MeshMetadataPtr mdBlock;
+  block->GetPartition(MPI_COMM_WORLD, md, mdBlock);
+
+  int err = 0;
+
+  sensei::WeightedPartitionerPtr part = sensei::WeightedPartitioner::New();
+  for (const char *method : {"lpt", "prefix"})
+    {
+    part->SetMethod(method);
+
+    part->SetCostModel("cells");
+    err |= Check((std::string("cells ") + method).c_str(), part, md, cells,
+      Imbalance(mdBlock, cells, nRanks));
+
+    part->SetCostModel("points");
+    err |= Check((std::string("points ") + method).c_str(), part, md, points,
+      Imbalance(mdBlock, points, nRanks));
+
+    part->SetCostModel("bytes");
+    part->SetArrays({"velocity"});
+    err |= Check((std::string("bytes ") + method).c_str(), part, md, bytes,
+      Imbalance(mdBlock, bytes, nRanks));
+
+    part->SetCostModel("weights");
+    part->SetBlockWeights(weights);
+    err |= Check((std::string("weights ") + method).c_str(), part, md, weights,
+      Imbalance(mdBlock, weights, nRanks));
+    }
+
+  // configured from XML
+  std::ostringstream xml;
+  xml << "<partitioner type=\"weighted\" cost=\"weights\" method=\"lpt\">"
+    << "<block_weights>";
+  for (int i = 0; i < nBlocks; ++i)
+    xml << weights[i] << " ";
+  xml << "</block_weights></partitioner>";
+
+  pugi::xml_document doc;
+  doc.load_string(xml.str().c_str());
+  pugi::xml_node node = doc.child("partitioner");
+
+  sensei::ConfigurablePartitionerPtr config = sensei::ConfigurablePartitioner::New();
+  sensei::MeshMetadataPtr mdConfig;
+  if (config->Initialize(node) ||
+    config->GetPartition(MPI_COMM_WORLD, md, mdConfig))
+    {
+    SENSEI_ERROR("Failed to partition with a configured weighted partitioner")
+    err = -1;
+    }
+  else
+    {
+    sensei::MeshMetadataPtr mdWeights;
+    part->SetMethod("lpt");
+    part->GetPartition(MPI_COMM_WORLD, md, mdWeights);
+    if (mdConfig->BlockOwner != mdWeights->BlockOwner)
+      {
+      SENSEI_ERROR("The configured partitioner gave a different partition")
+      err = -1;
+      }
+    }
+
+  // invalid configurations are reported
+  std::ostringstream os;
+  std::streambuf *buf = std::cerr.rdbuf(os.rdbuf());
+
+  sensei::MeshMetadataPtr mdBad;
+  part->SetBlockWeights({1.0, 2.0});
+  int badWeights = part->GetPartition(MPI_COMM_WORLD, md, mdBad);
+
+  part->SetCostModel("bytes");
+  part->SetArrays({"density"});
+  int badArray = part->GetPartition(MPI_COMM_WORLD, md, mdBad);
+
+  int badModel = part->SetCostModel("volume");
+
+  std::cerr.rdbuf(buf);
+
+  if (!badWeights || !badArray || !badModel)
+    {
+    SENSEI_ERROR("An invalid configuration was accepted")
+    err = -1;
+    }
+
+  MPI_Allreduce(MPI_IN_PLACE, &err, 1, MPI_INT, MPI_MIN, MPI_COMM_WORLD);
+
+  MPI_Finalize();
+
+  return err ? -1 : 0;
+}
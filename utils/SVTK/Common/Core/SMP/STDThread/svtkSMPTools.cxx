@@ -0,0 +1,303 @@
+/*=========================================================================
+
+  Program:   Visualization Toolkit
+  Module:    svtkSMPTools.cxx
+
+  Copyright (c) Ken Martin, Will Schroeder, Bill Lorensen
+  All rights reserved.
+  See Copyright.txt or http://www.kitware.com/Copyright.htm for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notice for more information.
+
+=========================================================================*/
+
+// The STDThread backend executes svtkSMPTools::For on a pool of std::thread
+// workers that is started on first use. The range is cut into chunks of
+// grain size and the chunks are dealt out in contiguous runs, one run per
+// thread, so that neighboring chunks are processed by the same thread. Each
+// thread works through its own run and then steals the chunks left in the
+// runs of the other threads. Chunks are claimed with an atomic increment, so
+// no locks are taken while the functor executes. The calling thread takes
+// part as thread 0.
+//
+// The number of threads is set by svtkSMPTools::Initialize, or else by the
+// SVTK_SMP_MAX_THREADS environment variable, and defaults to the number of
+// hardware threads. A For issued from inside a For, or while another thread
+// is executing a For, runs on the calling thread.
+
+#include "svtkSMPTools.h"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdlib>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace
+{
+using svtk::detail::smp::ExecuteFunctorPtrType;
+
+// set on the pool's workers and on a thread executing a For
+thread_local bool svtkSMPInParallel = false;
+
+// the number of threads when none are specified
+int svtkSMPGetDefaultNumberOfThreads()
+{
+  const char* env = std::getenv("SVTK_SMP_MAX_THREADS");
+  int numThreads = env ? std::atoi(env) : 0;
+  if (numThreads < 1)
+  {
+    numThreads = static_cast<int>(std::thread::hardware_concurrency());
+  }
+  return std::max(numThreads, 1);
+}
+
+class svtkSMPThreadPool
+{
+public:
+  svtkSMPThreadPool()
+    : NumberOfThreads(svtkSMPGetDefaultNumberOfThreads())
+    , Generation(0)
+    , Pending(0)
+    , Stop(false)
+    , Functor(nullptr)
+    , Executer(nullptr)
+    , First(0)
+    , Last(0)
+    , Grain(0)
+  {
+  }
+
+  ~svtkSMPThreadPool()
+  {
+    std::lock_guard<std::mutex> forLock(this->ForMutex);
+    this->StopWorkers();
+  }
+
+  static svtkSMPThreadPool& GetInstance()
+  {
+    static svtkSMPThreadPool pool;
+    return pool;
+  }
+
+  int GetNumberOfThreads() const { return this->NumberOfThreads; }
+
+  // ignored from inside a For
+  void SetNumberOfThreads(int numThreads)
+  {
+    if (svtkSMPInParallel)
+    {
+      return;
+    }
+
+    std::lock_guard<std::mutex> forLock(this->ForMutex);
+    if (numThreads != this->NumberOfThreads)
+    {
+      // the workers are restarted on the next For
+      this->StopWorkers();
+      this->NumberOfThreads = numThreads;
+    }
+  }
+
+  void For(svtkIdType first, svtkIdType last, svtkIdType grain,
+    ExecuteFunctorPtrType executer, void* functor)
+  {
+    // nested and concurrent calls run on the calling thread
+    std::unique_lock<std::mutex> forLock(this->ForMutex, std::defer_lock);
+    if (svtkSMPInParallel || (this->NumberOfThreads < 2) || !forLock.try_lock())
+    {
+      bool inParallel = svtkSMPInParallel;
+      svtkSMPInParallel = true;
+      for (svtkIdType from = first; from < last; from += grain)
+      {
+        executer(functor, from, grain, last);
+      }
+      svtkSMPInParallel = inParallel;
+      return;
+    }
+
+    this->StartWorkers();
+
+    // deal out the chunks
+    int numThreads = this->NumberOfThreads;
+    svtkIdType numChunks = (last - first + grain - 1) / grain;
+    for (int i = 0; i < numThreads; ++i)
+    {
+      this->Runs[i].Next.store(numChunks * i / numThreads, std::memory_order_relaxed);
+      this->Runs[i].End = numChunks * (i + 1) / numThreads;
+    }
+
+    this->Functor = functor;
+    this->Executer = executer;
+    this->First = first;
+    this->Last = last;
+    this->Grain = grain;
+
+    // wake the workers
+    {
+      std::lock_guard<std::mutex> lock(this->Mutex);
+      this->Pending = numThreads - 1;
+      ++this->Generation;
+    }
+    this->WorkReady.notify_all();
+
+    svtkSMPInParallel = true;
+    this->Work(0);
+    svtkSMPInParallel = false;
+
+    // wait for the chunks taken by the workers
+    std::unique_lock<std::mutex> lock(this->Mutex);
+    this->WorkDone.wait(lock, [this] { return this->Pending == 0; });
+  }
+
+private:
+  svtkSMPThreadPool(const svtkSMPThreadPool&) = delete;
+  void operator=(const svtkSMPThreadPool&) = delete;
+
+  // the chunks dealt to a thread. padded to a cache line, as Next is
+  // updated for every chunk
+  struct Run
+  {
+    std::atomic<svtkIdType> Next;
+    svtkIdType End;
+    char Pad[64 - 2 * sizeof(svtkIdType)];
+  };
+
+  // execute the chunks of the thread's run, then steal from the others
+  void Work(int threadId)
+  {
+    int numThreads = this->NumberOfThreads;
+    for (int i = 0; i < numThreads; ++i)
+    {
+      Run& run = this->Runs[(threadId + i) % numThreads];
+      svtkIdType chunk;
+      while ((chunk = run.Next.fetch_add(1, std::memory_order_relaxed)) < run.End)
+      {
+        this->Executer(this->Functor, this->First + chunk * this->Grain, this->Grain, this->Last);
+      }
+    }
+  }
+
+  // generation is that of the last For executed before the worker started
+  void WorkerLoop(int threadId, unsigned long generation)
+  {
+    svtkSMPInParallel = true;
+
+    std::unique_lock<std::mutex> lock(this->Mutex);
+    for (;;)
+    {
+      this->WorkReady.wait(
+        lock, [&] { return this->Stop || (this->Generation != generation); });
+
+      if (this->Stop)
+      {
+        return;
+      }
+
+      generation = this->Generation;
+
+      lock.unlock();
+      this->Work(threadId);
+      lock.lock();
+
+      if (--this->Pending == 0)
+      {
+        this->WorkDone.notify_one();
+      }
+    }
+  }
+
+  // called with the ForMutex held
+  void StartWorkers()
+  {
+    if (!this->Workers.empty())
+    {
+      return;
+    }
+
+    this->Runs.reset(new Run[this->NumberOfThreads]);
+
+    std::lock_guard<std::mutex> lock(this->Mutex);
+    this->Stop = false;
+    for (int i = 1; i < this->NumberOfThreads; ++i)
+    {
+      this->Workers.emplace_back(&svtkSMPThreadPool::WorkerLoop, this, i, this->Generation);
+    }
+  }
+
+  // called with the ForMutex held
+  void StopWorkers()
+  {
+    {
+      std::lock_guard<std::mutex> lock(this->Mutex);
+      this->Stop = true;
+    }
+    this->WorkReady.notify_all();
+
+    for (std::thread& worker : this->Workers)
+    {
+      worker.join();
+    }
+    this->Workers.clear();
+  }
+
+  std::atomic<int> NumberOfThreads;
+  std::vector<std::thread> Workers;
+  std::unique_ptr<Run[]> Runs;
+
+  // serializes For and changes to the number of threads
+  std::mutex ForMutex;
+
+  // protects Generation, Pending and Stop
+  std::mutex Mutex;
+  std::condition_variable WorkReady;
+  std::condition_variable WorkDone;
+  unsigned long Generation;
+  int Pending;
+  bool Stop;
+
+  // the current For
+  void* Functor;
+  ExecuteFunctorPtrType Executer;
+  svtkIdType First;
+  svtkIdType Last;
+  svtkIdType Grain;
+};
+}
+
+void svtkSMPTools::Initialize(int numThreads)
+{
+  if (numThreads > 0)
+  {
+    svtkSMPThreadPool::GetInstance().SetNumberOfThreads(numThreads);
+  }
+}
+
+int svtkSMPTools::GetEstimatedNumberOfThreads()
+{
+  return svtk::detail::smp::GetNumberOfThreads();
+}
+
+int svtk::detail::smp::GetNumberOfThreads()
+{
+  return svtkSMPThreadPool::GetInstance().GetNumberOfThreads();
+}
+
+void svtk::detail::smp::svtkSMPTools_Impl_For_STDThread(svtkIdType first, svtkIdType last,
+  svtkIdType grain, ExecuteFunctorPtrType functorExecuter, void* functor)
+{
+  svtkSMPThreadPool& pool = svtkSMPThreadPool::GetInstance();
+
+  if (grain <= 0)
+  {
+    svtkIdType estimateGrain = (last - first) / (pool.GetNumberOfThreads() * 4);
+    grain = (estimateGrain > 0) ? estimateGrain : 1;
+  }
+
+  pool.For(first, last, grain, functorExecuter, functor);
+}
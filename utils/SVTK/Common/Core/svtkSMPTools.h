@@ -19,7 +19,7 @@
  * svtkSMPTools provides a set of utility functions that can
  * be used to parallelize parts of SVTK code using multiple threads.
  * There are several back-end implementations of parallel functionality
- * (currently Sequential, TBB and X-Kaapi) that actual execution is
+ * (currently Sequential, STDThread, OpenMP and TBB) that actual execution is
  * delegated to.
  */
 
@@ -224,10 +224,12 @@ public:
    * not required as it is automatically called before the first
    * execution of any parallel code. However, it can be used to
    * control the maximum number of threads used when the back-end
-   * supports it (currently Simple and TBB only). Make sure to call
-   * it before any other parallel operation.
+   * supports it (currently Simple, STDThread, OpenMP and TBB). Make sure
+   * to call it before any other parallel operation.
    * When using Kaapi, use the KAAPI_CPUCOUNT env. variable to control
-   * the number of threads used in the thread pool.
+   * the number of threads used in the thread pool. When using STDThread,
+   * the SVTK_SMP_MAX_THREADS env. variable sets the number of threads
+   * used when Initialize is not called.
    */
   static void Initialize(int numThreads = 0);
 
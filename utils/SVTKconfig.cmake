@@ -7,6 +7,8 @@ set(SVTK_BUILD_EXAMPLES OFF CACHE INTERNAL "")
 set(SVTK_BUILD_TESTING OFF CACHE INTERNAL "")
 set(SVTK_BUILD_DOCUMENTATION OFF CACHE INTERNAL "")
 set(SVTK_BUILD_SHARED_LIBS ON CACHE INTERNAL "")
+set(SVTK_SMP_IMPLEMENTATION_TYPE STDThread CACHE STRING
+  "Which multi-threaded parallelism implementation to use. Options are Sequential, STDThread, OpenMP or TBB")
 set(SVTK_MODULE_ENABLE_SVTK_AcceleratorsSVTKm NO CACHE INTERNAL "")
 set(SVTK_MODULE_ENABLE_SVTK_ChartsCore NO CACHE INTERNAL "")
 set(SVTK_MODULE_ENABLE_SVTK_CommonArchive NO CACHE INTERNAL "")